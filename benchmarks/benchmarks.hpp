@@ -0,0 +1,39 @@
+#ifndef NEKO_BENCHMARKS_HPP
+#define NEKO_BENCHMARKS_HPP
+
+#include "threads.hpp"
+
+namespace neko {
+
+/**
+ * @brief Prints the throughput of short jobs on pools of 1, 2, 4... up to the
+ * worker count of {threadPool}, against a pool whose workers share one locked
+ * queue, as the engine had before the work-stealing deques. Each rate is the
+ * best of a few runs.
+ */
+void benchmarkThreadPool(const Settings &settings, ThreadPool &threadPool);
+
+/**
+ * @brief Prints the nanoseconds per ray/triangle test of the triangle block
+ * kernels of the settings' instruction set against {intersectTriangle}, and
+ * the rays whose closest hits differ.
+ */
+void benchmarkTriangleKernels(const Settings &settings,
+                              ThreadPool &threadPool);
+
+/**
+ * @brief Prints the cost and noise of next event estimation with each
+ * {LightSamplingMode}, on a floor lit by thousands of small emitters of
+ * widely varying power.
+ */
+void benchmarkLightSampling(const Settings &settings, ThreadPool &threadPool);
+
+/**
+ * @brief Prints the RMS error of each {SamplerType} against the sample count
+ * on an edge and a smooth integrand, and the cost of its values.
+ */
+void benchmarkSamplers(const Settings &settings, ThreadPool &threadPool);
+
+} /* namespace neko */
+
+#endif /* NEKO_BENCHMARKS_HPP */
@@ -0,0 +1,132 @@
+#include "benchmarks.hpp"
+
+#include "parallel.hpp"
+#include "sampling.hpp"
+
+#include <cstdio>
+
+namespace neko {
+
+/* Small emitters of widely varying power, lighting points of a floor */
+static constexpr u32 lightCount = 4096;
+static constexpr u32 pointCount = 512;
+static constexpr u32 samplesPerPoint = 1024;
+
+static constexpr u32 lightSamplingModeCount = 3;
+
+void benchmarkLightSampling([[maybe_unused]] const Settings &settings,
+                            ThreadPool &threadPool) {
+  /* Small emitters hovering over a 16 x 16 floor, their power spread over
+  four orders of magnitude */
+  constexpr f32 floorSize = 16.0f;
+  Rng rng{lightCount, pointCount};
+  Scene scene;
+  for (u32 iLight = 0; iLight < lightCount; ++iLight) {
+    f32 power = std::pow(10.0f, 4.0f * rng.nextF32() - 2.0f);
+    Vec3 color = {0.5f + 0.5f * rng.nextF32(), 0.5f + 0.5f * rng.nextF32(),
+                  0.5f + 0.5f * rng.nextF32()};
+    u32 material = scene.addMaterial({{}, color * power});
+    Vec3 center = {(rng.nextF32() - 0.5f) * floorSize,
+                   0.5f + 2.0f * rng.nextF32(),
+                   (rng.nextF32() - 0.5f) * floorSize};
+    auto randomCorner = [&rng, &center]() {
+      return center + Vec3{rng.nextF32() - 0.5f, rng.nextF32() - 0.5f,
+                           rng.nextF32() - 0.5f} *
+                          0.2f;
+    };
+    scene.addTriangle({randomCorner(), randomCorner(), randomCorner()},
+                      material);
+  }
+  constexpr f32 halfFloorSize = 0.5f * floorSize;
+  u32 floor = scene.addMaterial({});
+  scene.addQuad({-halfFloorSize, 0.0f, -halfFloorSize},
+                {-halfFloorSize, 0.0f, halfFloorSize},
+                {halfFloorSize, 0.0f, halfFloorSize},
+                {halfFloorSize, 0.0f, -halfFloorSize}, floor);
+  scene.buildBvh(threadPool, {});
+  std::vector<Vec3> points(pointCount);
+  for (Vec3 &point : points) {
+    point = {(rng.nextF32() - 0.5f) * floorSize, 0.0f,
+             (rng.nextF32() - 0.5f) * floorSize};
+  }
+  const Vec3 normal = {0.0f, 1.0f, 0.0f};
+
+  /* Milliseconds */
+  f64 buildTimes[lightSamplingModeCount] = {};
+  /* Nanoseconds per light sample, shadow ray included */
+  f64 sampleTimes[lightSamplingModeCount] = {};
+  /* Variance of a single sample relative to the squared mean, averaged over
+  the shading points */
+  f64 relativeVariances[lightSamplingModeCount] = {};
+  /* Average estimate over the uniform one, 1 up to noise since every mode is
+  unbiased */
+  f64 meanRatios[lightSamplingModeCount] = {};
+  std::vector<f64> sums(pointCount);
+  std::vector<f64> squareSums(pointCount);
+  f64 uniformTotal = 0.0;
+  for (u32 iMode = 0; iMode < lightSamplingModeCount; ++iMode) {
+    buildTimes[iMode] = static_cast<f64>(
+        scene.buildLights(threadPool, static_cast<LightSamplingMode>(iMode))
+            .buildTime);
+    ScopedTimer timer{TimeUnit::milliseconds};
+    /* Every sample traces its shadow ray, so the timings compare whole next
+    event estimation costs */
+    parallelFor(threadPool, 0, pointCount, 0, [&](u64 iPoint) {
+      SampleStream samples{Rng{iPoint, iMode}};
+      TraversalStats traversalStats;
+      f64 sum = 0.0;
+      f64 squareSum = 0.0;
+      for (u32 iSample = 0; iSample < samplesPerPoint; ++iSample) {
+        LightSample sample;
+        if (sampleLight(scene, points[iPoint], normal, samples, 0, sample) &&
+            !scene.occluded(sample.shadowRay, traversalStats)) {
+          auto value = static_cast<f64>(luminance(sample.radiance));
+          sum += value;
+          squareSum += value * value;
+        }
+      }
+      sums[iPoint] = sum;
+      squareSums[iPoint] = squareSum;
+    });
+    sampleTimes[iMode] = static_cast<f64>(timer.now()) * 1e6 /
+                         (static_cast<f64>(pointCount) *
+                          static_cast<f64>(samplesPerPoint));
+
+    f64 total = 0.0;
+    f64 relativeVarianceSum = 0.0;
+    u32 litPointCount = 0;
+    for (u32 iPoint = 0; iPoint < pointCount; ++iPoint) {
+      f64 mean = sums[iPoint] / samplesPerPoint;
+      total += mean;
+      if (mean > 0.0) {
+        f64 variance = squareSums[iPoint] / samplesPerPoint - mean * mean;
+        relativeVarianceSum += std::max(variance, 0.0) / (mean * mean);
+        ++litPointCount;
+      }
+    }
+    if (iMode == 0) {
+      uniformTotal = total;
+    }
+    relativeVariances[iMode] =
+        litPointCount > 0 ? relativeVarianceSum / litPointCount : 0.0;
+    meanRatios[iMode] = uniformTotal > 0.0 ? total / uniformTotal : 0.0;
+  }
+
+  f64 uniformCost = relativeVariances[0] * sampleTimes[0];
+  for (u32 iMode = 0; iMode < lightSamplingModeCount; ++iMode) {
+    /* RMS error at equal time relative to uniform sampling */
+    f64 equalTimeNoise =
+        uniformCost > 0.0
+            ? std::sqrt(relativeVariances[iMode] * sampleTimes[iMode] /
+                        uniformCost)
+            : 0.0;
+    std::printf("Light sampling %s: build %.2f ms, %.1f ns/sample, relative "
+                "variance %.2f, noise at equal time %.2fx uniform, mean "
+                "%.3fx uniform\n",
+                lightSamplingModeName(static_cast<LightSamplingMode>(iMode)),
+                buildTimes[iMode], sampleTimes[iMode], relativeVariances[iMode],
+                equalTimeNoise, meanRatios[iMode]);
+  }
+}
+
+} /* namespace neko */
@@ -0,0 +1,55 @@
+#include "benchmarks.hpp"
+
+#include <cstring>
+#include <iostream>
+
+struct Benchmark {
+  const char *name;
+  void (*pRun)(const neko::Settings &settings, neko::ThreadPool &threadPool);
+};
+
+static constexpr Benchmark benchmarks[] = {
+    {"thread-pool", &neko::benchmarkThreadPool},
+    {"triangle-kernels", &neko::benchmarkTriangleKernels},
+    {"light-sampling", &neko::benchmarkLightSampling},
+    {"samplers", &neko::benchmarkSamplers},
+};
+
+static int protected_main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " <benchmark|all> [settings-file]\nBenchmarks:";
+    for (const auto &benchmark : benchmarks) {
+      std::cerr << ' ' << benchmark.name;
+    }
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+  /* The settings size the pool and select the kernels, as in the engine */
+  auto settings = argc > 2 ? neko::Settings{argv[2]} : neko::Settings{};
+  neko::ThreadPool threadPool{settings};
+  bool runAll = std::strcmp(argv[1], "all") == 0;
+  bool found = false;
+  for (const auto &benchmark : benchmarks) {
+    if (runAll || std::strcmp(argv[1], benchmark.name) == 0) {
+      found = true;
+      benchmark.pRun(settings, threadPool);
+    }
+  }
+  if (!found) {
+    std::cerr << "Unknown benchmark " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+  try {
+    return protected_main(argc, argv);
+  } catch (std::exception &e) {
+    std::cerr << e.what() << std::endl;
+  } catch (...) {
+    std::cerr << "Uncaught exception" << std::endl;
+  }
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,180 @@
+#include "benchmarks.hpp"
+
+#include "math.hpp"
+#include "parallel.hpp"
+#include "sampler.hpp"
+
+#include <bit>
+#include <cmath>
+#include <cstdio>
+
+namespace neko {
+
+/**
+ * @brief RMS error of each {SamplerType} over {sampleCounts} samples per
+ * pixel, and its cost, measured by {measureConvergence}.
+ */
+struct SamplerConvergence {
+  static constexpr u32 maxCountLog2 = 10;
+
+  SimdIsa isa = SimdIsa::scalar;
+  /* 1, 2, 4, ... samples per pixel */
+  u32 sampleCounts[maxCountLog2 + 1] = {};
+  u32 countCount = 0;
+  /* Indexed by type then sample count, for the coverage of a disk edge and
+  for a smooth 4D function */
+  f64 edgeRmse[3][maxCountLog2 + 1] = {};
+  f64 smoothRmse[3][maxCountLog2 + 1] = {};
+  /* Nanoseconds per value generated one at a time and by rows */
+  f64 sampleTimes[3] = {};
+  f64 rowSampleTimes[3] = {};
+  /* Values of {Sampler::sampleRow} differing from those of
+  {Sampler::sample} */
+  u32 rowMismatchCount = 0;
+};
+
+/**
+ * @brief Integrates functions with known integrals over the unit square and
+ * the unit 4D cube in every pixel of a {pixelCountSide}^2 image, with up to
+ * {maxSampleCount} samples per pixel (a power of two up to
+ * 2^{maxCountLog2}), and measures the RMS error of the pixel estimates. PCG
+ * numbers are drawn from a sequential {Rng} as the path tracers do, but are
+ * timed with the hashed values of {Sampler}.
+ */
+static SamplerConvergence measureConvergence(ThreadPool &threadPool,
+                                             SimdIsa isa, u32 pixelCountSide,
+                                             u32 maxSampleCount) {
+  maxSampleCount = std::bit_floor(std::clamp(
+      maxSampleCount, 1u, 1u << SamplerConvergence::maxCountLog2));
+  u32 pixelCount = pixelCountSide * pixelCountSide;
+  constexpr auto piF64 = static_cast<f64>(pi);
+  SamplerConvergence convergence;
+  convergence.countCount = static_cast<u32>(std::countr_zero(maxSampleCount)) +
+                           1;
+  for (u32 iCount = 0; iCount < convergence.countCount; ++iCount) {
+    convergence.sampleCounts[iCount] = 1u << iCount;
+  }
+
+  /* Squared errors of each pixel, indexed by pixel then sample count */
+  std::vector<f64> edgeErrors(stdu64(pixelCount) * convergence.countCount);
+  std::vector<f64> smoothErrors(edgeErrors.size());
+  /* Values generated one at a time then by rows, indexed by sample,
+  dimension, row and pixel */
+  constexpr u32 timedSampleCount = 16;
+  std::vector<f32> values(stdu64(timedSampleCount) * sobolBlockSize *
+                          pixelCount);
+  std::vector<f32> rowValues(values.size());
+  for (u32 iType = 0; iType < 3; ++iType) {
+    Sampler sampler{static_cast<SamplerType>(iType), isa};
+    convergence.isa = sampler.isa();
+    parallelFor(threadPool, 0, pixelCount, 0, [&](u64 iPixel) {
+      auto x = static_cast<u32>(iPixel % pixelCountSide);
+      auto y = static_cast<u32>(iPixel / pixelCountSide);
+      /* Seeded as the path tracers seed their pixels */
+      SampleStream samples{&sampler, x, y, Rng{hashU64(iPixel)}};
+      f64 edgeSum = 0.0;
+      f64 smoothSum = 0.0;
+      for (u32 iSample = 0; iSample < maxSampleCount; ++iSample) {
+        samples.startSample(iSample);
+        /* Coverage of a quarter disk, whose edge crosses the pixel like
+        the edges of the scene do */
+        f32 u = samples.get(0);
+        f32 v = samples.get(1);
+        edgeSum += u * u + v * v < 1.0f ? 1.0 : 0.0;
+        /* Smooth in 4 dimensions, past the camera ones, with integral 1 */
+        f64 product = 1.0;
+        for (u32 component = 0; component < sobolBlockSize; ++component) {
+          product *= 0.5 * piF64 *
+                     std::sin(piF64 * static_cast<f64>(samples.get(
+                                          sobolBlockSize + component)));
+        }
+        smoothSum += product;
+        u32 sampleCount = iSample + 1;
+        if (std::has_single_bit(sampleCount)) {
+          auto iCount = static_cast<u32>(std::countr_zero(sampleCount));
+          f64 edgeError = edgeSum / sampleCount - 0.25 * piF64;
+          f64 smoothError = smoothSum / sampleCount - 1.0;
+          edgeErrors[iPixel * convergence.countCount + iCount] =
+              edgeError * edgeError;
+          smoothErrors[iPixel * convergence.countCount + iCount] =
+              smoothError * smoothError;
+        }
+      }
+    });
+    for (u32 iCount = 0; iCount < convergence.countCount; ++iCount) {
+      f64 edgeErrorSum = 0.0;
+      f64 smoothErrorSum = 0.0;
+      for (u32 iPixel = 0; iPixel < pixelCount; ++iPixel) {
+        edgeErrorSum += edgeErrors[iPixel * convergence.countCount + iCount];
+        smoothErrorSum +=
+            smoothErrors[iPixel * convergence.countCount + iCount];
+      }
+      convergence.edgeRmse[iType][iCount] =
+          std::sqrt(edgeErrorSum / pixelCount);
+      convergence.smoothRmse[iType][iCount] =
+          std::sqrt(smoothErrorSum / pixelCount);
+    }
+
+    /* Timed on the calling thread, PCG with the hashed values of
+    {Sampler} */
+    auto valueCount = static_cast<f64>(values.size());
+    ScopedTimer timer{TimeUnit::milliseconds};
+    f32 *pValue = values.data();
+    for (u32 iSample = 0; iSample < timedSampleCount; ++iSample) {
+      for (u32 dimension = 0; dimension < sobolBlockSize; ++dimension) {
+        for (u32 y = 0; y < pixelCountSide; ++y) {
+          for (u32 x = 0; x < pixelCountSide; ++x) {
+            *pValue++ = sampler.sample(x, y, iSample, dimension);
+          }
+        }
+      }
+    }
+    convergence.sampleTimes[iType] =
+        static_cast<f64>(timer.now()) * 1e6 / valueCount;
+    timer.reset();
+    pValue = rowValues.data();
+    for (u32 iSample = 0; iSample < timedSampleCount; ++iSample) {
+      for (u32 dimension = 0; dimension < sobolBlockSize; ++dimension) {
+        for (u32 y = 0; y < pixelCountSide; ++y) {
+          sampler.sampleRow(0, y, pixelCountSide, iSample, dimension, pValue);
+          pValue += pixelCountSide;
+        }
+      }
+    }
+    convergence.rowSampleTimes[iType] =
+        static_cast<f64>(timer.now()) * 1e6 / valueCount;
+    for (u64 iValue = 0; iValue < values.size(); ++iValue) {
+      if (std::bit_cast<u32>(values[iValue]) !=
+          std::bit_cast<u32>(rowValues[iValue])) {
+        ++convergence.rowMismatchCount;
+      }
+    }
+  }
+  return convergence;
+}
+
+void benchmarkSamplers(const Settings &settings, ThreadPool &threadPool) {
+  SamplerConvergence convergence = measureConvergence(
+      threadPool, settings.graphics.pathTracer.simdIsa, 64, 256);
+  for (u32 iCount = 0; iCount < convergence.countCount; ++iCount) {
+    std::printf("Sampler RMSE at %u spp: edge %.5f pcg, %.5f sobol, %.5f blue "
+                "noise, smooth %.5f pcg, %.5f sobol, %.5f blue noise\n",
+                convergence.sampleCounts[iCount],
+                convergence.edgeRmse[0][iCount],
+                convergence.edgeRmse[1][iCount],
+                convergence.edgeRmse[2][iCount],
+                convergence.smoothRmse[0][iCount],
+                convergence.smoothRmse[1][iCount],
+                convergence.smoothRmse[2][iCount]);
+  }
+  for (u32 iType = 0; iType < 3; ++iType) {
+    std::printf("Sampler %s: %.1f ns/value, %.1f ns/value by %s rows\n",
+                samplerTypeName(static_cast<SamplerType>(iType)),
+                convergence.sampleTimes[iType],
+                convergence.rowSampleTimes[iType],
+                simdIsaName(convergence.isa));
+  }
+  std::printf("Sampler rows: %u mismatches\n", convergence.rowMismatchCount);
+}
+
+} /* namespace neko */
@@ -0,0 +1,167 @@
+#include "benchmarks.hpp"
+
+#include <cstdio>
+#include <queue>
+
+namespace neko {
+
+/**
+ * @brief Workers taking their jobs from one queue behind one mutex, the
+ * design {ThreadPool} replaced.
+ */
+class SharedQueuePool {
+public:
+  explicit SharedQueuePool(u64 workerCount) {
+    for (u64 iWorker = 0; iWorker < workerCount; ++iWorker) {
+      mThreads.emplace_back([this] { workLoop(); });
+    }
+  }
+  SharedQueuePool(const SharedQueuePool &) = delete;
+  SharedQueuePool(SharedQueuePool &&) = delete;
+  SharedQueuePool &operator=(const SharedQueuePool &) = delete;
+  SharedQueuePool &operator=(SharedQueuePool &&) = delete;
+
+  ~SharedQueuePool() {
+    {
+      std::lock_guard lock{mMutex};
+      mStopping = true;
+    }
+    mCondition.notify_all();
+    for (auto &thread : mThreads) {
+      thread.join();
+    }
+  }
+
+  void submit(std::function<void()> job) {
+    mPendingCount.fetch_add(1);
+    {
+      std::lock_guard lock{mMutex};
+      mJobs.push(std::move(job));
+    }
+    mCondition.notify_one();
+  }
+
+  void waitIdle() {
+    while (mPendingCount.load() > 0) {
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  std::vector<std::thread> mThreads;
+  std::queue<std::function<void()>> mJobs;
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  bool mStopping = false;
+  std::atomic<u64> mPendingCount = 0;
+
+  void workLoop() {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock lock{mMutex};
+        mCondition.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+        if (mJobs.empty()) {
+          return;
+        }
+        job = std::move(mJobs.front());
+        mJobs.pop();
+      }
+      job();
+      mPendingCount.fetch_sub(1);
+    }
+  }
+};
+
+/* Jobs run at each worker count */
+static constexpr u64 jobCount = 1 << 18;
+
+/* Runs per pool and worker count, the fastest is reported so that other
+processes preempting the workers skew the comparison less */
+static constexpr u32 repetitionCount = 5;
+
+/* Jobs submitted by each job the benchmark submits itself, most jobs are
+submitted by other jobs, as those of {parallelFor} and {TaskGraph} are */
+static constexpr u32 fanOut = 64;
+
+/* Results of the benchmark jobs, per thread so that they share no cache line.
+Volatile, so that the compiler keeps the work whose result is never read */
+static thread_local volatile u64 jobSink = 0;
+
+/* Less than a hundred nanoseconds of dependent arithmetic, short enough that
+scheduling dominates */
+static u64 jobWork(u64 seed) {
+  u64 value = seed;
+  for (u32 iStep = 0; iStep < 64; ++iStep) {
+    value = value * 6364136223846793005ull + 1442695040888963407ull;
+  }
+  return value;
+}
+
+/* Millions of jobs per second */
+static f64 toJobRate(u64 time) {
+  return static_cast<f64>(jobCount) * 1e3 /
+         static_cast<f64>(std::max<u64>(time, 1));
+}
+
+static f64 runWorkStealing(const Settings &settings, u32 workerCount) {
+  Settings poolSettings = settings;
+  poolSettings.system.workerCount = workerCount;
+  ThreadPool threadPool{poolSettings};
+  JobCounter counter;
+  u64 start = metricsClock();
+  for (u64 iRoot = 0; iRoot < jobCount / fanOut; ++iRoot) {
+    threadPool.submit(
+        [&threadPool, &counter, iRoot] {
+          for (u32 iLeaf = 1; iLeaf < fanOut; ++iLeaf) {
+            threadPool.submit(
+                [seed = iRoot * fanOut + iLeaf] { jobSink = jobWork(seed); },
+                counter);
+          }
+          jobSink = jobWork(iRoot * fanOut);
+        },
+        counter);
+  }
+  threadPool.wait(counter);
+  return toJobRate(metricsClock() - start);
+}
+
+static f64 runSharedQueue(u32 workerCount) {
+  SharedQueuePool sharedQueuePool{workerCount};
+  u64 start = metricsClock();
+  for (u64 iRoot = 0; iRoot < jobCount / fanOut; ++iRoot) {
+    sharedQueuePool.submit([&sharedQueuePool, iRoot] {
+      for (u32 iLeaf = 1; iLeaf < fanOut; ++iLeaf) {
+        sharedQueuePool.submit(
+            [seed = iRoot * fanOut + iLeaf] { jobSink = jobWork(seed); });
+      }
+      jobSink = jobWork(iRoot * fanOut);
+    });
+  }
+  sharedQueuePool.waitIdle();
+  return toJobRate(metricsClock() - start);
+}
+
+void benchmarkThreadPool(const Settings &settings, ThreadPool &threadPool) {
+  auto maxWorkerCount = static_cast<u32>(threadPool.threadCount());
+  std::printf("Thread pool, M jobs/s\n%8s %14s %14s\n", "workers",
+              "work-stealing", "shared queue");
+  for (u32 workerCount = 1;;
+       workerCount = std::min(workerCount * 2, maxWorkerCount)) {
+    f64 workStealingRate = 0.0;
+    f64 sharedQueueRate = 0.0;
+    for (u32 iRepetition = 0; iRepetition < repetitionCount; ++iRepetition) {
+      workStealingRate =
+          std::max(workStealingRate, runWorkStealing(settings, workerCount));
+      sharedQueueRate =
+          std::max(sharedQueueRate, runSharedQueue(workerCount));
+    }
+    std::printf("%8u %14.2f %14.2f\n", workerCount, workStealingRate,
+                sharedQueueRate);
+    if (workerCount >= maxWorkerCount) {
+      break;
+    }
+  }
+}
+
+} /* namespace neko */
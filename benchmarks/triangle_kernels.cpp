@@ -0,0 +1,150 @@
+#include "benchmarks.hpp"
+
+#include "random.hpp"
+#include "simd_lanes.hpp"
+#include "triangle_block.hpp"
+
+#include <cstdio>
+#include <span>
+
+namespace neko {
+
+namespace scalar_kernels {
+
+template <u32 Width> using BlockLanes_T = Lanes;
+
+#include "triangle_block_intersect.inl"
+
+} /* namespace scalar_kernels */
+
+#if NEKO_SIMD_X86
+namespace sse_kernels {
+
+template <u32 Width> using BlockLanes_T = Lanes;
+
+#include "triangle_block_intersect.inl"
+
+} /* namespace sse_kernels */
+
+NEKO_BEGIN_TARGET_AVX2
+namespace avx2_kernels {
+
+template <u32 Width>
+using BlockLanes_T =
+    std::conditional_t<Width == 8, Lanes, sse_kernels::Lanes>;
+
+#include "triangle_block_intersect.inl"
+
+} /* namespace avx2_kernels */
+NEKO_END_TARGET_AVX2
+#endif /* NEKO_SIMD_X86 */
+
+template <u32 Width>
+using IntersectBlocksFunc_T = bool (*)(const TriangleBlock<Width> *pBlocks,
+                                       u32 blockCount,
+                                       const WatertightRay &watertightRay,
+                                       Ray &ray, Hit &hit) noexcept;
+
+/* Lowers {isa} to the instruction set of the returned kernel */
+template <u32 Width>
+static IntersectBlocksFunc_T<Width> selectIntersectBlocks(SimdIsa &isa) {
+#if NEKO_SIMD_X86
+  if (isa >= SimdIsa::avx2) {
+    isa = SimdIsa::avx2;
+    return &avx2_kernels::intersectBlocks<Width>;
+  }
+  if (isa >= SimdIsa::sse) {
+    isa = SimdIsa::sse;
+    return &sse_kernels::intersectBlocks<Width>;
+  }
+#endif /* NEKO_SIMD_X86 */
+  isa = SimdIsa::scalar;
+  return &scalar_kernels::intersectBlocks<Width>;
+}
+
+/**
+ * @brief Closest hits of {rays} against every block, in nanoseconds per
+ * ray/triangle test.
+ */
+template <u32 Width>
+static f64 timeBlocks(SimdIsa &isa, const std::vector<Triangle> &triangles,
+                      std::span<const Ray> rays, std::span<Hit> hits) {
+  std::vector<u32> triangleIndices(triangles.size());
+  for (u32 iTriangle = 0; iTriangle < triangles.size(); ++iTriangle) {
+    triangleIndices[iTriangle] = iTriangle;
+  }
+  std::vector<TriangleBlock<Width>> blocks;
+  appendTriangleBlocks(blocks, triangles, triangleIndices.data(),
+                       static_cast<u32>(triangles.size()));
+  IntersectBlocksFunc_T<Width> intersectBlocks =
+      selectIntersectBlocks<Width>(isa);
+
+  ScopedTimer timer{TimeUnit::milliseconds};
+  for (u64 iRay = 0; iRay < rays.size(); ++iRay) {
+    Ray ray = rays[iRay];
+    hits[iRay] = {};
+    intersectBlocks(blocks.data(), static_cast<u32>(blocks.size()),
+                    makeWatertightRay(ray), ray, hits[iRay]);
+  }
+  return static_cast<f64>(timer.now()) * 1e6 /
+         static_cast<f64>(rays.size() * triangles.size());
+}
+
+/* Random triangles tested against each ray, enough to fill many blocks of 8
+while staying in cache */
+static constexpr u32 triangleCount = 256;
+
+static constexpr u32 rayCount = 20000;
+
+void benchmarkTriangleKernels(const Settings &settings,
+                              [[maybe_unused]] ThreadPool &threadPool) {
+  /* Small triangles scattered in [-1, 1]^3, shot at from around the cube so
+  that a fair share of the rays hit */
+  Rng rng{triangleCount, rayCount};
+  auto randomPoint = [&rng](f32 scale) {
+    return Vec3{rng.nextF32() * 2.0f - 1.0f, rng.nextF32() * 2.0f - 1.0f,
+                rng.nextF32() * 2.0f - 1.0f} *
+           scale;
+  };
+  std::vector<Triangle> triangles(triangleCount);
+  for (Triangle &triangle : triangles) {
+    Vec3 center = randomPoint(1.0f);
+    triangle = {center + randomPoint(0.3f), center + randomPoint(0.3f),
+                center + randomPoint(0.3f)};
+  }
+  std::vector<Ray> rays(rayCount);
+  for (Ray &ray : rays) {
+    Vec3 origin = randomPoint(2.0f);
+    ray = {origin, normalize(randomPoint(1.0f) - origin), infinity};
+  }
+
+  std::vector<Hit> referenceHits(rayCount);
+  ScopedTimer timer{TimeUnit::milliseconds};
+  for (u32 iRay = 0; iRay < rayCount; ++iRay) {
+    Ray ray = rays[iRay];
+    for (u32 iTriangle = 0; iTriangle < triangleCount; ++iTriangle) {
+      intersectTriangle(triangles[iTriangle], iTriangle, ray,
+                        referenceHits[iRay]);
+    }
+  }
+  f64 mollerTrumboreTime = static_cast<f64>(timer.now()) * 1e6 /
+                           (static_cast<f64>(rayCount) * triangleCount);
+
+  SimdIsa isa = settings.graphics.pathTracer.simdIsa;
+  std::vector<Hit> hits(rayCount);
+  f64 block8Time = timeBlocks<8>(isa, triangles, rays, hits);
+  f64 block4Time = timeBlocks<4>(isa, triangles, rays, hits);
+  /* Rays whose closest hit differs from the Möller–Trumbore one */
+  u32 mismatchCount = 0;
+  for (u32 iRay = 0; iRay < rayCount; ++iRay) {
+    if (hits[iRay].triangleIndex != referenceHits[iRay].triangleIndex) {
+      ++mismatchCount;
+    }
+  }
+  std::printf("Triangle tests: Möller–Trumbore %.2f ns, %s blocks of 4 %.2f "
+              "ns, of 8 %.2f ns, %u mismatches\n",
+              mollerTrumboreTime, simdIsaName(isa), block4Time, block8Time,
+              mismatchCount);
+}
+
+} /* namespace neko */
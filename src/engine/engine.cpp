@@ -1,37 +1,118 @@
 #include "engine.hpp"
 
+#include "events.hpp"
 #include "renderer.hpp"
+#include "task_graph.hpp"
 #include "threads.hpp"
 
 namespace neko {
 
 void Engine::initRenderer() {
-  mpRenderer = std::make_unique<Renderer>(*mpSettings, *mpThreadPool);
+  mpRenderer =
+      std::make_unique<Renderer>(*mpSettings, *mpThreadPool, *mpEventBus);
+}
+
+/**
+ * @brief Logs when each startup stage started, relative to {startupBegin},
+ * and how long it took, and sets the gauges "engine.startup.<stage>-ms".
+ */
+static void
+reportStartup(u64 startupBegin,
+              const std::vector<TaskGraph::TaskTiming> &stageTimings) {
+  f64 totalTime = static_cast<f64>(metricsClock() - startupBegin) / 1e6;
+  f64 stagesTime = 0.0;
+  for (const auto &timing : stageTimings) {
+    f64 stageTime = static_cast<f64>(timing.end - timing.begin) / 1e6;
+    stagesTime += stageTime;
+    metricsRegistry()
+        .gauge("engine.startup." + timing.name + "-ms")
+        .set(stageTime);
+    logInfo("Startup stage %s: %.3f ms, started at %.3f ms", timing.name,
+            stageTime, static_cast<f64>(timing.begin - startupBegin) / 1e6);
+  }
+  metricsRegistry().gauge("engine.startup.total-ms").set(totalTime);
+  /* More time in stages than in total is the gain of running them
+  concurrently */
+  logInfo("Startup: %.3f ms, %.3f ms spent in stages", totalTime, stagesTime);
 }
 
 Engine::Engine(const std::string &settingsFilePath) {
-  TIMER_START(settingsTimer);
+  NEKO_PROFILE_THREAD("Main");
+  NEKO_PROFILE_FUNCTION();
+  u64 startupBegin = metricsClock();
+  /* The settings size the thread pool, both precede the other stages */
+  std::vector<TaskGraph::TaskTiming> stageTimings;
+  stageTimings.push_back({"settings", startupBegin, 0});
   if (settingsFilePath.length() == 0) {
     mpSettings = std::make_unique<Settings>();
   } else {
     mpSettings = std::make_unique<Settings>(settingsFilePath);
   }
-  TIMER_INVOKE(settingsTimer, "Settings' load time");
+  stageTimings.back().end = metricsClock();
 
-  TIMER_START(threadPoolTimer);
+  stageTimings.push_back({"thread-pool", metricsClock(), 0});
   mpThreadPool = std::make_unique<ThreadPool>(*mpSettings);
-  TIMER_INVOKE(threadPoolTimer, "Thread pool's creation time");
+  stageTimings.back().end = metricsClock();
 
-  auto rendererReady = mpThreadPool->submitJob([&] {
-    mpRenderer = std::make_unique<Renderer>(*mpSettings, *mpThreadPool);
+  TaskGraph startupGraph;
+  /* Records logged by the other stages wait in the queue of the logger until
+  it has started */
+  startupGraph.addTask("logger", [this] {
+    logger().start(mpSettings->system.logFile, mpSettings->system.logLevel);
   });
-  rendererReady->wait();
+  startupGraph.addTask("metrics-writer", [this] {
+    mpMetricsWriter = std::make_unique<MetricsWriter>(
+        metricsRegistry(), mpSettings->system.metricsFile,
+        std::chrono::milliseconds{
+            static_cast<i64>(mpSettings->system.metricsInterval * 1000.0f)});
+  });
+  mpEventBus = std::make_unique<EventBus>();
+  mpRenderer =
+      std::make_unique<Renderer>(*mpSettings, *mpThreadPool, *mpEventBus);
+  /* GLFW must be initialized and its window created on the main thread, the
+  graph only gets the stages that may run on any worker */
+  if (mpSettings->graphics.backend == RenderBackend::vulkan) {
+    stageTimings.push_back({"window", metricsClock(), 0});
+    mpRenderer->createWindow();
+    stageTimings.back().end = metricsClock();
+  }
+  mpRenderer->addStartupTasks(startupGraph);
+  {
+    NEKO_PROFILE_ZONE("Startup graph");
+    startupGraph.run(*mpThreadPool);
+  }
+  for (auto &timing : startupGraph.timings()) {
+    stageTimings.push_back(std::move(timing));
+  }
+  reportStartup(startupBegin, stageTimings);
 };
 
-Engine::~Engine() = default;
+Engine::~Engine() {
+  /* Moved from, the engine it was moved to shuts down */
+  if (!mpThreadPool) {
+    return;
+  }
+  /* Joins the workers, so that the trace holds every zone they opened */
+  mpThreadPool->release();
+  /* Destructors must not throw, a trace that cannot be written is lost */
+  try {
+    NEKO_PROFILE_WRITE_TRACE(mpSettings->system.profileTraceFile);
+  } catch (const std::exception &e) {
+    logError("Failed to write the profile trace: %s", e.what());
+  }
+  /* Members are destroyed after this body, the Vulkan teardown and its
+  validation messages must still reach the log file */
+  mpRenderer.reset();
+  mpEventBus.reset();
+  /* Before the last snapshot, so that it counts every dropped record */
+  logger().stop();
+  /* Writes the last snapshot, with the metrics of every finished job */
+  mpMetricsWriter.reset();
+}
 
 void Engine::start() {
-  mpThreadPool->submitJob([&] { mpRenderer->start(); });
+  /* On the calling thread, which processes the window events */
+  mpRenderer->start();
 }
 
 void Engine::stop() { mpThreadPool->release(); }
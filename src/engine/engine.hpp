@@ -9,6 +9,7 @@
 
 namespace neko {
 
+class EventBus;
 class Renderer;
 class ThreadPool;
 
@@ -23,14 +24,25 @@ public:
 
   ~Engine();
 
+  /**
+   * @brief Runs the renderer on the calling thread, which must be the main
+   * thread, and returns once its window is closed or its frame is written.
+   */
   void start();
 
   void stop();
 
+  /**
+   * @brief Bus the window publishes its input to, dispatched once per frame.
+   */
+  EventBus &eventBus() noexcept { return *mpEventBus; }
+
 private:
   std::string projectDirectory;
   std::unique_ptr<Settings> mpSettings;
+  std::unique_ptr<EventBus> mpEventBus;
   std::unique_ptr<Renderer> mpRenderer;
+  std::unique_ptr<MetricsWriter> mpMetricsWriter;
 
   /**
    * @brief
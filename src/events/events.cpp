@@ -1 +1,156 @@
-#include "events.hpp"
\ No newline at end of file
+#include "events.hpp"
+
+#include "threads.hpp"
+
+namespace neko {
+
+void submitEventJob(ThreadPool &threadPool, JobCounter &counter,
+                    std::function<void()> job) {
+  threadPool.submit(std::move(job), counter);
+}
+
+void EventBus::unsubscribe(SubscriptionId subscriptionId) {
+  std::lock_guard lock{mChannelMutex};
+  for (auto &[type, pChannel] : mChannels) {
+    if (pChannel->unsubscribe(subscriptionId)) {
+      return;
+    }
+  }
+}
+
+std::vector<EventChannelBase *> EventBus::beginFrame(u64 &eventCount) {
+  std::vector<EventChannelBase *> channels;
+  {
+    std::lock_guard lock{mChannelMutex};
+    channels.reserve(mChannels.size());
+    for (auto &[type, pChannel] : mChannels) {
+      channels.push_back(pChannel.get());
+    }
+  }
+  eventCount = 0;
+  std::erase_if(channels, [&](EventChannelBase *pChannel) {
+    u64 channelEventCount = pChannel->beginFrame();
+    eventCount += channelEventCount;
+    return channelEventCount == 0;
+  });
+  mPendingCount.fetch_sub(eventCount, std::memory_order_acq_rel);
+  return channels;
+}
+
+u64 EventBus::dispatch(ThreadPool &threadPool) {
+  NEKO_PROFILE_FUNCTION();
+  static Histogram &dispatchTimes =
+      metricsRegistry().histogram("events.dispatch-ns");
+  u64 start = metricsClock();
+  u64 eventCount = 0;
+  std::vector<EventChannelBase *> channels = beginFrame(eventCount);
+  if (channels.empty()) {
+    return 0;
+  }
+  JobCounter counter;
+  for (EventChannelBase *pChannel : channels) {
+    pChannel->submitFrame(threadPool, counter);
+  }
+  threadPool.wait(counter);
+  for (EventChannelBase *pChannel : channels) {
+    pChannel->endFrame();
+  }
+  dispatchTimes.record(metricsClock() - start);
+  return eventCount;
+}
+
+u64 EventBus::dispatch() {
+  u64 eventCount = 0;
+  std::vector<EventChannelBase *> channels = beginFrame(eventCount);
+  for (EventChannelBase *pChannel : channels) {
+    pChannel->handleFrame();
+    pChannel->endFrame();
+  }
+  return eventCount;
+}
+
+bool EventBus::waitForEvents(std::chrono::nanoseconds timeout) {
+  std::unique_lock lock{mWaitMutex};
+  /* Registered before checking for events, a publisher either sees the
+  waiter or the waiter sees its event */
+  mWaiterCount.fetch_add(1);
+  auto hasEvents = [this] { return mPendingCount.load() > 0; };
+  if (timeout == FramePacer::waitForever) {
+    mWaitCondition.wait(lock, hasEvents);
+  } else {
+    mWaitCondition.wait_for(lock, timeout, hasEvents);
+  }
+  mWaiterCount.fetch_sub(1);
+  return pending();
+}
+
+void EventBus::setWakeFunc(void (*func)()) {
+  std::unique_lock lock{mWakeMutex};
+  mpWakeFunc = func;
+  mWakeThreadId = std::this_thread::get_id();
+  mWakeCondition.wait(lock, [this] { return mWakeCallerCount == 0; });
+}
+
+void EventBus::notifyPublished() {
+  if (mWaiterCount.load() > 0) {
+    /* Locking orders the notification after the waiter has blocked */
+    { std::lock_guard lock{mWaitMutex}; }
+    mWaitCondition.notify_all();
+  }
+  void (*pWakeFunc)() = nullptr;
+  {
+    std::lock_guard lock{mWakeMutex};
+    if (mpWakeFunc != nullptr &&
+        mWakeThreadId != std::this_thread::get_id()) {
+      pWakeFunc = mpWakeFunc;
+      ++mWakeCallerCount;
+    }
+  }
+  if (pWakeFunc == nullptr) {
+    return;
+  }
+  pWakeFunc();
+  std::lock_guard lock{mWakeMutex};
+  if (--mWakeCallerCount == 0) {
+    mWakeCondition.notify_all();
+  }
+}
+
+FramePacer::FramePacer(FramePacing pacing, f32 frameRate)
+    : mPacing{pacing},
+      mFramePeriod{static_cast<u64>(1e9 / static_cast<f64>(frameRate))} {}
+
+std::chrono::nanoseconds FramePacer::waitTimeout(u64 now,
+                                                 bool eventsPending) const {
+  if (mPacing == FramePacing::continuous) {
+    return std::chrono::nanoseconds{0};
+  }
+  if (mPacing == FramePacing::onDemand && !eventsPending) {
+    return waitForever;
+  }
+  return std::chrono::nanoseconds{
+      static_cast<i64>(mNextFrameTime > now ? mNextFrameTime - now : 0)};
+}
+
+bool FramePacer::frameDue(u64 now, bool eventsPending) const {
+  switch (mPacing) {
+  case FramePacing::continuous:
+    return true;
+  case FramePacing::fixedRate:
+    return now >= mNextFrameTime;
+  case FramePacing::onDemand:
+    return eventsPending && now >= mNextFrameTime;
+  }
+  return true;
+}
+
+void FramePacer::beginFrame(u64 now) {
+  mNextFrameTime += mFramePeriod;
+  /* A late frame moves the schedule instead of rendering the missed frames
+  back to back */
+  if (mNextFrameTime <= now) {
+    mNextFrameTime = now + mFramePeriod;
+  }
+}
+
+} /* namespace neko */
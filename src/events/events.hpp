@@ -1,6 +1,335 @@
 #ifndef NEKO_EVENTS_HPP
 #define NEKO_EVENTS_HPP
 
-namespace neko {} /* namespace neko */
+#include "utils.hpp"
 
-#endif /* NEKO_EVENTS_HPP */
\ No newline at end of file
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <typeindex>
+#include <vector>
+
+namespace neko {
+
+class JobCounter;
+class ThreadPool;
+
+/* Events of the window, published by {Window} from the GLFW callbacks with
+their GLFW codes */
+struct KeyEvent {
+  i32 key;
+  i32 scancode;
+  i32 action;
+  i32 mods;
+};
+
+struct MouseButtonEvent {
+  i32 button;
+  i32 action;
+  i32 mods;
+};
+
+struct CursorMoveEvent {
+  f64 x;
+  f64 y;
+};
+
+struct ScrollEvent {
+  f64 xOffset;
+  f64 yOffset;
+};
+
+struct FramebufferResizeEvent {
+  u32 width;
+  u32 height;
+};
+
+struct WindowFocusEvent {
+  bool focused;
+};
+
+struct WindowCloseEvent {};
+
+/**
+ * @brief Submits {job} to {threadPool}, keeps {ThreadPool} out of the header
+ * of the event channels.
+ */
+void submitEventJob(ThreadPool &threadPool, JobCounter &counter,
+                    std::function<void()> job);
+
+/**
+ * @brief Events and subscribers of one event type, see {EventBus}.
+ */
+class EventChannelBase {
+public:
+  EventChannelBase() = default;
+  EventChannelBase(const EventChannelBase &) = delete;
+  EventChannelBase(EventChannelBase &&) = delete;
+  EventChannelBase &operator=(const EventChannelBase &) = delete;
+  EventChannelBase &operator=(EventChannelBase &&) = delete;
+  virtual ~EventChannelBase() = default;
+
+  /**
+   * @brief Moves the published events to the batch of the frame and takes a
+   * copy of the subscribers to deliver it to.
+   *
+   * @return the number of events in the batch
+   */
+  virtual u64 beginFrame() = 0;
+
+  /**
+   * @brief Submits one job per subscriber, each handling the whole batch.
+   */
+  virtual void submitFrame(ThreadPool &threadPool, JobCounter &counter) = 0;
+
+  virtual void handleFrame() = 0;
+
+  virtual void endFrame() noexcept = 0;
+
+  virtual bool unsubscribe(u64 subscriptionId) = 0;
+};
+
+template <typename Event> class EventChannel final : public EventChannelBase {
+public:
+  typedef std::function<void(std::span<const Event>)> Handler_T;
+
+  void publish(const Event &event) {
+    std::lock_guard lock{mEventMutex};
+    mEvents.push_back(event);
+  }
+
+  void subscribe(u64 subscriptionId, Handler_T handler) {
+    std::lock_guard lock{mSubscriberMutex};
+    mSubscribers.push_back(
+        {subscriptionId, std::make_shared<Handler_T>(std::move(handler))});
+  }
+
+  bool unsubscribe(u64 subscriptionId) override {
+    std::lock_guard lock{mSubscriberMutex};
+    for (auto it = mSubscribers.begin(); it != mSubscribers.end(); ++it) {
+      if (it->first == subscriptionId) {
+        mSubscribers.erase(it);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  u64 beginFrame() override {
+    {
+      std::lock_guard lock{mEventMutex};
+      mFrameEvents.swap(mEvents);
+    }
+    if (!mFrameEvents.empty()) {
+      std::lock_guard lock{mSubscriberMutex};
+      mFrameSubscribers = mSubscribers;
+    }
+    return mFrameEvents.size();
+  }
+
+  void submitFrame(ThreadPool &threadPool, JobCounter &counter) override;
+
+  void handleFrame() override {
+    for (const auto &subscriber : mFrameSubscribers) {
+      (*subscriber.second)(mFrameEvents);
+    }
+  }
+
+  void endFrame() noexcept override {
+    /* Keeps the capacity, so that a steady stream of events does not
+    allocate */
+    mFrameEvents.clear();
+    mFrameSubscribers.clear();
+  }
+
+private:
+  typedef std::pair<u64, std::shared_ptr<Handler_T>> Subscriber_T;
+
+  std::mutex mEventMutex;
+  std::vector<Event> mEvents;
+  std::mutex mSubscriberMutex;
+  std::vector<Subscriber_T> mSubscribers;
+  /* Only touched by the thread calling {EventBus::dispatch} and the jobs it
+  waits for */
+  std::vector<Event> mFrameEvents;
+  std::vector<Subscriber_T> mFrameSubscribers;
+};
+
+/**
+ * @brief Typed publish-subscribe bus. Published events are queued by type
+ * and delivered once per frame by {dispatch}: every subscriber of a type
+ * receives all the events of that type published since the last frame, in
+ * order, as one batch. Subscribers run concurrently on the thread pool, so
+ * they must not share unsynchronized state with each other.
+ *
+ * Events published while a frame is being dispatched, by the subscribers
+ * too, are delivered with the next frame. The bus needs no window, the main
+ * loop of a headless program blocks in {waitForEvents} instead of GLFW.
+ */
+class EventBus {
+public:
+  typedef u64 SubscriptionId;
+
+  EventBus() = default;
+  EventBus(const EventBus &) = delete;
+  EventBus(EventBus &&) = delete;
+  EventBus &operator=(const EventBus &) = delete;
+  EventBus &operator=(EventBus &&) = delete;
+  ~EventBus() = default;
+
+  template <typename Event> void publish(const Event &event) {
+    /* Counted first, so that {dispatch} never delivers an event it has not
+    counted */
+    mPendingCount.fetch_add(1);
+    channel<Event>().publish(event);
+    notifyPublished();
+  }
+
+  /**
+   * @brief {handler} is called with the batch of every frame that has events
+   * of type {Event}, until {unsubscribe}.
+   */
+  template <typename Event>
+  SubscriptionId
+  subscribe(typename EventChannel<Event>::Handler_T handler) {
+    SubscriptionId subscriptionId =
+        mNextSubscriptionId.fetch_add(1, std::memory_order_relaxed);
+    channel<Event>().subscribe(subscriptionId, std::move(handler));
+    return subscriptionId;
+  }
+
+  /**
+   * @brief Stops the deliveries to a subscriber, from the next frame on.
+   */
+  void unsubscribe(SubscriptionId subscriptionId);
+
+  /**
+   * @brief Whether events were published since the last {dispatch}.
+   */
+  bool pending() const noexcept {
+    return mPendingCount.load(std::memory_order_acquire) > 0;
+  }
+
+  /**
+   * @brief Delivers the events published since the last call to their
+   * subscribers, as jobs on {threadPool}, and returns once all have been
+   * handled. The calling thread runs jobs while it waits. Called by one
+   * thread at a time, usually the main loop once per frame.
+   *
+   * @return the number of events delivered
+   */
+  u64 dispatch(ThreadPool &threadPool);
+
+  /**
+   * @brief {dispatch} on the calling thread only.
+   */
+  u64 dispatch();
+
+  /**
+   * @brief Blocks until an event is published or {timeout} has passed, and
+   * returns at once if events are already pending.
+   *
+   * @return {pending}
+   */
+  bool waitForEvents(std::chrono::nanoseconds timeout);
+
+  /**
+   * @brief {func}, or nothing if null, is called when a thread other than
+   * the calling one publishes, so that a main loop blocked outside of
+   * {waitForEvents}, in {glfwWaitEventsTimeout} for instance, wakes up.
+   * Returns once no publisher is still calling the previous function, which
+   * may then be torn down.
+   */
+  void setWakeFunc(void (*func)());
+
+private:
+  std::mutex mChannelMutex;
+  std::map<std::type_index, std::unique_ptr<EventChannelBase>> mChannels;
+  std::atomic<SubscriptionId> mNextSubscriptionId = 1;
+
+  std::atomic<u64> mPendingCount = 0;
+  /* Threads blocked in {waitForEvents}, publishers only lock {mWaitMutex}
+  to wake them */
+  std::atomic<u32> mWaiterCount = 0;
+  std::mutex mWaitMutex;
+  std::condition_variable mWaitCondition;
+  /* The wake function and its thread change together, publishers calling
+  the function are counted so that {setWakeFunc} can wait for them */
+  std::mutex mWakeMutex;
+  std::condition_variable mWakeCondition;
+  void (*mpWakeFunc)() = nullptr;
+  std::thread::id mWakeThreadId;
+  u32 mWakeCallerCount = 0;
+
+  template <typename Event> EventChannel<Event> &channel() {
+    std::lock_guard lock{mChannelMutex};
+    auto &pChannel = mChannels[std::type_index{typeid(Event)}];
+    if (!pChannel) {
+      pChannel = std::make_unique<EventChannel<Event>>();
+    }
+    return static_cast<EventChannel<Event> &>(*pChannel);
+  }
+
+  void notifyPublished();
+
+  /**
+   * @brief Channels with events in the batch of the frame.
+   */
+  std::vector<EventChannelBase *> beginFrame(u64 &eventCount);
+};
+
+template <typename Event>
+void EventChannel<Event>::submitFrame(ThreadPool &threadPool,
+                                      JobCounter &counter) {
+  for (const auto &subscriber : mFrameSubscribers) {
+    submitEventJob(threadPool, counter, [this, pHandler = subscriber.second] {
+      (*pHandler)(mFrameEvents);
+    });
+  }
+}
+
+/**
+ * @brief When the window loop renders its next frame and how long it may
+ * block waiting for events until then, following a {FramePacing}. Waiting
+ * returns as soon as an event arrives, so input never waits for the timeout.
+ * Times are in nanoseconds of {metricsClock}.
+ */
+class FramePacer {
+public:
+  static constexpr auto waitForever = std::chrono::nanoseconds::max();
+
+  /**
+   * @brief {frameRate} must be positive, the settings reject any other.
+   */
+  FramePacer(FramePacing pacing, f32 frameRate);
+
+  /**
+   * @brief How long the loop may block at {now}, 0 to only poll events.
+   */
+  std::chrono::nanoseconds waitTimeout(u64 now, bool eventsPending) const;
+
+  /**
+   * @brief Whether the next frame should be rendered at {now}.
+   */
+  bool frameDue(u64 now, bool eventsPending) const;
+
+  /**
+   * @brief Schedules the frame after the one starting at {now}.
+   */
+  void beginFrame(u64 now);
+
+private:
+  FramePacing mPacing;
+  u64 mFramePeriod;
+  u64 mNextFrameTime = 0;
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_EVENTS_HPP */
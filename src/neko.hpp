@@ -4,6 +4,10 @@
 #include "engine/engine.hpp"
 #include "events/events.hpp"
 #include "renderer/renderer.hpp"
+#include "threads/io.hpp"
+#include "threads/parallel.hpp"
+#include "threads/task.hpp"
+#include "threads/task_graph.hpp"
 #include "threads/threads.hpp"
 #include "utils/utils.hpp"
 
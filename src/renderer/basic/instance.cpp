@@ -2,8 +2,6 @@
 
 #include "context.hpp"
 
-#include <iostream>
-
 namespace neko {
 
 VKAPI_ATTR VkBool32 VKAPI_CALL Instance::debugMessengerCallback(
@@ -11,9 +9,18 @@ VKAPI_ATTR VkBool32 VKAPI_CALL Instance::debugMessengerCallback(
     [[maybe_unused]] VkDebugUtilsMessageTypeFlagsEXT messageType,
     const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
     [[maybe_unused]] void *pUserData) {
-  if (messageSeverity > VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT) {
-    std::cerr << '\n' << pCallbackData->pMessage << std::endl;
+  /* Validation layers call back from the thread making the Vulkan call, the
+  message is only copied here */
+  LogLevel level = LogLevel::trace;
+  if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+    level = LogLevel::error;
+  } else if (messageSeverity >=
+             VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+    level = LogLevel::warning;
+  } else if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+    level = LogLevel::info;
   }
+  logger().log(level, "Vulkan: %s", pCallbackData->pMessage);
   return VK_FALSE;
 }
 
@@ -1,10 +1,51 @@
 #include "window.hpp"
 
+#include "events.hpp"
+
 namespace neko {
 
+static EventBus &windowEventBus(GLFWwindow *pWindow) {
+  return *static_cast<EventBus *>(glfwGetWindowUserPointer(pWindow));
+}
+
+static void keyCallback(GLFWwindow *pWindow, int key, int scancode,
+                        int action, int mods) {
+  windowEventBus(pWindow).publish(KeyEvent{key, scancode, action, mods});
+}
+
+static void mouseButtonCallback(GLFWwindow *pWindow, int button, int action,
+                                int mods) {
+  windowEventBus(pWindow).publish(MouseButtonEvent{button, action, mods});
+}
+
+static void cursorPosCallback(GLFWwindow *pWindow, double x, double y) {
+  windowEventBus(pWindow).publish(CursorMoveEvent{x, y});
+}
+
+static void scrollCallback(GLFWwindow *pWindow, double xOffset,
+                           double yOffset) {
+  windowEventBus(pWindow).publish(ScrollEvent{xOffset, yOffset});
+}
+
+static void framebufferSizeCallback(GLFWwindow *pWindow, int width,
+                                    int height) {
+  windowEventBus(pWindow).publish(FramebufferResizeEvent{
+      static_cast<u32>(width), static_cast<u32>(height)});
+}
+
+static void windowFocusCallback(GLFWwindow *pWindow, int focused) {
+  windowEventBus(pWindow).publish(WindowFocusEvent{focused == GLFW_TRUE});
+}
+
+static void windowCloseCallback(GLFWwindow *pWindow) {
+  windowEventBus(pWindow).publish(WindowCloseEvent{});
+}
+
 Window::Window(const Settings &settings)
     : mWidth{settings.graphics.screenWidth},
-      mHeight{settings.graphics.screenHeight} {
+      mHeight{settings.graphics.screenHeight},
+      mFramePacing{settings.graphics.framePacing},
+      mFrameRate{settings.graphics.frameRate} {
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
   glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
   mWindow = glfwCreateWindow(mWidth, mHeight, settings.general.appName.c_str(),
@@ -13,10 +54,47 @@ Window::Window(const Settings &settings)
 
 Window::~Window() { glfwDestroyWindow(mWindow); }
 
-void Window::open() {
+void Window::open(EventBus &eventBus, ThreadPool &threadPool) {
+  glfwSetWindowUserPointer(mWindow, &eventBus);
+  glfwSetKeyCallback(mWindow, keyCallback);
+  glfwSetMouseButtonCallback(mWindow, mouseButtonCallback);
+  glfwSetCursorPosCallback(mWindow, cursorPosCallback);
+  glfwSetScrollCallback(mWindow, scrollCallback);
+  glfwSetFramebufferSizeCallback(mWindow, framebufferSizeCallback);
+  glfwSetWindowFocusCallback(mWindow, windowFocusCallback);
+  glfwSetWindowCloseCallback(mWindow, windowCloseCallback);
+  /* Events published by other threads end the wait too */
+  eventBus.setWakeFunc(glfwPostEmptyEvent);
+
+  FramePacer pacer{mFramePacing, mFrameRate};
+  Histogram &frameTimes = metricsRegistry().histogram("window.frame-ns");
+  u64 frameStart = metricsClock();
   while (!glfwWindowShouldClose(mWindow)) {
-    glfwPollEvents();
+    /* The callbacks run inside the wait, which returns as soon as there is
+    input, so waiting adds no latency to it */
+    auto timeout = pacer.waitTimeout(metricsClock(), eventBus.pending());
+    if (timeout == FramePacer::waitForever) {
+      glfwWaitEvents();
+    } else if (timeout.count() > 0) {
+      glfwWaitEventsTimeout(static_cast<f64>(timeout.count()) / 1e9);
+    } else {
+      glfwPollEvents();
+    }
+    u64 now = metricsClock();
+    if (!pacer.frameDue(now, eventBus.pending())) {
+      continue;
+    }
+    pacer.beginFrame(now);
+    eventBus.dispatch(threadPool);
+    frameTimes.record(now - frameStart);
+    frameStart = now;
   }
+  /* Delivers the events of the last frame, the close event among them */
+  eventBus.dispatch(threadPool);
+  /* Waits for the publishers still posting empty events, GLFW may be
+  terminated once the window has closed */
+  eventBus.setWakeFunc(nullptr);
+  glfwSetWindowUserPointer(mWindow, nullptr);
 }
 
 } /* namespace neko */
\ No newline at end of file
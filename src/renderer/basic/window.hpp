@@ -5,6 +5,9 @@
 
 namespace neko {
 
+class EventBus;
+class ThreadPool;
+
 class Window {
   typedef GLFWwindow *GLWindow;
 
@@ -25,12 +28,20 @@ public:
 
   const GLWindow &operator*() const noexcept { return mWindow; }
 
-  void open();
+  /**
+   * @brief Runs the window loop until the window is closed. Input is
+   * published to {eventBus}, which is dispatched on {threadPool} once per
+   * frame, and the loop blocks between frames as set by
+   * {Settings::graphics.framePacing}.
+   */
+  void open(EventBus &eventBus, ThreadPool &threadPool);
 
 private:
   GLWindow mWindow;
   u32 mWidth;
   u32 mHeight;
+  FramePacing mFramePacing;
+  f32 mFrameRate;
 };
 
 } /* namespace neko */
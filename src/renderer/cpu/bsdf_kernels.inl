@@ -0,0 +1,486 @@
+/* BSDF kernels, included once per instruction set inside a namespace that
+provides {Lanes}. Every kernel shades {Lanes::width} hit points at a time and
+only branches on the batch, never on a lane */
+
+typedef Lanes L;
+typedef L::Float_T Float_T;
+typedef L::Mask_T Mask_T;
+
+struct LaneVec3 {
+  Float_T x;
+  Float_T y;
+  Float_T z;
+};
+
+static LaneVec3 add3(const LaneVec3 &lhs, const LaneVec3 &rhs) noexcept {
+  return {L::add(lhs.x, rhs.x), L::add(lhs.y, rhs.y), L::add(lhs.z, rhs.z)};
+}
+
+static LaneVec3 sub3(const LaneVec3 &lhs, const LaneVec3 &rhs) noexcept {
+  return {L::sub(lhs.x, rhs.x), L::sub(lhs.y, rhs.y), L::sub(lhs.z, rhs.z)};
+}
+
+static LaneVec3 scale3(const LaneVec3 &vec, Float_T scale) noexcept {
+  return {L::mul(vec.x, scale), L::mul(vec.y, scale), L::mul(vec.z, scale)};
+}
+
+static LaneVec3 negate3(const LaneVec3 &vec) noexcept {
+  Float_T minusOne = L::broadcast(-1.0f);
+  return {L::flipSign(vec.x, minusOne), L::flipSign(vec.y, minusOne),
+          L::flipSign(vec.z, minusOne)};
+}
+
+static LaneVec3 select3(Mask_T mask, const LaneVec3 &lhs,
+                        const LaneVec3 &rhs) noexcept {
+  return {L::select(mask, lhs.x, rhs.x), L::select(mask, lhs.y, rhs.y),
+          L::select(mask, lhs.z, rhs.z)};
+}
+
+static LaneVec3 broadcast3(f32 value) noexcept {
+  return {L::broadcast(value), L::broadcast(value), L::broadcast(value)};
+}
+
+/* Same operation order as {dot} and {normalize} */
+static Float_T dot3(const LaneVec3 &lhs, const LaneVec3 &rhs) noexcept {
+  return L::add(L::add(L::mul(lhs.x, rhs.x), L::mul(lhs.y, rhs.y)),
+                L::mul(lhs.z, rhs.z));
+}
+
+static LaneVec3 normalize3(const LaneVec3 &vec) noexcept {
+  return scale3(vec, L::div(L::broadcast(1.0f), L::sqrt(dot3(vec, vec))));
+}
+
+/* Same operation order as {buildBasis} */
+static void buildBasisLanes(const LaneVec3 &normal, LaneVec3 &tangent,
+                            LaneVec3 &bitangent) noexcept {
+  Float_T one = L::broadcast(1.0f);
+  Float_T minusOne = L::broadcast(-1.0f);
+  Float_T sign = L::flipSign(one, normal.z);
+  Float_T a = L::div(minusOne, L::add(sign, normal.z));
+  Float_T b = L::mul(L::mul(normal.x, normal.y), a);
+  tangent = {L::add(one, L::mul(L::mul(L::mul(sign, normal.x), normal.x), a)),
+             L::mul(sign, b), L::mul(L::flipSign(sign, minusOne), normal.x)};
+  bitangent = {b, L::add(sign, L::mul(L::mul(normal.y, normal.y), a)),
+               L::flipSign(normal.y, minusOne)};
+}
+
+/* Scalar per lane, so that every instruction set matches the C library */
+static void sinCosLanes(Float_T angle, Float_T &sine,
+                        Float_T &cosine) noexcept {
+  alignas(32) f32 angles[L::width];
+  alignas(32) f32 sines[L::width];
+  alignas(32) f32 cosines[L::width];
+  L::store(angles, angle);
+  for (u32 lane = 0; lane < L::width; ++lane) {
+    sines[lane] = std::sin(angles[lane]);
+    cosines[lane] = std::cos(angles[lane]);
+  }
+  sine = L::load(sines);
+  cosine = L::load(cosines);
+}
+
+/**
+ * @brief Flips {normal} towards {outgoing}, and returns the cosine between
+ * them in {cosOutgoing}.
+ */
+static LaneVec3 faceForward(const LaneVec3 &normal, const LaneVec3 &outgoing,
+                            Float_T &cosOutgoing) noexcept {
+  Float_T cosine = dot3(normal, outgoing);
+  cosOutgoing = L::abs(cosine);
+  return select3(L::less(cosine, L::broadcast(0.0f)), negate3(normal),
+                 normal);
+}
+
+/* Same operation order as {sampleCosineHemisphere} */
+static LaneVec3 sampleCosineLanes(const LaneVec3 &normal,
+                                  const LaneVec3 &tangent,
+                                  const LaneVec3 &bitangent, Float_T u,
+                                  Float_T v) noexcept {
+  Float_T radius = L::sqrt(u);
+  Float_T sine;
+  Float_T cosine;
+  sinCosLanes(L::mul(L::broadcast(2.0f * pi), v), sine, cosine);
+  Float_T height = L::sqrt(
+      L::max(L::broadcast(0.0f), L::sub(L::broadcast(1.0f), u)));
+  return normalize3(add3(add3(scale3(tangent, L::mul(radius, cosine)),
+                              scale3(bitangent, L::mul(radius, sine))),
+                         scale3(normal, height)));
+}
+
+/* Narrowest GGX distribution, below which the peak overflows */
+static constexpr f32 minGgxAlpha = 1e-3f;
+
+static Float_T ggxAlphaSquared(Float_T roughness) noexcept {
+  Float_T alpha =
+      L::max(L::mul(roughness, roughness), L::broadcast(minGgxAlpha));
+  return L::mul(alpha, alpha);
+}
+
+/**
+ * @brief Samples a GGX microfacet normal proportionally to its distribution
+ * times its cosine, which is also returned in {cosHalf}.
+ */
+static LaneVec3 sampleGgxHalfVector(const LaneVec3 &normal,
+                                    const LaneVec3 &tangent,
+                                    const LaneVec3 &bitangent,
+                                    Float_T alphaSquared, Float_T u, Float_T v,
+                                    Float_T &cosHalf) noexcept {
+  Float_T one = L::broadcast(1.0f);
+  Float_T tanSquared = L::div(L::mul(alphaSquared, u), L::sub(one, u));
+  cosHalf = L::div(one, L::sqrt(L::add(one, tanSquared)));
+  Float_T sinHalf = L::sqrt(L::max(
+      L::broadcast(0.0f), L::sub(one, L::mul(cosHalf, cosHalf))));
+  Float_T sine;
+  Float_T cosine;
+  sinCosLanes(L::mul(L::broadcast(2.0f * pi), v), sine, cosine);
+  return add3(add3(scale3(tangent, L::mul(sinHalf, cosine)),
+                   scale3(bitangent, L::mul(sinHalf, sine))),
+              scale3(normal, cosHalf));
+}
+
+/* GGX distribution times pi */
+static Float_T ggxDistributionPi(Float_T cosHalf,
+                                 Float_T alphaSquared) noexcept {
+  Float_T denominator =
+      L::add(L::mul(L::mul(cosHalf, cosHalf),
+                    L::sub(alphaSquared, L::broadcast(1.0f))),
+             L::broadcast(1.0f));
+  return L::div(alphaSquared, L::mul(denominator, denominator));
+}
+
+/* Smith masking of one direction */
+static Float_T smithG1(Float_T cosine, Float_T alphaSquared) noexcept {
+  Float_T cosSquared = L::mul(cosine, cosine);
+  Float_T root = L::sqrt(L::add(
+      alphaSquared,
+      L::mul(L::sub(L::broadcast(1.0f), alphaSquared), cosSquared)));
+  return L::div(L::mul(L::broadcast(2.0f), cosine), L::add(cosine, root));
+}
+
+static LaneVec3 schlickFresnel(const LaneVec3 &f0, Float_T cosine) noexcept {
+  Float_T m = L::max(L::broadcast(0.0f), L::sub(L::broadcast(1.0f), cosine));
+  Float_T m2 = L::mul(m, m);
+  Float_T m5 = L::mul(L::mul(m2, m2), m);
+  return add3(f0, scale3(sub3(broadcast3(1.0f), f0), m5));
+}
+
+static LaneVec3 reflect3(const LaneVec3 &outgoing, const LaneVec3 &normal,
+                         Float_T cosine) noexcept {
+  return sub3(scale3(normal, L::mul(L::broadcast(2.0f), cosine)), outgoing);
+}
+
+/**
+ * @brief GGX reflection towards {incoming} times pi, zero below the surface.
+ */
+static LaneVec3 ggxReflectionPi(const LaneVec3 &normal,
+                                const LaneVec3 &outgoing, Float_T cosOutgoing,
+                                const LaneVec3 &incoming, Float_T alphaSquared,
+                                const LaneVec3 &f0,
+                                Float_T &cosIncoming) noexcept {
+  Float_T zero = L::broadcast(0.0f);
+  cosIncoming = dot3(normal, incoming);
+  LaneVec3 half = normalize3(add3(outgoing, incoming));
+  Float_T distributionPi =
+      ggxDistributionPi(dot3(normal, half), alphaSquared);
+  Float_T masking = L::mul(smithG1(cosOutgoing, alphaSquared),
+                           smithG1(cosIncoming, alphaSquared));
+  Float_T value = L::div(
+      L::mul(distributionPi, masking),
+      L::mul(L::broadcast(4.0f), L::mul(cosOutgoing, cosIncoming)));
+  Mask_T valid =
+      L::logicalAnd(L::less(zero, cosIncoming), L::less(zero, cosOutgoing));
+  return select3(valid, scale3(schlickFresnel(f0, dot3(outgoing, half)), value),
+                 broadcast3(0.0f));
+}
+
+/* Hit points of a batch, the material parameters gathered per lane */
+struct ShadeBatch {
+  LaneVec3 normal;
+  LaneVec3 outgoing;
+  LaneVec3 lightDirection;
+  Float_T u;
+  Float_T v;
+  Float_T w;
+  LaneVec3 albedo;
+  Float_T roughness;
+  Float_T ior;
+  Float_T metallic;
+};
+
+struct ShadeResult {
+  LaneVec3 direction;
+  LaneVec3 weight;
+  LaneVec3 lightWeight;
+  Mask_T specular;
+};
+
+static void shadeDiffuseLanes(const ShadeBatch &batch,
+                              ShadeResult &result) noexcept {
+  Float_T cosOutgoing;
+  LaneVec3 normal = faceForward(batch.normal, batch.outgoing, cosOutgoing);
+  LaneVec3 tangent;
+  LaneVec3 bitangent;
+  buildBasisLanes(normal, tangent, bitangent);
+  result.direction =
+      sampleCosineLanes(normal, tangent, bitangent, batch.u, batch.v);
+  /* f * cos / pdf = albedo, and f * pi = albedo */
+  result.weight = batch.albedo;
+  result.lightWeight = batch.albedo;
+  result.specular = L::fromBits(0);
+}
+
+static void shadeConductorLanes(const ShadeBatch &batch,
+                                ShadeResult &result) noexcept {
+  Float_T zero = L::broadcast(0.0f);
+  Float_T cosOutgoing;
+  LaneVec3 normal = faceForward(batch.normal, batch.outgoing, cosOutgoing);
+  LaneVec3 tangent;
+  LaneVec3 bitangent;
+  buildBasisLanes(normal, tangent, bitangent);
+  Float_T alphaSquared = ggxAlphaSquared(batch.roughness);
+
+  Float_T cosHalf;
+  LaneVec3 half = sampleGgxHalfVector(normal, tangent, bitangent, alphaSquared,
+                                      batch.u, batch.v, cosHalf);
+  Float_T cosOutgoingHalf = dot3(batch.outgoing, half);
+  result.direction = reflect3(batch.outgoing, half, cosOutgoingHalf);
+  Float_T cosIncoming = dot3(normal, result.direction);
+  /* D F G / (4 cos_o cos_i) * cos_i / (D cos_h / (4 (o.h))) */
+  Float_T masking = L::mul(smithG1(cosOutgoing, alphaSquared),
+                           smithG1(cosIncoming, alphaSquared));
+  Float_T scale = L::div(L::mul(masking, cosOutgoingHalf),
+                         L::mul(cosOutgoing, cosHalf));
+  Mask_T valid = L::logicalAnd(
+      L::logicalAnd(L::less(zero, cosIncoming), L::less(zero, cosOutgoing)),
+      L::less(zero, cosOutgoingHalf));
+  result.weight =
+      select3(valid, scale3(schlickFresnel(batch.albedo, cosOutgoingHalf),
+                            scale),
+              broadcast3(0.0f));
+
+  Float_T cosLight;
+  result.lightWeight =
+      ggxReflectionPi(normal, batch.outgoing, cosOutgoing, batch.lightDirection,
+                      alphaSquared, batch.albedo, cosLight);
+  result.specular = L::fromBits(0);
+}
+
+static void shadeDielectricLanes(const ShadeBatch &batch,
+                                 ShadeResult &result) noexcept {
+  Float_T zero = L::broadcast(0.0f);
+  Float_T one = L::broadcast(1.0f);
+  Float_T cosine = dot3(batch.normal, batch.outgoing);
+  Mask_T entering = L::less(zero, cosine);
+  LaneVec3 normal =
+      select3(entering, batch.normal, negate3(batch.normal));
+  Float_T cosIncident = L::abs(cosine);
+  /* Ratio of the index on the outgoing side over the other side */
+  Float_T eta = L::select(entering, L::div(one, batch.ior), batch.ior);
+
+  Float_T sinSquaredTransmitted = L::mul(
+      L::mul(eta, eta), L::sub(one, L::mul(cosIncident, cosIncident)));
+  Mask_T totalReflection = L::lessEqual(one, sinSquaredTransmitted);
+  Float_T cosTransmitted =
+      L::sqrt(L::max(zero, L::sub(one, sinSquaredTransmitted)));
+  Float_T etaCosTransmitted = L::mul(eta, cosTransmitted);
+  Float_T etaCosIncident = L::mul(eta, cosIncident);
+  Float_T parallel = L::div(L::sub(cosIncident, etaCosTransmitted),
+                            L::add(cosIncident, etaCosTransmitted));
+  Float_T perpendicular = L::div(L::sub(etaCosIncident, cosTransmitted),
+                                 L::add(etaCosIncident, cosTransmitted));
+  Float_T fresnel = L::select(
+      totalReflection, one,
+      L::mul(L::broadcast(0.5f), L::add(L::mul(parallel, parallel),
+                                        L::mul(perpendicular, perpendicular))));
+
+  /* Reflection and refraction are picked with probability F and 1 - F, which
+  cancels the Fresnel term of the weight */
+  Mask_T reflected = L::less(batch.w, fresnel);
+  LaneVec3 reflection = reflect3(batch.outgoing, normal, cosIncident);
+  LaneVec3 refraction =
+      add3(scale3(batch.outgoing, L::flipSign(eta, L::broadcast(-1.0f))),
+           scale3(normal, L::sub(etaCosIncident, cosTransmitted)));
+  result.direction = select3(reflected, reflection, refraction);
+  /* Radiance is compressed by eta^2 when entering a denser medium */
+  result.weight = select3(reflected, batch.albedo,
+                          scale3(batch.albedo, L::mul(eta, eta)));
+  result.lightWeight = broadcast3(0.0f);
+  result.specular = L::fromBits((1u << L::width) - 1);
+}
+
+static void shadePrincipledLanes(const ShadeBatch &batch,
+                                 ShadeResult &result) noexcept {
+  Float_T zero = L::broadcast(0.0f);
+  Float_T one = L::broadcast(1.0f);
+  Float_T cosOutgoing;
+  LaneVec3 normal = faceForward(batch.normal, batch.outgoing, cosOutgoing);
+  LaneVec3 tangent;
+  LaneVec3 bitangent;
+  buildBasisLanes(normal, tangent, bitangent);
+  Float_T alphaSquared = ggxAlphaSquared(batch.roughness);
+  LaneVec3 f0 = add3(broadcast3(0.04f),
+                     scale3(sub3(batch.albedo, broadcast3(0.04f)),
+                            batch.metallic));
+  LaneVec3 diffuse = scale3(batch.albedo, L::sub(one, batch.metallic));
+  /* Metals have no diffuse lobe to sample */
+  Float_T specularProbability =
+      L::mul(L::broadcast(0.5f), L::add(one, batch.metallic));
+
+  /* Both lobes are sampled and each lane keeps one, the weight below accounts
+  for both lobes being able to produce the direction */
+  Float_T cosHalf;
+  LaneVec3 half = sampleGgxHalfVector(normal, tangent, bitangent, alphaSquared,
+                                      batch.u, batch.v, cosHalf);
+  LaneVec3 specularDirection =
+      reflect3(batch.outgoing, half, dot3(batch.outgoing, half));
+  LaneVec3 diffuseDirection =
+      sampleCosineLanes(normal, tangent, bitangent, batch.u, batch.v);
+  result.direction = select3(L::less(batch.w, specularProbability),
+                             specularDirection, diffuseDirection);
+
+  Float_T cosIncoming;
+  LaneVec3 valuePi =
+      add3(ggxReflectionPi(normal, batch.outgoing, cosOutgoing,
+                           result.direction, alphaSquared, f0, cosIncoming),
+           diffuse);
+  LaneVec3 sampledHalf = normalize3(add3(batch.outgoing, result.direction));
+  /* Mixture pdf times pi */
+  Float_T specularPdfPi = L::div(
+      L::mul(ggxDistributionPi(dot3(normal, sampledHalf), alphaSquared),
+             dot3(normal, sampledHalf)),
+      L::mul(L::broadcast(4.0f), dot3(batch.outgoing, sampledHalf)));
+  Float_T pdfPi =
+      L::add(L::mul(specularProbability, specularPdfPi),
+             L::mul(L::sub(one, specularProbability), cosIncoming));
+  Mask_T valid = L::logicalAnd(
+      L::logicalAnd(L::less(zero, cosIncoming), L::less(zero, cosOutgoing)),
+      L::less(zero, pdfPi));
+  result.weight = select3(valid, scale3(valuePi, L::div(cosIncoming, pdfPi)),
+                          broadcast3(0.0f));
+
+  Float_T cosLight;
+  LaneVec3 lightValuePi =
+      add3(ggxReflectionPi(normal, batch.outgoing, cosOutgoing,
+                           batch.lightDirection, alphaSquared, f0, cosLight),
+           diffuse);
+  result.lightWeight =
+      select3(L::less(zero, cosLight), lightValuePi, broadcast3(0.0f));
+  result.specular = L::fromBits(0);
+}
+
+/* Attributes gathered per batch, one row of lanes each */
+enum ShadeRow : u32 {
+  normalRow = 0,
+  outgoingRow = 3,
+  lightDirectionRow = 6,
+  albedoRow = 9,
+  uRow = 12,
+  vRow,
+  wRow,
+  roughnessRow,
+  iorRow,
+  metallicRow,
+  inputRowCount,
+  directionRow = 0,
+  weightRow = 3,
+  lightWeightRow = 6,
+  outputRowCount = 9,
+};
+
+static LaneVec3 loadRows(const f32 (*pRows)[L::width], u32 row) noexcept {
+  return {L::load(pRows[row]), L::load(pRows[row + 1]),
+          L::load(pRows[row + 2])};
+}
+
+static void storeRows(f32 (*pRows)[L::width], u32 row,
+                      const LaneVec3 &vec) noexcept {
+  L::store(pRows[row], vec.x);
+  L::store(pRows[row + 1], vec.y);
+  L::store(pRows[row + 2], vec.z);
+}
+
+static void setRows(f32 (*pRows)[L::width], u32 row, u32 lane,
+                    const Vec3 &vec) noexcept {
+  pRows[row][lane] = vec.x;
+  pRows[row + 1][lane] = vec.y;
+  pRows[row + 2][lane] = vec.z;
+}
+
+/**
+ * @brief Shades the entries {pSlots[0, count)} of {queue} with
+ * {shadeLanes(batch, result)}. The attributes and material parameters of a
+ * batch are fetched together before any evaluation, the last batch repeats
+ * its last entry in the unused lanes.
+ */
+template <typename ShadeFunc>
+static void shadeSlots(const Material *pMaterials, ShadingQueue &queue,
+                       const u32 *pSlots, u32 count,
+                       const ShadeFunc &shadeLanes) noexcept {
+  alignas(32) f32 rows[inputRowCount][L::width];
+  for (u32 first = 0; first < count; first += L::width) {
+    u32 laneCount = std::min(L::width, count - first);
+    for (u32 lane = 0; lane < L::width; ++lane) {
+      u32 slot = pSlots[first + std::min(lane, laneCount - 1)];
+      const Material &material = pMaterials[queue.materialIndices[slot]];
+      setRows(rows, normalRow, lane, queue.normals[slot]);
+      setRows(rows, outgoingRow, lane, queue.outgoing[slot]);
+      setRows(rows, lightDirectionRow, lane, queue.lightDirections[slot]);
+      setRows(rows, albedoRow, lane, material.albedo);
+      rows[uRow][lane] = queue.u[slot];
+      rows[vRow][lane] = queue.v[slot];
+      rows[wRow][lane] = queue.w[slot];
+      rows[roughnessRow][lane] = material.roughness;
+      rows[iorRow][lane] = material.ior;
+      rows[metallicRow][lane] = material.metallic;
+    }
+    ShadeBatch batch = {loadRows(rows, normalRow),
+                        loadRows(rows, outgoingRow),
+                        loadRows(rows, lightDirectionRow),
+                        L::load(rows[uRow]),
+                        L::load(rows[vRow]),
+                        L::load(rows[wRow]),
+                        loadRows(rows, albedoRow),
+                        L::load(rows[roughnessRow]),
+                        L::load(rows[iorRow]),
+                        L::load(rows[metallicRow])};
+    ShadeResult result;
+    shadeLanes(batch, result);
+
+    storeRows(rows, directionRow, result.direction);
+    storeRows(rows, weightRow, result.weight);
+    storeRows(rows, lightWeightRow, result.lightWeight);
+    u32 specularBits = L::bits(result.specular);
+    for (u32 lane = 0; lane < laneCount; ++lane) {
+      u32 slot = pSlots[first + lane];
+      queue.directions[slot] = {rows[directionRow][lane],
+                                rows[directionRow + 1][lane],
+                                rows[directionRow + 2][lane]};
+      queue.weights[slot] = {rows[weightRow][lane], rows[weightRow + 1][lane],
+                             rows[weightRow + 2][lane]};
+      queue.lightWeights[slot] = {rows[lightWeightRow][lane],
+                                  rows[lightWeightRow + 1][lane],
+                                  rows[lightWeightRow + 2][lane]};
+      queue.specular[slot] = static_cast<u8>((specularBits >> lane) & 1);
+    }
+  }
+}
+
+static void shadeDiffuse(const Material *pMaterials, ShadingQueue &queue,
+                         const u32 *pSlots, u32 count) {
+  shadeSlots(pMaterials, queue, pSlots, count, shadeDiffuseLanes);
+}
+
+static void shadeConductor(const Material *pMaterials, ShadingQueue &queue,
+                           const u32 *pSlots, u32 count) {
+  shadeSlots(pMaterials, queue, pSlots, count, shadeConductorLanes);
+}
+
+static void shadeDielectric(const Material *pMaterials, ShadingQueue &queue,
+                            const u32 *pSlots, u32 count) {
+  shadeSlots(pMaterials, queue, pSlots, count, shadeDielectricLanes);
+}
+
+static void shadePrincipled(const Material *pMaterials, ShadingQueue &queue,
+                            const u32 *pSlots, u32 count) {
+  shadeSlots(pMaterials, queue, pSlots, count, shadePrincipledLanes);
+}
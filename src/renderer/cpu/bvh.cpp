@@ -0,0 +1,330 @@
+#include "bvh.hpp"
+
+#include "parallel.hpp"
+
+#include <atomic>
+
+namespace neko {
+
+struct Bvh::BuildContext {
+  ThreadPool *pThreadPool;
+  const BvhBuildOptions *pOptions;
+  const std::vector<Aabb> *pPrimitiveBounds;
+  std::vector<Vec3> centroids;
+  /* Nodes are allocated in sibling pairs by concurrent build jobs */
+  std::atomic<u32> nodeCount;
+};
+
+struct RangeBounds {
+  Aabb bounds;
+  Aabb centroidBounds;
+};
+
+struct Bin {
+  Aabb bounds;
+  u32 count = 0;
+};
+
+struct SplitCandidate {
+  bool valid = false;
+  u32 axis = 0;
+  /* Bins up to and including {bin} go to the first child */
+  u32 bin = 0;
+  f32 cost = infinity;
+};
+
+static u32 binIndex(f32 centroid, f32 lower, f32 scale, u32 binCount) {
+  auto index = static_cast<i64>((centroid - lower) * scale);
+  return static_cast<u32>(
+      std::clamp<i64>(index, 0, static_cast<i64>(binCount) - 1));
+}
+
+static RangeBounds computeRangeBounds(ThreadPool &threadPool,
+                                      const std::vector<Aabb> &primitiveBounds,
+                                      const std::vector<Vec3> &centroids,
+                                      const std::vector<u32> &indices,
+                                      u32 begin, u32 end, bool parallel) {
+  auto mapFunc = [&](u64 chunkBegin, u64 chunkEnd) {
+    RangeBounds range;
+    for (u64 index = chunkBegin; index < chunkEnd; ++index) {
+      range.bounds.extend(primitiveBounds[indices[index]]);
+      range.centroidBounds.extend(centroids[indices[index]]);
+    }
+    return range;
+  };
+  if (!parallel) {
+    return mapFunc(begin, end);
+  }
+  return parallelReduce(threadPool, begin, end, 0, RangeBounds{}, mapFunc,
+                        [](RangeBounds lhs, const RangeBounds &rhs) {
+                          lhs.bounds.extend(rhs.bounds);
+                          lhs.centroidBounds.extend(rhs.centroidBounds);
+                          return lhs;
+                        });
+}
+
+/**
+ * @brief Bins the centroids of [begin, end) along all three axes and returns
+ * the cheapest split between two bins according to the SAH.
+ */
+static SplitCandidate findSahSplit(ThreadPool &threadPool,
+                                   const BvhBuildOptions &options,
+                                   const std::vector<Aabb> &primitiveBounds,
+                                   const std::vector<Vec3> &centroids,
+                                   const std::vector<u32> &indices,
+                                   const RangeBounds &range, u32 begin,
+                                   u32 end, bool parallel) {
+  u32 binCount = options.binCount;
+  Vec3 lower = range.centroidBounds.lower;
+  Vec3 extent = range.centroidBounds.extent();
+  f32 scales[3];
+  for (u32 axis = 0; axis < 3; ++axis) {
+    scales[axis] = extent[axis] > 0.0f
+                       ? static_cast<f32>(binCount) / extent[axis]
+                       : 0.0f;
+  }
+
+  auto mapFunc = [&](u64 chunkBegin, u64 chunkEnd) {
+    std::vector<Bin> bins(3 * stdu64(binCount));
+    for (u64 index = chunkBegin; index < chunkEnd; ++index) {
+      u32 primitiveIndex = indices[index];
+      const Vec3 &centroid = centroids[primitiveIndex];
+      for (u32 axis = 0; axis < 3; ++axis) {
+        Bin &bin = bins[axis * binCount + binIndex(centroid[axis], lower[axis],
+                                                   scales[axis], binCount)];
+        bin.bounds.extend(primitiveBounds[primitiveIndex]);
+        ++bin.count;
+      }
+    }
+    return bins;
+  };
+  auto reduceFunc = [](std::vector<Bin> lhs, const std::vector<Bin> &rhs) {
+    for (u64 iBin = 0; iBin < lhs.size(); ++iBin) {
+      lhs[iBin].bounds.extend(rhs[iBin].bounds);
+      lhs[iBin].count += rhs[iBin].count;
+    }
+    return lhs;
+  };
+  std::vector<Bin> bins;
+  if (parallel) {
+    bins = parallelReduce(threadPool, begin, end, 0,
+                          std::vector<Bin>(3 * stdu64(binCount)), mapFunc,
+                          reduceFunc);
+  } else {
+    bins = mapFunc(begin, end);
+  }
+
+  f32 parentArea = std::max(range.bounds.surfaceArea(), 1e-12f);
+  SplitCandidate best;
+  std::vector<f32> secondCosts(binCount);
+  for (u32 axis = 0; axis < 3; ++axis) {
+    if (scales[axis] == 0.0f) {
+      continue;
+    }
+    const Bin *pAxisBins = &bins[axis * binCount];
+    /* {secondCosts[iBin]}: area times count of the bins after {iBin} */
+    Aabb secondBounds;
+    u32 secondCount = 0;
+    for (u32 iBin = binCount - 1; iBin > 0; --iBin) {
+      secondBounds.extend(pAxisBins[iBin].bounds);
+      secondCount += pAxisBins[iBin].count;
+      secondCosts[iBin - 1] =
+          secondBounds.surfaceArea() * static_cast<f32>(secondCount);
+    }
+    Aabb firstBounds;
+    u32 firstCount = 0;
+    for (u32 iBin = 0; iBin + 1 < binCount; ++iBin) {
+      firstBounds.extend(pAxisBins[iBin].bounds);
+      firstCount += pAxisBins[iBin].count;
+      if (firstCount == 0 || firstCount == end - begin) {
+        continue;
+      }
+      f32 cost = options.traversalCost +
+                 (firstBounds.surfaceArea() * static_cast<f32>(firstCount) +
+                  secondCosts[iBin]) /
+                     parentArea;
+      if (cost < best.cost) {
+        best = {true, axis, iBin, cost};
+      }
+    }
+  }
+  return best;
+}
+
+BvhBuildStats Bvh::build(ThreadPool &threadPool,
+                         const std::vector<Aabb> &primitiveBounds,
+                         const BvhBuildOptions &options) {
+  ScopedTimer timer{TimeUnit::milliseconds};
+  mNodes.clear();
+  mPrimitiveIndices.clear();
+  if (primitiveBounds.empty()) {
+    return {};
+  }
+  if (primitiveBounds.size() >= stdu64(~0u) / 2) {
+    throw std::runtime_error("Too many primitives for a BVH.");
+  }
+  auto primitiveCount = static_cast<u32>(primitiveBounds.size());
+
+  BvhBuildOptions validOptions = options;
+  validOptions.maxLeafSize = std::max(validOptions.maxLeafSize, 1u);
+  validOptions.binCount = std::max(validOptions.binCount, 2u);
+  validOptions.parallelThreshold =
+      std::max(validOptions.parallelThreshold, 2u);
+
+  BuildContext context;
+  context.pThreadPool = &threadPool;
+  context.pOptions = &validOptions;
+  context.pPrimitiveBounds = &primitiveBounds;
+  context.centroids.resize(primitiveCount);
+  context.nodeCount = 1;
+  mPrimitiveIndices.resize(primitiveCount);
+  parallelFor(threadPool, 0, primitiveCount, 0, [&](u64 iPrimitive) {
+    context.centroids[iPrimitive] = primitiveBounds[iPrimitive].center();
+    mPrimitiveIndices[iPrimitive] = static_cast<u32>(iPrimitive);
+  });
+
+  /* A binary tree with single-primitive leaves is the largest possible */
+  mNodes.resize(2 * stdu64(primitiveCount) - 1);
+  buildNode(context, 0, 0, primitiveCount, 0);
+  mNodes.resize(context.nodeCount);
+  mNodes.shrink_to_fit();
+
+  BvhBuildStats stats = collectStats(validOptions);
+  stats.buildTime = timer.now();
+  return stats;
+}
+
+void Bvh::buildNode(BuildContext &context, u32 nodeIndex, u32 begin, u32 end,
+                    u32 depth) {
+  const auto &options = *context.pOptions;
+  const auto &primitiveBounds = *context.pPrimitiveBounds;
+  u32 primitiveCount = end - begin;
+  bool parallel = primitiveCount >= options.parallelThreshold;
+
+  RangeBounds range =
+      computeRangeBounds(*context.pThreadPool, primitiveBounds,
+                         context.centroids, mPrimitiveIndices, begin, end,
+                         parallel);
+  BvhNode &node = mNodes[nodeIndex];
+  node.lower = range.bounds.lower;
+  node.upper = range.bounds.upper;
+  if (primitiveCount == 1 || depth + 1 >= maxDepth) {
+    node.offset = begin;
+    node.primitiveCount = primitiveCount;
+    return;
+  }
+
+  SplitCandidate split = findSahSplit(
+      *context.pThreadPool, options, primitiveBounds, context.centroids,
+      mPrimitiveIndices, range, begin, end, parallel);
+  bool mustSplit = primitiveCount > options.maxLeafSize;
+  if (!mustSplit &&
+      (!split.valid || split.cost >= static_cast<f32>(primitiveCount))) {
+    node.offset = begin;
+    node.primitiveCount = primitiveCount;
+    return;
+  }
+
+  u32 middle;
+  if (split.valid) {
+    f32 lower = range.centroidBounds.lower[split.axis];
+    f32 scale = static_cast<f32>(options.binCount) /
+                range.centroidBounds.extent()[split.axis];
+    auto pMiddle = std::partition(
+        mPrimitiveIndices.begin() + begin, mPrimitiveIndices.begin() + end,
+        [&](u32 primitiveIndex) {
+          return binIndex(context.centroids[primitiveIndex][split.axis], lower,
+                          scale, options.binCount) <= split.bin;
+        });
+    middle = static_cast<u32>(pMiddle - mPrimitiveIndices.begin());
+  } else {
+    /* Every centroid coincides, any split is as good as another */
+    middle = begin + primitiveCount / 2;
+  }
+
+  u32 firstChild = context.nodeCount.fetch_add(2, std::memory_order_relaxed);
+  node.offset = firstChild;
+  node.primitiveCount = 0;
+  if (parallel) {
+    JobCounter counter;
+    context.pThreadPool->submit(
+        [this, &context, firstChild, begin, middle, depth] {
+          buildNode(context, firstChild, begin, middle, depth + 1);
+        },
+        counter);
+    buildNode(context, firstChild + 1, middle, end, depth + 1);
+    context.pThreadPool->wait(counter);
+  } else {
+    buildNode(context, firstChild, begin, middle, depth + 1);
+    buildNode(context, firstChild + 1, middle, end, depth + 1);
+  }
+}
+
+void Bvh::refit(ThreadPool &threadPool,
+                const std::vector<Aabb> &primitiveBounds) {
+  if (primitiveBounds.size() != mPrimitiveIndices.size()) {
+    throw std::runtime_error("Refitting a BVH requires the same primitives.");
+  }
+  parallelFor(threadPool, 0, mNodes.size(), 0, [&](u64 iNode) {
+    BvhNode &node = mNodes[iNode];
+    if (!node.leaf()) {
+      return;
+    }
+    Aabb box;
+    for (u32 iPrimitive = node.offset;
+         iPrimitive < node.offset + node.primitiveCount; ++iPrimitive) {
+      box.extend(primitiveBounds[mPrimitiveIndices[iPrimitive]]);
+    }
+    node.lower = box.lower;
+    node.upper = box.upper;
+  });
+  /* Children are allocated after their parent, so a reverse sweep visits
+  them first */
+  for (u64 iNode = mNodes.size(); iNode-- > 0;) {
+    BvhNode &node = mNodes[iNode];
+    if (!node.leaf()) {
+      Aabb box = mNodes[node.offset].bounds();
+      box.extend(mNodes[node.offset + 1].bounds());
+      node.lower = box.lower;
+      node.upper = box.upper;
+    }
+  }
+}
+
+u32 Bvh::maxLeafSize() const noexcept {
+  u32 maxPrimitiveCount = 0;
+  for (const BvhNode &node : mNodes) {
+    maxPrimitiveCount = std::max(maxPrimitiveCount, node.primitiveCount);
+  }
+  return maxPrimitiveCount;
+}
+
+BvhBuildStats Bvh::collectStats(const BvhBuildOptions &options) const {
+  BvhBuildStats stats;
+  stats.nodeCount = static_cast<u32>(mNodes.size());
+  f32 rootArea = std::max(mNodes[0].bounds().surfaceArea(), 1e-12f);
+
+  struct StackEntry {
+    u32 nodeIndex;
+    u32 depth;
+  };
+  std::vector<StackEntry> stack = {{0, 0}};
+  while (!stack.empty()) {
+    auto [nodeIndex, depth] = stack.back();
+    stack.pop_back();
+    const BvhNode &node = mNodes[nodeIndex];
+    f32 areaRatio = node.bounds().surfaceArea() / rootArea;
+    stats.maxDepth = std::max(stats.maxDepth, depth);
+    if (node.leaf()) {
+      ++stats.leafCount;
+      stats.sahCost += areaRatio * static_cast<f32>(node.primitiveCount);
+    } else {
+      stats.sahCost += areaRatio * options.traversalCost;
+      stack.push_back({node.offset, depth + 1});
+      stack.push_back({node.offset + 1, depth + 1});
+    }
+  }
+  return stats;
+}
+
+} /* namespace neko */
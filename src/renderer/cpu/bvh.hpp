@@ -0,0 +1,289 @@
+#ifndef NEKO_RENDERER_CPU_BVH_HPP
+#define NEKO_RENDERER_CPU_BVH_HPP
+
+#include "math.hpp"
+
+namespace neko {
+
+class ThreadPool;
+
+/**
+ * @brief Flattened BVH node. The two children of an interior node are stored
+ * next to each other, so a node only needs the index of the first one.
+ */
+struct BvhNode {
+  Vec3 lower;
+  /* First child of an interior node, first primitive reference of a leaf */
+  u32 offset = 0;
+  Vec3 upper;
+  /* 0 for interior nodes */
+  u32 primitiveCount = 0;
+
+  bool leaf() const noexcept { return primitiveCount > 0; }
+
+  Aabb bounds() const noexcept { return {lower, upper}; }
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode should fit two per cache line");
+
+struct BvhBuildOptions {
+  /* Nodes with more primitives are always split */
+  u32 maxLeafSize = 4;
+  /* Candidate split planes per axis are the boundaries of this many bins */
+  u32 binCount = 16;
+  /* SAH cost of visiting a node, relative to intersecting one primitive */
+  f32 traversalCost = 1.0f;
+  /* Subtrees with at least this many primitives are built as separate jobs
+  and binned in parallel */
+  u32 parallelThreshold = 4096;
+};
+
+struct BvhBuildStats {
+  /* Milliseconds */
+  f32 buildTime = 0.0f;
+  u32 nodeCount = 0;
+  u32 leafCount = 0;
+  u32 maxDepth = 0;
+  /* Nodes of the collapsed wide or compressed BVH, 0 if none was built */
+  u32 wideNodeCount = 0;
+  /* Expected cost of a random ray, in primitive intersections */
+  f32 sahCost = 0.0f;
+};
+
+/**
+ * @brief Counters of a batch of traversals, accumulated by the caller.
+ */
+struct TraversalStats {
+  u64 rayCount = 0;
+  u64 visitedNodeCount = 0;
+
+  TraversalStats &operator+=(const TraversalStats &rhs) noexcept {
+    rayCount += rhs.rayCount;
+    visitedNodeCount += rhs.visitedNodeCount;
+    return *this;
+  }
+
+  f64 averageVisitedNodeCount() const noexcept {
+    return rayCount > 0 ? static_cast<f64>(visitedNodeCount) /
+                              static_cast<f64>(rayCount)
+                        : 0.0;
+  }
+};
+
+/**
+ * @brief Slab test against the box {[lower, upper]}. On a hit, {tEntry} is the
+ * distance at which the ray enters the box, clamped to 0.
+ */
+inline bool intersectBounds(const Vec3 &lower, const Vec3 &upper,
+                            const Vec3 &origin, const Vec3 &invDirection,
+                            f32 tMax, f32 &tEntry) noexcept {
+  f32 tx0 = (lower.x - origin.x) * invDirection.x;
+  f32 tx1 = (upper.x - origin.x) * invDirection.x;
+  f32 ty0 = (lower.y - origin.y) * invDirection.y;
+  f32 ty1 = (upper.y - origin.y) * invDirection.y;
+  f32 tz0 = (lower.z - origin.z) * invDirection.z;
+  f32 tz1 = (upper.z - origin.z) * invDirection.z;
+  f32 tNear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)),
+                       std::max(std::min(tz0, tz1), 0.0f));
+  f32 tFar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)),
+                      std::min(std::max(tz0, tz1), tMax));
+  tEntry = tNear;
+  return tNear <= tFar;
+}
+
+/**
+ * @brief Binary bounding volume hierarchy over abstract primitives, built
+ * top-down with binned SAH splits. The tree only stores primitive indices,
+ * intersecting the primitives themselves is left to the caller.
+ */
+class Bvh {
+public:
+  /* Deepest tree the traversal stack can hold */
+  static constexpr u32 maxDepth = 64;
+
+  Bvh() = default;
+  Bvh(const Bvh &) = delete;
+  Bvh(Bvh &&) = default;
+  Bvh &operator=(const Bvh &) = delete;
+  Bvh &operator=(Bvh &&) = default;
+  ~Bvh() = default;
+
+  /**
+   * @brief Rebuilds the tree over {primitiveBounds}, primitive i being bounded
+   * by {primitiveBounds[i]}.
+   */
+  BvhBuildStats build(ThreadPool &threadPool,
+                      const std::vector<Aabb> &primitiveBounds,
+                      const BvhBuildOptions &options);
+
+  /**
+   * @brief Updates the node bounds after primitives moved, keeping the tree
+   * topology. Much cheaper than {build}, but the tree degrades as primitives
+   * drift away from their original neighbours.
+   */
+  void refit(ThreadPool &threadPool, const std::vector<Aabb> &primitiveBounds);
+
+  bool empty() const noexcept { return mNodes.empty(); }
+
+  const std::vector<BvhNode> &nodes() const noexcept { return mNodes; }
+
+  /* Primitive indices referenced by the leaves, in leaf order */
+  const std::vector<u32> &primitiveIndices() const noexcept {
+    return mPrimitiveIndices;
+  }
+
+  /* Largest primitive count of a leaf */
+  u32 maxLeafSize() const noexcept;
+
+  /* Bytes used by the nodes and primitive indices */
+  u64 memoryBytes() const noexcept {
+    return mNodes.size() * sizeof(BvhNode) +
+           mPrimitiveIndices.size() * sizeof(u32);
+  }
+
+  /**
+   * @brief Closest-hit traversal, nearer child first. {intersectPrimitive(
+   * primitiveIndex, ray)} must return whether it found a hit closer than
+   * {ray.tMax}, and shorten {ray.tMax} accordingly.
+   */
+  template <typename IntersectFunc>
+  bool traverse(Ray &ray, const IntersectFunc &intersectPrimitive,
+                TraversalStats &stats) const {
+    ++stats.rayCount;
+    if (mNodes.empty()) {
+      return false;
+    }
+    Vec3 invDirection = {1.0f / ray.direction.x, 1.0f / ray.direction.y,
+                         1.0f / ray.direction.z};
+    f32 tEntry;
+    if (!intersectBounds(mNodes[0].lower, mNodes[0].upper, ray.origin,
+                         invDirection, ray.tMax, tEntry)) {
+      return false;
+    }
+
+    struct StackEntry {
+      u32 nodeIndex;
+      f32 tEntry;
+    };
+    StackEntry stack[maxDepth];
+    u32 stackSize = 0;
+    u32 nodeIndex = 0;
+    bool found = false;
+    while (true) {
+      const BvhNode &node = mNodes[nodeIndex];
+      ++stats.visitedNodeCount;
+      if (!node.leaf()) {
+        const BvhNode &firstChild = mNodes[node.offset];
+        const BvhNode &secondChild = mNodes[node.offset + 1];
+        f32 tFirst;
+        f32 tSecond;
+        bool hitFirst =
+            intersectBounds(firstChild.lower, firstChild.upper, ray.origin,
+                            invDirection, ray.tMax, tFirst);
+        bool hitSecond =
+            intersectBounds(secondChild.lower, secondChild.upper, ray.origin,
+                            invDirection, ray.tMax, tSecond);
+        if (hitFirst && hitSecond) {
+          bool firstIsNearer = tFirst <= tSecond;
+          stack[stackSize++] = {node.offset + (firstIsNearer ? 1u : 0u),
+                                firstIsNearer ? tSecond : tFirst};
+          nodeIndex = node.offset + (firstIsNearer ? 0u : 1u);
+          continue;
+        }
+        if (hitFirst || hitSecond) {
+          nodeIndex = node.offset + (hitFirst ? 0u : 1u);
+          continue;
+        }
+      } else {
+        for (u32 iPrimitive = 0; iPrimitive < node.primitiveCount;
+             ++iPrimitive) {
+          found |= intersectPrimitive(
+              mPrimitiveIndices[node.offset + iPrimitive], ray);
+        }
+      }
+
+      /* Skip subtrees behind the closest hit found since they were pushed */
+      do {
+        if (stackSize == 0) {
+          return found;
+        }
+        --stackSize;
+      } while (stack[stackSize].tEntry > ray.tMax);
+      nodeIndex = stack[stackSize].nodeIndex;
+    }
+  }
+
+  /**
+   * @brief Any-hit traversal, which stops at the first primitive for which
+   * {occludedPrimitive(primitiveIndex)} returns true. Children are visited in
+   * memory order: with no closest hit to shorten the ray, ordering them would
+   * not prune anything.
+   */
+  template <typename OccludedFunc>
+  bool traverseAny(const Ray &ray, const OccludedFunc &occludedPrimitive,
+                   TraversalStats &stats) const {
+    ++stats.rayCount;
+    if (mNodes.empty()) {
+      return false;
+    }
+    Vec3 invDirection = {1.0f / ray.direction.x, 1.0f / ray.direction.y,
+                         1.0f / ray.direction.z};
+    u32 stack[maxDepth];
+    u32 stackSize = 0;
+    u32 nodeIndex = 0;
+    f32 tEntry;
+    if (!intersectBounds(mNodes[0].lower, mNodes[0].upper, ray.origin,
+                         invDirection, ray.tMax, tEntry)) {
+      return false;
+    }
+    while (true) {
+      const BvhNode &node = mNodes[nodeIndex];
+      ++stats.visitedNodeCount;
+      if (!node.leaf()) {
+        const BvhNode &firstChild = mNodes[node.offset];
+        const BvhNode &secondChild = mNodes[node.offset + 1];
+        bool hitFirst =
+            intersectBounds(firstChild.lower, firstChild.upper, ray.origin,
+                            invDirection, ray.tMax, tEntry);
+        bool hitSecond =
+            intersectBounds(secondChild.lower, secondChild.upper, ray.origin,
+                            invDirection, ray.tMax, tEntry);
+        if (hitFirst && hitSecond) {
+          stack[stackSize++] = node.offset + 1;
+        }
+        if (hitFirst || hitSecond) {
+          nodeIndex = node.offset + (hitFirst ? 0u : 1u);
+          continue;
+        }
+      } else {
+        for (u32 iPrimitive = 0; iPrimitive < node.primitiveCount;
+             ++iPrimitive) {
+          if (occludedPrimitive(
+                  mPrimitiveIndices[node.offset + iPrimitive])) {
+            return true;
+          }
+        }
+      }
+
+      if (stackSize == 0) {
+        return false;
+      }
+      nodeIndex = stack[--stackSize];
+    }
+  }
+
+private:
+  struct BuildContext;
+
+  std::vector<BvhNode> mNodes;
+  std::vector<u32> mPrimitiveIndices;
+
+  void buildNode(BuildContext &context, u32 nodeIndex, u32 begin, u32 end,
+                 u32 depth);
+
+  BvhBuildStats collectStats(const BvhBuildOptions &options) const;
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_BVH_HPP */
@@ -0,0 +1,157 @@
+#include "compressed_bvh.hpp"
+
+namespace neko {
+
+/**
+ * @brief Smallest power of two exponent whose 255 grid steps from {lower}
+ * reach {upper}.
+ */
+static i32 gridExponent(f32 lower, f32 upper) noexcept {
+  i32 exponent = -126;
+  if (upper > lower) {
+    std::frexp((upper - lower) / 255.0f, &exponent);
+    exponent = std::max(exponent, -126);
+  }
+  while (exponent < 127 &&
+         lower + 255.0f * std::ldexp(1.0f, exponent) < upper) {
+    ++exponent;
+  }
+  return exponent;
+}
+
+/* The decoded bounds are checked in floating point, so that rounding can only
+grow the child box */
+
+static u8 quantizeLower(f32 value, f32 origin, f32 step) noexcept {
+  f32 q = std::clamp(std::floor((value - origin) / step), 0.0f, 255.0f);
+  auto quantized = static_cast<u32>(q);
+  while (quantized > 0 &&
+         origin + static_cast<f32>(quantized) * step > value) {
+    --quantized;
+  }
+  return static_cast<u8>(quantized);
+}
+
+static u8 quantizeUpper(f32 value, f32 origin, f32 step) noexcept {
+  f32 q = std::clamp(std::ceil((value - origin) / step), 0.0f, 255.0f);
+  auto quantized = static_cast<u32>(q);
+  while (quantized < 255 &&
+         origin + static_cast<f32>(quantized) * step < value) {
+    ++quantized;
+  }
+  return static_cast<u8>(quantized);
+}
+
+void CompressedBvh::build(const Bvh &bvh,
+                          const std::vector<Triangle> &triangles,
+                          SimdIsa isa) {
+  mNodes.clear();
+  mBlocks4.clear();
+  mBlocks8.clear();
+  mKernels = {};
+  if (bvh.empty()) {
+    return;
+  }
+
+  /* The block width depends on the instruction set the kernel can use */
+  mIsa = clampCompressedBvhIsa(isa);
+  mBlockWidth = selectTriangleBlockWidth(mIsa, bvh.maxLeafSize());
+  if (mBlockWidth == 4) {
+    quantizeNodes(bvh, triangles, mBlocks4);
+  } else {
+    quantizeNodes(bvh, triangles, mBlocks8);
+  }
+  mKernels = selectCompressedBvhKernels(mBlockWidth, mIsa);
+}
+
+template <u32 BlockWidth>
+void CompressedBvh::quantizeNodes(
+    const Bvh &bvh, const std::vector<Triangle> &triangles,
+    std::vector<TriangleBlock<BlockWidth>> &blocks) {
+  std::vector<WideBvhNode<8>> wideNodes;
+  collapseBvh(bvh, wideNodes);
+  const std::vector<u32> &primitiveIndices = bvh.primitiveIndices();
+
+  /* Nodes are emitted top-down, reserving adjacent slots for the interior
+  children of each node and appending the triangle blocks of its leaf
+  children */
+  struct PendingNode {
+    u32 wideIndex;
+    u32 compressedIndex;
+  };
+  std::vector<PendingNode> pendingNodes = {{0, 0}};
+  mNodes.resize(1);
+  while (!pendingNodes.empty()) {
+    auto [wideIndex, compressedIndex] = pendingNodes.back();
+    pendingNodes.pop_back();
+    const WideBvhNode<8> &wideNode = wideNodes[wideIndex];
+
+    Aabb box;
+    for (u32 iSlot = 0; iSlot < 8; ++iSlot) {
+      if (wideNode.children[iSlot] != invalidIndex) {
+        box.extend(Aabb{{wideNode.bounds[0][iSlot], wideNode.bounds[2][iSlot],
+                         wideNode.bounds[4][iSlot]},
+                        {wideNode.bounds[1][iSlot], wideNode.bounds[3][iSlot],
+                         wideNode.bounds[5][iSlot]}});
+      }
+    }
+    CompressedBvhNode node{};
+    f32 steps[3];
+    for (u32 axis = 0; axis < 3; ++axis) {
+      i32 exponent = gridExponent(box.lower[axis], box.upper[axis]);
+      node.origin[axis] = box.lower[axis];
+      node.exponents[axis] = static_cast<i8>(exponent);
+      steps[axis] = std::ldexp(1.0f, exponent);
+    }
+    node.childBaseIndex = static_cast<u32>(mNodes.size());
+    node.blockBaseIndex = static_cast<u32>(blocks.size());
+
+    u32 childCount = 0;
+    u32 blockCount = 0;
+    for (u32 iSlot = 0; iSlot < 8; ++iSlot) {
+      if (wideNode.children[iSlot] == invalidIndex) {
+        for (u32 axis = 0; axis < 3; ++axis) {
+          node.bounds[2 * axis][iSlot] = 255;
+          node.bounds[2 * axis + 1][iSlot] = 0;
+        }
+        continue;
+      }
+      for (u32 axis = 0; axis < 3; ++axis) {
+        node.bounds[2 * axis][iSlot] =
+            quantizeLower(wideNode.bounds[2 * axis][iSlot], node.origin[axis],
+                          steps[axis]);
+        node.bounds[2 * axis + 1][iSlot] =
+            quantizeUpper(wideNode.bounds[2 * axis + 1][iSlot],
+                          node.origin[axis], steps[axis]);
+      }
+      u32 primitiveCount = wideNode.primitiveCounts[iSlot];
+      if (primitiveCount == 0) {
+        node.childOffsets[iSlot] = static_cast<u8>(childCount);
+        pendingNodes.push_back(
+            {wideNode.children[iSlot], node.childBaseIndex + childCount});
+        ++childCount;
+        continue;
+      }
+      u32 leafBlockCount = appendTriangleBlocks(
+          blocks, triangles, primitiveIndices.data() + wideNode.children[iSlot],
+          primitiveCount);
+      if (blockCount + leafBlockCount > 255) {
+        throw std::runtime_error(
+            "Compressed BVH nodes reference at most 255 triangle blocks.");
+      }
+      node.childOffsets[iSlot] = static_cast<u8>(blockCount);
+      node.blockCounts[iSlot] = static_cast<u8>(leafBlockCount);
+      blockCount += leafBlockCount;
+    }
+    mNodes.resize(mNodes.size() + childCount);
+    mNodes[compressedIndex] = node;
+  }
+}
+
+u64 CompressedBvh::memoryBytes() const noexcept {
+  return mNodes.size() * sizeof(CompressedBvhNode) +
+         mBlocks4.size() * sizeof(TriangleBlock<4>) +
+         mBlocks8.size() * sizeof(TriangleBlock<8>);
+}
+
+} /* namespace neko */
@@ -0,0 +1,145 @@
+#ifndef NEKO_RENDERER_CPU_COMPRESSED_BVH_HPP
+#define NEKO_RENDERER_CPU_COMPRESSED_BVH_HPP
+
+#include "wide_bvh.hpp"
+
+#include <bit>
+
+namespace neko {
+
+/**
+ * @brief 8-wide node whose child bounds are quantized to 8 bits against the
+ * node box (Ylitie et al., "Efficient Incoherent Ray Traversal on GPUs Through
+ * Compressed Wide BVHs"). Child bound {q} along {axis} decodes to
+ * {origin[axis] + q * 2^exponents[axis]}, rounded outwards so the decoded box
+ * encloses the child. The interior children of a node are stored next to each
+ * other, as are the triangle blocks of its leaf children, so each child only
+ * keeps an 8-bit offset from the matching base index.
+ */
+struct CompressedBvhNode {
+  f32 origin[3];
+  i8 exponents[3];
+  u8 padding;
+  u32 childBaseIndex;
+  u32 blockBaseIndex;
+  /* Offset from {childBaseIndex}, or from {blockBaseIndex} for leaves */
+  u8 childOffsets[8];
+  /* Triangle blocks of a leaf child, 0 for node children and unused slots */
+  u8 blockCounts[8];
+  /* Same layout as {WideBvhNode::bounds}. Unused slots have a lower bound of
+  255 and an upper bound of 0 */
+  u8 bounds[6][8];
+
+  /* Grid step along {axis}, built directly from the exponent bits since the
+  exponents stay in the normal range */
+  f32 step(u32 axis) const noexcept {
+    return std::bit_cast<f32>(static_cast<u32>(exponents[axis] + 127) << 23);
+  }
+};
+
+static_assert(sizeof(CompressedBvhNode) == 88,
+              "Compressed nodes take about a third of a BVH8 node");
+
+/**
+ * @brief 8-wide BVH with {CompressedBvhNode} nodes, for scenes where node
+ * fetches dominate traversal. Decoding costs one multiply-add per slab plane on
+ * top of the {WideBvh} test.
+ */
+class CompressedBvh {
+public:
+  typedef bool (*IntersectFunc_T)(const CompressedBvh &compressedBvh, Ray &ray,
+                                  Hit &hit, TraversalStats &stats);
+  typedef bool (*OccludedFunc_T)(const CompressedBvh &compressedBvh,
+                                 const Ray &ray, u32 &occluderIndex,
+                                 TraversalStats &stats);
+
+  struct Kernels {
+    IntersectFunc_T pIntersect = nullptr;
+    OccludedFunc_T pOccluded = nullptr;
+  };
+
+  CompressedBvh() = default;
+  CompressedBvh(const CompressedBvh &) = delete;
+  CompressedBvh(CompressedBvh &&) = default;
+  CompressedBvh &operator=(const CompressedBvh &) = delete;
+  CompressedBvh &operator=(CompressedBvh &&) = default;
+  ~CompressedBvh() = default;
+
+  /**
+   * @brief Collapses {bvh}, built over {triangles}, and quantizes the nodes.
+   * The vectorized kernel needs {SimdIsa::avx2}. Leaves are packed into
+   * blocks of {selectTriangleBlockWidth} triangles, at most 255 per node.
+   */
+  void build(const Bvh &bvh, const std::vector<Triangle> &triangles,
+             SimdIsa isa);
+
+  bool empty() const noexcept { return mKernels.pIntersect == nullptr; }
+
+  /* Instruction set of the selected traversal kernel */
+  SimdIsa isa() const noexcept { return mIsa; }
+
+  const std::vector<CompressedBvhNode> &nodes() const noexcept {
+    return mNodes;
+  }
+
+  u32 blockWidth() const noexcept { return mBlockWidth; }
+
+  /* Leaf triangles, in blocks of {blockWidth()} */
+  template <u32 BlockWidth>
+  const std::vector<TriangleBlock<BlockWidth>> &blocks() const {
+    static_assert(BlockWidth == 4 || BlockWidth == 8, "Unsupported block");
+    if constexpr (BlockWidth == 4) {
+      return mBlocks4;
+    } else {
+      return mBlocks8;
+    }
+  }
+
+  /**
+   * @brief Finds the closest hit along {ray}, reported with the scene index
+   * of the triangle.
+   */
+  bool intersect(Ray &ray, Hit &hit, TraversalStats &stats) const {
+    return mKernels.pIntersect(*this, ray, hit, stats);
+  }
+
+  /**
+   * @brief Whether any triangle is hit before {ray.tMax}, stopping at the
+   * first one found. Its scene index is stored in {occluderIndex}.
+   */
+  bool occluded(const Ray &ray, u32 &occluderIndex,
+                TraversalStats &stats) const {
+    return mKernels.pOccluded(*this, ray, occluderIndex, stats);
+  }
+
+  /* Bytes used by the nodes and the triangle blocks */
+  u64 memoryBytes() const noexcept;
+
+private:
+  u32 mBlockWidth = 4;
+  SimdIsa mIsa = SimdIsa::scalar;
+  std::vector<CompressedBvhNode> mNodes;
+  std::vector<TriangleBlock<4>> mBlocks4;
+  std::vector<TriangleBlock<8>> mBlocks8;
+  Kernels mKernels;
+
+  template <u32 BlockWidth>
+  void quantizeNodes(const Bvh &bvh, const std::vector<Triangle> &triangles,
+                     std::vector<TriangleBlock<BlockWidth>> &blocks);
+};
+
+/**
+ * @brief Lowers {isa} to the instruction set the compressed traversal
+ * kernels actually use, defined in wide_bvh_kernels.cpp.
+ */
+SimdIsa clampCompressedBvhIsa(SimdIsa isa) noexcept;
+
+/**
+ * @brief Traversal kernels using {isa}, which must already be clamped by
+ * {clampCompressedBvhIsa}. Blocks of 8 triangles need the AVX2 kernels.
+ */
+CompressedBvh::Kernels selectCompressedBvhKernels(u32 blockWidth, SimdIsa isa);
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_COMPRESSED_BVH_HPP */
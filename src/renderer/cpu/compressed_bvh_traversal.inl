@@ -0,0 +1,108 @@
+/* Closest- and any-hit traversals of a {CompressedBvh}, included by
+wide_bvh_kernels.cpp once per instruction set, inside a namespace that provides
+the matching {intersectNode(node, wideRay, tMax, tEntries)} for compressed
+nodes */
+
+template <u32 BlockWidth>
+bool intersectCompressed(const CompressedBvh &compressedBvh, Ray &ray,
+                         Hit &hit, TraversalStats &stats) {
+  ++stats.rayCount;
+  const std::vector<CompressedBvhNode> &nodes = compressedBvh.nodes();
+  const std::vector<TriangleBlock<BlockWidth>> &blocks =
+      compressedBvh.blocks<BlockWidth>();
+  WideRay wideRay = makeWideRay(ray);
+  WatertightRay watertightRay = makeWatertightRay(ray);
+
+  /* Same entries as the {WideBvh} traversal, with the base indices of the
+  node already added */
+  struct StackEntry {
+    u32 child;
+    u32 primitiveCount;
+    f32 tEntry;
+  };
+  StackEntry stack[Bvh::maxDepth * 8];
+  u32 stackSize = 0;
+  stack[stackSize++] = {0, 0, 0.0f};
+  bool found = false;
+  while (stackSize > 0) {
+    StackEntry entry = stack[--stackSize];
+    if (entry.tEntry > ray.tMax) {
+      continue;
+    }
+    if (entry.primitiveCount > 0) {
+      found |= intersectBlocks(blocks.data() + entry.child,
+                               entry.primitiveCount, watertightRay, ray, hit);
+      continue;
+    }
+
+    const CompressedBvhNode &node = nodes[entry.child];
+    ++stats.visitedNodeCount;
+    alignas(32) f32 tEntries[8];
+    u32 hitMask = intersectNode(node, wideRay, ray.tMax, tEntries);
+
+    StackEntry hitChildren[8];
+    u32 hitCount = 0;
+    while (hitMask != 0) {
+      auto iSlot = static_cast<u32>(std::countr_zero(hitMask));
+      hitMask &= hitMask - 1;
+      u32 blockCount = node.blockCounts[iSlot];
+      u32 baseIndex =
+          blockCount > 0 ? node.blockBaseIndex : node.childBaseIndex;
+      StackEntry hitChild = {baseIndex + node.childOffsets[iSlot], blockCount,
+                             tEntries[iSlot]};
+      u32 iHit = hitCount++;
+      for (; iHit > 0 && hitChildren[iHit - 1].tEntry < hitChild.tEntry;
+           --iHit) {
+        hitChildren[iHit] = hitChildren[iHit - 1];
+      }
+      hitChildren[iHit] = hitChild;
+    }
+    for (u32 iHit = 0; iHit < hitCount; ++iHit) {
+      stack[stackSize++] = hitChildren[iHit];
+    }
+  }
+  return found;
+}
+
+/* Any-hit traversal, see {occludedWide} */
+template <u32 BlockWidth>
+bool occludedCompressed(const CompressedBvh &compressedBvh, const Ray &ray,
+                        u32 &occluderIndex, TraversalStats &stats) {
+  ++stats.rayCount;
+  const std::vector<CompressedBvhNode> &nodes = compressedBvh.nodes();
+  const std::vector<TriangleBlock<BlockWidth>> &blocks =
+      compressedBvh.blocks<BlockWidth>();
+  WideRay wideRay = makeWideRay(ray);
+  WatertightRay watertightRay = makeWatertightRay(ray);
+
+  struct StackEntry {
+    u32 child;
+    u32 primitiveCount;
+  };
+  StackEntry stack[Bvh::maxDepth * 8];
+  u32 stackSize = 0;
+  stack[stackSize++] = {0, 0};
+  while (stackSize > 0) {
+    StackEntry entry = stack[--stackSize];
+    if (entry.primitiveCount > 0) {
+      if (occludedBlocks(blocks.data() + entry.child, entry.primitiveCount,
+                         watertightRay, ray, occluderIndex)) {
+        return true;
+      }
+      continue;
+    }
+
+    const CompressedBvhNode &node = nodes[entry.child];
+    ++stats.visitedNodeCount;
+    alignas(32) f32 tEntries[8];
+    for (u32 hitMask = intersectNode(node, wideRay, ray.tMax, tEntries);
+         hitMask != 0; hitMask &= hitMask - 1) {
+      auto iSlot = static_cast<u32>(std::countr_zero(hitMask));
+      u32 blockCount = node.blockCounts[iSlot];
+      u32 baseIndex =
+          blockCount > 0 ? node.blockBaseIndex : node.childBaseIndex;
+      stack[stackSize++] = {baseIndex + node.childOffsets[iSlot], blockCount};
+    }
+  }
+  return false;
+}
@@ -0,0 +1,40 @@
+#include "framebuffer.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+namespace neko {
+
+static u8 encodeSrgb(f32 value) {
+  value = std::clamp(value, 0.0f, 1.0f);
+  value = value <= 0.0031308f ? 12.92f * value
+                              : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+  return static_cast<u8>(value * 255.0f + 0.5f);
+}
+
+void Framebuffer::writePpm(const std::string &filePath) const {
+  auto parentPath = std::filesystem::path(filePath).parent_path();
+  if (!parentPath.empty()) {
+    std::filesystem::create_directories(parentPath);
+  }
+  std::ofstream fs(filePath, std::ios::binary);
+  if (!fs.is_open()) {
+    throw std::runtime_error("Failed to open image file " + filePath);
+  }
+  fs << "P6\n" << mWidth << " " << mHeight << "\n255\n";
+
+  std::vector<u8> bytes;
+  bytes.reserve(mPixels.size() * 3);
+  for (const auto &pixel : mPixels) {
+    bytes.push_back(encodeSrgb(pixel.x));
+    bytes.push_back(encodeSrgb(pixel.y));
+    bytes.push_back(encodeSrgb(pixel.z));
+  }
+  fs.write(reinterpret_cast<const char *>(bytes.data()),
+           static_cast<std::streamsize>(bytes.size()));
+  if (!fs) {
+    throw std::runtime_error("Failed to write image file " + filePath);
+  }
+}
+
+} /* namespace neko */
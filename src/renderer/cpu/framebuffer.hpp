@@ -0,0 +1,43 @@
+#ifndef NEKO_RENDERER_CPU_FRAMEBUFFER_HPP
+#define NEKO_RENDERER_CPU_FRAMEBUFFER_HPP
+
+#include "math.hpp"
+
+namespace neko {
+
+/**
+ * @brief Linear radiance image kept in memory.
+ */
+class Framebuffer {
+public:
+  Framebuffer() = default;
+  Framebuffer(u32 width, u32 height)
+      : mWidth{width}, mHeight{height}, mPixels(stdu64(width) * height) {}
+
+  u32 width() const noexcept { return mWidth; }
+
+  u32 height() const noexcept { return mHeight; }
+
+  Vec3 &at(u32 x, u32 y) noexcept { return mPixels[stdu64(y) * mWidth + x]; }
+
+  const Vec3 &at(u32 x, u32 y) const noexcept {
+    return mPixels[stdu64(y) * mWidth + x];
+  }
+
+  void clear() noexcept { std::fill(mPixels.begin(), mPixels.end(), Vec3{}); }
+
+  /**
+   * @brief Writes the image as a binary PPM, clamped and sRGB encoded. Missing
+   * parent directories are created.
+   */
+  void writePpm(const std::string &filePath) const;
+
+private:
+  u32 mWidth = 0;
+  u32 mHeight = 0;
+  std::vector<Vec3> mPixels;
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_FRAMEBUFFER_HPP */
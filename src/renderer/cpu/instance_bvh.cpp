@@ -0,0 +1,123 @@
+#include "instance_bvh.hpp"
+
+#include "parallel.hpp"
+
+#include <atomic>
+
+namespace neko {
+
+u32 InstanceBvh::addMesh(Mesh mesh) {
+  mMeshes.push_back(std::move(mesh));
+  return static_cast<u32>(mMeshes.size() - 1);
+}
+
+u32 InstanceBvh::addInstance(u32 meshIndex, const Transform &objectToWorld,
+                             u32 materialIndex) {
+  if (meshIndex >= mMeshes.size()) {
+    throw std::runtime_error("Instance refers to an unknown mesh.");
+  }
+  mInstances.push_back(
+      {meshIndex, materialIndex, objectToWorld, objectToWorld.inverse()});
+  return static_cast<u32>(mInstances.size() - 1);
+}
+
+void InstanceBvh::setTransform(u32 instanceIndex,
+                               const Transform &objectToWorld) {
+  MeshInstance &instance = mInstances[instanceIndex];
+  instance.objectToWorld = objectToWorld;
+  instance.worldToObject = objectToWorld.inverse();
+}
+
+InstanceUpdateStats InstanceBvh::update(ThreadPool &threadPool,
+                                        const BvhBuildOptions &options) {
+  InstanceUpdateStats stats;
+  ScopedTimer timer{TimeUnit::milliseconds};
+  std::atomic<u32> builtMeshCount = 0;
+  std::atomic<u32> refittedMeshCount = 0;
+  parallelFor(threadPool, 0, mMeshes.size(), 1, [&](u64 iMesh) {
+    Mesh &mesh = mMeshes[iMesh];
+    if (!mesh.built()) {
+      mesh.buildBvh(threadPool, options);
+      builtMeshCount.fetch_add(1, std::memory_order_relaxed);
+    } else if (!mesh.upToDate()) {
+      mesh.refitBvh(threadPool);
+      refittedMeshCount.fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  stats.builtMeshCount = builtMeshCount.load();
+  stats.refittedMeshCount = refittedMeshCount.load();
+  stats.blasTime = timer.now();
+
+  timer.reset();
+  std::vector<Aabb> instanceBounds(mInstances.size());
+  parallelFor(threadPool, 0, mInstances.size(), 0, [&](u64 iInstance) {
+    const MeshInstance &instance = mInstances[iInstance];
+    instanceBounds[iInstance] =
+        instance.objectToWorld.bounds(mMeshes[instance.meshIndex].bounds());
+  });
+  mTlas.build(threadPool, instanceBounds, options);
+  stats.tlasTime = timer.now();
+  return stats;
+}
+
+Aabb InstanceBvh::bounds() const noexcept {
+  return mTlas.empty() ? Aabb{} : mTlas.nodes()[0].bounds();
+}
+
+bool InstanceBvh::intersect(Ray &ray, Hit &hit, TraversalStats &stats) const {
+  /* Bottom-level traversals continue the same ray, only their nodes count */
+  TraversalStats meshStats;
+  bool found = mTlas.traverse(
+      ray,
+      [&](u32 instanceIndex, Ray &worldRay) {
+        const MeshInstance &instance = mInstances[instanceIndex];
+        Ray objectRay = instance.rayToObject(worldRay);
+        if (!mMeshes[instance.meshIndex].intersect(objectRay, hit,
+                                                   meshStats)) {
+          return false;
+        }
+        worldRay.tMax = objectRay.tMax;
+        hit.instanceIndex = instanceIndex;
+        return true;
+      },
+      stats);
+  stats.visitedNodeCount += meshStats.visitedNodeCount;
+  return found;
+}
+
+bool InstanceBvh::occluded(const Ray &ray, u32 &instanceIndex,
+                           u32 &triangleIndex, TraversalStats &stats) const {
+  TraversalStats meshStats;
+  bool found = mTlas.traverseAny(
+      ray,
+      [&](u32 iInstance) {
+        const MeshInstance &instance = mInstances[iInstance];
+        if (!mMeshes[instance.meshIndex].occluded(instance.rayToObject(ray),
+                                                  triangleIndex, meshStats)) {
+          return false;
+        }
+        instanceIndex = iInstance;
+        return true;
+      },
+      stats);
+  stats.visitedNodeCount += meshStats.visitedNodeCount;
+  return found;
+}
+
+u64 InstanceBvh::memoryBytes() const noexcept {
+  u64 bytes = mInstances.size() * sizeof(MeshInstance) + mTlas.memoryBytes();
+  for (const Mesh &mesh : mMeshes) {
+    bytes += mesh.memoryBytes();
+  }
+  return bytes;
+}
+
+u64 InstanceBvh::flattenedMemoryBytes() const noexcept {
+  u64 bytes = 0;
+  for (const MeshInstance &instance : mInstances) {
+    bytes += mMeshes[instance.meshIndex].memoryBytes();
+  }
+  return bytes;
+}
+
+} /* namespace neko */
@@ -0,0 +1,106 @@
+#ifndef NEKO_RENDERER_CPU_INSTANCE_BVH_HPP
+#define NEKO_RENDERER_CPU_INSTANCE_BVH_HPP
+
+#include "mesh.hpp"
+#include "transform.hpp"
+
+namespace neko {
+
+struct MeshInstance {
+  u32 meshIndex;
+  u32 materialIndex;
+  Transform objectToWorld;
+  Transform worldToObject;
+
+  Vec3 normalToWorld(const Vec3 &objectNormal) const noexcept {
+    return worldToObject.transposedVector(objectNormal);
+  }
+
+  /* The direction is not renormalized, so distances along the object space
+  ray match those along {worldRay} */
+  Ray rayToObject(const Ray &worldRay) const noexcept {
+    return {worldToObject.point(worldRay.origin),
+            worldToObject.vector(worldRay.direction), worldRay.tMax};
+  }
+};
+
+struct InstanceUpdateStats {
+  /* Milliseconds spent on the bottom and top levels */
+  f32 blasTime = 0.0f;
+  f32 tlasTime = 0.0f;
+  u32 builtMeshCount = 0;
+  u32 refittedMeshCount = 0;
+};
+
+/**
+ * @brief Two-level acceleration structure: a top-level BVH over instances,
+ * each placing a shared mesh with its own transform. Rays are moved to the
+ * object space of the instances they reach and traverse the bottom-level BVH
+ * of the mesh, so geometry repeated across instances is stored once.
+ */
+class InstanceBvh {
+public:
+  InstanceBvh() = default;
+  InstanceBvh(const InstanceBvh &) = delete;
+  InstanceBvh(InstanceBvh &&) = default;
+  InstanceBvh &operator=(const InstanceBvh &) = delete;
+  InstanceBvh &operator=(InstanceBvh &&) = default;
+  ~InstanceBvh() = default;
+
+  u32 addMesh(Mesh mesh);
+
+  /* Deform meshes through {Mesh::deform}, the next {update} refits them */
+  Mesh &mesh(u32 meshIndex) { return mMeshes[meshIndex]; }
+
+  const Mesh &mesh(u32 meshIndex) const { return mMeshes[meshIndex]; }
+
+  u32 addInstance(u32 meshIndex, const Transform &objectToWorld,
+                  u32 materialIndex);
+
+  void setTransform(u32 instanceIndex, const Transform &objectToWorld);
+
+  const std::vector<MeshInstance> &instances() const noexcept {
+    return mInstances;
+  }
+
+  bool empty() const noexcept { return mInstances.empty(); }
+
+  /**
+   * @brief Prepares the structure for the next frame: builds the BVH of new
+   * meshes and refits the deformed ones as parallel jobs, then rebuilds the
+   * top-level BVH over the current instance bounds.
+   */
+  InstanceUpdateStats update(ThreadPool &threadPool,
+                             const BvhBuildOptions &options);
+
+  Aabb bounds() const noexcept;
+
+  /**
+   * @brief Finds the closest hit along {ray}, reported with the instance and
+   * its mesh triangle.
+   */
+  bool intersect(Ray &ray, Hit &hit, TraversalStats &stats) const;
+
+  /**
+   * @brief Whether any instance is hit before {ray.tMax}, stopping at the
+   * first triangle found. The instance and its mesh triangle are stored in
+   * {instanceIndex} and {triangleIndex}.
+   */
+  bool occluded(const Ray &ray, u32 &instanceIndex, u32 &triangleIndex,
+                TraversalStats &stats) const;
+
+  /* Bytes used by the meshes, instances and the top-level BVH */
+  u64 memoryBytes() const noexcept;
+
+  /* Bytes the same geometry would take with a copy of its mesh per instance */
+  u64 flattenedMemoryBytes() const noexcept;
+
+private:
+  std::vector<Mesh> mMeshes;
+  std::vector<MeshInstance> mInstances;
+  Bvh mTlas;
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_INSTANCE_BVH_HPP */
@@ -0,0 +1,235 @@
+#include "light_sampler.hpp"
+
+#include "parallel.hpp"
+#include "ray_sort.hpp"
+
+#include <bit>
+
+namespace neko {
+
+void AliasTable::build(const std::vector<f32> &weights) {
+  f64 totalWeight = 0.0;
+  for (f32 weight : weights) {
+    totalWeight += static_cast<f64>(weight);
+  }
+  if (!(totalWeight > 0.0)) {
+    throw std::runtime_error("Alias table weights must have a positive sum.");
+  }
+
+  auto binCount = static_cast<u32>(weights.size());
+  mBins.resize(binCount);
+  mPmfs.resize(binCount);
+  std::vector<f64> scaledWeights(binCount);
+  std::vector<u32> smallBins;
+  std::vector<u32> largeBins;
+  for (u32 iBin = 0; iBin < binCount; ++iBin) {
+    f64 probability = static_cast<f64>(weights[iBin]) / totalWeight;
+    mPmfs[iBin] = static_cast<f32>(probability);
+    scaledWeights[iBin] = probability * binCount;
+    (scaledWeights[iBin] < 1.0 ? smallBins : largeBins).push_back(iBin);
+  }
+  /* Each small bin is topped up by a large one, which shrinks accordingly */
+  while (!smallBins.empty() && !largeBins.empty()) {
+    u32 iSmall = smallBins.back();
+    smallBins.pop_back();
+    u32 iLarge = largeBins.back();
+    mBins[iSmall] = {static_cast<f32>(scaledWeights[iSmall]), iLarge};
+    scaledWeights[iLarge] -= 1.0 - scaledWeights[iSmall];
+    if (scaledWeights[iLarge] < 1.0) {
+      largeBins.pop_back();
+      smallBins.push_back(iLarge);
+    }
+  }
+  /* The bins left are full, up to rounding errors */
+  for (u32 iBin : smallBins) {
+    mBins[iBin] = {1.0f, iBin};
+  }
+  for (u32 iBin : largeBins) {
+    mBins[iBin] = {1.0f, iBin};
+  }
+}
+
+void LightBvh::build(ThreadPool &threadPool,
+                     const std::vector<Triangle> &triangles,
+                     const std::vector<u32> &emitters,
+                     const std::vector<f32> &powers) {
+  mNodes.clear();
+  mEmitterOrder.clear();
+  mLeafCount = 0;
+  if (emitters.empty()) {
+    return;
+  }
+  auto emitterCount = static_cast<u32>(emitters.size());
+
+  Aabb centroidBounds = parallelReduce(
+      threadPool, 0, emitterCount, 0, Aabb{},
+      [&](u64 chunkBegin, u64 chunkEnd) {
+        Aabb bounds;
+        for (u64 iEmitter = chunkBegin; iEmitter < chunkEnd; ++iEmitter) {
+          bounds.extend(triangles[emitters[iEmitter]].centroid());
+        }
+        return bounds;
+      },
+      [](Aabb lhs, const Aabb &rhs) {
+        lhs.extend(rhs);
+        return lhs;
+      });
+
+  /* Morton order keeps the emitters of a subtree close to each other */
+  constexpr u32 cellBits = 10;
+  constexpr auto maxCell = static_cast<f32>((1u << cellBits) - 1);
+  Vec3 extent = centroidBounds.extent();
+  Vec3 scale = {extent.x > 0.0f ? maxCell / extent.x : 0.0f,
+                extent.y > 0.0f ? maxCell / extent.y : 0.0f,
+                extent.z > 0.0f ? maxCell / extent.z : 0.0f};
+  std::vector<u32> keys(emitterCount);
+  mEmitterOrder.resize(emitterCount);
+  parallelFor(threadPool, 0, emitterCount, 0, [&](u64 iEmitter) {
+    Vec3 cell = (triangles[emitters[iEmitter]].centroid() -
+                 centroidBounds.lower) *
+                scale;
+    keys[iEmitter] = (expandBits3(static_cast<u32>(cell.x)) << 2) |
+                     (expandBits3(static_cast<u32>(cell.y)) << 1) |
+                     expandBits3(static_cast<u32>(cell.z));
+    mEmitterOrder[iEmitter] = static_cast<u32>(iEmitter);
+  });
+  std::vector<u32> scratchKeys;
+  std::vector<u32> scratchOrder;
+  radixSortPairs(threadPool, keys, mEmitterOrder, scratchKeys, scratchOrder,
+                 3 * cellBits);
+
+  mLeafCount = std::bit_ceil(emitterCount);
+  u64 nodeCount = 2 * static_cast<u64>(mLeafCount) - 1;
+  u64 firstLeaf = mLeafCount - 1;
+  std::vector<Aabb> nodeBounds(nodeCount);
+  mNodes.assign(nodeCount, {});
+  parallelFor(threadPool, 0, emitterCount, 0, [&](u64 iLeaf) {
+    u32 iEmitter = mEmitterOrder[iLeaf];
+    nodeBounds[firstLeaf + iLeaf] = triangles[emitters[iEmitter]].bounds();
+    mNodes[firstLeaf + iLeaf].power = powers[iEmitter];
+  });
+  /* Level {k} holds the nodes [2^k - 1, 2^(k + 1) - 1) */
+  for (u64 levelSize = mLeafCount / 2; levelSize > 0; levelSize /= 2) {
+    parallelFor(threadPool, levelSize - 1, 2 * levelSize - 1, 0,
+                [&](u64 iNode) {
+                  nodeBounds[iNode] = nodeBounds[2 * iNode + 1];
+                  nodeBounds[iNode].extend(nodeBounds[2 * iNode + 2]);
+                  mNodes[iNode].power = mNodes[2 * iNode + 1].power +
+                                        mNodes[2 * iNode + 2].power;
+                });
+  }
+  parallelFor(threadPool, 0, nodeCount, 0, [&](u64 iNode) {
+    if (mNodes[iNode].power > 0.0f) {
+      mNodes[iNode].center = nodeBounds[iNode].center();
+      mNodes[iNode].radius = 0.5f * length(nodeBounds[iNode].extent());
+    }
+  });
+}
+
+/**
+ * @brief Estimated contribution of the emitters of {node} to a point: their
+ * power over the squared distance, times the cosine at the point towards the
+ * nearest side of the bounding sphere. As in pbrt-v4, the squared distance is
+ * clamped to the radius rather than the squared radius, which keeps large
+ * nodes around the point from dominating while still favouring the near ones.
+ * Zero only if the sphere lies behind the tangent plane of the point, where
+ * nothing can light it.
+ */
+static f32 importance(const LightBvhNode &node, const Vec3 &position,
+                      const Vec3 &normal) noexcept {
+  if (node.power <= 0.0f) {
+    return 0.0f;
+  }
+  Vec3 toCenter = node.center - position;
+  f32 nearestHeight = dot(normal, toCenter) + node.radius;
+  if (nearestHeight <= 0.0f) {
+    return 0.0f;
+  }
+  f32 distanceSquared = dot(toCenter, toCenter);
+  f32 cosine = std::min(nearestHeight / std::sqrt(distanceSquared), 1.0f);
+  return node.power * cosine / std::max(distanceSquared, node.radius);
+}
+
+bool LightBvh::sample(const Vec3 &position, const Vec3 &normal, f32 u,
+                      u32 &emitter, f32 &pmf) const noexcept {
+  if (mNodes.empty()) {
+    return false;
+  }
+  constexpr f32 oneMinusEpsilon = 0x1.fffffep-1f;
+  u32 iNode = 0;
+  pmf = 1.0f;
+  while (iNode < mLeafCount - 1) {
+    f32 leftImportance = importance(mNodes[2 * iNode + 1], position, normal);
+    f32 rightImportance = importance(mNodes[2 * iNode + 2], position, normal);
+    f32 totalImportance = leftImportance + rightImportance;
+    if (totalImportance <= 0.0f) {
+      return false;
+    }
+    /* Rescaling {u} without normalizing first keeps a single division on
+    the dependency chain between levels */
+    f32 scaledU = u * totalImportance;
+    if (scaledU < leftImportance || rightImportance <= 0.0f) {
+      u = std::min(scaledU / leftImportance, oneMinusEpsilon);
+      pmf *= leftImportance / totalImportance;
+      iNode = 2 * iNode + 1;
+    } else {
+      u = std::min((scaledU - leftImportance) / rightImportance,
+                   oneMinusEpsilon);
+      pmf *= rightImportance / totalImportance;
+      iNode = 2 * iNode + 2;
+    }
+  }
+  emitter = mEmitterOrder[iNode - (mLeafCount - 1)];
+  return true;
+}
+
+LightBuildStats LightSampler::build(ThreadPool &threadPool,
+                                    LightSamplingMode mode,
+                                    const std::vector<Triangle> &triangles,
+                                    const std::vector<u32> &emitters,
+                                    const std::vector<Vec3> &emissions) {
+  ScopedTimer timer{TimeUnit::milliseconds};
+  mMode = mode;
+  mEmitterCount = static_cast<u32>(emitters.size());
+  mAliasTable = {};
+  mLightBvh = {};
+
+  std::vector<f32> powers(emitters.size());
+  parallelFor(threadPool, 0, emitters.size(), 0, [&](u64 iEmitter) {
+    powers[iEmitter] = luminance(emissions[iEmitter]) *
+                       triangles[emitters[iEmitter]].area();
+  });
+  if (!emitters.empty()) {
+    switch (mode) {
+    case LightSamplingMode::uniform:
+      break;
+    case LightSamplingMode::power:
+      mAliasTable.build(powers);
+      break;
+    case LightSamplingMode::bvh:
+      mLightBvh.build(threadPool, triangles, emitters, powers);
+      break;
+    }
+  }
+
+  LightBuildStats stats;
+  stats.emitterCount = mEmitterCount;
+  stats.bvhNodeCount = mLightBvh.nodeCount();
+  stats.memoryBytes = mAliasTable.memoryBytes() + mLightBvh.memoryBytes();
+  stats.buildTime = timer.now();
+  return stats;
+}
+
+const char *lightSamplingModeName(LightSamplingMode mode) {
+  switch (mode) {
+  case LightSamplingMode::uniform:
+    return "uniform";
+  case LightSamplingMode::power:
+    return "power";
+  case LightSamplingMode::bvh:
+    return "bvh";
+  }
+  return "unknown";
+}
+
+} /* namespace neko */
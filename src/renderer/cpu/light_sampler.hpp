@@ -0,0 +1,170 @@
+#ifndef NEKO_RENDERER_CPU_LIGHT_SAMPLER_HPP
+#define NEKO_RENDERER_CPU_LIGHT_SAMPLER_HPP
+
+#include "triangle.hpp"
+#include "utils.hpp"
+
+namespace neko {
+
+class ThreadPool;
+
+/**
+ * @brief Walker's alias method: draws an index with probability proportional
+ * to its weight from a single uniform number, in constant time.
+ */
+class AliasTable {
+public:
+  /**
+   * @brief Builds the table with Vose's algorithm. Weights must be
+   * non-negative with a positive sum.
+   */
+  void build(const std::vector<f32> &weights);
+
+  bool empty() const noexcept { return mBins.empty(); }
+
+  /* Draws an index for {u} in [0, 1) and stores its probability in {pmf} */
+  u32 sample(f32 u, f32 &pmf) const noexcept {
+    auto binCount = static_cast<f32>(mBins.size());
+    f32 scaled = u * binCount;
+    u32 iBin = std::min(static_cast<u32>(scaled),
+                        static_cast<u32>(mBins.size() - 1));
+    const Bin &bin = mBins[iBin];
+    u32 index = scaled - static_cast<f32>(iBin) < bin.threshold ? iBin
+                                                                : bin.alias;
+    pmf = mPmfs[index];
+    return index;
+  }
+
+  u64 memoryBytes() const noexcept {
+    return mBins.size() * sizeof(Bin) + mPmfs.size() * sizeof(f32);
+  }
+
+private:
+  /* Bin {i} yields {i} below {threshold} and {alias} above */
+  struct Bin {
+    f32 threshold;
+    u32 alias;
+  };
+
+  std::vector<Bin> mBins;
+  std::vector<f32> mPmfs;
+};
+
+/* Bounding sphere of the emitters under a node of a {LightBvh}, with their
+total power */
+struct LightBvhNode {
+  Vec3 center;
+  f32 radius = 0.0f;
+  f32 power = 0.0f;
+};
+
+/**
+ * @brief Binary tree over the emitters used to pick one in proportion to its
+ * estimated contribution to a shading point. The emitters are ordered along a
+ * Morton curve and the tree is complete over the next power of two, stored
+ * implicitly: the children of node {i} are {2i + 1} and {2i + 2}, leaves hold
+ * one emitter each and padding leaves have no power. Every level is built in
+ * parallel from the one below.
+ */
+class LightBvh {
+public:
+  /**
+   * @brief Builds the tree over {emitters}, whose bounds and power are given
+   * by {triangles} and {powers}.
+   */
+  void build(ThreadPool &threadPool, const std::vector<Triangle> &triangles,
+             const std::vector<u32> &emitters, const std::vector<f32> &powers);
+
+  bool empty() const noexcept { return mNodes.empty(); }
+
+  u32 nodeCount() const noexcept { return static_cast<u32>(mNodes.size()); }
+
+  /**
+   * @brief Descends from the root, choosing each child by its importance to
+   * the point {position} with normal {normal} and rescaling {u} to reuse it
+   * at the next level. Returns false if no emitter can light the point,
+   * otherwise stores the index of the emitter in the list given to {build}
+   * and the probability of choosing it.
+   */
+  bool sample(const Vec3 &position, const Vec3 &normal, f32 u, u32 &emitter,
+              f32 &pmf) const noexcept;
+
+  u64 memoryBytes() const noexcept {
+    return mNodes.size() * sizeof(LightBvhNode) +
+           mEmitterOrder.size() * sizeof(u32);
+  }
+
+private:
+  std::vector<LightBvhNode> mNodes;
+  /* Emitter of each leaf, in Morton order */
+  std::vector<u32> mEmitterOrder;
+  u32 mLeafCount = 0;
+};
+
+struct LightBuildStats {
+  u32 emitterCount = 0;
+  u32 bvhNodeCount = 0;
+  u64 memoryBytes = 0;
+  /* Milliseconds */
+  f32 buildTime = 0.0f;
+};
+
+/**
+ * @brief Picks the emitter sampled by next event estimation, following a
+ * {LightSamplingMode}. Emitters are weighted by their power, the luminance of
+ * their emission times their area.
+ */
+class LightSampler {
+public:
+  /**
+   * @brief Builds the structures of {mode} over the emitting {triangles}
+   * listed by {emitters}, whose emission is given by {emissions}.
+   */
+  LightBuildStats build(ThreadPool &threadPool, LightSamplingMode mode,
+                        const std::vector<Triangle> &triangles,
+                        const std::vector<u32> &emitters,
+                        const std::vector<Vec3> &emissions);
+
+  LightSamplingMode mode() const noexcept { return mMode; }
+
+  /**
+   * @brief Chooses an emitter for the point {position} with normal
+   * {normal} from {u} in [0, 1). Returns false if there is none worth
+   * sampling, otherwise stores its index in the emitter list and the
+   * probability of choosing it.
+   */
+  bool sample(const Vec3 &position, const Vec3 &normal, f32 u, u32 &emitter,
+              f32 &pmf) const noexcept {
+    switch (mMode) {
+    case LightSamplingMode::power:
+      if (mAliasTable.empty()) {
+        return false;
+      }
+      emitter = mAliasTable.sample(u, pmf);
+      return true;
+    case LightSamplingMode::bvh:
+      return mLightBvh.sample(position, normal, u, emitter, pmf);
+    case LightSamplingMode::uniform:
+      break;
+    }
+    if (mEmitterCount == 0) {
+      return false;
+    }
+    auto emitterCount = static_cast<f32>(mEmitterCount);
+    emitter = std::min(static_cast<u32>(u * emitterCount), mEmitterCount - 1);
+    pmf = 1.0f / emitterCount;
+    return true;
+  }
+
+private:
+  LightSamplingMode mMode = LightSamplingMode::uniform;
+  u32 mEmitterCount = 0;
+  AliasTable mAliasTable;
+  LightBvh mLightBvh;
+};
+
+const char *lightSamplingModeName(LightSamplingMode mode);
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_LIGHT_SAMPLER_HPP */
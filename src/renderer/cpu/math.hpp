@@ -0,0 +1,169 @@
+#ifndef NEKO_RENDERER_CPU_MATH_HPP
+#define NEKO_RENDERER_CPU_MATH_HPP
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace neko {
+
+inline constexpr f32 pi = 3.14159265358979323846f;
+inline constexpr f32 infinity = std::numeric_limits<f32>::infinity();
+
+struct Vec3 {
+  f32 x = 0.0f;
+  f32 y = 0.0f;
+  f32 z = 0.0f;
+
+  f32 operator[](u32 axis) const noexcept {
+    return axis == 0 ? x : (axis == 1 ? y : z);
+  }
+
+  Vec3 &operator+=(const Vec3 &rhs) noexcept {
+    x += rhs.x;
+    y += rhs.y;
+    z += rhs.z;
+    return *this;
+  }
+
+  Vec3 &operator*=(const Vec3 &rhs) noexcept {
+    x *= rhs.x;
+    y *= rhs.y;
+    z *= rhs.z;
+    return *this;
+  }
+
+  Vec3 &operator*=(f32 scale) noexcept {
+    x *= scale;
+    y *= scale;
+    z *= scale;
+    return *this;
+  }
+};
+
+inline Vec3 operator+(const Vec3 &lhs, const Vec3 &rhs) noexcept {
+  return {lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z};
+}
+
+inline Vec3 operator-(const Vec3 &lhs, const Vec3 &rhs) noexcept {
+  return {lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z};
+}
+
+inline Vec3 operator-(const Vec3 &vec) noexcept {
+  return {-vec.x, -vec.y, -vec.z};
+}
+
+inline Vec3 operator*(const Vec3 &lhs, const Vec3 &rhs) noexcept {
+  return {lhs.x * rhs.x, lhs.y * rhs.y, lhs.z * rhs.z};
+}
+
+inline Vec3 operator*(const Vec3 &vec, f32 scale) noexcept {
+  return {vec.x * scale, vec.y * scale, vec.z * scale};
+}
+
+inline Vec3 operator*(f32 scale, const Vec3 &vec) noexcept {
+  return vec * scale;
+}
+
+inline Vec3 operator/(const Vec3 &vec, f32 divisor) noexcept {
+  return vec * (1.0f / divisor);
+}
+
+inline f32 dot(const Vec3 &lhs, const Vec3 &rhs) noexcept {
+  return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z;
+}
+
+inline Vec3 cross(const Vec3 &lhs, const Vec3 &rhs) noexcept {
+  return {lhs.y * rhs.z - lhs.z * rhs.y, lhs.z * rhs.x - lhs.x * rhs.z,
+          lhs.x * rhs.y - lhs.y * rhs.x};
+}
+
+inline f32 length(const Vec3 &vec) noexcept { return std::sqrt(dot(vec, vec)); }
+
+inline Vec3 normalize(const Vec3 &vec) noexcept { return vec / length(vec); }
+
+inline Vec3 min(const Vec3 &lhs, const Vec3 &rhs) noexcept {
+  return {std::min(lhs.x, rhs.x), std::min(lhs.y, rhs.y),
+          std::min(lhs.z, rhs.z)};
+}
+
+inline Vec3 max(const Vec3 &lhs, const Vec3 &rhs) noexcept {
+  return {std::max(lhs.x, rhs.x), std::max(lhs.y, rhs.y),
+          std::max(lhs.z, rhs.z)};
+}
+
+inline f32 maxComponent(const Vec3 &vec) noexcept {
+  return std::max(vec.x, std::max(vec.y, vec.z));
+}
+
+inline f32 luminance(const Vec3 &color) noexcept {
+  return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+/**
+ * @brief Builds an orthonormal basis around the unit vector {normal}
+ * (Duff et al., "Building an Orthonormal Basis, Revisited").
+ */
+inline void buildBasis(const Vec3 &normal, Vec3 &tangent, Vec3 &bitangent) {
+  f32 sign = std::copysign(1.0f, normal.z);
+  f32 a = -1.0f / (sign + normal.z);
+  f32 b = normal.x * normal.y * a;
+  tangent = {1.0f + sign * normal.x * normal.x * a, sign * b,
+             -sign * normal.x};
+  bitangent = {b, sign + normal.y * normal.y * a, -normal.y};
+}
+
+struct Ray {
+  Vec3 origin;
+  Vec3 direction;
+  f32 tMax = infinity;
+
+  Vec3 at(f32 t) const noexcept { return origin + direction * t; }
+};
+
+/**
+ * @brief Axis-aligned bounding box. A default constructed box is empty and
+ * grows with {extend}.
+ */
+struct Aabb {
+  Vec3 lower = {infinity, infinity, infinity};
+  Vec3 upper = {-infinity, -infinity, -infinity};
+
+  void extend(const Vec3 &point) noexcept {
+    lower = min(lower, point);
+    upper = max(upper, point);
+  }
+
+  void extend(const Aabb &box) noexcept {
+    lower = min(lower, box.lower);
+    upper = max(upper, box.upper);
+  }
+
+  bool empty() const noexcept { return lower.x > upper.x; }
+
+  Vec3 center() const noexcept { return (lower + upper) * 0.5f; }
+
+  Vec3 extent() const noexcept { return upper - lower; }
+
+  f32 surfaceArea() const noexcept {
+    if (empty()) {
+      return 0.0f;
+    }
+    Vec3 size = extent();
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+  }
+
+  u32 largestAxis() const noexcept {
+    Vec3 size = extent();
+    if (size.x >= size.y && size.x >= size.z) {
+      return 0;
+    }
+    return size.y >= size.z ? 1 : 2;
+  }
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_MATH_HPP */
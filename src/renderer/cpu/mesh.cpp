@@ -0,0 +1,69 @@
+#include "mesh.hpp"
+
+#include "parallel.hpp"
+
+namespace neko {
+
+void Mesh::deform(std::vector<Triangle> triangles) {
+  if (triangles.size() != mTriangles.size()) {
+    throw std::runtime_error("A deformed mesh must keep its triangle count.");
+  }
+  mTriangles = std::move(triangles);
+  mUpToDate = false;
+}
+
+BvhBuildStats Mesh::buildBvh(ThreadPool &threadPool,
+                             const BvhBuildOptions &options) {
+  BvhBuildStats stats =
+      mBvh.build(threadPool, computeTriangleBounds(threadPool), options);
+  mUpToDate = true;
+  return stats;
+}
+
+void Mesh::refitBvh(ThreadPool &threadPool) {
+  mBvh.refit(threadPool, computeTriangleBounds(threadPool));
+  mUpToDate = true;
+}
+
+u64 Mesh::memoryBytes() const noexcept {
+  return mTriangles.size() * sizeof(Triangle) + mBvh.memoryBytes();
+}
+
+std::vector<Aabb> Mesh::computeTriangleBounds(ThreadPool &threadPool) const {
+  std::vector<Aabb> triangleBounds(mTriangles.size());
+  parallelFor(threadPool, 0, mTriangles.size(), 0, [&](u64 iTriangle) {
+    triangleBounds[iTriangle] = mTriangles[iTriangle].bounds();
+  });
+  return triangleBounds;
+}
+
+Mesh Mesh::sphere(u32 segmentCount) {
+  u32 ringCount = std::max(segmentCount, 2u);
+  u32 sliceCount = 2 * ringCount;
+  auto point = [&](u32 iRing, u32 iSlice) {
+    f32 theta = pi * static_cast<f32>(iRing) / static_cast<f32>(ringCount);
+    f32 phi =
+        2.0f * pi * static_cast<f32>(iSlice) / static_cast<f32>(sliceCount);
+    return Vec3{std::sin(theta) * std::cos(phi), std::cos(theta),
+                std::sin(theta) * std::sin(phi)};
+  };
+  std::vector<Triangle> triangles;
+  for (u32 iRing = 0; iRing < ringCount; ++iRing) {
+    for (u32 iSlice = 0; iSlice < sliceCount; ++iSlice) {
+      Vec3 p00 = point(iRing, iSlice);
+      Vec3 p01 = point(iRing, iSlice + 1);
+      Vec3 p10 = point(iRing + 1, iSlice);
+      Vec3 p11 = point(iRing + 1, iSlice + 1);
+      /* The first and last rings degenerate to a fan around the poles */
+      if (iRing != 0) {
+        triangles.push_back({p00, p01, p11});
+      }
+      if (iRing + 1 != ringCount) {
+        triangles.push_back({p00, p11, p10});
+      }
+    }
+  }
+  return Mesh{std::move(triangles)};
+}
+
+} /* namespace neko */
@@ -0,0 +1,96 @@
+#ifndef NEKO_RENDERER_CPU_MESH_HPP
+#define NEKO_RENDERER_CPU_MESH_HPP
+
+#include "bvh.hpp"
+#include "triangle.hpp"
+
+namespace neko {
+
+/**
+ * @brief Triangles in object space with their own bottom-level BVH, shared by
+ * every instance of the mesh.
+ */
+class Mesh {
+public:
+  Mesh() = default;
+  explicit Mesh(std::vector<Triangle> triangles)
+      : mTriangles{std::move(triangles)} {}
+  Mesh(const Mesh &) = delete;
+  Mesh(Mesh &&) = default;
+  Mesh &operator=(const Mesh &) = delete;
+  Mesh &operator=(Mesh &&) = default;
+  ~Mesh() = default;
+
+  const std::vector<Triangle> &triangles() const noexcept {
+    return mTriangles;
+  }
+
+  /**
+   * @brief Moves the vertices of a deformed mesh. The triangle count cannot
+   * change, so that the BVH can be refitted instead of rebuilt.
+   */
+  void deform(std::vector<Triangle> triangles);
+
+  /* Whether the BVH was built or refitted since the last change */
+  bool upToDate() const noexcept { return mUpToDate; }
+
+  BvhBuildStats buildBvh(ThreadPool &threadPool,
+                         const BvhBuildOptions &options);
+
+  void refitBvh(ThreadPool &threadPool);
+
+  bool built() const noexcept { return !mBvh.empty(); }
+
+  /* Object space bounds, valid once the BVH is built */
+  Aabb bounds() const noexcept {
+    return mBvh.empty() ? Aabb{} : mBvh.nodes()[0].bounds();
+  }
+
+  /* Bytes used by the triangles and the BVH */
+  u64 memoryBytes() const noexcept;
+
+  bool intersect(Ray &ray, Hit &hit, TraversalStats &stats) const {
+    return mBvh.traverse(
+        ray,
+        [this, &hit](u32 triangleIndex, Ray &primitiveRay) {
+          return intersectTriangle(mTriangles[triangleIndex], triangleIndex,
+                                   primitiveRay, hit);
+        },
+        stats);
+  }
+
+  /**
+   * @brief Whether any triangle is hit before {ray.tMax}, stopping at the
+   * first one found. Its index is stored in {occluderIndex}.
+   */
+  bool occluded(const Ray &ray, u32 &occluderIndex,
+                TraversalStats &stats) const {
+    return mBvh.traverseAny(
+        ray,
+        [&](u32 triangleIndex) {
+          if (!occludes(mTriangles[triangleIndex], ray)) {
+            return false;
+          }
+          occluderIndex = triangleIndex;
+          return true;
+        },
+        stats);
+  }
+
+  /**
+   * @brief UV sphere of radius 1 around the origin, with {segmentCount} rings
+   * and twice as many slices.
+   */
+  static Mesh sphere(u32 segmentCount);
+
+private:
+  std::vector<Triangle> mTriangles;
+  Bvh mBvh;
+  bool mUpToDate = false;
+
+  std::vector<Aabb> computeTriangleBounds(ThreadPool &threadPool) const;
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_MESH_HPP */
@@ -0,0 +1,383 @@
+#include "path_tracer.hpp"
+
+#include "parallel.hpp"
+#include "sampling.hpp"
+#include "shading.hpp"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+namespace neko {
+
+/* Samples of the first batch of a tile under adaptive sampling, enough for a
+first estimate of its noise */
+static constexpr u32 adaptiveFirstBatchSize = 8;
+
+/* Luminance below which the noise is measured against this floor, so that
+black pixels do not need to be noiseless */
+static constexpr f32 minNoiseLuminance = 1e-3f;
+
+PathTracer::PathTracer(const Settings &settings, ThreadPool &threadPool)
+    : mpThreadPool{&threadPool},
+      mSamplesPerPixel{
+          std::max(settings.graphics.pathTracer.samplesPerPixel, 1u)},
+      mMaxBounces{settings.graphics.pathTracer.maxBounces},
+      mTileSize{std::max(settings.graphics.pathTracer.tileSize, 1u)},
+      mPrimaryRayMode{settings.graphics.pathTracer.primaryRays},
+      mSampler{settings.graphics.pathTracer.sampler,
+               settings.graphics.pathTracer.simdIsa},
+      mAdaptiveSampling{settings.graphics.pathTracer.adaptiveSampling},
+      mNoiseThreshold{settings.graphics.pathTracer.noiseThreshold},
+      mTimeBudget{settings.graphics.pathTracer.timeBudget} {}
+
+RenderStats PathTracer::render(const Scene &scene, Framebuffer &framebuffer) {
+  NEKO_PROFILE_FUNCTION();
+  ScopedTimer timer{TimeUnit::milliseconds};
+  u32 tileCountX = (framebuffer.width() + mTileSize - 1) / mTileSize;
+  u32 tileCountY = (framebuffer.height() + mTileSize - 1) / mTileSize;
+  u32 tileCount = tileCountX * tileCountY;
+  u64 pixelCount = stdu64(framebuffer.width()) * framebuffer.height();
+  PixelSums sums;
+  sums.radiances.assign(pixelCount, Vec3{});
+  sums.squaredLuminances.assign(pixelCount, 0.0f);
+  std::atomic<u64> rayCount = 0;
+  std::atomic<u64> visitedNodeCount = 0;
+  std::atomic<u64> shadowRayCount = 0;
+  std::atomic<u64> cachedOcclusionCount = 0;
+  std::atomic<u64> pixelSampleCount = 0;
+  auto renderTileSamples = [&](u32 iTile, u32 firstSample, u32 endSample) {
+    NEKO_PROFILE_ZONE("Tile");
+    u32 tileX = (iTile % tileCountX) * mTileSize;
+    u32 tileY = (iTile / tileCountX) * mTileSize;
+    TraversalStats tileStats;
+    OcclusionCache occlusionCache;
+    renderTile(scene, framebuffer, sums, tileX, tileY, firstSample, endSample,
+               occlusionCache, tileStats);
+    u32 tilePixelCount =
+        (std::min(tileX + mTileSize, framebuffer.width()) - tileX) *
+        (std::min(tileY + mTileSize, framebuffer.height()) - tileY);
+    rayCount.fetch_add(tileStats.rayCount, std::memory_order_relaxed);
+    visitedNodeCount.fetch_add(tileStats.visitedNodeCount,
+                               std::memory_order_relaxed);
+    shadowRayCount.fetch_add(occlusionCache.queryCount,
+                             std::memory_order_relaxed);
+    cachedOcclusionCount.fetch_add(occlusionCache.hitCount,
+                                   std::memory_order_relaxed);
+    pixelSampleCount.fetch_add(stdu64(tilePixelCount) *
+                                   (endSample - firstSample),
+                               std::memory_order_relaxed);
+  };
+
+  u32 convergedTileCount = 0;
+  if (!mAdaptiveSampling) {
+    parallelFor(*mpThreadPool, 0, tileCount, 1, [&](u64 iTile) {
+      renderTileSamples(static_cast<u32>(iTile), 0, mSamplesPerPixel);
+    });
+  } else {
+    /* Tiles waiting for their next batch, noisiest first, unrendered tiles
+    first of all in image order */
+    struct QueuedTile {
+      f32 noise;
+      u32 iTile;
+
+      bool operator<(const QueuedTile &rhs) const noexcept {
+        return noise < rhs.noise || (noise == rhs.noise && iTile > rhs.iTile);
+      }
+    };
+    std::vector<QueuedTile> queue(tileCount);
+    for (u32 iTile = 0; iTile < tileCount; ++iTile) {
+      queue[iTile] = {infinity, iTile};
+    }
+    std::make_heap(queue.begin(), queue.end());
+    std::mutex queueMutex;
+    /* Only touched by the job holding the tile */
+    std::vector<u32> tileSampleCounts(tileCount, 0);
+    std::atomic<u32> convergedCount = 0;
+    /* One job per queued tile, each renders the next batch of the noisiest
+    tile at the time it runs rather than of a tile picked at submission */
+    JobCounter counter;
+    std::function<void()> renderNoisiestTile;
+    renderNoisiestTile = [&] {
+      u32 iTile;
+      {
+        std::lock_guard lock{queueMutex};
+        /* Past the time budget, tiles keep the samples they have, but every
+        tile gets its first batch */
+        if (queue.empty() ||
+            (queue.front().noise != infinity && mTimeBudget > 0.0f &&
+             timer.now() >= mTimeBudget)) {
+          return;
+        }
+        std::pop_heap(queue.begin(), queue.end());
+        iTile = queue.back().iTile;
+        queue.pop_back();
+      }
+
+      u32 firstSample = tileSampleCounts[iTile];
+      u32 endSample =
+          std::min(firstSample > 0 ? 2 * firstSample : adaptiveFirstBatchSize,
+                   mSamplesPerPixel);
+      renderTileSamples(iTile, firstSample, endSample);
+      tileSampleCounts[iTile] = endSample;
+      f32 noise =
+          tileNoise(framebuffer, sums, (iTile % tileCountX) * mTileSize,
+                    (iTile / tileCountX) * mTileSize, endSample);
+      if (noise <= mNoiseThreshold) {
+        convergedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      if (endSample < mSamplesPerPixel) {
+        {
+          std::lock_guard lock{queueMutex};
+          queue.push_back({noise, iTile});
+          std::push_heap(queue.begin(), queue.end());
+        }
+        mpThreadPool->submit([&] { renderNoisiestTile(); }, counter);
+      }
+    };
+    mpThreadPool->submitBatch(
+        tileCount, [&](u64) { renderNoisiestTile(); }, counter);
+    mpThreadPool->wait(counter);
+    convergedTileCount = convergedCount.load();
+  }
+  RenderStats stats;
+  stats.renderTime = timer.now();
+  stats.traversal = {rayCount.load(), visitedNodeCount.load()};
+  stats.shadowRayCount = shadowRayCount.load();
+  stats.cachedOcclusionCount = cachedOcclusionCount.load();
+  stats.pixelSampleCount = pixelSampleCount.load();
+  stats.tileCount = tileCount;
+  stats.convergedTileCount = convergedTileCount;
+  return stats;
+}
+
+void PathTracer::renderTile(const Scene &scene, Framebuffer &framebuffer,
+                            PixelSums &sums, u32 tileX, u32 tileY,
+                            u32 firstSample, u32 endSample,
+                            OcclusionCache &occlusionCache,
+                            TraversalStats &stats) const {
+  u32 endX = std::min(tileX + mTileSize, framebuffer.width());
+  u32 endY = std::min(tileY + mTileSize, framebuffer.height());
+  f32 invWidth = 1.0f / static_cast<f32>(framebuffer.width());
+  f32 invHeight = 1.0f / static_cast<f32>(framebuffer.height());
+  f32 sampleWeight = 1.0f / static_cast<f32>(endSample);
+
+  /* Pixels whose camera rays are intersected together */
+  u32 blockWidth = 1;
+  u32 blockHeight = 1;
+  switch (mPrimaryRayMode) {
+  case PrimaryRayMode::single:
+    break;
+  case PrimaryRayMode::packet8:
+    blockWidth = 4;
+    blockHeight = 2;
+    break;
+  case PrimaryRayMode::packet16:
+    blockWidth = 4;
+    blockHeight = 4;
+    break;
+  case PrimaryRayMode::stream:
+    blockWidth = mTileSize;
+    blockHeight = mTileSize;
+    break;
+  }
+  std::vector<SampleStream> pixelSamples;
+  std::vector<Ray> rays(stdu64(blockWidth) * blockHeight);
+  std::vector<Hit> hits(rays.size());
+  for (u32 blockY = tileY; blockY < endY; blockY += blockHeight) {
+    for (u32 blockX = tileX; blockX < endX; blockX += blockWidth) {
+      u32 width = std::min(blockWidth, endX - blockX);
+      u32 pixelCount = width * std::min(blockHeight, endY - blockY);
+      pixelSamples.clear();
+      for (u32 iPixel = 0; iPixel < pixelCount; ++iPixel) {
+        u32 x = blockX + iPixel % width;
+        u32 y = blockY + iPixel / width;
+        /* Seeded per pixel, so the image depends on neither the schedule nor
+        the primary ray mode. Each batch of samples draws from its own
+        stream */
+        pixelSamples.emplace_back(
+            &mSampler, x, y,
+            Rng{hashU64(stdu64(y) * framebuffer.width() + x), firstSample});
+      }
+      for (u32 iSample = firstSample; iSample < endSample; ++iSample) {
+        for (u32 iPixel = 0; iPixel < pixelCount; ++iPixel) {
+          u32 x = blockX + iPixel % width;
+          u32 y = blockY + iPixel / width;
+          SampleStream &samples = pixelSamples[iPixel];
+          samples.startSample(iSample);
+          f32 s = (static_cast<f32>(x) + samples.get(cameraDimensionU)) *
+                  invWidth;
+          f32 t = (static_cast<f32>(y) + samples.get(cameraDimensionV)) *
+                  invHeight;
+          rays[iPixel] = scene.camera().generateRay(s, t);
+          hits[iPixel] = {};
+        }
+        intersectPrimaryRays(scene, {rays.data(), pixelCount},
+                             {hits.data(), pixelCount}, stats);
+        for (u32 iPixel = 0; iPixel < pixelCount; ++iPixel) {
+          u64 index = stdu64(blockY + iPixel / width) * framebuffer.width() +
+                      blockX + iPixel % width;
+          Vec3 radiance = trace(scene, rays[iPixel], hits[iPixel],
+                                pixelSamples[iPixel], occlusionCache, stats);
+          f32 pixelLuminance = luminance(radiance);
+          sums.radiances[index] += radiance;
+          sums.squaredLuminances[index] += pixelLuminance * pixelLuminance;
+        }
+      }
+      for (u32 iPixel = 0; iPixel < pixelCount; ++iPixel) {
+        u32 x = blockX + iPixel % width;
+        u32 y = blockY + iPixel / width;
+        framebuffer.at(x, y) =
+            sums.radiances[stdu64(y) * framebuffer.width() + x] *
+            sampleWeight;
+      }
+    }
+  }
+}
+
+f32 PathTracer::tileNoise(const Framebuffer &framebuffer,
+                          const PixelSums &sums, u32 tileX, u32 tileY,
+                          u32 sampleCount) const {
+  if (sampleCount < 2) {
+    return infinity;
+  }
+  u32 endX = std::min(tileX + mTileSize, framebuffer.width());
+  u32 endY = std::min(tileY + mTileSize, framebuffer.height());
+  auto count = static_cast<f32>(sampleCount);
+  f32 noiseSum = 0.0f;
+  for (u32 y = tileY; y < endY; ++y) {
+    for (u32 x = tileX; x < endX; ++x) {
+      u64 index = stdu64(y) * framebuffer.width() + x;
+      f32 mean = luminance(sums.radiances[index]) / count;
+      f32 variance = std::max(
+          (sums.squaredLuminances[index] / count - mean * mean) * count /
+              (count - 1.0f),
+          0.0f);
+      /* Standard error of the mean, over the square root of the mean, which
+      follows the visible error of the gamma encoded image */
+      noiseSum += std::sqrt(variance / count /
+                            std::max(mean, minNoiseLuminance));
+    }
+  }
+  return noiseSum / static_cast<f32>((endX - tileX) * (endY - tileY));
+}
+
+/**
+ * @brief Copies up to {Size} rays into a packet and intersects them at once.
+ */
+template <u32 Size, typename IntersectFunc>
+static void intersectAsPacket(std::span<Ray> rays, std::span<Hit> hits,
+                              const IntersectFunc &intersectPacket) {
+  RayPacket<Size> packet;
+  HitPacket<Size> packetHits;
+  auto rayCount = static_cast<u32>(rays.size());
+  for (u32 lane = 0; lane < rayCount; ++lane) {
+    packet.setRay(lane, rays[lane]);
+  }
+  intersectPacket((1u << rayCount) - 1, packet, packetHits);
+  for (u32 lane = 0; lane < rayCount; ++lane) {
+    rays[lane].tMax = packet.tMax[lane];
+    hits[lane] = packetHits.hit(lane);
+  }
+}
+
+void PathTracer::intersectPrimaryRays(const Scene &scene, std::span<Ray> rays,
+                                      std::span<Hit> hits,
+                                      TraversalStats &stats) const {
+  switch (mPrimaryRayMode) {
+  case PrimaryRayMode::single:
+    for (u64 iRay = 0; iRay < rays.size(); ++iRay) {
+      scene.intersect(rays[iRay], hits[iRay], stats);
+    }
+    break;
+  case PrimaryRayMode::packet8:
+    intersectAsPacket<8>(rays, hits,
+                         [&](u32 validMask, RayPacket<8> &packet,
+                             HitPacket<8> &packetHits) {
+                           scene.intersect8(validMask, packet, packetHits,
+                                            stats);
+                         });
+    break;
+  case PrimaryRayMode::packet16:
+    intersectAsPacket<16>(rays, hits,
+                          [&](u32 validMask, RayPacket<16> &packet,
+                              HitPacket<16> &packetHits) {
+                            scene.intersect16(validMask, packet, packetHits,
+                                              stats);
+                          });
+    break;
+  case PrimaryRayMode::stream:
+    scene.intersectStream(rays, hits, stats);
+    break;
+  }
+}
+
+Vec3 PathTracer::trace(const Scene &scene, Ray ray, Hit hit,
+                       SampleStream &samples,
+                       OcclusionCache &occlusionCache,
+                       TraversalStats &stats) const {
+  Vec3 radiance;
+  Vec3 throughput = {1.0f, 1.0f, 1.0f};
+  /* Emitters reached by a bounce were already sampled by next event
+  estimation at the previous vertex, unless its BSDF is a delta */
+  bool countEmission = true;
+  for (u32 depth = 0; hit.valid(); ++depth) {
+    const Material &material = scene.material(hit);
+    if (countEmission) {
+      radiance += throughput * material.emission;
+    }
+    if (depth == mMaxBounces) {
+      break;
+    }
+
+    Vec3 position = ray.at(hit.t);
+    Vec3 normal = scene.normal(hit);
+    Vec3 facingNormal = dot(normal, ray.direction) > 0.0f ? -normal : normal;
+    LightSample lightSample;
+    bool lit = !material.specular() &&
+               sampleLight(scene, position, facingNormal, samples, depth,
+                           lightSample) &&
+               !scene.occluded(lightSample.shadowRay, occlusionCache, stats);
+
+    /* Russian roulette on the albedo, so that terminated paths skip sampling
+    a direction */
+    f32 survival = 1.0f;
+    bool survived = true;
+    if (depth + 1 >= minRouletteDepth) {
+      survival = std::min(maxComponent(throughput * material.albedo), 0.95f);
+      survived =
+          samples.get(bounceDimension(depth, BounceDimension::roulette)) <
+          survival;
+    }
+    f32 u = 0.0f;
+    f32 v = 0.0f;
+    f32 w = 0.0f;
+    if (survived) {
+      u = samples.get(bounceDimension(depth, BounceDimension::bsdfU));
+      v = samples.get(bounceDimension(depth, BounceDimension::bsdfV));
+      if (material.type != MaterialType::diffuse) {
+        w = samples.get(bounceDimension(depth, BounceDimension::bsdfLobe));
+      }
+    }
+    BsdfSample bsdfSample =
+        sampleBsdf(material, normal, -ray.direction,
+                   lit ? lightSample.shadowRay.direction : Vec3{}, u, v, w);
+    if (lit) {
+      radiance += throughput * bsdfSample.lightWeight * lightSample.radiance;
+    }
+    if (!survived || maxComponent(bsdfSample.weight) <= 0.0f) {
+      break;
+    }
+
+    throughput *= bsdfSample.weight;
+    throughput *= 1.0f / survival;
+    ray = {position, bsdfSample.direction};
+    countEmission = bsdfSample.specular;
+    hit = {};
+    scene.intersect(ray, hit, stats);
+  }
+  return radiance;
+}
+
+} /* namespace neko */
@@ -0,0 +1,109 @@
+#ifndef NEKO_RENDERER_CPU_PATH_TRACER_HPP
+#define NEKO_RENDERER_CPU_PATH_TRACER_HPP
+
+#include "framebuffer.hpp"
+#include "sampler.hpp"
+#include "scene.hpp"
+
+namespace neko {
+
+class ThreadPool;
+
+struct RenderStats {
+  /* Wall-clock time of the whole frame in milliseconds */
+  f32 renderTime = 0.0f;
+  /* Camera, bounce and shadow rays traced */
+  TraversalStats traversal;
+  /* Shadow rays, and those blocked by the cached occluder of their tile */
+  u64 shadowRayCount = 0;
+  u64 cachedOcclusionCount = 0;
+  /* Samples taken over all pixels */
+  u64 pixelSampleCount = 0;
+  /* Tiles of the frame, and those adaptive sampling stopped because their
+  noise fell below the threshold rather than on the sample limit or the time
+  budget */
+  u32 tileCount = 0;
+  u32 convergedTileCount = 0;
+
+  f64 mraysPerSecond() const noexcept {
+    return renderTime > 0.0f
+               ? static_cast<f64>(traversal.rayCount) / (renderTime * 1000.0)
+               : 0.0;
+  }
+};
+
+/**
+ * @brief Reference CPU renderer. The image is split into square tiles that are
+ * rendered as independent jobs on {ThreadPool}, each pixel is estimated with
+ * unidirectional path tracing and next event estimation. Camera rays are
+ * coherent, they are intersected a pixel block at a time as packets or
+ * streams depending on {PrimaryRayMode}.
+ *
+ * With adaptive sampling, tiles are refined in batches that double their
+ * sample count. Workers take the tile of highest estimated noise from a shared
+ * queue, and put it back after the batch unless its noise fell below the
+ * threshold or it reached the sample limit. A tile only ever depends on its
+ * own samples, so without a time budget the image does not depend on the
+ * schedule.
+ */
+class PathTracer {
+public:
+  PathTracer(const Settings &settings, ThreadPool &threadPool);
+  PathTracer(const PathTracer &) = delete;
+  PathTracer(PathTracer &&) = default;
+  PathTracer &operator=(const PathTracer &) = delete;
+  PathTracer &operator=(PathTracer &&) = default;
+  ~PathTracer() = default;
+
+  /**
+   * @brief Renders {scene} into {framebuffer}, overwriting its content.
+   */
+  RenderStats render(const Scene &scene, Framebuffer &framebuffer);
+
+private:
+  /* Running sums of the samples of every pixel */
+  struct PixelSums {
+    std::vector<Vec3> radiances;
+    std::vector<f32> squaredLuminances;
+  };
+
+  ThreadPool *mpThreadPool;
+  u32 mSamplesPerPixel;
+  u32 mMaxBounces;
+  u32 mTileSize;
+  PrimaryRayMode mPrimaryRayMode;
+  Sampler mSampler;
+  bool mAdaptiveSampling;
+  f32 mNoiseThreshold;
+  f32 mTimeBudget;
+
+  /**
+   * @brief Takes samples [firstSample, endSample) of the pixels of the tile
+   * at {tileX, tileY}, adds them to {sums} and writes their mean to
+   * {framebuffer}.
+   */
+  void renderTile(const Scene &scene, Framebuffer &framebuffer,
+                  PixelSums &sums, u32 tileX, u32 tileY, u32 firstSample,
+                  u32 endSample, OcclusionCache &occlusionCache,
+                  TraversalStats &stats) const;
+
+  /**
+   * @brief Noise of the tile at {tileX, tileY} once {sampleCount} samples
+   * were added to {sums}.
+   */
+  f32 tileNoise(const Framebuffer &framebuffer, const PixelSums &sums,
+                u32 tileX, u32 tileY, u32 sampleCount) const;
+
+  void intersectPrimaryRays(const Scene &scene, std::span<Ray> rays,
+                           std::span<Hit> hits, TraversalStats &stats) const;
+
+  /**
+   * @brief Radiance along {ray}, whose closest hit {hit} was already found.
+   */
+  Vec3 trace(const Scene &scene, Ray ray, Hit hit, SampleStream &samples,
+             OcclusionCache &occlusionCache, TraversalStats &stats) const;
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_PATH_TRACER_HPP */
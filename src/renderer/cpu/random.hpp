@@ -0,0 +1,54 @@
+#ifndef NEKO_RENDERER_CPU_RANDOM_HPP
+#define NEKO_RENDERER_CPU_RANDOM_HPP
+
+#include "utils.hpp"
+
+namespace neko {
+
+/**
+ * @brief SplitMix64 finalizer, used to turn pixel and sample indices into
+ * well distributed seeds.
+ */
+inline u64 hashU64(u64 value) noexcept {
+  value += 0x9e3779b97f4a7c15ull;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+  return value ^ (value >> 31);
+}
+
+/**
+ * @brief PCG32 generator (O'Neill, PCG XSH RR). Small enough to keep one per
+ * pixel sample on the stack.
+ */
+class Rng {
+public:
+  explicit Rng(u64 seed, u64 stream = 0) noexcept
+      : mIncrement{(stream << 1) | 1} {
+    nextU32();
+    mState += seed;
+    nextU32();
+  }
+
+  u32 nextU32() noexcept {
+    u64 oldState = mState;
+    mState = oldState * 6364136223846793005ull + mIncrement;
+    auto xorShifted = static_cast<u32>(((oldState >> 18) ^ oldState) >> 27);
+    auto rotation = static_cast<u32>(oldState >> 59);
+    return (xorShifted >> rotation) | (xorShifted << ((~rotation + 1) & 31));
+  }
+
+  /**
+   * @brief Uniform float in [0, 1).
+   */
+  f32 nextF32() noexcept {
+    return static_cast<f32>(nextU32() >> 8) * (1.0f / 16777216.0f);
+  }
+
+private:
+  u64 mState = 0;
+  u64 mIncrement;
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_RANDOM_HPP */
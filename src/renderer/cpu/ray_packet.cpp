@@ -0,0 +1,79 @@
+#include "ray_packet.hpp"
+
+namespace neko {
+
+void intersectStream(const Bvh &bvh, const std::vector<Triangle> &triangles,
+                     std::span<Ray> rays, std::span<Hit> hits,
+                     TraversalStats &stats) {
+  stats.rayCount += rays.size();
+  if (bvh.empty() || rays.empty()) {
+    return;
+  }
+  const std::vector<BvhNode> &nodes = bvh.nodes();
+  const std::vector<u32> &primitiveIndices = bvh.primitiveIndices();
+  std::vector<Vec3> invDirections(rays.size());
+  for (u64 iRay = 0; iRay < rays.size(); ++iRay) {
+    invDirections[iRay] = {1.0f / rays[iRay].direction.x,
+                           1.0f / rays[iRay].direction.y,
+                           1.0f / rays[iRay].direction.z};
+  }
+
+  /* Rays reaching a node are filtered from the list of its parent, and the
+  list is appended on top of {rayIndices}. Lists are popped in stack order, so
+  truncating to the end of the parent list drops those of finished subtrees */
+  std::vector<u32> rayIndices(rays.size());
+  for (u32 iRay = 0; iRay < rayIndices.size(); ++iRay) {
+    rayIndices[iRay] = iRay;
+  }
+  struct StackEntry {
+    u32 nodeIndex;
+    u32 begin;
+    u32 end;
+  };
+  /* Both children are pushed, one entry more than the depth is needed */
+  StackEntry stack[Bvh::maxDepth + 1];
+  u32 stackSize = 0;
+  stack[stackSize++] = {0, 0, static_cast<u32>(rays.size())};
+  while (stackSize > 0) {
+    StackEntry entry = stack[--stackSize];
+    const BvhNode &node = nodes[entry.nodeIndex];
+    ++stats.visitedNodeCount;
+    rayIndices.resize(entry.end);
+    for (u32 iEntry = entry.begin; iEntry < entry.end; ++iEntry) {
+      u32 rayIndex = rayIndices[iEntry];
+      const Ray &ray = rays[rayIndex];
+      f32 tEntry;
+      if (intersectBounds(node.lower, node.upper, ray.origin,
+                          invDirections[rayIndex], ray.tMax, tEntry)) {
+        rayIndices.push_back(rayIndex);
+      }
+    }
+    u32 begin = entry.end;
+    auto end = static_cast<u32>(rayIndices.size());
+    if (begin == end) {
+      continue;
+    }
+
+    if (node.leaf()) {
+      for (u32 iEntry = begin; iEntry < end; ++iEntry) {
+        u32 rayIndex = rayIndices[iEntry];
+        for (u32 iPrimitive = node.offset;
+             iPrimitive < node.offset + node.primitiveCount; ++iPrimitive) {
+          u32 triangleIndex = primitiveIndices[iPrimitive];
+          intersectTriangle(triangles[triangleIndex], triangleIndex,
+                            rays[rayIndex], hits[rayIndex]);
+        }
+      }
+      continue;
+    }
+    const Vec3 &direction = rays[rayIndices[begin]].direction;
+    Vec3 centerOffset =
+        nodes[node.offset + 1].bounds().center() -
+        nodes[node.offset].bounds().center();
+    u32 nearOffset = dot(centerOffset, direction) < 0.0f ? 1 : 0;
+    stack[stackSize++] = {node.offset + 1 - nearOffset, begin, end};
+    stack[stackSize++] = {node.offset + nearOffset, begin, end};
+  }
+}
+
+} /* namespace neko */
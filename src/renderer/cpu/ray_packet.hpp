@@ -0,0 +1,135 @@
+#ifndef NEKO_RENDERER_CPU_RAY_PACKET_HPP
+#define NEKO_RENDERER_CPU_RAY_PACKET_HPP
+
+#include "bvh.hpp"
+#include "simd.hpp"
+#include "triangle.hpp"
+
+#include <span>
+
+namespace neko {
+
+/**
+ * @brief {Size} rays stored as structure of arrays, one lane per ray.
+ */
+template <u32 Size> struct alignas(32) RayPacket {
+  static_assert(Size == 8 || Size == 16, "Packets hold 8 or 16 rays");
+
+  f32 originX[Size];
+  f32 originY[Size];
+  f32 originZ[Size];
+  f32 directionX[Size];
+  f32 directionY[Size];
+  f32 directionZ[Size];
+  f32 tMax[Size];
+
+  void setRay(u32 lane, const Ray &ray) noexcept {
+    originX[lane] = ray.origin.x;
+    originY[lane] = ray.origin.y;
+    originZ[lane] = ray.origin.z;
+    directionX[lane] = ray.direction.x;
+    directionY[lane] = ray.direction.y;
+    directionZ[lane] = ray.direction.z;
+    tMax[lane] = ray.tMax;
+  }
+
+  Ray ray(u32 lane) const noexcept {
+    return {{originX[lane], originY[lane], originZ[lane]},
+            {directionX[lane], directionY[lane], directionZ[lane]},
+            tMax[lane]};
+  }
+};
+
+/**
+ * @brief Closest hits of a {RayPacket}, lanes without a hit keep an invalid
+ * triangle index.
+ */
+template <u32 Size> struct alignas(32) HitPacket {
+  f32 t[Size];
+  f32 u[Size];
+  f32 v[Size];
+  u32 triangleIndices[Size];
+  u32 instanceIndices[Size];
+
+  HitPacket() noexcept {
+    for (u32 lane = 0; lane < Size; ++lane) {
+      t[lane] = infinity;
+      u[lane] = 0.0f;
+      v[lane] = 0.0f;
+      triangleIndices[lane] = invalidIndex;
+      instanceIndices[lane] = invalidIndex;
+    }
+  }
+
+  void setHit(u32 lane, const Hit &hit) noexcept {
+    t[lane] = hit.t;
+    u[lane] = hit.u;
+    v[lane] = hit.v;
+    triangleIndices[lane] = hit.triangleIndex;
+    instanceIndices[lane] = hit.instanceIndex;
+  }
+
+  Hit hit(u32 lane) const noexcept {
+    return {t[lane], u[lane], v[lane], triangleIndices[lane],
+            instanceIndices[lane]};
+  }
+};
+
+/**
+ * @brief Closest-hit traversal of {bvh}, built over {triangles}, for the lanes
+ * of {packet} set in {validMask}. Each node is fetched once for the whole
+ * packet: it is culled with the interval bounds of the packet when the ray
+ * directions agree in sign, then tested against every active lane with the
+ * kernel of {isa}. Returns the mask of lanes that hit a triangle, and
+ * shortens their {tMax}. {stats.visitedNodeCount} counts node visits of the
+ * packet, not of each ray.
+ */
+template <u32 Size>
+u32 intersectPacket(SimdIsa isa, const Bvh &bvh,
+                    const std::vector<Triangle> &triangles, u32 validMask,
+                    RayPacket<Size> &packet, HitPacket<Size> &hits,
+                    TraversalStats &stats);
+
+/**
+ * @brief Any-hit traversal of {bvh} for the lanes of {packet} set in
+ * {validMask}, such as a batch of shadow rays. A lane leaves the packet at the
+ * first triangle it hits before its {tMax}, and only the index of the last
+ * such triangle is written, to {occluderIndex}. Returns the mask of occluded
+ * lanes.
+ */
+template <u32 Size>
+u32 occludedPacket(SimdIsa isa, const Bvh &bvh,
+                   const std::vector<Triangle> &triangles, u32 validMask,
+                   const RayPacket<Size> &packet, u32 &occluderIndex,
+                   TraversalStats &stats);
+
+/**
+ * @brief Closest-hit traversal of {bvh} for a whole stream of rays, such as
+ * the camera rays of a tile. The stream is filtered at every node, so each
+ * node is fetched once for all the rays that reach it. {hits} must have one
+ * element per ray.
+ */
+void intersectStream(const Bvh &bvh, const std::vector<Triangle> &triangles,
+                     std::span<Ray> rays, std::span<Hit> hits,
+                     TraversalStats &stats);
+
+extern template u32 intersectPacket<8>(SimdIsa, const Bvh &,
+                                       const std::vector<Triangle> &, u32,
+                                       RayPacket<8> &, HitPacket<8> &,
+                                       TraversalStats &);
+extern template u32 intersectPacket<16>(SimdIsa, const Bvh &,
+                                        const std::vector<Triangle> &, u32,
+                                        RayPacket<16> &, HitPacket<16> &,
+                                        TraversalStats &);
+extern template u32 occludedPacket<8>(SimdIsa, const Bvh &,
+                                      const std::vector<Triangle> &, u32,
+                                      const RayPacket<8> &, u32 &,
+                                      TraversalStats &);
+extern template u32 occludedPacket<16>(SimdIsa, const Bvh &,
+                                       const std::vector<Triangle> &, u32,
+                                       const RayPacket<16> &, u32 &,
+                                       TraversalStats &);
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_RAY_PACKET_HPP */
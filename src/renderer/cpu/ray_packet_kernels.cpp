@@ -0,0 +1,110 @@
+#include "ray_packet.hpp"
+#include "simd_lanes.hpp"
+
+#include <bit>
+
+namespace neko {
+
+/**
+ * @brief Per-traversal data of a packet: reciprocal directions, and the
+ * interval bounds of origins and reciprocal directions used to cull nodes for
+ * the whole packet at once.
+ */
+template <u32 Size> struct PacketContext {
+  alignas(32) f32 invDirectionX[Size];
+  alignas(32) f32 invDirectionY[Size];
+  alignas(32) f32 invDirectionZ[Size];
+  /* Interval bounds are only valid if every direction component of an axis
+  has the same, non-zero sign */
+  bool hasFrustum;
+  Vec3 originMin;
+  Vec3 originMax;
+  Vec3 invDirectionMin;
+  Vec3 invDirectionMax;
+};
+
+namespace scalar_kernels {
+
+#include "ray_packet_traversal.inl"
+
+} /* namespace scalar_kernels */
+
+#if NEKO_SIMD_X86
+namespace sse_kernels {
+
+#include "ray_packet_traversal.inl"
+
+} /* namespace sse_kernels */
+
+NEKO_BEGIN_TARGET_AVX2
+namespace avx2_kernels {
+
+#include "ray_packet_traversal.inl"
+
+} /* namespace avx2_kernels */
+NEKO_END_TARGET_AVX2
+#endif /* NEKO_SIMD_X86 */
+
+template <u32 Size>
+u32 intersectPacket(SimdIsa isa, const Bvh &bvh,
+                    const std::vector<Triangle> &triangles, u32 validMask,
+                    RayPacket<Size> &packet, HitPacket<Size> &hits,
+                    TraversalStats &stats) {
+  stats.rayCount += static_cast<u64>(std::popcount(validMask));
+  if (bvh.empty() || validMask == 0) {
+    return 0;
+  }
+#if NEKO_SIMD_X86
+  if (isa >= SimdIsa::avx2) {
+    return avx2_kernels::traversePacket(bvh, triangles, validMask, packet,
+                                        hits, stats);
+  }
+  if (isa >= SimdIsa::sse) {
+    return sse_kernels::traversePacket(bvh, triangles, validMask, packet, hits,
+                                       stats);
+  }
+#endif /* NEKO_SIMD_X86 */
+  return scalar_kernels::traversePacket(bvh, triangles, validMask, packet,
+                                        hits, stats);
+}
+
+template <u32 Size>
+u32 occludedPacket(SimdIsa isa, const Bvh &bvh,
+                   const std::vector<Triangle> &triangles, u32 validMask,
+                   const RayPacket<Size> &packet, u32 &occluderIndex,
+                   TraversalStats &stats) {
+  stats.rayCount += static_cast<u64>(std::popcount(validMask));
+  if (bvh.empty() || validMask == 0) {
+    return 0;
+  }
+#if NEKO_SIMD_X86
+  if (isa >= SimdIsa::avx2) {
+    return avx2_kernels::occludePacket(bvh, triangles, validMask, packet,
+                                       occluderIndex, stats);
+  }
+  if (isa >= SimdIsa::sse) {
+    return sse_kernels::occludePacket(bvh, triangles, validMask, packet,
+                                      occluderIndex, stats);
+  }
+#endif /* NEKO_SIMD_X86 */
+  return scalar_kernels::occludePacket(bvh, triangles, validMask, packet,
+                                       occluderIndex, stats);
+}
+
+template u32 intersectPacket<8>(SimdIsa, const Bvh &,
+                                const std::vector<Triangle> &, u32,
+                                RayPacket<8> &, HitPacket<8> &,
+                                TraversalStats &);
+template u32 intersectPacket<16>(SimdIsa, const Bvh &,
+                                 const std::vector<Triangle> &, u32,
+                                 RayPacket<16> &, HitPacket<16> &,
+                                 TraversalStats &);
+template u32 occludedPacket<8>(SimdIsa, const Bvh &,
+                               const std::vector<Triangle> &, u32,
+                               const RayPacket<8> &, u32 &, TraversalStats &);
+template u32 occludedPacket<16>(SimdIsa, const Bvh &,
+                                const std::vector<Triangle> &, u32,
+                                const RayPacket<16> &, u32 &,
+                                TraversalStats &);
+
+} /* namespace neko */
@@ -0,0 +1,406 @@
+/* Packet traversals of a binary {Bvh}, included by ray_packet_kernels.cpp once
+per instruction set, inside a namespace that provides {Lanes}: a group of
+{Lanes::width} floats ({Float_T}) with its comparison masks ({Mask_T}) and the
+arithmetic used below. Packets are processed a group of lanes at a time.
+Scalar helpers are compiled per instruction set as well: calling baseline code
+with dirty upper AVX registers costs a state transition per node */
+
+template <u32 Size>
+static void initPacketContext(const RayPacket<Size> &packet, u32 validMask,
+                              PacketContext<Size> &context) noexcept {
+  for (u32 lane = 0; lane < Size; ++lane) {
+    context.invDirectionX[lane] = 1.0f / packet.directionX[lane];
+    context.invDirectionY[lane] = 1.0f / packet.directionY[lane];
+    context.invDirectionZ[lane] = 1.0f / packet.directionZ[lane];
+  }
+
+  const f32 *origins[3] = {packet.originX, packet.originY, packet.originZ};
+  const f32 *directions[3] = {packet.directionX, packet.directionY,
+                              packet.directionZ};
+  const f32 *invDirections[3] = {context.invDirectionX, context.invDirectionY,
+                                 context.invDirectionZ};
+  f32 bounds[4][3];
+  context.hasFrustum = true;
+  for (u32 axis = 0; axis < 3; ++axis) {
+    bounds[0][axis] = infinity;
+    bounds[1][axis] = -infinity;
+    bounds[2][axis] = infinity;
+    bounds[3][axis] = -infinity;
+    u32 positiveCount = 0;
+    u32 negativeCount = 0;
+    for (u32 mask = validMask; mask != 0; mask &= mask - 1) {
+      auto lane = static_cast<u32>(std::countr_zero(mask));
+      positiveCount += directions[axis][lane] > 0.0f ? 1 : 0;
+      negativeCount += directions[axis][lane] < 0.0f ? 1 : 0;
+      bounds[0][axis] = std::min(bounds[0][axis], origins[axis][lane]);
+      bounds[1][axis] = std::max(bounds[1][axis], origins[axis][lane]);
+      bounds[2][axis] = std::min(bounds[2][axis], invDirections[axis][lane]);
+      bounds[3][axis] = std::max(bounds[3][axis], invDirections[axis][lane]);
+    }
+    auto validCount = static_cast<u32>(std::popcount(validMask));
+    context.hasFrustum &=
+        positiveCount == validCount || negativeCount == validCount;
+  }
+  context.originMin = {bounds[0][0], bounds[0][1], bounds[0][2]};
+  context.originMax = {bounds[1][0], bounds[1][1], bounds[1][2]};
+  context.invDirectionMin = {bounds[2][0], bounds[2][1], bounds[2][2]};
+  context.invDirectionMax = {bounds[3][0], bounds[3][1], bounds[3][2]};
+}
+
+/**
+ * @brief Bounds of {(bound - origin) * invDirection} over the origin and
+ * reciprocal direction intervals of the packet, by interval arithmetic.
+ */
+static void slabInterval(f32 bound, f32 originMin, f32 originMax,
+                         f32 invDirectionMin, f32 invDirectionMax,
+                         f32 &tMin, f32 &tMax) noexcept {
+  f32 distanceMin = bound - originMax;
+  f32 distanceMax = bound - originMin;
+  f32 products[4] = {distanceMin * invDirectionMin,
+                     distanceMin * invDirectionMax,
+                     distanceMax * invDirectionMin,
+                     distanceMax * invDirectionMax};
+  tMin = std::min(std::min(products[0], products[1]),
+                  std::min(products[2], products[3]));
+  tMax = std::max(std::max(products[0], products[1]),
+                  std::max(products[2], products[3]));
+}
+
+/**
+ * @brief Conservative test of the whole packet against {node}: false only if
+ * no ray of the packet can hit it before {packetTMax}.
+ */
+template <u32 Size>
+static bool intersectFrustum(const BvhNode &node,
+                             const PacketContext<Size> &context,
+                             f32 packetTMax) noexcept {
+  f32 tNear = 0.0f;
+  f32 tFar = packetTMax;
+  for (u32 axis = 0; axis < 3; ++axis) {
+    bool positive = context.invDirectionMin[axis] > 0.0f;
+    f32 nearBound = positive ? node.lower[axis] : node.upper[axis];
+    f32 farBound = positive ? node.upper[axis] : node.lower[axis];
+    f32 tMin;
+    f32 tMax;
+    slabInterval(nearBound, context.originMin[axis], context.originMax[axis],
+                 context.invDirectionMin[axis], context.invDirectionMax[axis],
+                 tMin, tMax);
+    tNear = std::max(tNear, tMin);
+    slabInterval(farBound, context.originMin[axis], context.originMax[axis],
+                 context.invDirectionMin[axis], context.invDirectionMax[axis],
+                 tMin, tMax);
+    tFar = std::min(tFar, tMax);
+  }
+  return tNear <= tFar;
+}
+
+
+/* Largest {tMax} of the lanes in {activeMask} */
+template <u32 Size>
+static f32 packetTMax(const RayPacket<Size> &packet, u32 activeMask) noexcept {
+  f32 tMax = 0.0f;
+  for (u32 mask = activeMask; mask != 0; mask &= mask - 1) {
+    tMax = std::max(tMax, packet.tMax[std::countr_zero(mask)]);
+  }
+  return tMax;
+}
+
+/**
+ * @brief 1 if the second child of {node} should be visited first, judging by
+ * the direction of the first ray in {activeMask}.
+ */
+template <u32 Size>
+static u32 nearChildOffset(const std::vector<BvhNode> &nodes,
+                           const BvhNode &node, const RayPacket<Size> &packet,
+                           u32 activeMask) noexcept {
+  auto lane = static_cast<u32>(std::countr_zero(activeMask));
+  Vec3 direction = {packet.directionX[lane], packet.directionY[lane],
+                    packet.directionZ[lane]};
+  Vec3 centerOffset = nodes[node.offset + 1].bounds().center() -
+                      nodes[node.offset].bounds().center();
+  return dot(centerOffset, direction) < 0.0f ? 1 : 0;
+}
+
+/**
+ * @brief Slab test of every lane against {node}.
+ */
+template <u32 Size>
+static u32 intersectNodeLanes(const BvhNode &node, u32 activeMask,
+                              const RayPacket<Size> &packet,
+                              const PacketContext<Size> &context) noexcept {
+  typedef Lanes::Float_T Float_T;
+  u32 hitMask = 0;
+  for (u32 group = 0; group < Size; group += Lanes::width) {
+    Float_T originX = Lanes::load(packet.originX + group);
+    Float_T originY = Lanes::load(packet.originY + group);
+    Float_T originZ = Lanes::load(packet.originZ + group);
+    Float_T invDirectionX = Lanes::load(context.invDirectionX + group);
+    Float_T invDirectionY = Lanes::load(context.invDirectionY + group);
+    Float_T invDirectionZ = Lanes::load(context.invDirectionZ + group);
+    Float_T tx0 = Lanes::mul(
+        Lanes::sub(Lanes::broadcast(node.lower.x), originX), invDirectionX);
+    Float_T tx1 = Lanes::mul(
+        Lanes::sub(Lanes::broadcast(node.upper.x), originX), invDirectionX);
+    Float_T ty0 = Lanes::mul(
+        Lanes::sub(Lanes::broadcast(node.lower.y), originY), invDirectionY);
+    Float_T ty1 = Lanes::mul(
+        Lanes::sub(Lanes::broadcast(node.upper.y), originY), invDirectionY);
+    Float_T tz0 = Lanes::mul(
+        Lanes::sub(Lanes::broadcast(node.lower.z), originZ), invDirectionZ);
+    Float_T tz1 = Lanes::mul(
+        Lanes::sub(Lanes::broadcast(node.upper.z), originZ), invDirectionZ);
+    Float_T tNear = Lanes::max(
+        Lanes::max(Lanes::min(tx0, tx1), Lanes::min(ty0, ty1)),
+        Lanes::max(Lanes::min(tz0, tz1), Lanes::broadcast(0.0f)));
+    Float_T tFar = Lanes::min(
+        Lanes::min(Lanes::max(tx0, tx1), Lanes::max(ty0, ty1)),
+        Lanes::min(Lanes::max(tz0, tz1), Lanes::load(packet.tMax + group)));
+    hitMask |= Lanes::bits(Lanes::lessEqual(tNear, tFar)) << group;
+  }
+  return hitMask & activeMask;
+}
+
+/**
+ * @brief Möller–Trumbore test of the lanes of {group} against {triangle},
+ * with the same arithmetic as {intersectTriangle}. Returns the mask of the
+ * group lanes hit before their {tMax}, with the hit distances and barycentric
+ * coordinates in {t}, {u} and {v}.
+ */
+template <u32 Size>
+static u32 intersectTriangleGroup(const Triangle &triangle, u32 group,
+                                  const RayPacket<Size> &packet,
+                                  Lanes::Float_T &t, Lanes::Float_T &u,
+                                  Lanes::Float_T &v) noexcept {
+  typedef Lanes::Float_T Float_T;
+  typedef Lanes::Mask_T Mask_T;
+  Vec3 edge1 = triangle.p1 - triangle.p0;
+  Vec3 edge2 = triangle.p2 - triangle.p0;
+  Float_T edge1X = Lanes::broadcast(edge1.x);
+  Float_T edge1Y = Lanes::broadcast(edge1.y);
+  Float_T edge1Z = Lanes::broadcast(edge1.z);
+  Float_T edge2X = Lanes::broadcast(edge2.x);
+  Float_T edge2Y = Lanes::broadcast(edge2.y);
+  Float_T edge2Z = Lanes::broadcast(edge2.z);
+  Float_T directionX = Lanes::load(packet.directionX + group);
+  Float_T directionY = Lanes::load(packet.directionY + group);
+  Float_T directionZ = Lanes::load(packet.directionZ + group);
+  Float_T pVecX = Lanes::sub(Lanes::mul(directionY, edge2Z),
+                             Lanes::mul(directionZ, edge2Y));
+  Float_T pVecY = Lanes::sub(Lanes::mul(directionZ, edge2X),
+                             Lanes::mul(directionX, edge2Z));
+  Float_T pVecZ = Lanes::sub(Lanes::mul(directionX, edge2Y),
+                             Lanes::mul(directionY, edge2X));
+  Float_T determinant = Lanes::add(
+      Lanes::add(Lanes::mul(edge1X, pVecX), Lanes::mul(edge1Y, pVecY)),
+      Lanes::mul(edge1Z, pVecZ));
+  Float_T invDeterminant = Lanes::div(Lanes::broadcast(1.0f), determinant);
+  Float_T tVecX = Lanes::sub(Lanes::load(packet.originX + group),
+                             Lanes::broadcast(triangle.p0.x));
+  Float_T tVecY = Lanes::sub(Lanes::load(packet.originY + group),
+                             Lanes::broadcast(triangle.p0.y));
+  Float_T tVecZ = Lanes::sub(Lanes::load(packet.originZ + group),
+                             Lanes::broadcast(triangle.p0.z));
+  u = Lanes::mul(
+      Lanes::add(Lanes::add(Lanes::mul(tVecX, pVecX), Lanes::mul(tVecY, pVecY)),
+                 Lanes::mul(tVecZ, pVecZ)),
+      invDeterminant);
+  Float_T qVecX =
+      Lanes::sub(Lanes::mul(tVecY, edge1Z), Lanes::mul(tVecZ, edge1Y));
+  Float_T qVecY =
+      Lanes::sub(Lanes::mul(tVecZ, edge1X), Lanes::mul(tVecX, edge1Z));
+  Float_T qVecZ =
+      Lanes::sub(Lanes::mul(tVecX, edge1Y), Lanes::mul(tVecY, edge1X));
+  v = Lanes::mul(Lanes::add(Lanes::add(Lanes::mul(directionX, qVecX),
+                                       Lanes::mul(directionY, qVecY)),
+                            Lanes::mul(directionZ, qVecZ)),
+                 invDeterminant);
+  t = Lanes::mul(Lanes::add(Lanes::add(Lanes::mul(edge2X, qVecX),
+                                       Lanes::mul(edge2Y, qVecY)),
+                            Lanes::mul(edge2Z, qVecZ)),
+                 invDeterminant);
+  Float_T zero = Lanes::broadcast(0.0f);
+  Float_T one = Lanes::broadcast(1.0f);
+  Mask_T hit =
+      Lanes::lessEqual(Lanes::broadcast(1e-12f), Lanes::abs(determinant));
+  hit = Lanes::logicalAnd(hit, Lanes::lessEqual(zero, u));
+  hit = Lanes::logicalAnd(hit, Lanes::lessEqual(u, one));
+  hit = Lanes::logicalAnd(hit, Lanes::lessEqual(zero, v));
+  hit = Lanes::logicalAnd(hit, Lanes::lessEqual(Lanes::add(u, v), one));
+  hit = Lanes::logicalAnd(hit, Lanes::less(Lanes::broadcast(rayEpsilon), t));
+  hit = Lanes::logicalAnd(hit,
+                          Lanes::less(t, Lanes::load(packet.tMax + group)));
+  return Lanes::bits(hit);
+}
+
+/**
+ * @brief Closest-hit test of every lane against {triangle}, which updates
+ * {hits} and {packet.tMax} of the lanes it hits.
+ */
+template <u32 Size>
+static u32 intersectTriangleLanes(const Triangle &triangle, u32 triangleIndex,
+                                  u32 activeMask, RayPacket<Size> &packet,
+                                  HitPacket<Size> &hits) noexcept {
+  typedef Lanes::Float_T Float_T;
+  typedef Lanes::Mask_T Mask_T;
+  u32 foundMask = 0;
+  for (u32 group = 0; group < Size; group += Lanes::width) {
+    u32 groupMask = (activeMask >> group) & ((1u << Lanes::width) - 1);
+    if (groupMask == 0) {
+      continue;
+    }
+    Float_T t;
+    Float_T u;
+    Float_T v;
+    u32 hitMask =
+        intersectTriangleGroup(triangle, group, packet, t, u, v) & groupMask;
+    if (hitMask == 0) {
+      continue;
+    }
+    Mask_T hit = Lanes::fromBits(hitMask);
+    Lanes::store(packet.tMax + group,
+                 Lanes::select(hit, t, Lanes::load(packet.tMax + group)));
+    Lanes::store(hits.t + group,
+                 Lanes::select(hit, t, Lanes::load(hits.t + group)));
+    Lanes::store(hits.u + group,
+                 Lanes::select(hit, u, Lanes::load(hits.u + group)));
+    Lanes::store(hits.v + group,
+                 Lanes::select(hit, v, Lanes::load(hits.v + group)));
+    for (u32 mask = hitMask; mask != 0; mask &= mask - 1) {
+      u32 lane = group + static_cast<u32>(std::countr_zero(mask));
+      hits.triangleIndices[lane] = triangleIndex;
+      hits.instanceIndices[lane] = invalidIndex;
+    }
+    foundMask |= hitMask << group;
+  }
+  return foundMask;
+}
+
+/**
+ * @brief Any-hit test of every lane against {triangle}, without writing
+ * anything.
+ */
+template <u32 Size>
+static u32 occludedTriangleLanes(const Triangle &triangle, u32 activeMask,
+                                 const RayPacket<Size> &packet) noexcept {
+  u32 occludedMask = 0;
+  for (u32 group = 0; group < Size; group += Lanes::width) {
+    u32 groupMask = (activeMask >> group) & ((1u << Lanes::width) - 1);
+    if (groupMask == 0) {
+      continue;
+    }
+    Lanes::Float_T t;
+    Lanes::Float_T u;
+    Lanes::Float_T v;
+    occludedMask |=
+        (intersectTriangleGroup(triangle, group, packet, t, u, v) & groupMask)
+        << group;
+  }
+  return occludedMask;
+}
+
+template <u32 Size>
+u32 traversePacket(const Bvh &bvh, const std::vector<Triangle> &triangles,
+                   u32 validMask, RayPacket<Size> &packet,
+                   HitPacket<Size> &hits, TraversalStats &stats) {
+  const std::vector<BvhNode> &nodes = bvh.nodes();
+  const std::vector<u32> &primitiveIndices = bvh.primitiveIndices();
+  PacketContext<Size> context;
+  initPacketContext(packet, validMask, context);
+
+  struct StackEntry {
+    u32 nodeIndex;
+    u32 activeMask;
+  };
+  /* Both children are pushed, one entry more than the depth is needed */
+  StackEntry stack[Bvh::maxDepth + 1];
+  u32 stackSize = 0;
+  stack[stackSize++] = {0, validMask};
+  u32 foundMask = 0;
+  while (stackSize > 0) {
+    StackEntry entry = stack[--stackSize];
+    const BvhNode &node = nodes[entry.nodeIndex];
+    ++stats.visitedNodeCount;
+    if (context.hasFrustum &&
+        !intersectFrustum(node, context,
+                          packetTMax(packet, entry.activeMask))) {
+      continue;
+    }
+    u32 activeMask =
+        intersectNodeLanes(node, entry.activeMask, packet, context);
+    if (activeMask == 0) {
+      continue;
+    }
+
+    if (node.leaf()) {
+      for (u32 iPrimitive = node.offset;
+           iPrimitive < node.offset + node.primitiveCount; ++iPrimitive) {
+        u32 triangleIndex = primitiveIndices[iPrimitive];
+        foundMask |= intersectTriangleLanes(
+            triangles[triangleIndex], triangleIndex, activeMask, packet, hits);
+      }
+      continue;
+    }
+    u32 nearOffset = nearChildOffset(nodes, node, packet, activeMask);
+    stack[stackSize++] = {node.offset + 1 - nearOffset, activeMask};
+    stack[stackSize++] = {node.offset + nearOffset, activeMask};
+  }
+  return foundMask;
+}
+
+/* Any-hit counterpart of {traversePacket}: occluded lanes leave the packet,
+children are visited in memory order, and the traversal ends once every lane
+is occluded */
+template <u32 Size>
+u32 occludePacket(const Bvh &bvh, const std::vector<Triangle> &triangles,
+                  u32 validMask, const RayPacket<Size> &packet,
+                  u32 &occluderIndex, TraversalStats &stats) {
+  const std::vector<BvhNode> &nodes = bvh.nodes();
+  const std::vector<u32> &primitiveIndices = bvh.primitiveIndices();
+  PacketContext<Size> context;
+  initPacketContext(packet, validMask, context);
+
+  struct StackEntry {
+    u32 nodeIndex;
+    u32 activeMask;
+  };
+  StackEntry stack[Bvh::maxDepth + 1];
+  u32 stackSize = 0;
+  stack[stackSize++] = {0, validMask};
+  u32 occludedMask = 0;
+  while (stackSize > 0 && occludedMask != validMask) {
+    StackEntry entry = stack[--stackSize];
+    u32 activeMask = entry.activeMask & ~occludedMask;
+    if (activeMask == 0) {
+      continue;
+    }
+    const BvhNode &node = nodes[entry.nodeIndex];
+    ++stats.visitedNodeCount;
+    if (context.hasFrustum &&
+        !intersectFrustum(node, context, packetTMax(packet, activeMask))) {
+      continue;
+    }
+    activeMask = intersectNodeLanes(node, activeMask, packet, context);
+    if (activeMask == 0) {
+      continue;
+    }
+
+    if (node.leaf()) {
+      for (u32 iPrimitive = node.offset;
+           iPrimitive < node.offset + node.primitiveCount && activeMask != 0;
+           ++iPrimitive) {
+        u32 triangleIndex = primitiveIndices[iPrimitive];
+        u32 hitMask =
+            occludedTriangleLanes(triangles[triangleIndex], activeMask, packet);
+        if (hitMask != 0) {
+          occluderIndex = triangleIndex;
+          occludedMask |= hitMask;
+          activeMask &= ~hitMask;
+        }
+      }
+      continue;
+    }
+    stack[stackSize++] = {node.offset + 1, activeMask};
+    stack[stackSize++] = {node.offset, activeMask};
+  }
+  return occludedMask;
+}
@@ -0,0 +1,62 @@
+#include "ray_sort.hpp"
+
+#include "parallel.hpp"
+
+namespace neko {
+
+void radixSortPairs(ThreadPool &threadPool, std::vector<u32> &keys,
+                    std::vector<u32> &values, std::vector<u32> &scratchKeys,
+                    std::vector<u32> &scratchValues, u32 keyBits) {
+  constexpr u32 digitBits = 11;
+  constexpr u32 bucketCount = 1u << digitBits;
+  u64 count = keys.size();
+  scratchKeys.resize(count);
+  scratchValues.resize(count);
+  u64 grainSize = chooseGrainSize(threadPool, count, 0);
+  u64 chunkCount = (count + grainSize - 1) / grainSize;
+  /* Chunk-major: the buckets of chunk i start at {i * bucketCount} */
+  std::vector<u64> offsets(chunkCount * bucketCount);
+
+  for (u32 shift = 0; shift < keyBits; shift += digitBits) {
+    std::fill(offsets.begin(), offsets.end(), 0);
+    parallelFor(threadPool, 0, chunkCount, 1, [&](u64 iChunk) {
+      u64 *pCounts = offsets.data() + iChunk * bucketCount;
+      u64 end = std::min(count, (iChunk + 1) * grainSize);
+      for (u64 iKey = iChunk * grainSize; iKey < end; ++iKey) {
+        ++pCounts[(keys[iKey] >> shift) & (bucketCount - 1)];
+      }
+    });
+
+    /* Exclusive scan, bucket-major so that equal digits keep their order */
+    u64 offset = 0;
+    bool skipPass = false;
+    for (u32 iBucket = 0; iBucket < bucketCount && !skipPass; ++iBucket) {
+      u64 bucketSize = 0;
+      for (u64 iChunk = 0; iChunk < chunkCount; ++iChunk) {
+        u64 &chunkOffset = offsets[iChunk * bucketCount + iBucket];
+        u64 chunkCountInBucket = chunkOffset;
+        chunkOffset = offset;
+        offset += chunkCountInBucket;
+        bucketSize += chunkCountInBucket;
+      }
+      skipPass = bucketSize == count;
+    }
+    if (skipPass) {
+      continue;
+    }
+
+    parallelFor(threadPool, 0, chunkCount, 1, [&](u64 iChunk) {
+      u64 *pOffsets = offsets.data() + iChunk * bucketCount;
+      u64 end = std::min(count, (iChunk + 1) * grainSize);
+      for (u64 iKey = iChunk * grainSize; iKey < end; ++iKey) {
+        u64 destination = pOffsets[(keys[iKey] >> shift) & (bucketCount - 1)]++;
+        scratchKeys[destination] = keys[iKey];
+        scratchValues[destination] = values[iKey];
+      }
+    });
+    keys.swap(scratchKeys);
+    values.swap(scratchValues);
+  }
+}
+
+} /* namespace neko */
@@ -0,0 +1,81 @@
+#ifndef NEKO_RENDERER_CPU_RAY_SORT_HPP
+#define NEKO_RENDERER_CPU_RAY_SORT_HPP
+
+#include "math.hpp"
+
+namespace neko {
+
+class ThreadPool;
+
+/* Bits of a ray sort key: a 9-bit grid coordinate per axis, then the octant */
+inline constexpr u32 raySortCellBits = 9;
+inline constexpr u32 raySortKeyBits = 3 * raySortCellBits + 3;
+
+/**
+ * @brief Spreads the low 10 bits of {value} so that two zero bits separate
+ * consecutive ones.
+ */
+inline u32 expandBits3(u32 value) noexcept {
+  value &= 0x3ffu;
+  value = (value * 0x00010001u) & 0xff0000ffu;
+  value = (value * 0x00000101u) & 0x0f00f00fu;
+  value = (value * 0x00000011u) & 0xc30c30c3u;
+  value = (value * 0x00000005u) & 0x49249249u;
+  return value;
+}
+
+/**
+ * @brief Maps ray origins to a regular grid over the scene bounds and builds
+ * the keys that bin rays by direction octant, then by origin cell along a
+ * Morton curve. Rays with equal or close keys start near each other and head
+ * the same way, so they tend to visit the same BVH nodes.
+ */
+class RaySortKeyEncoder {
+public:
+  RaySortKeyEncoder() = default;
+
+  explicit RaySortKeyEncoder(const Aabb &bounds) noexcept {
+    constexpr auto cellCount = static_cast<f32>(1u << raySortCellBits);
+    Vec3 extent = bounds.extent();
+    mLower = bounds.lower;
+    mScale = {extent.x > 0.0f ? cellCount / extent.x : 0.0f,
+              extent.y > 0.0f ? cellCount / extent.y : 0.0f,
+              extent.z > 0.0f ? cellCount / extent.z : 0.0f};
+  }
+
+  u32 key(const Vec3 &origin, const Vec3 &direction) const noexcept {
+    u32 octant = (direction.x < 0.0f ? 4u : 0u) |
+                 (direction.y < 0.0f ? 2u : 0u) |
+                 (direction.z < 0.0f ? 1u : 0u);
+    return (octant << (3 * raySortCellBits)) |
+           (expandBits3(cell(origin.x, mLower.x, mScale.x)) << 2) |
+           (expandBits3(cell(origin.y, mLower.y, mScale.y)) << 1) |
+           expandBits3(cell(origin.z, mLower.z, mScale.z));
+  }
+
+private:
+  Vec3 mLower;
+  Vec3 mScale;
+
+  static u32 cell(f32 coordinate, f32 lower, f32 scale) noexcept {
+    constexpr auto maxCell = static_cast<f32>((1u << raySortCellBits) - 1);
+    return static_cast<u32>(
+        std::clamp((coordinate - lower) * scale, 0.0f, maxCell));
+  }
+};
+
+/**
+ * @brief Stable parallel LSD radix sort of {keys} with their {values}, 11 bits
+ * per pass over the low {keyBits} bits. Each chunk of the thread pool counts
+ * its digits, a prefix sum over the chunk histograms gives every chunk its
+ * output offsets, and the chunks scatter independently. Passes whose digit is
+ * the same for all keys are skipped. The scratch vectors are resized as
+ * needed and hold garbage afterwards.
+ */
+void radixSortPairs(ThreadPool &threadPool, std::vector<u32> &keys,
+                    std::vector<u32> &values, std::vector<u32> &scratchKeys,
+                    std::vector<u32> &scratchValues, u32 keyBits = 32);
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_RAY_SORT_HPP */
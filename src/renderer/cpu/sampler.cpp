@@ -0,0 +1,127 @@
+#include "sampler.hpp"
+
+#include "math.hpp"
+
+#include <cmath>
+
+namespace neko {
+
+/**
+ * @brief Void and cluster: the energy of a pixel is the sum of a toroidal
+ * Gaussian centered on every pixel of the pattern, so that the tightest
+ * cluster is the pattern pixel of highest energy and the largest void the
+ * empty pixel of lowest energy. A random pattern is first relaxed until moving
+ * its tightest cluster to the largest void changes nothing, then its pixels
+ * are ranked by removing the tightest clusters one after the other, and the
+ * empty pixels by filling the largest voids.
+ */
+static std::vector<u16> buildBlueNoiseRanks() {
+  constexpr u32 pixelCount = blueNoiseSize * blueNoiseSize;
+  constexpr f32 sigma = 1.5f;
+
+  /* Gaussian by toroidal offset, indexed like the pixels */
+  std::vector<f32> kernel(pixelCount);
+  for (u32 offsetY = 0; offsetY < blueNoiseSize; ++offsetY) {
+    for (u32 offsetX = 0; offsetX < blueNoiseSize; ++offsetX) {
+      auto dx = static_cast<f32>(std::min(offsetX, blueNoiseSize - offsetX));
+      auto dy = static_cast<f32>(std::min(offsetY, blueNoiseSize - offsetY));
+      kernel[offsetY * blueNoiseSize + offsetX] =
+          std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+    }
+  }
+  std::vector<u8> pattern(pixelCount, 0);
+  std::vector<f32> energies(pixelCount, 0.0f);
+  auto toggle = [&](u32 iPixel, bool set) {
+    pattern[iPixel] = set ? 1 : 0;
+    f32 sign = set ? 1.0f : -1.0f;
+    u32 pixelX = iPixel % blueNoiseSize;
+    u32 pixelY = iPixel / blueNoiseSize;
+    for (u32 y = 0; y < blueNoiseSize; ++y) {
+      u32 offsetY = (y - pixelY) & (blueNoiseSize - 1);
+      for (u32 x = 0; x < blueNoiseSize; ++x) {
+        u32 offsetX = (x - pixelX) & (blueNoiseSize - 1);
+        energies[y * blueNoiseSize + x] +=
+            sign * kernel[offsetY * blueNoiseSize + offsetX];
+      }
+    }
+  };
+  auto tightestCluster = [&]() {
+    u32 best = 0;
+    f32 bestEnergy = -infinity;
+    for (u32 iPixel = 0; iPixel < pixelCount; ++iPixel) {
+      if (pattern[iPixel] != 0 && energies[iPixel] > bestEnergy) {
+        best = iPixel;
+        bestEnergy = energies[iPixel];
+      }
+    }
+    return best;
+  };
+  auto largestVoid = [&]() {
+    u32 best = 0;
+    f32 bestEnergy = infinity;
+    for (u32 iPixel = 0; iPixel < pixelCount; ++iPixel) {
+      if (pattern[iPixel] == 0 && energies[iPixel] < bestEnergy) {
+        best = iPixel;
+        bestEnergy = energies[iPixel];
+      }
+    }
+    return best;
+  };
+
+  constexpr u32 initialCount = pixelCount / 10;
+  Rng rng{pixelCount};
+  for (u32 setCount = 0; setCount < initialCount;) {
+    u32 iPixel = rng.nextU32() % pixelCount;
+    if (pattern[iPixel] == 0) {
+      toggle(iPixel, true);
+      ++setCount;
+    }
+  }
+  for (u32 iteration = 0; iteration < pixelCount; ++iteration) {
+    u32 cluster = tightestCluster();
+    toggle(cluster, false);
+    u32 emptiest = largestVoid();
+    toggle(emptiest, true);
+    if (emptiest == cluster) {
+      break;
+    }
+  }
+
+  std::vector<u16> ranks(pixelCount);
+  std::vector<u8> initialPattern = pattern;
+  std::vector<f32> initialEnergies = energies;
+  for (u32 rank = initialCount; rank-- > 0;) {
+    u32 cluster = tightestCluster();
+    toggle(cluster, false);
+    ranks[cluster] = static_cast<u16>(rank);
+  }
+  pattern = std::move(initialPattern);
+  energies = std::move(initialEnergies);
+  /* The energy is linear in the pattern, so the tightest cluster of empty
+  pixels past half coverage is also the largest void */
+  for (u32 rank = initialCount; rank < pixelCount; ++rank) {
+    u32 emptiest = largestVoid();
+    toggle(emptiest, true);
+    ranks[emptiest] = static_cast<u16>(rank);
+  }
+  return ranks;
+}
+
+const std::vector<u16> &blueNoiseRanks() {
+  static const std::vector<u16> ranks = buildBlueNoiseRanks();
+  return ranks;
+}
+
+const char *samplerTypeName(SamplerType type) {
+  switch (type) {
+  case SamplerType::pcg:
+    return "pcg";
+  case SamplerType::sobol:
+    return "sobol";
+  case SamplerType::blueNoise:
+    return "blue noise";
+  }
+  return "unknown";
+}
+
+} /* namespace neko */
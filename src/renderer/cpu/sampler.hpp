@@ -0,0 +1,184 @@
+#ifndef NEKO_RENDERER_CPU_SAMPLER_HPP
+#define NEKO_RENDERER_CPU_SAMPLER_HPP
+
+#include "random.hpp"
+#include "simd.hpp"
+
+#include <vector>
+
+namespace neko {
+
+class ThreadPool;
+
+/* Sobol dimensions are used in blocks of 4, each with its own shuffle of the
+sample indices ("padding"), so that a path may use any number of them */
+inline constexpr u32 sobolBlockSize = 4;
+
+/**
+ * @brief Generator matrices of the first {sobolBlockSize} Sobol dimensions,
+ * from the direction numbers of Joe and Kuo. Column {k} is added (xor) to the
+ * point for bit {k} of the index, the first digit being the most significant
+ * bit.
+ */
+struct SobolMatrices {
+  u32 columns[sobolBlockSize][32];
+};
+
+inline constexpr SobolMatrices makeSobolMatrices() noexcept {
+  /* Degree and inner coefficients of the primitive polynomial, then the
+  initial direction numbers, of dimensions 1 to 3. Dimension 0 is the van der
+  Corput sequence */
+  constexpr u32 degrees[sobolBlockSize] = {0, 1, 2, 3};
+  constexpr u32 coefficients[sobolBlockSize] = {0, 0, 1, 1};
+  constexpr u32 initialNumbers[sobolBlockSize][3] = {
+      {}, {1}, {1, 3}, {1, 3, 1}};
+  SobolMatrices matrices{};
+  for (u32 bit = 0; bit < 32; ++bit) {
+    matrices.columns[0][bit] = 1u << (31 - bit);
+  }
+  for (u32 dimension = 1; dimension < sobolBlockSize; ++dimension) {
+    u32 degree = degrees[dimension];
+    u32 *pColumns = matrices.columns[dimension];
+    for (u32 bit = 0; bit < 32; ++bit) {
+      if (bit < degree) {
+        pColumns[bit] = initialNumbers[dimension][bit] << (31 - bit);
+        continue;
+      }
+      u32 column = pColumns[bit - degree] ^ (pColumns[bit - degree] >> degree);
+      for (u32 term = 1; term < degree; ++term) {
+        if ((coefficients[dimension] >> (degree - 1 - term)) & 1) {
+          column ^= pColumns[bit - term];
+        }
+      }
+      pColumns[bit] = column;
+    }
+  }
+  return matrices;
+}
+
+inline constexpr SobolMatrices sobolMatrices = makeSobolMatrices();
+
+/* Side of the tileable blue noise mask */
+inline constexpr u32 blueNoiseSizeBits = 6;
+inline constexpr u32 blueNoiseSize = 1u << blueNoiseSizeBits;
+
+/**
+ * @brief Ranks of the pixels of a {blueNoiseSize}^2 tileable blue noise mask,
+ * row by row: the pixels ranked below any threshold are evenly spread. Built
+ * by void and cluster (Ulichney) the first time it is needed, then shared.
+ */
+const std::vector<u16> &blueNoiseRanks();
+
+/* Arguments of the {Sampler} kernels */
+struct SamplerState {
+  SamplerType type = SamplerType::pcg;
+  u32 seed = 0;
+  const u16 *pBlueNoiseRanks = nullptr;
+};
+
+/**
+ * @brief Sample values indexed by pixel, sample and dimension, computed
+ * directly from the index without any state or allocation, so that any pixel
+ * or dimension can be generated in any order. Sobol values are Owen-scrambled
+ * with the hash-based scheme of Burley ("Practical Hash-based Owen
+ * Scrambling"): each pixel and block of dimensions shuffles the sample
+ * indices, each dimension scrambles the digits. Blue noise values use the
+ * same Sobol points in every pixel, offset by a blue noise mask shifted per
+ * dimension (Georgiev and Fajardo, "Blue-noise Dithered Sampling"). PCG
+ * values are hashed independently.
+ */
+class Sampler {
+public:
+  /* Kernel filling the values of {count} consecutive pixels of a row */
+  typedef void (*SampleRowFunc_T)(const SamplerState &state, u32 x, u32 y,
+                                  u32 count, u32 sampleIndex, u32 dimension,
+                                  f32 *pValues);
+
+  /**
+   * @brief Generates rows of pixels with the kernels of {isa}, lowered to
+   * the instruction set the kernels were built for.
+   */
+  Sampler(SamplerType type, SimdIsa isa, u32 seed = 0);
+
+  SamplerType type() const noexcept { return mState.type; }
+
+  SimdIsa isa() const noexcept { return mIsa; }
+
+  /* Values of the dimensions of block {block}, in [0, 1) */
+  void sampleBlock(u32 x, u32 y, u32 sampleIndex, u32 block,
+                   f32 (&values)[sobolBlockSize]) const noexcept;
+
+  /* Value of dimension {dimension} alone, in [0, 1) */
+  f32 sample(u32 x, u32 y, u32 sampleIndex, u32 dimension) const noexcept;
+
+  /**
+   * @brief Values of dimension {dimension} for the pixels [x, x + count) of
+   * row {y}, equal to those of {sample}.
+   */
+  void sampleRow(u32 x, u32 y, u32 count, u32 sampleIndex, u32 dimension,
+                 f32 *pValues) const noexcept {
+    mSampleRow(mState, x, y, count, sampleIndex, dimension, pValues);
+  }
+
+private:
+  SamplerState mState;
+  SimdIsa mIsa;
+  SampleRowFunc_T mSampleRow;
+};
+
+/**
+ * @brief Kernel generating rows for {isa}. Lowers {isa} to the instruction
+ * set of the returned kernel.
+ */
+Sampler::SampleRowFunc_T selectSampleRowKernel(SimdIsa &isa);
+
+/**
+ * @brief Sample values of one pixel sample, drawn by dimension. Without a
+ * {Sampler}, or with a PCG one, the dimensions are ignored and each draw takes
+ * the next number of {rng}, which carries on from one sample to the next as
+ * the path tracers always did. The last block drawn is cached, so that the
+ * dimensions of a block cost one evaluation.
+ */
+class SampleStream {
+public:
+  explicit SampleStream(const Rng &rng) noexcept : mRng{rng} {}
+
+  SampleStream(const Sampler *pSampler, u32 x, u32 y, const Rng &rng) noexcept
+      : mpSampler{pSampler && pSampler->type() != SamplerType::pcg ? pSampler
+                                                                   : nullptr},
+        mX{x}, mY{y}, mRng{rng} {}
+
+  void startSample(u32 sampleIndex) noexcept {
+    mSampleIndex = sampleIndex;
+    mCachedBlock = invalidBlock;
+  }
+
+  f32 get(u32 dimension) noexcept {
+    if (!mpSampler) {
+      return mRng.nextF32();
+    }
+    u32 block = dimension / sobolBlockSize;
+    if (block != mCachedBlock) {
+      mpSampler->sampleBlock(mX, mY, mSampleIndex, block, mCachedValues);
+      mCachedBlock = block;
+    }
+    return mCachedValues[dimension % sobolBlockSize];
+  }
+
+private:
+  static constexpr u32 invalidBlock = ~0u;
+
+  const Sampler *mpSampler = nullptr;
+  u32 mX = 0;
+  u32 mY = 0;
+  u32 mSampleIndex = 0;
+  u32 mCachedBlock = invalidBlock;
+  f32 mCachedValues[sobolBlockSize] = {};
+  Rng mRng;
+};
+
+const char *samplerTypeName(SamplerType type);
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_SAMPLER_HPP */
@@ -0,0 +1,66 @@
+#include "sampler.hpp"
+#include "simd_lanes.hpp"
+
+namespace neko {
+
+namespace scalar_kernels {
+
+#include "sampler_kernels.inl"
+
+} /* namespace scalar_kernels */
+
+#if NEKO_SIMD_X86
+namespace sse_kernels {
+
+#include "sampler_kernels.inl"
+
+} /* namespace sse_kernels */
+
+NEKO_BEGIN_TARGET_AVX2
+namespace avx2_kernels {
+
+#include "sampler_kernels.inl"
+
+} /* namespace avx2_kernels */
+NEKO_END_TARGET_AVX2
+#endif /* NEKO_SIMD_X86 */
+
+Sampler::Sampler(SamplerType type, SimdIsa isa, u32 seed)
+    : mState{type, seed,
+             type == SamplerType::blueNoise ? blueNoiseRanks().data()
+                                            : nullptr},
+      mIsa{isa}, mSampleRow{selectSampleRowKernel(mIsa)} {}
+
+void Sampler::sampleBlock(u32 x, u32 y, u32 sampleIndex, u32 block,
+                          f32 (&values)[sobolBlockSize]) const noexcept {
+  using namespace scalar_kernels;
+  u32 blockSeed = blockSeedLanes(mState, x, y, block);
+  u32 shuffledIndex = shuffledIndicesLanes(mState, blockSeed, sampleIndex);
+  for (u32 component = 0; component < sobolBlockSize; ++component) {
+    values[component] = L::toUnitFloat(dimensionBitsLanes(
+        mState, x, y, blockSeed, shuffledIndex, block, component));
+  }
+}
+
+f32 Sampler::sample(u32 x, u32 y, u32 sampleIndex,
+                    u32 dimension) const noexcept {
+  return scalar_kernels::sampleDimensionLanes(mState, x, y, sampleIndex,
+                                              dimension);
+}
+
+Sampler::SampleRowFunc_T selectSampleRowKernel(SimdIsa &isa) {
+#if NEKO_SIMD_X86
+  if (isa >= SimdIsa::avx2) {
+    isa = SimdIsa::avx2;
+    return &avx2_kernels::sampleRow;
+  }
+  if (isa >= SimdIsa::sse) {
+    isa = SimdIsa::sse;
+    return &sse_kernels::sampleRow;
+  }
+#endif /* NEKO_SIMD_X86 */
+  isa = SimdIsa::scalar;
+  return &scalar_kernels::sampleRow;
+}
+
+} /* namespace neko */
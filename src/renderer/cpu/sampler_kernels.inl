@@ -0,0 +1,172 @@
+/* Sampler kernels, included once per instruction set inside a namespace that
+provides {Lanes}. Every lane generates the value of one pixel, with integer
+arithmetic only, so that all instruction sets agree bit for bit */
+
+typedef Lanes L;
+typedef L::Float_T Float_T;
+typedef L::Uint_T Uint_T;
+
+/* Wellons' lowbias32 integer hash */
+static Uint_T hashLanes(Uint_T values) noexcept {
+  values = L::xorUint(values, L::shiftRight<16>(values));
+  values = L::mulUint(values, L::broadcastUint(0x7feb352du));
+  values = L::xorUint(values, L::shiftRight<15>(values));
+  values = L::mulUint(values, L::broadcastUint(0x846ca68bu));
+  return L::xorUint(values, L::shiftRight<16>(values));
+}
+
+static Uint_T hashCombineLanes(Uint_T seeds, Uint_T values) noexcept {
+  return hashLanes(L::xorUint(seeds, hashLanes(values)));
+}
+
+/* Swaps the bits of {mask} with those {Shift} places above */
+template <int Shift>
+static Uint_T swapBitsLanes(Uint_T values, u32 mask) noexcept {
+  Uint_T masks = L::broadcastUint(mask);
+  return L::orUint(L::andUint(L::shiftRight<Shift>(values), masks),
+                   L::shiftLeft<Shift>(L::andUint(values, masks)));
+}
+
+static Uint_T reverseBitsLanes(Uint_T values) noexcept {
+  values = swapBitsLanes<16>(values, 0x0000ffffu);
+  values = swapBitsLanes<8>(values, 0x00ff00ffu);
+  values = swapBitsLanes<4>(values, 0x0f0f0f0fu);
+  values = swapBitsLanes<2>(values, 0x33333333u);
+  return swapBitsLanes<1>(values, 0x55555555u);
+}
+
+/* Permutation in which every bit only depends on the bits below it (Laine and
+Karras, with Burley's constants) */
+static Uint_T laineKarrasPermutationLanes(Uint_T values,
+                                          Uint_T seeds) noexcept {
+  values = L::addUint(values, seeds);
+  values = L::xorUint(values,
+                      L::mulUint(values, L::broadcastUint(0x6c50b47cu)));
+  values = L::xorUint(values,
+                      L::mulUint(values, L::broadcastUint(0xb82f1e52u)));
+  values = L::xorUint(values,
+                      L::mulUint(values, L::broadcastUint(0xc7afe638u)));
+  return L::xorUint(values,
+                    L::mulUint(values, L::broadcastUint(0x8d22f6e6u)));
+}
+
+/* Owen scrambling of binary fractions: every bit is flipped depending on the
+bits above it */
+static Uint_T nestedUniformScrambleLanes(Uint_T values,
+                                         Uint_T seeds) noexcept {
+  return reverseBitsLanes(
+      laineKarrasPermutationLanes(reverseBitsLanes(values), seeds));
+}
+
+static Uint_T sobolLanes(Uint_T indices, const u32 (&columns)[32]) noexcept {
+  Uint_T one = L::broadcastUint(1);
+  Uint_T zero = L::broadcastUint(0);
+  Uint_T result = zero;
+  for (u32 bit = 0; bit < 32; ++bit) {
+    Uint_T bitMasks = L::subUint(zero, L::andUint(indices, one));
+    result = L::xorUint(result,
+                        L::andUint(bitMasks, L::broadcastUint(columns[bit])));
+    indices = L::shiftRight<1>(indices);
+  }
+  return result;
+}
+
+/* Seed shared by the dimensions of block {block}. Blue noise uses the same
+points in every pixel */
+static Uint_T blockSeedLanes(const SamplerState &state, Uint_T xs, Uint_T ys,
+                             u32 block) noexcept {
+  Uint_T seeds = L::broadcastUint(state.seed);
+  if (state.type != SamplerType::blueNoise) {
+    seeds = hashCombineLanes(hashCombineLanes(seeds, ys), xs);
+  }
+  return hashCombineLanes(seeds, L::broadcastUint(block));
+}
+
+/* Offset of dimension {dimension} by the blue noise mask, shifted per
+dimension so that the dimensions are not correlated */
+static Uint_T blueNoiseOffsetLanes(const SamplerState &state, Uint_T xs,
+                                   Uint_T ys, u32 dimension) noexcept {
+  constexpr u32 rankBits = 2 * blueNoiseSizeBits;
+  Uint_T shifts = hashCombineLanes(L::broadcastUint(state.seed),
+                                   L::broadcastUint(dimension));
+  Uint_T sizeMasks = L::broadcastUint(blueNoiseSize - 1);
+  Uint_T maskXs = L::andUint(L::addUint(xs, shifts), sizeMasks);
+  Uint_T maskYs = L::andUint(
+      L::addUint(ys, L::shiftRight<blueNoiseSizeBits>(shifts)), sizeMasks);
+  u32 maskIndices[L::width];
+  L::storeUint(maskIndices,
+               L::orUint(L::shiftLeft<blueNoiseSizeBits>(maskYs), maskXs));
+  u32 offsets[L::width];
+  for (u32 lane = 0; lane < L::width; ++lane) {
+    /* Centered in the interval of the rank */
+    offsets[lane] = (u32{state.pBlueNoiseRanks[maskIndices[lane]]}
+                     << (32 - rankBits)) |
+                    (1u << (31 - rankBits));
+  }
+  return L::loadUint(offsets);
+}
+
+/* Bits of the value of dimension {component} of the block of {blockSeeds} */
+static Uint_T dimensionBitsLanes(const SamplerState &state, Uint_T xs,
+                                 Uint_T ys, Uint_T blockSeeds,
+                                 Uint_T sampleIndices, u32 block,
+                                 u32 component) noexcept {
+  Uint_T componentSeeds =
+      hashCombineLanes(blockSeeds, L::broadcastUint(component));
+  if (state.type == SamplerType::pcg) {
+    return hashCombineLanes(componentSeeds, sampleIndices);
+  }
+  Uint_T bits = nestedUniformScrambleLanes(
+      sobolLanes(sampleIndices, sobolMatrices.columns[component]),
+      componentSeeds);
+  if (state.type == SamplerType::blueNoise) {
+    bits = L::addUint(bits, blueNoiseOffsetLanes(
+                                state, xs, ys,
+                                block * sobolBlockSize + component));
+  }
+  return bits;
+}
+
+/* Sample indices of the block of {blockSeeds}, shuffled by an Owen scramble
+that keeps every power of two prefix a (0, m, 2)-net */
+static Uint_T shuffledIndicesLanes(const SamplerState &state,
+                                   Uint_T blockSeeds,
+                                   u32 sampleIndex) noexcept {
+  Uint_T sampleIndices = L::broadcastUint(sampleIndex);
+  if (state.type == SamplerType::pcg) {
+    return sampleIndices;
+  }
+  return nestedUniformScrambleLanes(
+      sampleIndices,
+      hashCombineLanes(blockSeeds, L::broadcastUint(sobolBlockSize)));
+}
+
+static Float_T sampleDimensionLanes(const SamplerState &state, Uint_T xs,
+                                    Uint_T ys, u32 sampleIndex,
+                                    u32 dimension) noexcept {
+  u32 block = dimension / sobolBlockSize;
+  Uint_T blockSeeds = blockSeedLanes(state, xs, ys, block);
+  Uint_T sampleIndices = shuffledIndicesLanes(state, blockSeeds, sampleIndex);
+  return L::toUnitFloat(dimensionBitsLanes(state, xs, ys, blockSeeds,
+                                           sampleIndices, block,
+                                           dimension % sobolBlockSize));
+}
+
+void sampleRow(const SamplerState &state, u32 x, u32 y, u32 count,
+               u32 sampleIndex, u32 dimension, f32 *pValues) {
+  Uint_T ys = L::broadcastUint(y);
+  u32 iPixel = 0;
+  for (; iPixel + L::width <= count; iPixel += L::width) {
+    Uint_T xs = L::addUint(L::broadcastUint(x + iPixel), L::laneIndices());
+    L::storeUnaligned(pValues + iPixel,
+                      sampleDimensionLanes(state, xs, ys, sampleIndex,
+                                           dimension));
+  }
+  if (iPixel < count) {
+    Uint_T xs = L::addUint(L::broadcastUint(x + iPixel), L::laneIndices());
+    alignas(32) f32 values[L::width];
+    L::store(values,
+             sampleDimensionLanes(state, xs, ys, sampleIndex, dimension));
+    std::copy(values, values + (count - iPixel), pValues + iPixel);
+  }
+}
@@ -0,0 +1,40 @@
+#include "sampling.hpp"
+
+namespace neko {
+
+bool sampleLight(const Scene &scene, const Vec3 &position, const Vec3 &normal,
+                 SampleStream &samples, u32 depth, LightSample &sample) {
+  u32 iEmitter;
+  f32 pmf;
+  if (!scene.lightSampler().sample(
+          position, normal,
+          samples.get(bounceDimension(depth, BounceDimension::lightChoice)),
+          iEmitter, pmf)) {
+    return false;
+  }
+  u32 lightIndex = scene.emitters()[iEmitter];
+  const Triangle &light = scene.triangles()[lightIndex];
+
+  f32 u = samples.get(bounceDimension(depth, BounceDimension::lightPointU));
+  f32 v = samples.get(bounceDimension(depth, BounceDimension::lightPointV));
+  Vec3 toLight = light.samplePoint(u, v) - position;
+  f32 distanceSquared = dot(toLight, toLight);
+  f32 distance = std::sqrt(distanceSquared);
+  Vec3 direction = toLight / distance;
+  Vec3 lightNormal = light.scaledNormal();
+  f32 doubleArea = length(lightNormal);
+  f32 cosSurface = dot(normal, direction);
+  f32 cosLight = std::abs(dot(lightNormal, direction)) / doubleArea;
+  if (cosSurface <= 0.0f || cosLight <= 0.0f) {
+    return false;
+  }
+
+  sample.shadowRay = {position, direction, distance * (1.0f - 1e-3f)};
+  /* Solid angle pdf of the sampled direction */
+  f32 pdf = distanceSquared * pmf / (cosLight * 0.5f * doubleArea);
+  sample.radiance =
+      scene.material(lightIndex).emission * (cosSurface / (pi * pdf));
+  return true;
+}
+
+} /* namespace neko */
@@ -0,0 +1,64 @@
+#ifndef NEKO_RENDERER_CPU_SAMPLING_HPP
+#define NEKO_RENDERER_CPU_SAMPLING_HPP
+
+#include "sampler.hpp"
+#include "scene.hpp"
+
+namespace neko {
+
+/* Paths shorter than this are never terminated by Russian roulette */
+inline constexpr u32 minRouletteDepth = 3;
+
+/* Sampler dimensions of a path: the camera takes the first block, every
+bounce the next two. Pairs sampled together lead their block, where Sobol
+points are best stratified */
+inline constexpr u32 cameraDimensionU = 0;
+inline constexpr u32 cameraDimensionV = 1;
+
+enum class BounceDimension : u32 {
+  lightPointU,
+  lightPointV,
+  lightChoice,
+  roulette,
+  bsdfU,
+  bsdfV,
+  bsdfLobe,
+};
+
+inline u32 bounceDimension(u32 depth, BounceDimension dimension) noexcept {
+  return sobolBlockSize * (1 + 2 * depth) + static_cast<u32>(dimension);
+}
+
+inline Vec3 sampleCosineHemisphere(const Vec3 &normal, f32 u, f32 v) {
+  f32 radius = std::sqrt(u);
+  f32 phi = 2.0f * pi * v;
+  Vec3 tangent;
+  Vec3 bitangent;
+  buildBasis(normal, tangent, bitangent);
+  return normalize(tangent * (radius * std::cos(phi)) +
+                   bitangent * (radius * std::sin(phi)) +
+                   normal * std::sqrt(std::max(0.0f, 1.0f - u)));
+}
+
+/**
+ * @brief Next event estimation sample: a shadow ray towards a point on an
+ * emitter, and the radiance it brings if nothing blocks it.
+ */
+struct LightSample {
+  Ray shadowRay;
+  Vec3 radiance;
+};
+
+/**
+ * @brief Samples the direct light reflected towards the viewer by a white
+ * Lambertian surface at {position}, from one emitter picked by the light
+ * sampler of {scene}, with the dimensions of bounce {depth} of {samples}.
+ * Returns false if the sample cannot contribute, in which case no shadow ray
+ * is needed.
+ */
+bool sampleLight(const Scene &scene, const Vec3 &position, const Vec3 &normal,
+                 SampleStream &samples, u32 depth, LightSample &sample);
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_SAMPLING_HPP */
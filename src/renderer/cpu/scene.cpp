@@ -0,0 +1,411 @@
+#include "scene.hpp"
+
+#include "parallel.hpp"
+
+#include <bit>
+
+namespace neko {
+
+Camera::Camera(const Vec3 &position, const Vec3 &target, const Vec3 &up,
+               f32 verticalFov, f32 aspectRatio)
+    : mPosition{position} {
+  f32 halfHeight = std::tan(verticalFov * pi / 360.0f);
+  f32 halfWidth = halfHeight * aspectRatio;
+  Vec3 forward = normalize(target - position);
+  Vec3 right = normalize(cross(forward, up));
+  Vec3 cameraUp = cross(right, forward);
+  mTopLeft = position + forward - right * halfWidth + cameraUp * halfHeight;
+  mHorizontal = right * (2.0f * halfWidth);
+  mVertical = cameraUp * (2.0f * halfHeight);
+}
+
+u32 Scene::addMaterial(const Material &material) {
+  mMaterials.push_back(material);
+  return static_cast<u32>(mMaterials.size() - 1);
+}
+
+void Scene::addTriangle(const Triangle &triangle, u32 materialIndex) {
+  if (materialIndex >= mMaterials.size()) {
+    throw std::runtime_error("Triangle refers to an unknown material.");
+  }
+  if (mMaterials[materialIndex].emissive()) {
+    mEmitters.push_back(static_cast<u32>(mTriangles.size()));
+  }
+  mTriangles.push_back(triangle);
+  mMaterialIndices.push_back(materialIndex);
+}
+
+void Scene::addQuad(const Vec3 &p0, const Vec3 &p1, const Vec3 &p2,
+                    const Vec3 &p3, u32 materialIndex) {
+  addTriangle({p0, p1, p2}, materialIndex);
+  addTriangle({p0, p2, p3}, materialIndex);
+}
+
+void Scene::addSphere(const Vec3 &center, f32 radius, u32 segmentCount,
+                      u32 materialIndex) {
+  Mesh sphere = Mesh::sphere(segmentCount);
+  for (const Triangle &triangle : sphere.triangles()) {
+    addTriangle({center + triangle.p0 * radius, center + triangle.p1 * radius,
+                 center + triangle.p2 * radius},
+                materialIndex);
+  }
+}
+
+u32 Scene::addInstance(u32 meshIndex, const Transform &objectToWorld,
+                       u32 materialIndex) {
+  if (materialIndex >= mMaterials.size()) {
+    throw std::runtime_error("Instance refers to an unknown material.");
+  }
+  if (mMaterials[materialIndex].emissive()) {
+    throw std::runtime_error("Emissive instances are not supported.");
+  }
+  return mInstances.addInstance(meshIndex, objectToWorld, materialIndex);
+}
+
+Vec3 Scene::normal(const Hit &hit) const noexcept {
+  if (hit.instanceIndex == invalidIndex) {
+    return normalize(mTriangles[hit.triangleIndex].scaledNormal());
+  }
+  const MeshInstance &instance = mInstances.instances()[hit.instanceIndex];
+  const Triangle &triangle =
+      mInstances.mesh(instance.meshIndex).triangles()[hit.triangleIndex];
+  return normalize(instance.normalToWorld(triangle.scaledNormal()));
+}
+
+Aabb Scene::bounds() const noexcept {
+  Aabb box = mInstances.bounds();
+  for (const auto &triangle : mTriangles) {
+    box.extend(triangle.bounds());
+  }
+  return box;
+}
+
+LightBuildStats Scene::buildLights(ThreadPool &threadPool,
+                                   LightSamplingMode mode) {
+  NEKO_PROFILE_FUNCTION();
+  std::vector<Vec3> emissions(mEmitters.size());
+  for (u64 iEmitter = 0; iEmitter < mEmitters.size(); ++iEmitter) {
+    emissions[iEmitter] = material(mEmitters[iEmitter]).emission;
+  }
+  return mLightSampler.build(threadPool, mode, mTriangles, mEmitters,
+                             emissions);
+}
+
+BvhBuildStats Scene::buildBvh(ThreadPool &threadPool,
+                              const BvhBuildOptions &options, u32 width,
+                              SimdIsa isa, bool compressed) {
+  NEKO_PROFILE_FUNCTION();
+  std::vector<Aabb> triangleBounds(mTriangles.size());
+  parallelFor(threadPool, 0, mTriangles.size(), 0, [&](u64 iTriangle) {
+    triangleBounds[iTriangle] = mTriangles[iTriangle].bounds();
+  });
+  BvhBuildStats stats = mBvh.build(threadPool, triangleBounds, options);
+  mSimdIsa = isa;
+  mWideBvh = {};
+  mCompressedBvh = {};
+  if (compressed) {
+    ScopedTimer timer{TimeUnit::milliseconds};
+    mCompressedBvh.build(mBvh, mTriangles, isa);
+    stats.buildTime += timer.now();
+    stats.wideNodeCount = static_cast<u32>(mCompressedBvh.nodes().size());
+  } else if (width != 2) {
+    ScopedTimer timer{TimeUnit::milliseconds};
+    mWideBvh.build(mBvh, mTriangles, width, isa);
+    stats.buildTime += timer.now();
+    stats.wideNodeCount = mWideBvh.nodeCount();
+  }
+  return stats;
+}
+
+bool Scene::intersect(Ray &ray, Hit &hit,
+                      TraversalStats &stats) const noexcept {
+  bool found = intersectTriangles(ray, hit, stats);
+  return intersectInstances(ray, hit, stats) || found;
+}
+
+bool Scene::intersectTriangles(Ray &ray, Hit &hit,
+                               TraversalStats &stats) const noexcept {
+  if (!mCompressedBvh.empty()) {
+    return mCompressedBvh.intersect(ray, hit, stats);
+  }
+  if (!mWideBvh.empty()) {
+    return mWideBvh.intersect(ray, hit, stats);
+  }
+  if (!mBvh.empty()) {
+    return mBvh.traverse(
+        ray,
+        [this, &hit](u32 triangleIndex, Ray &primitiveRay) {
+          return intersectTriangle(mTriangles[triangleIndex], triangleIndex,
+                                   primitiveRay, hit);
+        },
+        stats);
+  }
+  ++stats.rayCount;
+  bool found = false;
+  for (u64 iTriangle = 0; iTriangle < mTriangles.size(); ++iTriangle) {
+    found |= intersectTriangle(mTriangles[iTriangle],
+                               static_cast<u32>(iTriangle), ray, hit);
+  }
+  return found;
+}
+
+/**
+ * @brief Continues {ray} through the instances. The ray was already counted
+ * by {intersectTriangles}, only the visited nodes are added to {stats}.
+ */
+bool Scene::intersectInstances(Ray &ray, Hit &hit,
+                               TraversalStats &stats) const noexcept {
+  if (mInstances.empty()) {
+    return false;
+  }
+  TraversalStats instanceStats;
+  bool found = mInstances.intersect(ray, hit, instanceStats);
+  stats.visitedNodeCount += instanceStats.visitedNodeCount;
+  return found;
+}
+
+bool Scene::occluded(const Ray &ray, TraversalStats &stats) const noexcept {
+  u32 triangleIndex;
+  u32 instanceIndex;
+  return occludedTriangles(ray, triangleIndex, stats) ||
+         occludedInstances(ray, instanceIndex, triangleIndex, stats);
+}
+
+bool Scene::occluded(const Ray &ray, OcclusionCache &cache,
+                     TraversalStats &stats) const noexcept {
+  ++cache.queryCount;
+  if (occludedByCache(ray, cache)) {
+    ++cache.hitCount;
+    ++stats.rayCount;
+    return true;
+  }
+  /* An unoccluded ray clears the cache, so that lit regions do not pay for
+  the cached test */
+  u32 triangleIndex = invalidIndex;
+  u32 instanceIndex = invalidIndex;
+  bool found = occludedTriangles(ray, triangleIndex, stats) ||
+               occludedInstances(ray, instanceIndex, triangleIndex, stats);
+  cache.triangleIndex = found ? triangleIndex : invalidIndex;
+  cache.instanceIndex = instanceIndex;
+  return found;
+}
+
+bool Scene::occludedTriangles(const Ray &ray, u32 &occluderIndex,
+                              TraversalStats &stats) const noexcept {
+  if (!mCompressedBvh.empty()) {
+    return mCompressedBvh.occluded(ray, occluderIndex, stats);
+  }
+  if (!mWideBvh.empty()) {
+    return mWideBvh.occluded(ray, occluderIndex, stats);
+  }
+  if (!mBvh.empty()) {
+    return mBvh.traverseAny(
+        ray,
+        [&](u32 triangleIndex) {
+          if (!occludes(mTriangles[triangleIndex], ray)) {
+            return false;
+          }
+          occluderIndex = triangleIndex;
+          return true;
+        },
+        stats);
+  }
+  ++stats.rayCount;
+  for (u64 iTriangle = 0; iTriangle < mTriangles.size(); ++iTriangle) {
+    if (occludes(mTriangles[iTriangle], ray)) {
+      occluderIndex = static_cast<u32>(iTriangle);
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Only counts the visited nodes, as {intersectInstances} does */
+bool Scene::occludedInstances(const Ray &ray, u32 &instanceIndex,
+                              u32 &triangleIndex,
+                              TraversalStats &stats) const noexcept {
+  if (mInstances.empty()) {
+    return false;
+  }
+  TraversalStats instanceStats;
+  bool found =
+      mInstances.occluded(ray, instanceIndex, triangleIndex, instanceStats);
+  stats.visitedNodeCount += instanceStats.visitedNodeCount;
+  return found;
+}
+
+bool Scene::occludedByCache(const Ray &ray,
+                            const OcclusionCache &cache) const noexcept {
+  if (cache.triangleIndex == invalidIndex) {
+    return false;
+  }
+  if (cache.instanceIndex == invalidIndex) {
+    return occludes(mTriangles[cache.triangleIndex], ray);
+  }
+  const MeshInstance &instance = mInstances.instances()[cache.instanceIndex];
+  return occludes(
+      mInstances.mesh(instance.meshIndex).triangles()[cache.triangleIndex],
+      instance.rayToObject(ray));
+}
+
+u32 Scene::occluded8(u32 validMask, const RayPacket<8> &packet,
+                     OcclusionCache &cache, TraversalStats &stats) const {
+  cache.queryCount += static_cast<u64>(std::popcount(validMask));
+  u32 occludedMask = 0;
+  for (u32 mask = validMask; mask != 0; mask &= mask - 1) {
+    auto lane = static_cast<u32>(std::countr_zero(mask));
+    if (occludedByCache(packet.ray(lane), cache)) {
+      occludedMask |= 1u << lane;
+    }
+  }
+  auto cachedCount = static_cast<u64>(std::popcount(occludedMask));
+  cache.hitCount += cachedCount;
+  stats.rayCount += cachedCount;
+
+  u32 remainingMask = validMask & ~occludedMask;
+  /* Only the binary BVH has a packet kernel, the other layouts are traversed
+  lane by lane so that every layout answers as {occluded} does */
+  if (mBvh.empty() || !mWideBvh.empty() || !mCompressedBvh.empty()) {
+    for (u32 mask = remainingMask; mask != 0; mask &= mask - 1) {
+      auto lane = static_cast<u32>(std::countr_zero(mask));
+      u32 triangleIndex;
+      if (occludedTriangles(packet.ray(lane), triangleIndex, stats)) {
+        occludedMask |= 1u << lane;
+        cache.triangleIndex = triangleIndex;
+        cache.instanceIndex = invalidIndex;
+      }
+    }
+  } else if (remainingMask != 0) {
+    u32 triangleIndex = invalidIndex;
+    occludedMask |= occludedPacket(mSimdIsa, mBvh, mTriangles, remainingMask,
+                                   packet, triangleIndex, stats);
+    if (triangleIndex != invalidIndex) {
+      cache.triangleIndex = triangleIndex;
+      cache.instanceIndex = invalidIndex;
+    }
+  }
+  for (u32 mask = validMask & ~occludedMask; mask != 0; mask &= mask - 1) {
+    auto lane = static_cast<u32>(std::countr_zero(mask));
+    u32 instanceIndex;
+    u32 triangleIndex;
+    if (occludedInstances(packet.ray(lane), instanceIndex, triangleIndex,
+                          stats)) {
+      occludedMask |= 1u << lane;
+      cache.triangleIndex = triangleIndex;
+      cache.instanceIndex = instanceIndex;
+    }
+  }
+  return occludedMask;
+}
+
+/**
+ * @brief Runs {intersectRay(ray, hit)} on each lane of {packet} set in
+ * {validMask}.
+ */
+template <u32 Size, typename IntersectFunc>
+static u32 intersectLanes(u32 validMask, RayPacket<Size> &packet,
+                          HitPacket<Size> &hits,
+                          const IntersectFunc &intersectRay) {
+  u32 foundMask = 0;
+  for (u32 lane = 0; lane < Size; ++lane) {
+    if (((validMask >> lane) & 1) == 0) {
+      continue;
+    }
+    Ray ray = packet.ray(lane);
+    Hit hit = hits.hit(lane);
+    if (intersectRay(ray, hit)) {
+      foundMask |= 1u << lane;
+      packet.tMax[lane] = ray.tMax;
+      hits.setHit(lane, hit);
+    }
+  }
+  return foundMask;
+}
+
+u32 Scene::intersect8(u32 validMask, RayPacket<8> &packet, HitPacket<8> &hits,
+                      TraversalStats &stats) const {
+  u32 foundMask;
+  if (mBvh.empty()) {
+    foundMask =
+        intersectLanes(validMask, packet, hits, [&](Ray &ray, Hit &hit) {
+          return intersectTriangles(ray, hit, stats);
+        });
+  } else {
+    foundMask = intersectPacket(mSimdIsa, mBvh, mTriangles, validMask, packet,
+                                hits, stats);
+  }
+  return foundMask |
+         intersectLanes(validMask, packet, hits, [&](Ray &ray, Hit &hit) {
+           return intersectInstances(ray, hit, stats);
+         });
+}
+
+u32 Scene::intersect16(u32 validMask, RayPacket<16> &packet,
+                       HitPacket<16> &hits, TraversalStats &stats) const {
+  u32 foundMask;
+  if (mBvh.empty()) {
+    foundMask =
+        intersectLanes(validMask, packet, hits, [&](Ray &ray, Hit &hit) {
+          return intersectTriangles(ray, hit, stats);
+        });
+  } else {
+    foundMask = intersectPacket(mSimdIsa, mBvh, mTriangles, validMask, packet,
+                                hits, stats);
+  }
+  return foundMask |
+         intersectLanes(validMask, packet, hits, [&](Ray &ray, Hit &hit) {
+           return intersectInstances(ray, hit, stats);
+         });
+}
+
+void Scene::intersectStream(std::span<Ray> rays, std::span<Hit> hits,
+                            TraversalStats &stats) const {
+  if (mBvh.empty()) {
+    for (u64 iRay = 0; iRay < rays.size(); ++iRay) {
+      intersectTriangles(rays[iRay], hits[iRay], stats);
+    }
+  } else {
+    neko::intersectStream(mBvh, mTriangles, rays, hits, stats);
+  }
+  for (u64 iRay = 0; iRay < rays.size(); ++iRay) {
+    intersectInstances(rays[iRay], hits[iRay], stats);
+  }
+}
+
+Scene Scene::cornellBox(f32 aspectRatio, u32 sphereSegmentCount) {
+  Scene scene;
+  u32 white = scene.addMaterial({{0.73f, 0.73f, 0.73f}, {}});
+  u32 red = scene.addMaterial({{0.65f, 0.05f, 0.05f}, {}});
+  u32 green = scene.addMaterial({{0.12f, 0.45f, 0.15f}, {}});
+  u32 light = scene.addMaterial({{0.78f, 0.78f, 0.78f}, {17.0f, 12.0f, 4.0f}});
+
+  /* Box spanning [-1, 1] x [0, 2] x [-1, 1], open towards +z */
+  scene.addQuad({-1, 0, -1}, {1, 0, -1}, {1, 0, 1}, {-1, 0, 1}, white);
+  scene.addQuad({-1, 2, -1}, {-1, 2, 1}, {1, 2, 1}, {1, 2, -1}, white);
+  scene.addQuad({-1, 0, -1}, {-1, 2, -1}, {1, 2, -1}, {1, 0, -1}, white);
+  scene.addQuad({-1, 0, -1}, {-1, 0, 1}, {-1, 2, 1}, {-1, 2, -1}, red);
+  scene.addQuad({1, 0, -1}, {1, 2, -1}, {1, 2, 1}, {1, 0, 1}, green);
+  scene.addQuad({-0.25f, 1.99f, -0.25f}, {0.25f, 1.99f, -0.25f},
+                {0.25f, 1.99f, 0.25f}, {-0.25f, 1.99f, 0.25f}, light);
+
+  /* The spheres hold most of the triangles, so they belong to the scene BVH
+  where the wide, compressed and packet traversals apply */
+  scene.addSphere({-0.4f, 0.4f, -0.3f}, 0.4f, sphereSegmentCount, white);
+  scene.addSphere({0.45f, 0.3f, 0.35f}, 0.3f, sphereSegmentCount, white);
+
+  /* A row of pebbles along the back wall, instances of one coarse mesh */
+  u32 pebble =
+      scene.addMesh(Mesh::sphere(std::max(sphereSegmentCount / 4, 4u)));
+  for (u32 iPebble = 0; iPebble < 5; ++iPebble) {
+    f32 x = -0.6f + 0.3f * static_cast<f32>(iPebble);
+    scene.addInstance(pebble,
+                      Transform::translation({x, 0.06f, -0.85f}) *
+                          Transform::scaling({0.06f, 0.06f, 0.06f}),
+                      iPebble % 2 == 0 ? red : green);
+  }
+
+  scene.setCamera({{0, 1, 3.4f}, {0, 1, 0}, {0, 1, 0}, 40.0f, aspectRatio});
+  return scene;
+}
+
+} /* namespace neko */
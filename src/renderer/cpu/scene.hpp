@@ -0,0 +1,292 @@
+#ifndef NEKO_RENDERER_CPU_SCENE_HPP
+#define NEKO_RENDERER_CPU_SCENE_HPP
+
+#include "bvh.hpp"
+#include "compressed_bvh.hpp"
+#include "instance_bvh.hpp"
+#include "light_sampler.hpp"
+#include "ray_packet.hpp"
+#include "triangle.hpp"
+#include "wide_bvh.hpp"
+
+namespace neko {
+
+/* BSDF families, each shaded by its own batched kernel */
+enum class MaterialType : u8 {
+  /* Lambertian reflection */
+  diffuse,
+  /* Rough metal: GGX microfacets with Schlick Fresnel, {albedo} is the
+  reflectance at normal incidence */
+  conductor,
+  /* Smooth glass, reflecting or refracting by the exact Fresnel term */
+  dielectric,
+  /* Diffuse base under a GGX coat, blended towards a conductor by
+  {metallic} */
+  principled,
+};
+
+inline constexpr u32 materialTypeCount = 4;
+
+struct Material {
+  Vec3 albedo = {0.8f, 0.8f, 0.8f};
+  Vec3 emission = {};
+  MaterialType type = MaterialType::diffuse;
+  /* GGX roughness of conductors and principled materials, squared into the
+  distribution width */
+  f32 roughness = 0.5f;
+  /* Index of refraction of dielectrics, relative to the outside medium */
+  f32 ior = 1.5f;
+  f32 metallic = 0.0f;
+
+  bool emissive() const noexcept { return maxComponent(emission) > 0.0f; }
+
+  /* Whether the BSDF is a Dirac delta, which next event estimation cannot
+  sample */
+  bool specular() const noexcept { return type == MaterialType::dielectric; }
+};
+
+class Camera {
+public:
+  Camera() = default;
+
+  /**
+   * @brief Pinhole camera at {position} looking at {target}, with a vertical
+   * field of view of {verticalFov} degrees.
+   */
+  Camera(const Vec3 &position, const Vec3 &target, const Vec3 &up,
+         f32 verticalFov, f32 aspectRatio);
+
+  /**
+   * @brief Ray through the film position {(s, t)} in [0, 1]^2, {(0, 0)} being
+   * the top left corner.
+   */
+  Ray generateRay(f32 s, f32 t) const noexcept {
+    Vec3 direction = mTopLeft + mHorizontal * s - mVertical * t - mPosition;
+    return {mPosition, normalize(direction)};
+  }
+
+private:
+  Vec3 mPosition;
+  Vec3 mTopLeft;
+  Vec3 mHorizontal;
+  Vec3 mVertical;
+};
+
+/**
+ * @brief Last occluder found by the shadow rays of one tile. Neighbouring
+ * shadow rays tend to be blocked by the same triangle, so it is tested before
+ * traversing anything.
+ */
+struct OcclusionCache {
+  /* Scene triangle, or mesh triangle of {instanceIndex} */
+  u32 triangleIndex = invalidIndex;
+  u32 instanceIndex = invalidIndex;
+  u64 queryCount = 0;
+  /* Queries answered by the cached triangle */
+  u64 hitCount = 0;
+};
+
+/**
+ * @brief Triangle soup with one material per triangle, plus instances of
+ * shared meshes with one material per instance. Every surface is two-sided.
+ */
+class Scene {
+public:
+  Scene() = default;
+  Scene(const Scene &) = delete;
+  Scene(Scene &&) = default;
+  Scene &operator=(const Scene &) = delete;
+  Scene &operator=(Scene &&) = default;
+  ~Scene() = default;
+
+  u32 addMaterial(const Material &material);
+
+  void addTriangle(const Triangle &triangle, u32 materialIndex);
+
+  /**
+   * @brief Adds the planar quad {p0 p1 p2 p3} as two triangles.
+   */
+  void addQuad(const Vec3 &p0, const Vec3 &p1, const Vec3 &p2, const Vec3 &p3,
+               u32 materialIndex);
+
+  /**
+   * @brief Adds a UV sphere with {segmentCount} rings and twice as many
+   * slices.
+   */
+  void addSphere(const Vec3 &center, f32 radius, u32 segmentCount,
+                 u32 materialIndex);
+
+  u32 addMesh(Mesh mesh) { return mInstances.addMesh(std::move(mesh)); }
+
+  /**
+   * @brief Places mesh {meshIndex} with {objectToWorld}. Emitters cannot be
+   * instanced, since only scene triangles are sampled as lights.
+   */
+  u32 addInstance(u32 meshIndex, const Transform &objectToWorld,
+                  u32 materialIndex);
+
+  /* Moves instances and deforms meshes, the next {updateInstances} applies
+  the changes */
+  InstanceBvh &instances() noexcept { return mInstances; }
+
+  const InstanceBvh &instances() const noexcept { return mInstances; }
+
+  /**
+   * @brief Builds or refits the mesh BVHs and rebuilds the top-level BVH.
+   * Must be called after changing instances, typically once per frame.
+   */
+  InstanceUpdateStats updateInstances(ThreadPool &threadPool,
+                                      const BvhBuildOptions &options) {
+    return mInstances.update(threadPool, options);
+  }
+
+  void setCamera(const Camera &camera) noexcept { mCamera = camera; }
+
+  const Camera &camera() const noexcept { return mCamera; }
+
+  const std::vector<Triangle> &triangles() const noexcept {
+    return mTriangles;
+  }
+
+  const Material &material(u32 triangleIndex) const noexcept {
+    return mMaterials[mMaterialIndices[triangleIndex]];
+  }
+
+  u32 materialIndex(const Hit &hit) const noexcept {
+    return hit.instanceIndex == invalidIndex
+               ? mMaterialIndices[hit.triangleIndex]
+               : mInstances.instances()[hit.instanceIndex].materialIndex;
+  }
+
+  const Material &material(const Hit &hit) const noexcept {
+    return mMaterials[materialIndex(hit)];
+  }
+
+  const std::vector<Material> &materials() const noexcept {
+    return mMaterials;
+  }
+
+  /* World space unit normal of the hit triangle */
+  Vec3 normal(const Hit &hit) const noexcept;
+
+  /* Indices of the triangles with an emissive material */
+  const std::vector<u32> &emitters() const noexcept { return mEmitters; }
+
+  /**
+   * @brief Builds the light sampler of {mode} over the emitters. Must be
+   * called again after adding emitters, no light is sampled before.
+   */
+  LightBuildStats buildLights(ThreadPool &threadPool, LightSamplingMode mode);
+
+  /* Picks among {emitters} */
+  const LightSampler &lightSampler() const noexcept { return mLightSampler; }
+
+  Aabb bounds() const noexcept;
+
+  /**
+   * @brief Builds the BVH of the scene triangles. Must be called again after
+   * adding triangles. A {width} of 4 or 8 collapses the binary tree into a wide
+   * BVH for single rays, {compressed} into a {CompressedBvh} whatever the
+   * width. Single rays and packets are traversed with the kernels of {isa}.
+   */
+  BvhBuildStats buildBvh(ThreadPool &threadPool,
+                         const BvhBuildOptions &options, u32 width = 2,
+                         SimdIsa isa = SimdIsa::scalar,
+                         bool compressed = false);
+
+  const Bvh &bvh() const noexcept { return mBvh; }
+
+  const WideBvh &wideBvh() const noexcept { return mWideBvh; }
+
+  const CompressedBvh &compressedBvh() const noexcept {
+    return mCompressedBvh;
+  }
+
+  /**
+   * @brief Finds the closest hit along {ray}, among the scene triangles and
+   * the instances. Tests every scene triangle if no BVH has been built.
+   */
+  bool intersect(Ray &ray, Hit &hit, TraversalStats &stats) const noexcept;
+
+  /**
+   * @brief Whether anything is hit along {ray} before {ray.tMax}, such as for
+   * a shadow ray. Stops at the first hit and records none.
+   */
+  bool occluded(const Ray &ray, TraversalStats &stats) const noexcept;
+
+  /**
+   * @brief Same query, trying the occluder in {cache} first and remembering
+   * the new occluder when the traversal finds one.
+   */
+  bool occluded(const Ray &ray, OcclusionCache &cache,
+                TraversalStats &stats) const noexcept;
+
+  /**
+   * @brief Any-hit query for the lanes of {packet} set in {validMask}. Lanes
+   * blocked by the occluder in {cache} are settled first, the others traverse
+   * the binary BVH as a packet, or the wide or compressed BVH lane by lane,
+   * and then the instances lane by lane. Returns the mask of occluded lanes.
+   */
+  u32 occluded8(u32 validMask, const RayPacket<8> &packet,
+                OcclusionCache &cache, TraversalStats &stats) const;
+
+  /**
+   * @brief Finds the closest hits of the lanes of {packet} set in
+   * {validMask}, traversing the binary BVH once for the whole packet.
+   * Instances are then intersected lane by lane. Returns the mask of lanes
+   * that hit a triangle.
+   */
+  u32 intersect8(u32 validMask, RayPacket<8> &packet, HitPacket<8> &hits,
+                 TraversalStats &stats) const;
+
+  u32 intersect16(u32 validMask, RayPacket<16> &packet, HitPacket<16> &hits,
+                  TraversalStats &stats) const;
+
+  /**
+   * @brief Finds the closest hit of every ray of {rays}, such as all the
+   * camera rays of a tile, filtering the stream through the binary BVH.
+   */
+  void intersectStream(std::span<Ray> rays, std::span<Hit> hits,
+                       TraversalStats &stats) const;
+
+  /**
+   * @brief Cornell box with an area light and two diffuse spheres made of
+   * scene triangles, plus a row of small spheres instancing a shared mesh.
+   */
+  static Scene cornellBox(f32 aspectRatio, u32 sphereSegmentCount);
+
+private:
+  Camera mCamera;
+  std::vector<Triangle> mTriangles;
+  std::vector<u32> mMaterialIndices;
+  std::vector<Material> mMaterials;
+  std::vector<u32> mEmitters;
+  LightSampler mLightSampler;
+  Bvh mBvh;
+  /* Used by the packet queries on {mBvh} */
+  SimdIsa mSimdIsa = SimdIsa::scalar;
+  WideBvh mWideBvh;
+  CompressedBvh mCompressedBvh;
+  InstanceBvh mInstances;
+
+  bool intersectTriangles(Ray &ray, Hit &hit,
+                          TraversalStats &stats) const noexcept;
+
+  bool intersectInstances(Ray &ray, Hit &hit,
+                          TraversalStats &stats) const noexcept;
+
+  bool occludedTriangles(const Ray &ray, u32 &occluderIndex,
+                         TraversalStats &stats) const noexcept;
+
+  bool occludedInstances(const Ray &ray, u32 &instanceIndex,
+                         u32 &triangleIndex,
+                         TraversalStats &stats) const noexcept;
+
+  /* Whether the occluder in {cache} blocks {ray} */
+  bool occludedByCache(const Ray &ray,
+                       const OcclusionCache &cache) const noexcept;
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_SCENE_HPP */
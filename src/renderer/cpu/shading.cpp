@@ -0,0 +1,84 @@
+#include "shading.hpp"
+
+#include "parallel.hpp"
+#include "ray_sort.hpp"
+
+namespace neko {
+
+void ShadingQueue::resize(u32 capacity) {
+  normals.resize(capacity);
+  outgoing.resize(capacity);
+  lightDirections.resize(capacity);
+  u.resize(capacity);
+  v.resize(capacity);
+  w.resize(capacity);
+  materialIndices.resize(capacity);
+  directions.resize(capacity);
+  weights.resize(capacity);
+  lightWeights.resize(capacity);
+  specular.resize(capacity);
+  size = 0;
+}
+
+const char *materialTypeName(MaterialType type) {
+  switch (type) {
+  case MaterialType::diffuse:
+    return "diffuse";
+  case MaterialType::conductor:
+    return "conductor";
+  case MaterialType::dielectric:
+    return "dielectric";
+  case MaterialType::principled:
+    return "principled";
+  }
+  return "unknown";
+}
+
+BatchedShader::BatchedShader(ThreadPool &threadPool, SimdIsa isa)
+    : mpThreadPool{&threadPool}, mIsa{isa} {
+  selectShadeKernels(mIsa, mShadeFuncs);
+}
+
+void BatchedShader::shade(const std::vector<Material> &materials,
+                          ShadingQueue &queue) {
+  /* Counting sort by type, skipped entries go to an extra last bin. The keys
+  fit in 3 bits, a single radix pass */
+  mKeys.resize(queue.size);
+  mSlots.resize(queue.size);
+  parallelFor(*mpThreadPool, 0, queue.size, 0, [&](u64 iSlot) {
+    u32 materialIndex = queue.materialIndices[iSlot];
+    mKeys[iSlot] = materialIndex == invalidIndex
+                       ? materialTypeCount
+                       : static_cast<u32>(materials[materialIndex].type);
+    mSlots[iSlot] = static_cast<u32>(iSlot);
+  });
+  radixSortPairs(*mpThreadPool, mKeys, mSlots, mScratchKeys, mScratchSlots,
+                 3);
+
+  u64 begin = 0;
+  for (u32 iType = 0; iType < materialTypeCount; ++iType) {
+    u64 end = static_cast<u64>(
+        std::upper_bound(mKeys.begin() + static_cast<i64>(begin), mKeys.end(),
+                         iType) -
+        mKeys.begin());
+    if (end == begin) {
+      continue;
+    }
+    /* Whole batches per chunk, so that only the last one has idle lanes */
+    constexpr u64 batchSize = 8;
+    u64 grainSize = chooseGrainSize(*mpThreadPool, end - begin, 0);
+    grainSize = (grainSize + batchSize - 1) / batchSize * batchSize;
+    ScopedTimer timer{TimeUnit::milliseconds};
+    parallelForRange(*mpThreadPool, begin, end, grainSize,
+                     [&](u64 chunkBegin, u64 chunkEnd) {
+                       mShadeFuncs[iType](
+                           materials.data(), queue, mSlots.data() + chunkBegin,
+                           static_cast<u32>(chunkEnd - chunkBegin));
+                     });
+    mStats.times[iType] += timer.now();
+    mStats.hitCounts[iType] += end - begin;
+    begin = end;
+  }
+}
+
+} /* namespace neko */
@@ -0,0 +1,125 @@
+#ifndef NEKO_RENDERER_CPU_SHADING_HPP
+#define NEKO_RENDERER_CPU_SHADING_HPP
+
+#include "scene.hpp"
+
+namespace neko {
+
+class ThreadPool;
+
+/**
+ * @brief Outcome of sampling the BSDF at a hit point. {weight} is the BSDF
+ * times the cosine over the pdf of {direction}, zero if the path is absorbed.
+ * {lightWeight} is the BSDF towards the light sample relative to a white
+ * Lambertian, i.e. the BSDF times pi, so that it scales the radiance of a
+ * {LightSample}.
+ */
+struct BsdfSample {
+  Vec3 direction;
+  Vec3 weight;
+  Vec3 lightWeight;
+  bool specular = false;
+};
+
+/**
+ * @brief Samples the BSDF of {material} at a hit point with the geometric
+ * normal {normal}, seen from the unit direction {outgoing}. The normal may
+ * face either side. {lightDirection} is the direction of the light sample,
+ * zero if there is none. Direction sampling uses {u} and {v}, lobe selection
+ * {w}, which diffuse materials ignore. Scalar version of the kernels run by
+ * {BatchedShader}, with the same results.
+ */
+BsdfSample sampleBsdf(const Material &material, const Vec3 &normal,
+                      const Vec3 &outgoing, const Vec3 &lightDirection, f32 u,
+                      f32 v, f32 w);
+
+/**
+ * @brief Hit points waiting for {BatchedShader}, as one array per attribute.
+ * The caller fills the inputs of entries [0, size), the shader writes the
+ * outputs of the same entries. Arguments are those of {sampleBsdf}.
+ */
+struct ShadingQueue {
+  /* Inputs. Entries whose material index is {invalidIndex} are skipped */
+  std::vector<Vec3> normals;
+  std::vector<Vec3> outgoing;
+  std::vector<Vec3> lightDirections;
+  std::vector<f32> u;
+  std::vector<f32> v;
+  std::vector<f32> w;
+  std::vector<u32> materialIndices;
+
+  /* Outputs */
+  std::vector<Vec3> directions;
+  std::vector<Vec3> weights;
+  std::vector<Vec3> lightWeights;
+  std::vector<u8> specular;
+
+  u32 size = 0;
+
+  void resize(u32 capacity);
+};
+
+/* Shading work per material class, accumulated until reset */
+struct MaterialShadingStats {
+  u64 hitCounts[materialTypeCount] = {};
+  /* Milliseconds */
+  f32 times[materialTypeCount] = {};
+};
+
+const char *materialTypeName(MaterialType type);
+
+/**
+ * @brief Shades hit points in batches. Entries are first binned by material
+ * type, then each type is evaluated by its own kernel, {Lanes::width} hits at
+ * a time: the kernel gathers the hit attributes and the material parameters
+ * of a batch into lanes, evaluates the BSDF without branches and scatters the
+ * results. Each type runs as a parallel loop over the thread pool, so the
+ * code of a single BSDF is hot at a time and its time can be measured.
+ */
+class BatchedShader {
+public:
+  /* Kernel evaluating {count} entries of {queue}, listed by {pSlots} */
+  typedef void (*ShadeFunc_T)(const Material *pMaterials, ShadingQueue &queue,
+                              const u32 *pSlots, u32 count);
+
+  /**
+   * @brief Shades with the kernels of {isa}, lowered to the instruction set
+   * the kernels were built for.
+   */
+  BatchedShader(ThreadPool &threadPool, SimdIsa isa);
+
+  SimdIsa isa() const noexcept { return mIsa; }
+
+  /**
+   * @brief Shades the entries of {queue}, whose material indices refer to
+   * {materials}.
+   */
+  void shade(const std::vector<Material> &materials, ShadingQueue &queue);
+
+  const MaterialShadingStats &stats() const noexcept { return mStats; }
+
+  void resetStats() noexcept { mStats = {}; }
+
+private:
+  ThreadPool *mpThreadPool;
+  SimdIsa mIsa;
+  ShadeFunc_T mShadeFuncs[materialTypeCount];
+  MaterialShadingStats mStats;
+
+  /* Entries sorted by material type, and the radix sort buffers */
+  std::vector<u32> mKeys;
+  std::vector<u32> mSlots;
+  std::vector<u32> mScratchKeys;
+  std::vector<u32> mScratchSlots;
+};
+
+/**
+ * @brief Kernels of each material type for {isa}, indexed by type. Lowers
+ * {isa} to the instruction set of the returned kernels.
+ */
+void selectShadeKernels(
+    SimdIsa &isa, BatchedShader::ShadeFunc_T (&shadeFuncs)[materialTypeCount]);
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_SHADING_HPP */
@@ -0,0 +1,90 @@
+#include "shading.hpp"
+#include "simd_lanes.hpp"
+
+namespace neko {
+
+namespace scalar_kernels {
+
+#include "bsdf_kernels.inl"
+
+} /* namespace scalar_kernels */
+
+#if NEKO_SIMD_X86
+namespace sse_kernels {
+
+#include "bsdf_kernels.inl"
+
+} /* namespace sse_kernels */
+
+NEKO_BEGIN_TARGET_AVX2
+namespace avx2_kernels {
+
+#include "bsdf_kernels.inl"
+
+} /* namespace avx2_kernels */
+NEKO_END_TARGET_AVX2
+#endif /* NEKO_SIMD_X86 */
+
+BsdfSample sampleBsdf(const Material &material, const Vec3 &normal,
+                      const Vec3 &outgoing, const Vec3 &lightDirection, f32 u,
+                      f32 v, f32 w) {
+  using namespace scalar_kernels;
+  ShadeBatch batch = {{normal.x, normal.y, normal.z},
+                      {outgoing.x, outgoing.y, outgoing.z},
+                      {lightDirection.x, lightDirection.y, lightDirection.z},
+                      u,
+                      v,
+                      w,
+                      {material.albedo.x, material.albedo.y, material.albedo.z},
+                      material.roughness,
+                      material.ior,
+                      material.metallic};
+  ShadeResult result;
+  switch (material.type) {
+  case MaterialType::diffuse:
+    shadeDiffuseLanes(batch, result);
+    break;
+  case MaterialType::conductor:
+    shadeConductorLanes(batch, result);
+    break;
+  case MaterialType::dielectric:
+    shadeDielectricLanes(batch, result);
+    break;
+  case MaterialType::principled:
+    shadePrincipledLanes(batch, result);
+    break;
+  }
+  return {{result.direction.x, result.direction.y, result.direction.z},
+          {result.weight.x, result.weight.y, result.weight.z},
+          {result.lightWeight.x, result.lightWeight.y, result.lightWeight.z},
+          result.specular};
+}
+
+void selectShadeKernels(
+    SimdIsa &isa, BatchedShader::ShadeFunc_T (&shadeFuncs)[materialTypeCount]) {
+#if NEKO_SIMD_X86
+  if (isa >= SimdIsa::avx2) {
+    isa = SimdIsa::avx2;
+    shadeFuncs[0] = &avx2_kernels::shadeDiffuse;
+    shadeFuncs[1] = &avx2_kernels::shadeConductor;
+    shadeFuncs[2] = &avx2_kernels::shadeDielectric;
+    shadeFuncs[3] = &avx2_kernels::shadePrincipled;
+    return;
+  }
+  if (isa >= SimdIsa::sse) {
+    isa = SimdIsa::sse;
+    shadeFuncs[0] = &sse_kernels::shadeDiffuse;
+    shadeFuncs[1] = &sse_kernels::shadeConductor;
+    shadeFuncs[2] = &sse_kernels::shadeDielectric;
+    shadeFuncs[3] = &sse_kernels::shadePrincipled;
+    return;
+  }
+#endif /* NEKO_SIMD_X86 */
+  isa = SimdIsa::scalar;
+  shadeFuncs[0] = &scalar_kernels::shadeDiffuse;
+  shadeFuncs[1] = &scalar_kernels::shadeConductor;
+  shadeFuncs[2] = &scalar_kernels::shadeDielectric;
+  shadeFuncs[3] = &scalar_kernels::shadePrincipled;
+}
+
+} /* namespace neko */
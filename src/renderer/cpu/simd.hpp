@@ -0,0 +1,24 @@
+#ifndef NEKO_RENDERER_CPU_SIMD_HPP
+#define NEKO_RENDERER_CPU_SIMD_HPP
+
+#include "utils.hpp"
+
+/* Code between these markers may use AVX2 and FMA intrinsics, without the
+whole translation unit requiring them. Only reach it after checking
+{detectSimdIsa}. Headers must be included before the region, so that the inline
+functions they define are still compiled for the baseline ISA */
+#if defined(__clang__)
+#define NEKO_BEGIN_TARGET_AVX2                                                 \
+  _Pragma("clang attribute push(__attribute__((target(\"avx2,fma\"))), "      \
+          "apply_to = function)")
+#define NEKO_END_TARGET_AVX2 _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+#define NEKO_BEGIN_TARGET_AVX2                                                 \
+  _Pragma("GCC push_options") _Pragma("GCC target(\"avx2,fma\")")
+#define NEKO_END_TARGET_AVX2 _Pragma("GCC pop_options")
+#else
+#define NEKO_BEGIN_TARGET_AVX2
+#define NEKO_END_TARGET_AVX2
+#endif /* compiler */
+
+#endif /* NEKO_RENDERER_CPU_SIMD_HPP */
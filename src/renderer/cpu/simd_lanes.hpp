@@ -0,0 +1,329 @@
+#ifndef NEKO_RENDERER_CPU_SIMD_LANES_HPP
+#define NEKO_RENDERER_CPU_SIMD_LANES_HPP
+
+#include "simd.hpp"
+
+#include <bit>
+#include <cmath>
+
+#if NEKO_SIMD_X86
+#include <immintrin.h>
+#endif /* NEKO_SIMD_X86 */
+
+/* Lane groups shared by the kernels written once for every instruction set.
+Kernel sources include their .inl files inside {scalar_kernels},
+{sse_kernels} and {avx2_kernels}, where {Lanes} is a group of {Lanes::width}
+floats ({Float_T}) with its comparison masks ({Mask_T}), or of as many
+32-bit unsigned integers ({Uint_T}) whose arithmetic wraps around */
+
+namespace neko {
+
+namespace scalar_kernels {
+
+/* One lane per group: packets are traced ray by ray but still share the node
+fetches, triangle blocks are tested triangle by triangle */
+struct Lanes {
+  typedef f32 Float_T;
+  typedef bool Mask_T;
+  typedef u32 Uint_T;
+  static constexpr u32 width = 1;
+
+  static f32 load(const f32 *pValues) noexcept { return *pValues; }
+  static void store(f32 *pValues, f32 value) noexcept { *pValues = value; }
+  static void storeUnaligned(f32 *pValues, f32 value) noexcept {
+    *pValues = value;
+  }
+  static f32 broadcast(f32 value) noexcept { return value; }
+  static f32 add(f32 lhs, f32 rhs) noexcept { return lhs + rhs; }
+  static f32 sub(f32 lhs, f32 rhs) noexcept { return lhs - rhs; }
+  static f32 mul(f32 lhs, f32 rhs) noexcept { return lhs * rhs; }
+  static f32 div(f32 lhs, f32 rhs) noexcept { return lhs / rhs; }
+  static f32 min(f32 lhs, f32 rhs) noexcept { return std::min(lhs, rhs); }
+  static f32 max(f32 lhs, f32 rhs) noexcept { return std::max(lhs, rhs); }
+  static f32 abs(f32 value) noexcept { return std::abs(value); }
+  static f32 sqrt(f32 value) noexcept { return std::sqrt(value); }
+  static bool less(f32 lhs, f32 rhs) noexcept { return lhs < rhs; }
+  static bool lessEqual(f32 lhs, f32 rhs) noexcept { return lhs <= rhs; }
+  static bool logicalAnd(bool lhs, bool rhs) noexcept { return lhs && rhs; }
+  static bool logicalOr(bool lhs, bool rhs) noexcept { return lhs || rhs; }
+  static bool logicalAndNot(bool lhs, bool rhs) noexcept {
+    return lhs && !rhs;
+  }
+  static u32 bits(bool mask) noexcept { return mask ? 1 : 0; }
+  static bool fromBits(u32 bits) noexcept { return bits != 0; }
+  static f32 select(bool mask, f32 lhs, f32 rhs) noexcept {
+    return mask ? lhs : rhs;
+  }
+  static f32 flipSign(f32 value, f32 sign) noexcept {
+    return std::bit_cast<f32>(std::bit_cast<u32>(value) ^
+                              (std::bit_cast<u32>(sign) & 0x80000000u));
+  }
+
+  static u32 loadUint(const u32 *pValues) noexcept { return *pValues; }
+  static void storeUint(u32 *pValues, u32 value) noexcept { *pValues = value; }
+  static u32 broadcastUint(u32 value) noexcept { return value; }
+  static u32 laneIndices() noexcept { return 0; }
+  static u32 addUint(u32 lhs, u32 rhs) noexcept { return lhs + rhs; }
+  static u32 subUint(u32 lhs, u32 rhs) noexcept { return lhs - rhs; }
+  static u32 mulUint(u32 lhs, u32 rhs) noexcept { return lhs * rhs; }
+  static u32 andUint(u32 lhs, u32 rhs) noexcept { return lhs & rhs; }
+  static u32 orUint(u32 lhs, u32 rhs) noexcept { return lhs | rhs; }
+  static u32 xorUint(u32 lhs, u32 rhs) noexcept { return lhs ^ rhs; }
+  template <int Shift> static u32 shiftLeft(u32 value) noexcept {
+    return value << Shift;
+  }
+  template <int Shift> static u32 shiftRight(u32 value) noexcept {
+    return value >> Shift;
+  }
+  /* Float of the top 24 bits, in [0, 1) */
+  static f32 toUnitFloat(u32 bits) noexcept {
+    return static_cast<f32>(bits >> 8) * 0x1p-24f;
+  }
+};
+
+} /* namespace scalar_kernels */
+
+#if NEKO_SIMD_X86
+namespace sse_kernels {
+
+struct Lanes {
+  typedef __m128 Float_T;
+  typedef __m128 Mask_T;
+  typedef __m128i Uint_T;
+  static constexpr u32 width = 4;
+
+  static __m128 load(const f32 *pValues) noexcept {
+    return _mm_load_ps(pValues);
+  }
+  static void store(f32 *pValues, __m128 values) noexcept {
+    _mm_store_ps(pValues, values);
+  }
+  static void storeUnaligned(f32 *pValues, __m128 values) noexcept {
+    _mm_storeu_ps(pValues, values);
+  }
+  static __m128 broadcast(f32 value) noexcept { return _mm_set1_ps(value); }
+  static __m128 add(__m128 lhs, __m128 rhs) noexcept {
+    return _mm_add_ps(lhs, rhs);
+  }
+  static __m128 sub(__m128 lhs, __m128 rhs) noexcept {
+    return _mm_sub_ps(lhs, rhs);
+  }
+  static __m128 mul(__m128 lhs, __m128 rhs) noexcept {
+    return _mm_mul_ps(lhs, rhs);
+  }
+  static __m128 div(__m128 lhs, __m128 rhs) noexcept {
+    return _mm_div_ps(lhs, rhs);
+  }
+  static __m128 min(__m128 lhs, __m128 rhs) noexcept {
+    return _mm_min_ps(lhs, rhs);
+  }
+  static __m128 max(__m128 lhs, __m128 rhs) noexcept {
+    return _mm_max_ps(lhs, rhs);
+  }
+  static __m128 abs(__m128 values) noexcept {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), values);
+  }
+  static __m128 sqrt(__m128 values) noexcept { return _mm_sqrt_ps(values); }
+  static __m128 less(__m128 lhs, __m128 rhs) noexcept {
+    return _mm_cmplt_ps(lhs, rhs);
+  }
+  static __m128 lessEqual(__m128 lhs, __m128 rhs) noexcept {
+    return _mm_cmple_ps(lhs, rhs);
+  }
+  static __m128 logicalAnd(__m128 lhs, __m128 rhs) noexcept {
+    return _mm_and_ps(lhs, rhs);
+  }
+  static __m128 logicalOr(__m128 lhs, __m128 rhs) noexcept {
+    return _mm_or_ps(lhs, rhs);
+  }
+  static __m128 logicalAndNot(__m128 lhs, __m128 rhs) noexcept {
+    return _mm_andnot_ps(rhs, lhs);
+  }
+  static u32 bits(__m128 mask) noexcept {
+    return static_cast<u32>(_mm_movemask_ps(mask));
+  }
+  static __m128 fromBits(u32 bits) noexcept {
+    __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(
+        _mm_and_si128(_mm_set1_epi32(static_cast<i32>(bits)), laneBits),
+        laneBits));
+  }
+  static __m128 select(__m128 mask, __m128 lhs, __m128 rhs) noexcept {
+    return _mm_or_ps(_mm_and_ps(mask, lhs), _mm_andnot_ps(mask, rhs));
+  }
+  static __m128 flipSign(__m128 values, __m128 signs) noexcept {
+    return _mm_xor_ps(values, _mm_and_ps(signs, _mm_set1_ps(-0.0f)));
+  }
+
+  static __m128i loadUint(const u32 *pValues) noexcept {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(pValues));
+  }
+  static void storeUint(u32 *pValues, __m128i values) noexcept {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(pValues), values);
+  }
+  static __m128i broadcastUint(u32 value) noexcept {
+    return _mm_set1_epi32(static_cast<i32>(value));
+  }
+  static __m128i laneIndices() noexcept { return _mm_setr_epi32(0, 1, 2, 3); }
+  static __m128i addUint(__m128i lhs, __m128i rhs) noexcept {
+    return _mm_add_epi32(lhs, rhs);
+  }
+  static __m128i subUint(__m128i lhs, __m128i rhs) noexcept {
+    return _mm_sub_epi32(lhs, rhs);
+  }
+  /* SSE2 has no 32-bit multiply, the even and odd lanes go through the
+  64-bit one */
+  static __m128i mulUint(__m128i lhs, __m128i rhs) noexcept {
+    __m128i evenProducts = _mm_mul_epu32(lhs, rhs);
+    __m128i oddProducts =
+        _mm_mul_epu32(_mm_srli_epi64(lhs, 32), _mm_srli_epi64(rhs, 32));
+    return _mm_unpacklo_epi32(
+        _mm_shuffle_epi32(evenProducts, _MM_SHUFFLE(0, 0, 2, 0)),
+        _mm_shuffle_epi32(oddProducts, _MM_SHUFFLE(0, 0, 2, 0)));
+  }
+  static __m128i andUint(__m128i lhs, __m128i rhs) noexcept {
+    return _mm_and_si128(lhs, rhs);
+  }
+  static __m128i orUint(__m128i lhs, __m128i rhs) noexcept {
+    return _mm_or_si128(lhs, rhs);
+  }
+  static __m128i xorUint(__m128i lhs, __m128i rhs) noexcept {
+    return _mm_xor_si128(lhs, rhs);
+  }
+  template <int Shift> static __m128i shiftLeft(__m128i values) noexcept {
+    return _mm_slli_epi32(values, Shift);
+  }
+  template <int Shift> static __m128i shiftRight(__m128i values) noexcept {
+    return _mm_srli_epi32(values, Shift);
+  }
+  static __m128 toUnitFloat(__m128i bits) noexcept {
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(bits, 8)),
+                      _mm_set1_ps(0x1p-24f));
+  }
+};
+
+} /* namespace sse_kernels */
+
+NEKO_BEGIN_TARGET_AVX2
+namespace avx2_kernels {
+
+struct Lanes {
+  typedef __m256 Float_T;
+  typedef __m256 Mask_T;
+  typedef __m256i Uint_T;
+  static constexpr u32 width = 8;
+
+  static __m256 load(const f32 *pValues) noexcept {
+    return _mm256_load_ps(pValues);
+  }
+  static void store(f32 *pValues, __m256 values) noexcept {
+    _mm256_store_ps(pValues, values);
+  }
+  static void storeUnaligned(f32 *pValues, __m256 values) noexcept {
+    _mm256_storeu_ps(pValues, values);
+  }
+  static __m256 broadcast(f32 value) noexcept { return _mm256_set1_ps(value); }
+  static __m256 add(__m256 lhs, __m256 rhs) noexcept {
+    return _mm256_add_ps(lhs, rhs);
+  }
+  static __m256 sub(__m256 lhs, __m256 rhs) noexcept {
+    return _mm256_sub_ps(lhs, rhs);
+  }
+  static __m256 mul(__m256 lhs, __m256 rhs) noexcept {
+    return _mm256_mul_ps(lhs, rhs);
+  }
+  static __m256 div(__m256 lhs, __m256 rhs) noexcept {
+    return _mm256_div_ps(lhs, rhs);
+  }
+  static __m256 min(__m256 lhs, __m256 rhs) noexcept {
+    return _mm256_min_ps(lhs, rhs);
+  }
+  static __m256 max(__m256 lhs, __m256 rhs) noexcept {
+    return _mm256_max_ps(lhs, rhs);
+  }
+  static __m256 abs(__m256 values) noexcept {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), values);
+  }
+  static __m256 sqrt(__m256 values) noexcept {
+    return _mm256_sqrt_ps(values);
+  }
+  static __m256 less(__m256 lhs, __m256 rhs) noexcept {
+    return _mm256_cmp_ps(lhs, rhs, _CMP_LT_OQ);
+  }
+  static __m256 lessEqual(__m256 lhs, __m256 rhs) noexcept {
+    return _mm256_cmp_ps(lhs, rhs, _CMP_LE_OQ);
+  }
+  static __m256 logicalAnd(__m256 lhs, __m256 rhs) noexcept {
+    return _mm256_and_ps(lhs, rhs);
+  }
+  static __m256 logicalOr(__m256 lhs, __m256 rhs) noexcept {
+    return _mm256_or_ps(lhs, rhs);
+  }
+  static __m256 logicalAndNot(__m256 lhs, __m256 rhs) noexcept {
+    return _mm256_andnot_ps(rhs, lhs);
+  }
+  static u32 bits(__m256 mask) noexcept {
+    return static_cast<u32>(_mm256_movemask_ps(mask));
+  }
+  static __m256 fromBits(u32 bits) noexcept {
+    __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+        _mm256_and_si256(_mm256_set1_epi32(static_cast<i32>(bits)), laneBits),
+        laneBits));
+  }
+  static __m256 select(__m256 mask, __m256 lhs, __m256 rhs) noexcept {
+    return _mm256_blendv_ps(rhs, lhs, mask);
+  }
+  static __m256 flipSign(__m256 values, __m256 signs) noexcept {
+    return _mm256_xor_ps(values, _mm256_and_ps(signs, _mm256_set1_ps(-0.0f)));
+  }
+
+  static __m256i loadUint(const u32 *pValues) noexcept {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pValues));
+  }
+  static void storeUint(u32 *pValues, __m256i values) noexcept {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(pValues), values);
+  }
+  static __m256i broadcastUint(u32 value) noexcept {
+    return _mm256_set1_epi32(static_cast<i32>(value));
+  }
+  static __m256i laneIndices() noexcept {
+    return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  }
+  static __m256i addUint(__m256i lhs, __m256i rhs) noexcept {
+    return _mm256_add_epi32(lhs, rhs);
+  }
+  static __m256i subUint(__m256i lhs, __m256i rhs) noexcept {
+    return _mm256_sub_epi32(lhs, rhs);
+  }
+  static __m256i mulUint(__m256i lhs, __m256i rhs) noexcept {
+    return _mm256_mullo_epi32(lhs, rhs);
+  }
+  static __m256i andUint(__m256i lhs, __m256i rhs) noexcept {
+    return _mm256_and_si256(lhs, rhs);
+  }
+  static __m256i orUint(__m256i lhs, __m256i rhs) noexcept {
+    return _mm256_or_si256(lhs, rhs);
+  }
+  static __m256i xorUint(__m256i lhs, __m256i rhs) noexcept {
+    return _mm256_xor_si256(lhs, rhs);
+  }
+  template <int Shift> static __m256i shiftLeft(__m256i values) noexcept {
+    return _mm256_slli_epi32(values, Shift);
+  }
+  template <int Shift> static __m256i shiftRight(__m256i values) noexcept {
+    return _mm256_srli_epi32(values, Shift);
+  }
+  static __m256 toUnitFloat(__m256i bits) noexcept {
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(bits, 8)),
+                         _mm256_set1_ps(0x1p-24f));
+  }
+};
+
+} /* namespace avx2_kernels */
+NEKO_END_TARGET_AVX2
+#endif /* NEKO_SIMD_X86 */
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_SIMD_LANES_HPP */
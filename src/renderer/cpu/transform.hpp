@@ -0,0 +1,146 @@
+#ifndef NEKO_RENDERER_CPU_TRANSFORM_HPP
+#define NEKO_RENDERER_CPU_TRANSFORM_HPP
+
+#include "math.hpp"
+
+namespace neko {
+
+/**
+ * @brief Affine transform, stored as the 3 rows of a 3x4 matrix whose last
+ * column is the translation.
+ */
+struct Transform {
+  f32 rows[3][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+
+  static Transform translation(const Vec3 &offset) noexcept {
+    Transform transform;
+    transform.rows[0][3] = offset.x;
+    transform.rows[1][3] = offset.y;
+    transform.rows[2][3] = offset.z;
+    return transform;
+  }
+
+  static Transform scaling(const Vec3 &scale) noexcept {
+    Transform transform;
+    transform.rows[0][0] = scale.x;
+    transform.rows[1][1] = scale.y;
+    transform.rows[2][2] = scale.z;
+    return transform;
+  }
+
+  /**
+   * @brief Rotation of {angle} radians around the unit vector {axis}.
+   */
+  static Transform rotation(const Vec3 &axis, f32 angle) noexcept {
+    f32 c = std::cos(angle);
+    f32 s = std::sin(angle);
+    f32 t = 1.0f - c;
+    Transform transform;
+    transform.rows[0][0] = t * axis.x * axis.x + c;
+    transform.rows[0][1] = t * axis.x * axis.y - s * axis.z;
+    transform.rows[0][2] = t * axis.x * axis.z + s * axis.y;
+    transform.rows[1][0] = t * axis.x * axis.y + s * axis.z;
+    transform.rows[1][1] = t * axis.y * axis.y + c;
+    transform.rows[1][2] = t * axis.y * axis.z - s * axis.x;
+    transform.rows[2][0] = t * axis.x * axis.z - s * axis.y;
+    transform.rows[2][1] = t * axis.y * axis.z + s * axis.x;
+    transform.rows[2][2] = t * axis.z * axis.z + c;
+    return transform;
+  }
+
+  Vec3 point(const Vec3 &point) const noexcept {
+    return vector(point) + Vec3{rows[0][3], rows[1][3], rows[2][3]};
+  }
+
+  Vec3 vector(const Vec3 &vec) const noexcept {
+    return {rows[0][0] * vec.x + rows[0][1] * vec.y + rows[0][2] * vec.z,
+            rows[1][0] * vec.x + rows[1][1] * vec.y + rows[1][2] * vec.z,
+            rows[2][0] * vec.x + rows[2][1] * vec.y + rows[2][2] * vec.z};
+  }
+
+  /**
+   * @brief Applies the transpose of the linear part. Called on the inverse
+   * transform, it maps normals.
+   */
+  Vec3 transposedVector(const Vec3 &vec) const noexcept {
+    return {rows[0][0] * vec.x + rows[1][0] * vec.y + rows[2][0] * vec.z,
+            rows[0][1] * vec.x + rows[1][1] * vec.y + rows[2][1] * vec.z,
+            rows[0][2] * vec.x + rows[1][2] * vec.y + rows[2][2] * vec.z};
+  }
+
+  /**
+   * @brief Box enclosing {box} once transformed (Arvo, "Transforming
+   * Axis-Aligned Bounding Boxes").
+   */
+  Aabb bounds(const Aabb &box) const noexcept {
+    if (box.empty()) {
+      return box;
+    }
+    f32 lower[3];
+    f32 upper[3];
+    for (u32 iRow = 0; iRow < 3; ++iRow) {
+      lower[iRow] = rows[iRow][3];
+      upper[iRow] = rows[iRow][3];
+      for (u32 iColumn = 0; iColumn < 3; ++iColumn) {
+        f32 a = rows[iRow][iColumn] * box.lower[iColumn];
+        f32 b = rows[iRow][iColumn] * box.upper[iColumn];
+        lower[iRow] += std::min(a, b);
+        upper[iRow] += std::max(a, b);
+      }
+    }
+    return {{lower[0], lower[1], lower[2]}, {upper[0], upper[1], upper[2]}};
+  }
+
+  /**
+   * @brief Inverse of an invertible transform.
+   */
+  Transform inverse() const noexcept {
+    const auto &m = rows;
+    f32 cofactors[3][3] = {
+        {m[1][1] * m[2][2] - m[1][2] * m[2][1],
+         m[0][2] * m[2][1] - m[0][1] * m[2][2],
+         m[0][1] * m[1][2] - m[0][2] * m[1][1]},
+        {m[1][2] * m[2][0] - m[1][0] * m[2][2],
+         m[0][0] * m[2][2] - m[0][2] * m[2][0],
+         m[0][2] * m[1][0] - m[0][0] * m[1][2]},
+        {m[1][0] * m[2][1] - m[1][1] * m[2][0],
+         m[0][1] * m[2][0] - m[0][0] * m[2][1],
+         m[0][0] * m[1][1] - m[0][1] * m[1][0]}};
+    f32 invDeterminant =
+        1.0f / (m[0][0] * cofactors[0][0] + m[0][1] * cofactors[1][0] +
+                m[0][2] * cofactors[2][0]);
+    Transform inverse;
+    for (u32 iRow = 0; iRow < 3; ++iRow) {
+      for (u32 iColumn = 0; iColumn < 3; ++iColumn) {
+        inverse.rows[iRow][iColumn] = cofactors[iRow][iColumn] * invDeterminant;
+      }
+    }
+    Vec3 translation = inverse.vector({m[0][3], m[1][3], m[2][3]});
+    inverse.rows[0][3] = -translation.x;
+    inverse.rows[1][3] = -translation.y;
+    inverse.rows[2][3] = -translation.z;
+    return inverse;
+  }
+};
+
+/**
+ * @brief Composition applying {rhs} first.
+ */
+inline Transform operator*(const Transform &lhs,
+                           const Transform &rhs) noexcept {
+  Transform product;
+  for (u32 iRow = 0; iRow < 3; ++iRow) {
+    for (u32 iColumn = 0; iColumn < 4; ++iColumn) {
+      product.rows[iRow][iColumn] =
+          lhs.rows[iRow][0] * rhs.rows[0][iColumn] +
+          lhs.rows[iRow][1] * rhs.rows[1][iColumn] +
+          lhs.rows[iRow][2] * rhs.rows[2][iColumn] +
+          (iColumn == 3 ? lhs.rows[iRow][3] : 0.0f);
+    }
+  }
+  return product;
+}
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_TRANSFORM_HPP */
@@ -0,0 +1,108 @@
+#ifndef NEKO_RENDERER_CPU_TRIANGLE_HPP
+#define NEKO_RENDERER_CPU_TRIANGLE_HPP
+
+#include "math.hpp"
+
+namespace neko {
+
+inline constexpr u32 invalidIndex = ~0u;
+
+struct Triangle {
+  Vec3 p0;
+  Vec3 p1;
+  Vec3 p2;
+
+  Aabb bounds() const noexcept {
+    Aabb box;
+    box.extend(p0);
+    box.extend(p1);
+    box.extend(p2);
+    return box;
+  }
+
+  Vec3 centroid() const noexcept { return (p0 + p1 + p2) * (1.0f / 3.0f); }
+
+  /* Unnormalized, its length is twice the area */
+  Vec3 scaledNormal() const noexcept { return cross(p1 - p0, p2 - p0); }
+
+  f32 area() const noexcept { return 0.5f * length(scaledNormal()); }
+
+  /**
+   * @brief Uniformly distributed point for the unit square sample {(u, v)}.
+   */
+  Vec3 samplePoint(f32 u, f32 v) const noexcept {
+    f32 su = std::sqrt(u);
+    return p0 * (1.0f - su) + p1 * (su * (1.0f - v)) + p2 * (su * v);
+  }
+};
+
+struct Hit {
+  f32 t = infinity;
+  f32 u = 0.0f;
+  f32 v = 0.0f;
+  /* Index in the scene, or in the mesh of {instanceIndex} */
+  u32 triangleIndex = invalidIndex;
+  u32 instanceIndex = invalidIndex;
+
+  bool valid() const noexcept { return triangleIndex != invalidIndex; }
+};
+
+/* Hits closer than this are treated as self-intersections */
+inline constexpr f32 rayEpsilon = 1e-4f;
+
+/**
+ * @brief Möller–Trumbore ray/triangle test. On a hit between {rayEpsilon} and
+ * {ray.tMax}, stores its distance and barycentric coordinates.
+ */
+inline bool intersectTriangle(const Triangle &triangle, const Ray &ray, f32 &t,
+                              f32 &u, f32 &v) noexcept {
+  Vec3 edge1 = triangle.p1 - triangle.p0;
+  Vec3 edge2 = triangle.p2 - triangle.p0;
+  Vec3 pVec = cross(ray.direction, edge2);
+  f32 determinant = dot(edge1, pVec);
+  if (std::abs(determinant) < 1e-12f) {
+    return false;
+  }
+  f32 invDeterminant = 1.0f / determinant;
+  Vec3 tVec = ray.origin - triangle.p0;
+  u = dot(tVec, pVec) * invDeterminant;
+  if (u < 0.0f || u > 1.0f) {
+    return false;
+  }
+  Vec3 qVec = cross(tVec, edge1);
+  v = dot(ray.direction, qVec) * invDeterminant;
+  if (v < 0.0f || u + v > 1.0f) {
+    return false;
+  }
+  t = dot(edge2, qVec) * invDeterminant;
+  return t > rayEpsilon && t < ray.tMax;
+}
+
+/**
+ * @brief Updates {hit} and {ray.tMax} if the triangle is hit closer than
+ * {ray.tMax}.
+ */
+inline bool intersectTriangle(const Triangle &triangle, u32 triangleIndex,
+                              Ray &ray, Hit &hit) noexcept {
+  f32 t;
+  f32 u;
+  f32 v;
+  if (!intersectTriangle(triangle, ray, t, u, v)) {
+    return false;
+  }
+  ray.tMax = t;
+  hit = {t, u, v, triangleIndex};
+  return true;
+}
+
+/* Whether the triangle is hit before {ray.tMax}, without recording the hit */
+inline bool occludes(const Triangle &triangle, const Ray &ray) noexcept {
+  f32 t;
+  f32 u;
+  f32 v;
+  return intersectTriangle(triangle, ray, t, u, v);
+}
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_TRIANGLE_HPP */
@@ -0,0 +1,108 @@
+#ifndef NEKO_RENDERER_CPU_TRIANGLE_BLOCK_HPP
+#define NEKO_RENDERER_CPU_TRIANGLE_BLOCK_HPP
+
+#include "simd.hpp"
+#include "triangle.hpp"
+
+#include <limits>
+
+namespace neko {
+
+/**
+ * @brief {Width} triangles stored as structure of arrays, so that one SIMD
+ * test covers the whole block. {vertices[3 * vertex + axis]} holds one
+ * coordinate of one vertex for every triangle. Padding lanes have NaN vertices,
+ * which fail every comparison of the test.
+ */
+template <u32 Width> struct alignas(4 * Width) TriangleBlock {
+  f32 vertices[9][Width];
+  /* Scene index of each triangle, {invalidIndex} for padding lanes */
+  u32 triangleIndices[Width];
+};
+
+static_assert(sizeof(TriangleBlock<4>) == 160, "4 triangles in 5 lines of 32B");
+static_assert(sizeof(TriangleBlock<8>) == 320, "8 triangles in 5 lines of 64B");
+
+/**
+ * @brief Appends the blocks holding the {count} triangles of {triangles}
+ * referenced from {pTriangleIndices}, and returns how many were added.
+ */
+template <u32 Width>
+u32 appendTriangleBlocks(std::vector<TriangleBlock<Width>> &blocks,
+                         const std::vector<Triangle> &triangles,
+                         const u32 *pTriangleIndices, u32 count) {
+  u32 blockCount = (count + Width - 1) / Width;
+  for (u32 iBlock = 0; iBlock < blockCount; ++iBlock) {
+    TriangleBlock<Width> block{};
+    for (u32 lane = 0; lane < Width; ++lane) {
+      u32 iTriangle = iBlock * Width + lane;
+      if (iTriangle >= count) {
+        for (u32 iCoordinate = 0; iCoordinate < 9; ++iCoordinate) {
+          block.vertices[iCoordinate][lane] =
+              std::numeric_limits<f32>::quiet_NaN();
+        }
+        block.triangleIndices[lane] = invalidIndex;
+        continue;
+      }
+      u32 triangleIndex = pTriangleIndices[iTriangle];
+      const Triangle &triangle = triangles[triangleIndex];
+      const Vec3 *vertices[3] = {&triangle.p0, &triangle.p1, &triangle.p2};
+      for (u32 iVertex = 0; iVertex < 3; ++iVertex) {
+        for (u32 axis = 0; axis < 3; ++axis) {
+          block.vertices[3 * iVertex + axis][lane] = (*vertices[iVertex])[axis];
+        }
+      }
+      block.triangleIndices[lane] = triangleIndex;
+    }
+    blocks.push_back(block);
+  }
+  return blockCount;
+}
+
+/**
+ * @brief Block width used by the wide BVH leaves. Blocks of 8 only pay off
+ * with AVX2 and leaves of more than 4 triangles, otherwise they would be
+ * mostly padding.
+ */
+inline u32 selectTriangleBlockWidth(SimdIsa isa, u32 maxLeafSize) noexcept {
+  return isa >= SimdIsa::avx2 && maxLeafSize > 4 ? 8 : 4;
+}
+
+/**
+ * @brief Per-ray constants of the watertight test: {kz} is the dominant axis
+ * of the direction, and the shear maps the ray onto the +z axis of a frame
+ * centred on its origin.
+ */
+struct WatertightRay {
+  u32 kx;
+  u32 ky;
+  u32 kz;
+  f32 shearX;
+  f32 shearY;
+  f32 shearZ;
+};
+
+inline WatertightRay makeWatertightRay(const Ray &ray) noexcept {
+  Vec3 absDirection = {std::abs(ray.direction.x), std::abs(ray.direction.y),
+                       std::abs(ray.direction.z)};
+  u32 kz = absDirection.x >= absDirection.y
+               ? (absDirection.x >= absDirection.z ? 0 : 2)
+               : (absDirection.y >= absDirection.z ? 1 : 2);
+  u32 kx = kz == 2 ? 0 : kz + 1;
+  u32 ky = kx == 2 ? 0 : kx + 1;
+  /* Keeps the winding of the sheared triangles */
+  if (ray.direction[kz] < 0.0f) {
+    std::swap(kx, ky);
+  }
+  f32 invDirectionZ = 1.0f / ray.direction[kz];
+  return {kx,
+          ky,
+          kz,
+          ray.direction[kx] * invDirectionZ,
+          ray.direction[ky] * invDirectionZ,
+          invDirectionZ};
+}
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_TRIANGLE_BLOCK_HPP */
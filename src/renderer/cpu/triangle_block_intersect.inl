@@ -0,0 +1,147 @@
+/* Triangle block tests, included once per instruction set inside a namespace
+that provides {BlockLanes_T<Width>}: the {Lanes} of simd_lanes.hpp used to
+test a block of {Width} triangles */
+
+/**
+ * @brief Watertight ray/triangle test (Woop et al., "Watertight Ray/Triangle
+ * Intersection") of every lane of {block}. The vertices are sheared into the
+ * frame of {watertightRay}, where the ray runs along +z through the origin, and
+ * the hit is decided by the signs of 2D edge functions. Triangles sharing an
+ * edge evaluate it identically, so no ray slips between them. Returns the mask
+ * of lanes hit before {ray.tMax}, with their distances and barycentric
+ * coordinates in {ts}, {us} and {vs}. With {AnyHit}, returns the mask of the
+ * first group of lanes with a hit, without storing anything.
+ */
+template <bool AnyHit, u32 Width>
+static u32 intersectBlockLanes(const TriangleBlock<Width> &block,
+                               const WatertightRay &watertightRay,
+                               const Ray &ray, f32 *ts, f32 *us,
+                               f32 *vs) noexcept {
+  typedef BlockLanes_T<Width> L;
+  typedef typename L::Float_T Float_T;
+  typedef typename L::Mask_T Mask_T;
+  const u32 axes[3] = {watertightRay.kx, watertightRay.ky, watertightRay.kz};
+  Float_T origin[3] = {L::broadcast(ray.origin[axes[0]]),
+                       L::broadcast(ray.origin[axes[1]]),
+                       L::broadcast(ray.origin[axes[2]])};
+  Float_T shearX = L::broadcast(watertightRay.shearX);
+  Float_T shearY = L::broadcast(watertightRay.shearY);
+  Float_T shearZ = L::broadcast(watertightRay.shearZ);
+  Float_T zero = L::broadcast(0.0f);
+  Float_T tMin = L::broadcast(rayEpsilon);
+  Float_T tMax = L::broadcast(ray.tMax);
+
+  u32 hitMask = 0;
+  for (u32 group = 0; group < Width; group += L::width) {
+    Float_T x[3];
+    Float_T y[3];
+    Float_T z[3];
+    for (u32 iVertex = 0; iVertex < 3; ++iVertex) {
+      Float_T px = L::sub(
+          L::load(block.vertices[3 * iVertex + axes[0]] + group), origin[0]);
+      Float_T py = L::sub(
+          L::load(block.vertices[3 * iVertex + axes[1]] + group), origin[1]);
+      Float_T pz = L::sub(
+          L::load(block.vertices[3 * iVertex + axes[2]] + group), origin[2]);
+      x[iVertex] = L::sub(px, L::mul(shearX, pz));
+      y[iVertex] = L::sub(py, L::mul(shearY, pz));
+      z[iVertex] = L::mul(shearZ, pz);
+    }
+    /* Edge functions, the scaled barycentric weights of vertices 0, 1, 2 */
+    Float_T e0 = L::sub(L::mul(x[2], y[1]), L::mul(y[2], x[1]));
+    Float_T e1 = L::sub(L::mul(x[0], y[2]), L::mul(y[0], x[2]));
+    Float_T e2 = L::sub(L::mul(x[1], y[0]), L::mul(y[1], x[0]));
+    /* Two-sided: the weights only need to share a sign */
+    Mask_T anyNegative = L::logicalOr(
+        L::logicalOr(L::less(e0, zero), L::less(e1, zero)), L::less(e2, zero));
+    Mask_T anyPositive = L::logicalOr(
+        L::logicalOr(L::less(zero, e0), L::less(zero, e1)), L::less(zero, e2));
+    Float_T determinant = L::add(L::add(e0, e1), e2);
+    Float_T absDeterminant = L::abs(determinant);
+    Float_T tScaled = L::flipSign(
+        L::add(L::add(L::mul(e0, z[0]), L::mul(e1, z[1])), L::mul(e2, z[2])),
+        determinant);
+    /* A zero determinant leaves no room between the bounds */
+    Mask_T inRange =
+        L::logicalAnd(L::less(L::mul(tMin, absDeterminant), tScaled),
+                      L::less(tScaled, L::mul(tMax, absDeterminant)));
+    u32 groupMask = L::bits(
+        L::logicalAndNot(inRange, L::logicalAnd(anyNegative, anyPositive)));
+    if (groupMask == 0) {
+      continue;
+    }
+    if constexpr (AnyHit) {
+      return groupMask << group;
+    }
+    L::store(ts + group, L::div(tScaled, absDeterminant));
+    L::store(us + group, L::div(e1, determinant));
+    L::store(vs + group, L::div(e2, determinant));
+    hitMask |= groupMask << group;
+  }
+  return hitMask;
+}
+
+/**
+ * @brief Closest hit in {block}, which updates {hit} and {ray.tMax} as
+ * {intersectTriangle} does.
+ */
+template <u32 Width>
+static bool intersectBlock(const TriangleBlock<Width> &block,
+                           const WatertightRay &watertightRay, Ray &ray,
+                           Hit &hit) noexcept {
+  alignas(32) f32 ts[Width];
+  alignas(32) f32 us[Width];
+  alignas(32) f32 vs[Width];
+  u32 hitMask = intersectBlockLanes<false>(block, watertightRay, ray, ts, us,
+                                           vs);
+  if (hitMask == 0) {
+    return false;
+  }
+
+  u32 nearestLane = static_cast<u32>(std::countr_zero(hitMask));
+  for (u32 mask = hitMask & (hitMask - 1); mask != 0; mask &= mask - 1) {
+    auto lane = static_cast<u32>(std::countr_zero(mask));
+    if (ts[lane] < ts[nearestLane]) {
+      nearestLane = lane;
+    }
+  }
+  ray.tMax = ts[nearestLane];
+  hit = {ts[nearestLane], us[nearestLane], vs[nearestLane],
+         block.triangleIndices[nearestLane]};
+  return true;
+}
+
+/**
+ * @brief Closest hit among the {blockCount} blocks starting at {pBlocks}.
+ */
+template <u32 Width>
+static bool intersectBlocks(const TriangleBlock<Width> *pBlocks,
+                            u32 blockCount, const WatertightRay &watertightRay,
+                            Ray &ray, Hit &hit) noexcept {
+  bool found = false;
+  for (u32 iBlock = 0; iBlock < blockCount; ++iBlock) {
+    found |= intersectBlock(pBlocks[iBlock], watertightRay, ray, hit);
+  }
+  return found;
+}
+
+/**
+ * @brief Any-hit test of the {blockCount} blocks starting at {pBlocks}. On a
+ * hit before {ray.tMax}, stores the scene index of the triangle in
+ * {occluderIndex}.
+ */
+template <u32 Width>
+static bool occludedBlocks(const TriangleBlock<Width> *pBlocks,
+                           u32 blockCount, const WatertightRay &watertightRay,
+                           const Ray &ray, u32 &occluderIndex) noexcept {
+  for (u32 iBlock = 0; iBlock < blockCount; ++iBlock) {
+    u32 hitMask = intersectBlockLanes<true>(pBlocks[iBlock], watertightRay,
+                                            ray, nullptr, nullptr, nullptr);
+    if (hitMask != 0) {
+      occluderIndex =
+          pBlocks[iBlock].triangleIndices[std::countr_zero(hitMask)];
+      return true;
+    }
+  }
+  return false;
+}
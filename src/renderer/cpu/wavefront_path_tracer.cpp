@@ -0,0 +1,438 @@
+#include "wavefront_path_tracer.hpp"
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace neko {
+
+void RayQueue::resize(u32 capacity) {
+  originX.resize(capacity);
+  originY.resize(capacity);
+  originZ.resize(capacity);
+  directionX.resize(capacity);
+  directionY.resize(capacity);
+  directionZ.resize(capacity);
+  tMax.resize(capacity);
+  pathIndices.resize(capacity);
+  size = 0;
+}
+
+void HitQueue::resize(u32 capacity) {
+  t.resize(capacity);
+  triangleIndices.resize(capacity);
+  instanceIndices.resize(capacity);
+}
+
+WavefrontPathTracer::WavefrontPathTracer(const Settings &settings,
+                                         ThreadPool &threadPool)
+    : mpThreadPool{&threadPool},
+      mSamplesPerPixel{
+          std::max(settings.graphics.pathTracer.samplesPerPixel, 1u)},
+      mMaxBounces{settings.graphics.pathTracer.maxBounces},
+      mRaySorting{settings.graphics.pathTracer.raySorting},
+      mSampler{settings.graphics.pathTracer.sampler,
+               settings.graphics.pathTracer.simdIsa},
+      mShader{threadPool, settings.graphics.pathTracer.simdIsa} {}
+
+RenderStats WavefrontPathTracer::render(const Scene &scene,
+                                        Framebuffer &framebuffer) {
+  NEKO_PROFILE_FUNCTION();
+  ScopedTimer timer{TimeUnit::milliseconds};
+  auto pathCount = static_cast<u32>(stdu64(framebuffer.width()) *
+                                    framebuffer.height());
+  mPathSamples.assign(pathCount, SampleStream{Rng{0}});
+  mCameraOffsetsX.resize(pathCount);
+  mCameraOffsetsY.resize(pathCount);
+  mThroughputs.resize(pathCount);
+  mRadiances.resize(pathCount);
+  mCountEmission.resize(pathCount);
+  /* A path queues at most one bounce and one shadow ray per stage */
+  mRays.resize(pathCount);
+  mNextRays.resize(pathCount);
+  mHits.resize(pathCount);
+  mShadowRays.resize(pathCount);
+  mShadowRadiances.resize(pathCount);
+  mShadingQueue.resize(pathCount);
+  mPositions.resize(pathCount);
+  mLightSamples.resize(pathCount);
+  mSurvivals.resize(pathCount);
+  mShadeFlags.resize(pathCount);
+
+  if (mRaySorting != RaySortMode::off) {
+    mKeyEncoder = RaySortKeyEncoder{scene.bounds()};
+  }
+
+  mStageTimes = {};
+  mShader.resetStats();
+  /* Paths stop after {mMaxBounces} bounces, then the queue is empty */
+  mBounceSortStats.assign(stdu64(mMaxBounces) + 1, {});
+  RenderStats stats;
+  ScopedTimer stageTimer{TimeUnit::milliseconds};
+  for (u32 iSample = 0; iSample < mSamplesPerPixel; ++iSample) {
+    stageTimer.reset();
+    generate(scene, framebuffer, iSample);
+    mStageTimes.generate += stageTimer.now();
+
+    for (u32 depth = 0; mRays.size.load() > 0; ++depth) {
+      BounceSortStats &bounceStats = mBounceSortStats[depth];
+      u32 rayCount = mRays.size.load();
+      bool sorted = shouldSortRays(depth);
+      if (sorted) {
+        stageTimer.reset();
+        sortRays();
+        f32 sortTime = stageTimer.now();
+        mStageTimes.sort += sortTime;
+        bounceStats.sortTime += sortTime;
+      }
+
+      u64 visitedNodeCount = stats.traversal.visitedNodeCount;
+      stageTimer.reset();
+      extend(scene, stats);
+      f32 extendTime = stageTimer.now();
+      mStageTimes.extend += extendTime;
+      visitedNodeCount = stats.traversal.visitedNodeCount - visitedNodeCount;
+      if (sorted) {
+        bounceStats.sortedRayCount += rayCount;
+        bounceStats.sortedExtendTime += extendTime;
+        bounceStats.sortedVisitedNodeCount += visitedNodeCount;
+      } else {
+        bounceStats.unsortedRayCount += rayCount;
+        bounceStats.unsortedExtendTime += extendTime;
+        bounceStats.unsortedVisitedNodeCount += visitedNodeCount;
+      }
+
+      stageTimer.reset();
+      shade(scene, depth);
+      mStageTimes.shade += stageTimer.now();
+
+      stageTimer.reset();
+      traceShadowRays(scene, stats);
+      mStageTimes.shadow += stageTimer.now();
+
+      swapRayQueues();
+    }
+
+    stageTimer.reset();
+    accumulate(framebuffer, iSample);
+    mStageTimes.accumulate += stageTimer.now();
+  }
+  stats.renderTime = timer.now();
+  return stats;
+}
+
+void WavefrontPathTracer::generate(const Scene &scene,
+                                   const Framebuffer &framebuffer,
+                                   u32 sampleIndex) {
+  NEKO_PROFILE_FUNCTION();
+  u32 width = framebuffer.width();
+  u32 height = framebuffer.height();
+  f32 invWidth = 1.0f / static_cast<f32>(width);
+  f32 invHeight = 1.0f / static_cast<f32>(height);
+  auto pathCount = static_cast<u32>(mPathSamples.size());
+  /* PCG streams are sequential, the other samplers fill whole rows with
+  their SIMD kernels */
+  bool sampleRows = mSampler.type() != SamplerType::pcg;
+  parallelFor(*mpThreadPool, 0, height, 0, [&](u64 iRow) {
+    auto y = static_cast<u32>(iRow);
+    u32 firstPath = y * width;
+    f32 *pOffsetsX = mCameraOffsetsX.data() + firstPath;
+    f32 *pOffsetsY = mCameraOffsetsY.data() + firstPath;
+    if (sampleRows) {
+      mSampler.sampleRow(0, y, width, sampleIndex, cameraDimensionU,
+                         pOffsetsX);
+      mSampler.sampleRow(0, y, width, sampleIndex, cameraDimensionV,
+                         pOffsetsY);
+    }
+    for (u32 x = 0; x < width; ++x) {
+      u32 pathIndex = firstPath + x;
+      SampleStream &samples = mPathSamples[pathIndex];
+      /* Same seed as {PathTracer}, so both render the same image */
+      if (sampleIndex == 0) {
+        samples = {&mSampler, x, y, Rng{hashU64(pathIndex)}};
+      }
+      samples.startSample(sampleIndex);
+      if (!sampleRows) {
+        pOffsetsX[x] = samples.get(cameraDimensionU);
+        pOffsetsY[x] = samples.get(cameraDimensionV);
+      }
+      f32 s = (static_cast<f32>(x) + pOffsetsX[x]) * invWidth;
+      f32 t = (static_cast<f32>(y) + pOffsetsY[x]) * invHeight;
+      mRays.setRay(pathIndex, scene.camera().generateRay(s, t), pathIndex);
+      mThroughputs[pathIndex] = {1.0f, 1.0f, 1.0f};
+      mRadiances[pathIndex] = {};
+      mCountEmission[pathIndex] = 1;
+    }
+  });
+  mRays.size = pathCount;
+}
+
+bool WavefrontPathTracer::shouldSortRays(u32 depth) const noexcept {
+  /* Camera rays are generated in pixel order, which is already coherent */
+  if (depth == 0 || mRaySorting == RaySortMode::off) {
+    return false;
+  }
+  if (mRaySorting == RaySortMode::on) {
+    return true;
+  }
+  const BounceSortStats &bounceStats = mBounceSortStats[depth];
+  if (bounceStats.unsortedRayCount == 0) {
+    return false;
+  }
+  if (bounceStats.sortedRayCount == 0) {
+    return true;
+  }
+  return bounceStats.sortingPays();
+}
+
+void WavefrontPathTracer::sortRays() {
+  NEKO_PROFILE_FUNCTION();
+  u32 rayCount = mRays.size.load();
+  mSortKeys.resize(rayCount);
+  mSortedSlots.resize(rayCount);
+  parallelFor(*mpThreadPool, 0, rayCount, 0, [&](u64 iSlot) {
+    auto slot = static_cast<u32>(iSlot);
+    mSortKeys[slot] = mKeyEncoder.key(
+        {mRays.originX[slot], mRays.originY[slot], mRays.originZ[slot]},
+        {mRays.directionX[slot], mRays.directionY[slot],
+         mRays.directionZ[slot]});
+    mSortedSlots[slot] = slot;
+  });
+  radixSortPairs(*mpThreadPool, mSortKeys, mSortedSlots, mScratchKeys,
+                 mScratchSlots, raySortKeyBits);
+
+  /* Gather into the idle queue, then make it the current one */
+  parallelFor(*mpThreadPool, 0, rayCount, 0, [&](u64 iSlot) {
+    u32 sourceSlot = mSortedSlots[iSlot];
+    mNextRays.setRay(static_cast<u32>(iSlot), mRays.ray(sourceSlot),
+                     mRays.pathIndices[sourceSlot]);
+  });
+  mNextRays.size = rayCount;
+  swapRayQueues();
+}
+
+void WavefrontPathTracer::extend(const Scene &scene, RenderStats &stats) {
+  NEKO_PROFILE_FUNCTION();
+  stats.traversal += parallelReduce(
+      *mpThreadPool, 0, mRays.size.load(), 0, TraversalStats{},
+      [&](u64 begin, u64 end) {
+        TraversalStats chunkStats;
+        for (u64 iSlot = begin; iSlot < end; ++iSlot) {
+          auto slot = static_cast<u32>(iSlot);
+          Ray ray = mRays.ray(slot);
+          Hit hit;
+          scene.intersect(ray, hit, chunkStats);
+          mHits.setHit(slot, hit);
+        }
+        return chunkStats;
+      },
+      [](TraversalStats lhs, const TraversalStats &rhs) {
+        return lhs += rhs;
+      });
+}
+
+/* Flags of {mShadeFlags} */
+static constexpr u8 litFlag = 1;
+static constexpr u8 survivedFlag = 2;
+
+void WavefrontPathTracer::shade(const Scene &scene, u32 depth) {
+  NEKO_PROFILE_FUNCTION();
+  prepareShading(scene, depth);
+  mShader.shade(scene.materials(), mShadingQueue);
+  queueRays();
+}
+
+void WavefrontPathTracer::prepareShading(const Scene &scene, u32 depth) {
+  /* Random numbers are drawn in the order of {PathTracer::trace} */
+  u32 rayCount = mRays.size.load();
+  mShadingQueue.size = rayCount;
+  parallelFor(*mpThreadPool, 0, rayCount, 0, [&](u64 iSlot) {
+    auto slot = static_cast<u32>(iSlot);
+    mShadingQueue.materialIndices[slot] = invalidIndex;
+    mShadeFlags[slot] = 0;
+    Hit hit = mHits.hit(slot);
+    if (!hit.valid()) {
+      return;
+    }
+    u32 pathIndex = mRays.pathIndices[slot];
+    u32 materialIndex = scene.materialIndex(hit);
+    const Material &material = scene.materials()[materialIndex];
+    const Vec3 &throughput = mThroughputs[pathIndex];
+    if (mCountEmission[pathIndex] != 0) {
+      mRadiances[pathIndex] += throughput * material.emission;
+    }
+    if (depth == mMaxBounces) {
+      return;
+    }
+
+    Ray ray = mRays.ray(slot);
+    Vec3 position = ray.at(hit.t);
+    Vec3 normal = scene.normal(hit);
+    Vec3 facingNormal = dot(normal, ray.direction) > 0.0f ? -normal : normal;
+    SampleStream &samples = mPathSamples[pathIndex];
+    LightSample &lightSample = mLightSamples[slot];
+    bool lit = !material.specular() &&
+               sampleLight(scene, position, facingNormal, samples, depth,
+                           lightSample);
+
+    f32 survival = 1.0f;
+    bool survived = true;
+    if (depth + 1 >= minRouletteDepth) {
+      survival = std::min(maxComponent(throughput * material.albedo), 0.95f);
+      survived =
+          samples.get(bounceDimension(depth, BounceDimension::roulette)) <
+          survival;
+    }
+    f32 u = 0.0f;
+    f32 v = 0.0f;
+    f32 w = 0.0f;
+    if (survived) {
+      u = samples.get(bounceDimension(depth, BounceDimension::bsdfU));
+      v = samples.get(bounceDimension(depth, BounceDimension::bsdfV));
+      if (material.type != MaterialType::diffuse) {
+        w = samples.get(bounceDimension(depth, BounceDimension::bsdfLobe));
+      }
+    }
+
+    mShadingQueue.normals[slot] = normal;
+    mShadingQueue.outgoing[slot] = -ray.direction;
+    mShadingQueue.lightDirections[slot] =
+        lit ? lightSample.shadowRay.direction : Vec3{};
+    mShadingQueue.u[slot] = u;
+    mShadingQueue.v[slot] = v;
+    mShadingQueue.w[slot] = w;
+    mShadingQueue.materialIndices[slot] = materialIndex;
+    mPositions[slot] = position;
+    mSurvivals[slot] = survival;
+    mShadeFlags[slot] =
+        static_cast<u8>((lit ? litFlag : 0) | (survived ? survivedFlag : 0));
+  });
+}
+
+void WavefrontPathTracer::queueRays() {
+  mNextRays.size = 0;
+  mShadowRays.size = 0;
+  parallelForRange(*mpThreadPool, 0, mRays.size.load(), 0, [&](u64 begin,
+                                                               u64 end) {
+    /* Rays are gathered per chunk, so that each chunk reserves its slots in
+    the output queues with a single atomic operation */
+    struct QueuedRay {
+      Ray ray;
+      u32 pathIndex;
+      Vec3 radiance;
+    };
+    std::vector<QueuedRay> bounceRays;
+    std::vector<QueuedRay> shadowRays;
+    bounceRays.reserve(end - begin);
+    shadowRays.reserve(end - begin);
+    for (u64 iSlot = begin; iSlot < end; ++iSlot) {
+      auto slot = static_cast<u32>(iSlot);
+      if (mShadingQueue.materialIndices[slot] == invalidIndex) {
+        continue;
+      }
+      u32 pathIndex = mRays.pathIndices[slot];
+      Vec3 &throughput = mThroughputs[pathIndex];
+      if ((mShadeFlags[slot] & litFlag) != 0) {
+        const LightSample &lightSample = mLightSamples[slot];
+        shadowRays.push_back({lightSample.shadowRay, pathIndex,
+                              throughput * mShadingQueue.lightWeights[slot] *
+                                  lightSample.radiance});
+      }
+      const Vec3 &weight = mShadingQueue.weights[slot];
+      if ((mShadeFlags[slot] & survivedFlag) == 0 ||
+          maxComponent(weight) <= 0.0f) {
+        continue;
+      }
+
+      throughput *= weight;
+      throughput *= 1.0f / mSurvivals[slot];
+      bounceRays.push_back(
+          {{mPositions[slot], mShadingQueue.directions[slot]}, pathIndex, {}});
+      mCountEmission[pathIndex] = mShadingQueue.specular[slot];
+    }
+
+    u32 firstSlot = mNextRays.append(static_cast<u32>(bounceRays.size()));
+    for (u32 iRay = 0; iRay < bounceRays.size(); ++iRay) {
+      mNextRays.setRay(firstSlot + iRay, bounceRays[iRay].ray,
+                       bounceRays[iRay].pathIndex);
+    }
+    firstSlot = mShadowRays.append(static_cast<u32>(shadowRays.size()));
+    for (u32 iRay = 0; iRay < shadowRays.size(); ++iRay) {
+      mShadowRays.setRay(firstSlot + iRay, shadowRays[iRay].ray,
+                         shadowRays[iRay].pathIndex);
+      mShadowRadiances[firstSlot + iRay] = shadowRays[iRay].radiance;
+    }
+  });
+}
+
+void WavefrontPathTracer::traceShadowRays(const Scene &scene,
+                                          RenderStats &stats) {
+  NEKO_PROFILE_FUNCTION();
+  /* Each path queued at most one shadow ray, so paths are updated without
+  synchronization. The occluder cache is kept per chunk, whose rays are
+  queried 8 at a time */
+  u32 shadowRayCount = mShadowRays.size.load();
+  std::atomic<u64> cachedOcclusionCount = 0;
+  stats.traversal += parallelReduce(
+      *mpThreadPool, 0, shadowRayCount, 0, TraversalStats{},
+      [&](u64 begin, u64 end) {
+        TraversalStats chunkStats;
+        OcclusionCache occlusionCache;
+        RayPacket<8> packet;
+        for (u64 iFirst = begin; iFirst < end; iFirst += 8) {
+          auto laneCount = static_cast<u32>(std::min<u64>(end - iFirst, 8));
+          for (u32 lane = 0; lane < laneCount; ++lane) {
+            packet.setRay(lane,
+                          mShadowRays.ray(static_cast<u32>(iFirst + lane)));
+          }
+          u32 validMask = (1u << laneCount) - 1;
+          u32 occludedMask =
+              scene.occluded8(validMask, packet, occlusionCache, chunkStats);
+          for (u32 mask = validMask & ~occludedMask; mask != 0;
+               mask &= mask - 1) {
+            auto slot = static_cast<u32>(iFirst) +
+                        static_cast<u32>(std::countr_zero(mask));
+            mRadiances[mShadowRays.pathIndices[slot]] +=
+                mShadowRadiances[slot];
+          }
+        }
+        cachedOcclusionCount.fetch_add(occlusionCache.hitCount,
+                                       std::memory_order_relaxed);
+        return chunkStats;
+      },
+      [](TraversalStats lhs, const TraversalStats &rhs) {
+        return lhs += rhs;
+      });
+  stats.shadowRayCount += shadowRayCount;
+  stats.cachedOcclusionCount += cachedOcclusionCount.load();
+}
+
+void WavefrontPathTracer::accumulate(Framebuffer &framebuffer,
+                                     u32 sampleIndex) {
+  NEKO_PROFILE_FUNCTION();
+  u32 width = framebuffer.width();
+  bool lastSample = sampleIndex + 1 == mSamplesPerPixel;
+  f32 sampleWeight = 1.0f / static_cast<f32>(mSamplesPerPixel);
+  parallelFor(*mpThreadPool, 0, mRadiances.size(), 0, [&](u64 iPath) {
+    Vec3 &pixel = framebuffer.at(static_cast<u32>(iPath % width),
+                                 static_cast<u32>(iPath / width));
+    Vec3 sum = sampleIndex == 0 ? mRadiances[iPath] : pixel + mRadiances[iPath];
+    pixel = lastSample ? sum * sampleWeight : sum;
+  });
+}
+
+void WavefrontPathTracer::swapRayQueues() noexcept {
+  std::swap(mRays.originX, mNextRays.originX);
+  std::swap(mRays.originY, mNextRays.originY);
+  std::swap(mRays.originZ, mNextRays.originZ);
+  std::swap(mRays.directionX, mNextRays.directionX);
+  std::swap(mRays.directionY, mNextRays.directionY);
+  std::swap(mRays.directionZ, mNextRays.directionZ);
+  std::swap(mRays.tMax, mNextRays.tMax);
+  std::swap(mRays.pathIndices, mNextRays.pathIndices);
+  mRays.size = mNextRays.size.load();
+  mNextRays.size = 0;
+}
+
+} /* namespace neko */
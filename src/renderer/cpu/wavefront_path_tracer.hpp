@@ -0,0 +1,242 @@
+#ifndef NEKO_RENDERER_CPU_WAVEFRONT_PATH_TRACER_HPP
+#define NEKO_RENDERER_CPU_WAVEFRONT_PATH_TRACER_HPP
+
+#include "path_tracer.hpp"
+#include "ray_sort.hpp"
+#include "sampling.hpp"
+#include "shading.hpp"
+
+#include <atomic>
+
+namespace neko {
+
+/**
+ * @brief Rays waiting for a wavefront stage, stored as structure of arrays.
+ * Each ray continues the path {pathIndices[slot]}.
+ */
+struct RayQueue {
+  std::vector<f32> originX;
+  std::vector<f32> originY;
+  std::vector<f32> originZ;
+  std::vector<f32> directionX;
+  std::vector<f32> directionY;
+  std::vector<f32> directionZ;
+  std::vector<f32> tMax;
+  std::vector<u32> pathIndices;
+  /* Slots in use, filled concurrently by the stages */
+  std::atomic<u32> size = 0;
+
+  void resize(u32 capacity);
+
+  /* Reserves {count} consecutive slots and returns the first one */
+  u32 append(u32 count) noexcept {
+    return size.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  void setRay(u32 slot, const Ray &ray, u32 pathIndex) noexcept {
+    originX[slot] = ray.origin.x;
+    originY[slot] = ray.origin.y;
+    originZ[slot] = ray.origin.z;
+    directionX[slot] = ray.direction.x;
+    directionY[slot] = ray.direction.y;
+    directionZ[slot] = ray.direction.z;
+    tMax[slot] = ray.tMax;
+    pathIndices[slot] = pathIndex;
+  }
+
+  Ray ray(u32 slot) const noexcept {
+    return {{originX[slot], originY[slot], originZ[slot]},
+            {directionX[slot], directionY[slot], directionZ[slot]},
+            tMax[slot]};
+  }
+};
+
+/**
+ * @brief Closest hits of the rays of a {RayQueue}, slot for slot.
+ */
+struct HitQueue {
+  std::vector<f32> t;
+  std::vector<u32> triangleIndices;
+  std::vector<u32> instanceIndices;
+
+  void resize(u32 capacity);
+
+  void setHit(u32 slot, const Hit &hit) noexcept {
+    t[slot] = hit.t;
+    triangleIndices[slot] = hit.triangleIndex;
+    instanceIndices[slot] = hit.instanceIndex;
+  }
+
+  /* Shading only needs the distance and the primitive */
+  Hit hit(u32 slot) const noexcept {
+    return {t[slot], 0.0f, 0.0f, triangleIndices[slot], instanceIndices[slot]};
+  }
+};
+
+/* Milliseconds spent in each stage of a wavefront frame */
+struct WavefrontStageTimes {
+  f32 generate = 0.0f;
+  f32 sort = 0.0f;
+  f32 extend = 0.0f;
+  /* Includes the batched BSDF evaluation, see {MaterialShadingStats} */
+  f32 shade = 0.0f;
+  f32 shadow = 0.0f;
+  f32 accumulate = 0.0f;
+};
+
+/**
+ * @brief Cost and benefit of sorting the rays of one bounce, summed over the
+ * samples of a frame. Extend counters are split by whether the rays were
+ * sorted first, the comparison is only meaningful once both were measured.
+ */
+struct BounceSortStats {
+  u64 sortedRayCount = 0;
+  u64 unsortedRayCount = 0;
+  /* Milliseconds */
+  f32 sortTime = 0.0f;
+  f32 sortedExtendTime = 0.0f;
+  f32 unsortedExtendTime = 0.0f;
+  u64 sortedVisitedNodeCount = 0;
+  u64 unsortedVisitedNodeCount = 0;
+
+  /* Nanoseconds per ray */
+  f64 sortCost() const noexcept { return perRay(sortTime, sortedRayCount); }
+  f64 sortedExtendCost() const noexcept {
+    return perRay(sortedExtendTime, sortedRayCount);
+  }
+  f64 unsortedExtendCost() const noexcept {
+    return perRay(unsortedExtendTime, unsortedRayCount);
+  }
+
+  /* Whether sorting saved more traversal time than it cost */
+  bool sortingPays() const noexcept {
+    return sortCost() + sortedExtendCost() < unsortedExtendCost();
+  }
+
+private:
+  static f64 perRay(f32 time, u64 rayCount) noexcept {
+    return rayCount > 0 ? static_cast<f64>(time) * 1e6 /
+                              static_cast<f64>(rayCount)
+                        : 0.0;
+  }
+};
+
+/**
+ * @brief CPU path tracer organized as a wavefront: every pixel traces one
+ * path per sample, and all the paths of a sample advance together through
+ * separate stages instead of one pixel at a time. Generate writes the camera
+ * rays, extend finds their closest hits, shade adds emission, evaluates the
+ * BSDFs with {BatchedShader} and queues the shadow and bounce rays, shadow
+ * resolves the light samples and accumulate
+ * adds the finished paths to the image. Each stage is a parallel loop over a
+ * large queue, so its code and data stay hot, and the queues are compacted
+ * between bounces so that only live paths are processed. Bounce rays can
+ * be sorted by direction octant and origin cell before extend, always or only
+ * for the bounces where the measured traversal savings exceed the sort cost.
+ * Renders the same image as {PathTracer}.
+ */
+class WavefrontPathTracer {
+public:
+  WavefrontPathTracer(const Settings &settings, ThreadPool &threadPool);
+  WavefrontPathTracer(const WavefrontPathTracer &) = delete;
+  WavefrontPathTracer(WavefrontPathTracer &&) = delete;
+  WavefrontPathTracer &operator=(const WavefrontPathTracer &) = delete;
+  WavefrontPathTracer &operator=(WavefrontPathTracer &&) = delete;
+  ~WavefrontPathTracer() = default;
+
+  /**
+   * @brief Renders {scene} into {framebuffer}, overwriting its content.
+   */
+  RenderStats render(const Scene &scene, Framebuffer &framebuffer);
+
+  /* Stage times of the last frame */
+  const WavefrontStageTimes &stageTimes() const noexcept {
+    return mStageTimes;
+  }
+
+  /* Batched BSDF evaluation of the last frame */
+  const MaterialShadingStats &shadingStats() const noexcept {
+    return mShader.stats();
+  }
+
+  /* Sorting statistics of the last frame, indexed by bounce. Camera rays are
+  never sorted */
+  const std::vector<BounceSortStats> &bounceSortStats() const noexcept {
+    return mBounceSortStats;
+  }
+
+private:
+  ThreadPool *mpThreadPool;
+  u32 mSamplesPerPixel;
+  u32 mMaxBounces;
+  RaySortMode mRaySorting;
+  WavefrontStageTimes mStageTimes;
+  std::vector<BounceSortStats> mBounceSortStats;
+
+  /* Path states, indexed by pixel. Each pixel keeps its sample stream
+  across samples, as {PathTracer} does */
+  Sampler mSampler;
+  std::vector<SampleStream> mPathSamples;
+  /* Camera sample offsets of each pixel, generated a row at a time */
+  std::vector<f32> mCameraOffsetsX;
+  std::vector<f32> mCameraOffsetsY;
+  std::vector<Vec3> mThroughputs;
+  std::vector<Vec3> mRadiances;
+  /* Whether the next hit adds its emission, false once next event estimation
+  has accounted for it */
+  std::vector<u8> mCountEmission;
+
+  RayQueue mRays;
+  RayQueue mNextRays;
+  HitQueue mHits;
+  RayQueue mShadowRays;
+  /* Radiance each shadow ray brings to its path if unoccluded */
+  std::vector<Vec3> mShadowRadiances;
+
+  /* Hit points of {mRays}, slot for slot, and what shading needs besides
+  the BSDF */
+  BatchedShader mShader;
+  ShadingQueue mShadingQueue;
+  std::vector<Vec3> mPositions;
+  std::vector<LightSample> mLightSamples;
+  std::vector<f32> mSurvivals;
+  std::vector<u8> mShadeFlags;
+
+  RaySortKeyEncoder mKeyEncoder;
+  std::vector<u32> mSortKeys;
+  std::vector<u32> mSortedSlots;
+  std::vector<u32> mScratchKeys;
+  std::vector<u32> mScratchSlots;
+
+  void generate(const Scene &scene, const Framebuffer &framebuffer,
+                u32 sampleIndex);
+
+  /* Whether to sort the rays of bounce {depth}, probing both options first
+  in adaptive mode */
+  bool shouldSortRays(u32 depth) const noexcept;
+
+  /* Reorders {mRays} by sort key */
+  void sortRays();
+
+  void extend(const Scene &scene, RenderStats &stats);
+
+  void shade(const Scene &scene, u32 depth);
+
+  /* Adds emission, samples the lights and plays Russian roulette, filling
+  {mShadingQueue} */
+  void prepareShading(const Scene &scene, u32 depth);
+
+  /* Queues the shadow and bounce rays of the shaded hit points */
+  void queueRays();
+
+  void traceShadowRays(const Scene &scene, RenderStats &stats);
+
+  void accumulate(Framebuffer &framebuffer, u32 sampleIndex);
+
+  /* Bounce rays become the input of the next extend stage */
+  void swapRayQueues() noexcept;
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_WAVEFRONT_PATH_TRACER_HPP */
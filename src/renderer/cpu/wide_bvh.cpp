@@ -0,0 +1,157 @@
+#include "wide_bvh.hpp"
+
+namespace neko {
+
+/* Each wide node starts from the two children of a binary node and repeatedly
+opens the interior child with the largest surface area, until {Width}
+children are gathered or only leaves are left */
+template <u32 Width>
+void collapseBvh(const Bvh &bvh, std::vector<WideBvhNode<Width>> &wideNodes) {
+  const auto &binaryNodes = bvh.nodes();
+  struct PendingNode {
+    u32 binaryIndex;
+    u32 wideIndex;
+  };
+  std::vector<PendingNode> pendingNodes = {{0, 0}};
+  wideNodes.assign(1, {});
+  while (!pendingNodes.empty()) {
+    auto [binaryIndex, wideIndex] = pendingNodes.back();
+    pendingNodes.pop_back();
+
+    u32 candidates[Width];
+    u32 candidateCount = 0;
+    const BvhNode &binaryNode = binaryNodes[binaryIndex];
+    if (binaryNode.leaf()) {
+      /* Only happens for a root leaf */
+      candidates[candidateCount++] = binaryIndex;
+    } else {
+      candidates[candidateCount++] = binaryNode.offset;
+      candidates[candidateCount++] = binaryNode.offset + 1;
+    }
+    while (candidateCount < Width) {
+      u32 openedIndex = invalidIndex;
+      f32 largestArea = -1.0f;
+      for (u32 iCandidate = 0; iCandidate < candidateCount; ++iCandidate) {
+        const BvhNode &candidate = binaryNodes[candidates[iCandidate]];
+        f32 area = candidate.bounds().surfaceArea();
+        if (!candidate.leaf() && area > largestArea) {
+          largestArea = area;
+          openedIndex = iCandidate;
+        }
+      }
+      if (openedIndex == invalidIndex) {
+        break;
+      }
+      u32 firstChild = binaryNodes[candidates[openedIndex]].offset;
+      candidates[openedIndex] = firstChild;
+      candidates[candidateCount++] = firstChild + 1;
+    }
+
+    WideBvhNode<Width> wideNode;
+    for (u32 iSlot = 0; iSlot < Width; ++iSlot) {
+      if (iSlot >= candidateCount) {
+        for (u32 axis = 0; axis < 3; ++axis) {
+          wideNode.bounds[2 * axis][iSlot] = infinity;
+          wideNode.bounds[2 * axis + 1][iSlot] = -infinity;
+        }
+        wideNode.children[iSlot] = invalidIndex;
+        wideNode.primitiveCounts[iSlot] = 0;
+        continue;
+      }
+      const BvhNode &child = binaryNodes[candidates[iSlot]];
+      for (u32 axis = 0; axis < 3; ++axis) {
+        wideNode.bounds[2 * axis][iSlot] = child.lower[axis];
+        wideNode.bounds[2 * axis + 1][iSlot] = child.upper[axis];
+      }
+      if (child.leaf()) {
+        wideNode.children[iSlot] = child.offset;
+        wideNode.primitiveCounts[iSlot] = child.primitiveCount;
+      } else {
+        auto childWideIndex = static_cast<u32>(wideNodes.size());
+        wideNodes.emplace_back();
+        pendingNodes.push_back({candidates[iSlot], childWideIndex});
+        wideNode.children[iSlot] = childWideIndex;
+        wideNode.primitiveCounts[iSlot] = 0;
+      }
+    }
+    wideNodes[wideIndex] = wideNode;
+  }
+}
+
+template void collapseBvh<4>(const Bvh &bvh,
+                             std::vector<WideBvhNode<4>> &wideNodes);
+template void collapseBvh<8>(const Bvh &bvh,
+                             std::vector<WideBvhNode<8>> &wideNodes);
+
+/**
+ * @brief Replaces the primitive references of the leaf children by the
+ * triangle blocks they are packed into.
+ */
+template <u32 Width, u32 BlockWidth>
+static void packLeaves(const Bvh &bvh, const std::vector<Triangle> &triangles,
+                       std::vector<WideBvhNode<Width>> &wideNodes,
+                       std::vector<TriangleBlock<BlockWidth>> &blocks) {
+  const std::vector<u32> &primitiveIndices = bvh.primitiveIndices();
+  for (WideBvhNode<Width> &wideNode : wideNodes) {
+    for (u32 iSlot = 0; iSlot < Width; ++iSlot) {
+      if (wideNode.primitiveCounts[iSlot] == 0) {
+        continue;
+      }
+      auto firstBlock = static_cast<u32>(blocks.size());
+      wideNode.primitiveCounts[iSlot] = appendTriangleBlocks(
+          blocks, triangles, primitiveIndices.data() + wideNode.children[iSlot],
+          wideNode.primitiveCounts[iSlot]);
+      wideNode.children[iSlot] = firstBlock;
+    }
+  }
+}
+
+template <u32 Width>
+static void collapseAndPack(const Bvh &bvh,
+                            const std::vector<Triangle> &triangles,
+                            u32 blockWidth,
+                            std::vector<WideBvhNode<Width>> &wideNodes,
+                            std::vector<TriangleBlock<4>> &blocks4,
+                            std::vector<TriangleBlock<8>> &blocks8) {
+  collapseBvh(bvh, wideNodes);
+  if (blockWidth == 4) {
+    packLeaves(bvh, triangles, wideNodes, blocks4);
+  } else {
+    packLeaves(bvh, triangles, wideNodes, blocks8);
+  }
+}
+
+void WideBvh::build(const Bvh &bvh, const std::vector<Triangle> &triangles,
+                    u32 width, SimdIsa isa) {
+  if (width != 4 && width != 8) {
+    throw std::runtime_error("Wide BVHs have 4 or 8 children per node.");
+  }
+  mWidth = width;
+  mNodes4.clear();
+  mNodes8.clear();
+  mBlocks4.clear();
+  mBlocks8.clear();
+  mKernels = {};
+  if (bvh.empty()) {
+    return;
+  }
+
+  /* The block width depends on the instruction set the kernel can use */
+  mIsa = clampWideBvhIsa(width, isa);
+  mBlockWidth = selectTriangleBlockWidth(mIsa, bvh.maxLeafSize());
+  if (width == 4) {
+    collapseAndPack(bvh, triangles, mBlockWidth, mNodes4, mBlocks4, mBlocks8);
+  } else {
+    collapseAndPack(bvh, triangles, mBlockWidth, mNodes8, mBlocks4, mBlocks8);
+  }
+  mKernels = selectWideBvhKernels(width, mBlockWidth, mIsa);
+}
+
+u64 WideBvh::memoryBytes() const noexcept {
+  return mNodes4.size() * sizeof(WideBvhNode<4>) +
+         mNodes8.size() * sizeof(WideBvhNode<8>) +
+         mBlocks4.size() * sizeof(TriangleBlock<4>) +
+         mBlocks8.size() * sizeof(TriangleBlock<8>);
+}
+
+} /* namespace neko */
@@ -0,0 +1,151 @@
+#ifndef NEKO_RENDERER_CPU_WIDE_BVH_HPP
+#define NEKO_RENDERER_CPU_WIDE_BVH_HPP
+
+#include "bvh.hpp"
+#include "simd.hpp"
+#include "triangle_block.hpp"
+
+namespace neko {
+
+/**
+ * @brief Node with up to {Width} children whose bounds are stored as
+ * structure of arrays, so one SIMD slab test covers all of them.
+ * {bounds[2 * axis]} holds the lower and {bounds[2 * axis + 1]} the upper
+ * bounds along {axis}. Unused slots have inverted (empty) bounds, which no ray
+ * can hit.
+ */
+template <u32 Width> struct alignas(32) WideBvhNode {
+  f32 bounds[6][Width];
+  /* Child node index, or first triangle block of a leaf child */
+  u32 children[Width];
+  /* Triangle blocks of a leaf child, 0 for node children and unused slots */
+  u32 primitiveCounts[Width];
+};
+
+static_assert(sizeof(WideBvhNode<4>) == 128, "BVH4 nodes span 2 cache lines");
+static_assert(sizeof(WideBvhNode<8>) == 256, "BVH8 nodes span 4 cache lines");
+
+/**
+ * @brief Collapses the binary {bvh} top-down into {wideNodes}, root first.
+ * Leaf children still reference the primitive references of {bvh} instead of
+ * triangle blocks, with their primitive count.
+ */
+template <u32 Width>
+void collapseBvh(const Bvh &bvh, std::vector<WideBvhNode<Width>> &wideNodes);
+
+/**
+ * @brief 4- or 8-wide BVH over triangles, obtained by collapsing a binary
+ * {Bvh}. Traversal runs a single slab test per node over all children and
+ * visits the hit children front to back. Leaves hold triangle blocks, tested
+ * with the watertight kernel. The kernel is chosen once at build time from the
+ * requested width and instruction set.
+ */
+class WideBvh {
+public:
+  typedef bool (*IntersectFunc_T)(const WideBvh &wideBvh, Ray &ray, Hit &hit,
+                                  TraversalStats &stats);
+  typedef bool (*OccludedFunc_T)(const WideBvh &wideBvh, const Ray &ray,
+                                 u32 &occluderIndex, TraversalStats &stats);
+
+  /* Closest- and any-hit traversals of the same width and instruction set */
+  struct Kernels {
+    IntersectFunc_T pIntersect = nullptr;
+    OccludedFunc_T pOccluded = nullptr;
+  };
+
+  WideBvh() = default;
+  WideBvh(const WideBvh &) = delete;
+  WideBvh(WideBvh &&) = default;
+  WideBvh &operator=(const WideBvh &) = delete;
+  WideBvh &operator=(WideBvh &&) = default;
+  ~WideBvh() = default;
+
+  /**
+   * @brief Collapses {bvh}, built over {triangles}, into nodes of {width}
+   * children. Width 8 needs {SimdIsa::avx2} and width 4 {SimdIsa::sse} for the
+   * vectorized kernels, other combinations use the scalar kernel. Leaves are
+   * packed into blocks of {selectTriangleBlockWidth} triangles.
+   */
+  void build(const Bvh &bvh, const std::vector<Triangle> &triangles,
+             u32 width, SimdIsa isa);
+
+  bool empty() const noexcept { return mKernels.pIntersect == nullptr; }
+
+  u32 width() const noexcept { return mWidth; }
+
+  /* Instruction set of the selected traversal kernel */
+  SimdIsa isa() const noexcept { return mIsa; }
+
+  u32 nodeCount() const noexcept {
+    return static_cast<u32>(mWidth == 4 ? mNodes4.size() : mNodes8.size());
+  }
+
+  template <u32 Width> const std::vector<WideBvhNode<Width>> &nodes() const {
+    static_assert(Width == 4 || Width == 8, "Unsupported BVH width");
+    if constexpr (Width == 4) {
+      return mNodes4;
+    } else {
+      return mNodes8;
+    }
+  }
+
+  u32 blockWidth() const noexcept { return mBlockWidth; }
+
+  /* Leaf triangles, in blocks of {blockWidth()} */
+  template <u32 BlockWidth>
+  const std::vector<TriangleBlock<BlockWidth>> &blocks() const {
+    static_assert(BlockWidth == 4 || BlockWidth == 8, "Unsupported block");
+    if constexpr (BlockWidth == 4) {
+      return mBlocks4;
+    } else {
+      return mBlocks8;
+    }
+  }
+
+  /**
+   * @brief Finds the closest hit along {ray}, reported with the scene index
+   * of the triangle.
+   */
+  bool intersect(Ray &ray, Hit &hit, TraversalStats &stats) const {
+    return mKernels.pIntersect(*this, ray, hit, stats);
+  }
+
+  /**
+   * @brief Whether any triangle is hit before {ray.tMax}, stopping at the
+   * first one found. Its scene index is stored in {occluderIndex}.
+   */
+  bool occluded(const Ray &ray, u32 &occluderIndex,
+                TraversalStats &stats) const {
+    return mKernels.pOccluded(*this, ray, occluderIndex, stats);
+  }
+
+  /* Bytes used by the nodes and the triangle blocks */
+  u64 memoryBytes() const noexcept;
+
+private:
+  u32 mWidth = 0;
+  u32 mBlockWidth = 4;
+  SimdIsa mIsa = SimdIsa::scalar;
+  std::vector<WideBvhNode<4>> mNodes4;
+  std::vector<WideBvhNode<8>> mNodes8;
+  std::vector<TriangleBlock<4>> mBlocks4;
+  std::vector<TriangleBlock<8>> mBlocks8;
+  Kernels mKernels;
+};
+
+/**
+ * @brief Lowers {isa} to the instruction set the traversal kernels for
+ * {width} actually use, defined in wide_bvh_kernels.cpp.
+ */
+SimdIsa clampWideBvhIsa(u32 width, SimdIsa isa) noexcept;
+
+/**
+ * @brief Traversal kernels for {width} using {isa}, which must already be
+ * clamped by {clampWideBvhIsa}. Blocks of 8 triangles are only supported by
+ * the AVX2 kernels.
+ */
+WideBvh::Kernels selectWideBvhKernels(u32 width, u32 blockWidth, SimdIsa isa);
+
+} /* namespace neko */
+
+#endif /* NEKO_RENDERER_CPU_WIDE_BVH_HPP */
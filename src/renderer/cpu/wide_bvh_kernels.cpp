@@ -0,0 +1,268 @@
+#include "compressed_bvh.hpp"
+#include "simd_lanes.hpp"
+#include "wide_bvh.hpp"
+
+#include <bit>
+
+namespace neko {
+
+/**
+ * @brief Ray data shared by the node tests of a traversal. For each axis,
+ * {nearOffsets} selects the bound the ray enters the slab through (0 for the
+ * lower, 1 for the upper bound), which also rejects the inverted bounds of
+ * unused slots without a separate check.
+ */
+struct WideRay {
+  Vec3 origin;
+  Vec3 invDirection;
+  /* {origin * invDirection}, for fused multiply-subtract slab tests */
+  Vec3 scaledOrigin;
+  u32 nearOffsets[3];
+};
+
+static WideRay makeWideRay(const Ray &ray) noexcept {
+  Vec3 invDirection = {1.0f / ray.direction.x, 1.0f / ray.direction.y,
+                       1.0f / ray.direction.z};
+  return {ray.origin,
+          invDirection,
+          {ray.origin.x * invDirection.x, ray.origin.y * invDirection.y,
+           ray.origin.z * invDirection.z},
+          {invDirection.x < 0.0f ? 1u : 0u, invDirection.y < 0.0f ? 1u : 0u,
+           invDirection.z < 0.0f ? 1u : 0u}};
+}
+
+/* The slab tests below accumulate with the new distance as the first operand
+of min/max, which drops the NaN of a ray lying in a slab plane */
+
+/* Compressed nodes are decoded inside the slab test: a quantized bound {q}
+along {axis} is reached at {q * step * invDirection + (origin - rayOrigin) *
+invDirection}, a single multiply-add per plane */
+
+namespace scalar_kernels {
+
+template <u32 Width> using BlockLanes_T = Lanes;
+
+#include "triangle_block_intersect.inl"
+
+template <u32 Width>
+static u32 intersectNode(const WideBvhNode<Width> &node, const WideRay &wideRay,
+                         f32 tMax, f32 *tEntries) noexcept {
+  u32 hitMask = 0;
+  for (u32 iSlot = 0; iSlot < Width; ++iSlot) {
+    f32 tNear = 0.0f;
+    f32 tFar = tMax;
+    for (u32 axis = 0; axis < 3; ++axis) {
+      u32 nearOffset = wideRay.nearOffsets[axis];
+      f32 tAxisNear = (node.bounds[2 * axis + nearOffset][iSlot] -
+                       wideRay.origin[axis]) *
+                      wideRay.invDirection[axis];
+      f32 tAxisFar = (node.bounds[2 * axis + 1 - nearOffset][iSlot] -
+                      wideRay.origin[axis]) *
+                     wideRay.invDirection[axis];
+      tNear = tAxisNear > tNear ? tAxisNear : tNear;
+      tFar = tAxisFar < tFar ? tAxisFar : tFar;
+    }
+    tEntries[iSlot] = tNear;
+    hitMask |= (tNear <= tFar ? 1u : 0u) << iSlot;
+  }
+  return hitMask;
+}
+
+static u32 intersectNode(const CompressedBvhNode &node, const WideRay &wideRay,
+                         f32 tMax, f32 *tEntries) noexcept {
+  f32 scales[3];
+  f32 offsets[3];
+  for (u32 axis = 0; axis < 3; ++axis) {
+    scales[axis] = node.step(axis) * wideRay.invDirection[axis];
+    offsets[axis] =
+        (node.origin[axis] - wideRay.origin[axis]) * wideRay.invDirection[axis];
+  }
+  u32 hitMask = 0;
+  for (u32 iSlot = 0; iSlot < 8; ++iSlot) {
+    f32 tNear = 0.0f;
+    f32 tFar = tMax;
+    for (u32 axis = 0; axis < 3; ++axis) {
+      u32 nearOffset = wideRay.nearOffsets[axis];
+      f32 tAxisNear =
+          static_cast<f32>(node.bounds[2 * axis + nearOffset][iSlot]) *
+              scales[axis] +
+          offsets[axis];
+      f32 tAxisFar =
+          static_cast<f32>(node.bounds[2 * axis + 1 - nearOffset][iSlot]) *
+              scales[axis] +
+          offsets[axis];
+      tNear = tAxisNear > tNear ? tAxisNear : tNear;
+      tFar = tAxisFar < tFar ? tAxisFar : tFar;
+    }
+    tEntries[iSlot] = tNear;
+    hitMask |= (tNear <= tFar ? 1u : 0u) << iSlot;
+  }
+  return hitMask;
+}
+
+#include "compressed_bvh_traversal.inl"
+#include "wide_bvh_traversal.inl"
+
+} /* namespace scalar_kernels */
+
+#if NEKO_SIMD_X86
+namespace sse_kernels {
+
+template <u32 Width> using BlockLanes_T = Lanes;
+
+#include "triangle_block_intersect.inl"
+
+static u32 intersectNode(const WideBvhNode<4> &node, const WideRay &wideRay,
+                         f32 tMax, f32 *tEntries) noexcept {
+  __m128 tNear = _mm_setzero_ps();
+  __m128 tFar = _mm_set1_ps(tMax);
+  for (u32 axis = 0; axis < 3; ++axis) {
+    u32 nearOffset = wideRay.nearOffsets[axis];
+    __m128 origin = _mm_set1_ps(wideRay.origin[axis]);
+    __m128 invDirection = _mm_set1_ps(wideRay.invDirection[axis]);
+    __m128 tAxisNear = _mm_mul_ps(
+        _mm_sub_ps(_mm_load_ps(node.bounds[2 * axis + nearOffset]), origin),
+        invDirection);
+    __m128 tAxisFar = _mm_mul_ps(
+        _mm_sub_ps(_mm_load_ps(node.bounds[2 * axis + 1 - nearOffset]),
+                   origin),
+        invDirection);
+    tNear = _mm_max_ps(tAxisNear, tNear);
+    tFar = _mm_min_ps(tAxisFar, tFar);
+  }
+  _mm_store_ps(tEntries, tNear);
+  return static_cast<u32>(_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)));
+}
+
+#include "wide_bvh_traversal.inl"
+
+} /* namespace sse_kernels */
+
+NEKO_BEGIN_TARGET_AVX2
+namespace avx2_kernels {
+
+/* Blocks of 4 are tested with the VEX encoding of the SSE lanes */
+template <u32 Width>
+using BlockLanes_T =
+    std::conditional_t<Width == 8, Lanes, sse_kernels::Lanes>;
+
+#include "triangle_block_intersect.inl"
+
+static u32 intersectNode(const WideBvhNode<8> &node, const WideRay &wideRay,
+                         f32 tMax, f32 *tEntries) noexcept {
+  __m256 tNear = _mm256_setzero_ps();
+  __m256 tFar = _mm256_set1_ps(tMax);
+  for (u32 axis = 0; axis < 3; ++axis) {
+    u32 nearOffset = wideRay.nearOffsets[axis];
+    __m256 scaledOrigin = _mm256_set1_ps(wideRay.scaledOrigin[axis]);
+    __m256 invDirection = _mm256_set1_ps(wideRay.invDirection[axis]);
+    __m256 tAxisNear =
+        _mm256_fmsub_ps(_mm256_load_ps(node.bounds[2 * axis + nearOffset]),
+                        invDirection, scaledOrigin);
+    __m256 tAxisFar = _mm256_fmsub_ps(
+        _mm256_load_ps(node.bounds[2 * axis + 1 - nearOffset]), invDirection,
+        scaledOrigin);
+    tNear = _mm256_max_ps(tAxisNear, tNear);
+    tFar = _mm256_min_ps(tAxisFar, tFar);
+  }
+  _mm256_store_ps(tEntries, tNear);
+  return static_cast<u32>(
+      _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ)));
+}
+
+/* Widens 8 quantized bounds to floats */
+static __m256 loadQuantized(const u8 *bounds) noexcept {
+  return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i *>(bounds))));
+}
+
+static u32 intersectNode(const CompressedBvhNode &node, const WideRay &wideRay,
+                         f32 tMax, f32 *tEntries) noexcept {
+  __m256 tNear = _mm256_setzero_ps();
+  __m256 tFar = _mm256_set1_ps(tMax);
+  for (u32 axis = 0; axis < 3; ++axis) {
+    u32 nearOffset = wideRay.nearOffsets[axis];
+    __m256 scale =
+        _mm256_set1_ps(node.step(axis) * wideRay.invDirection[axis]);
+    __m256 offset = _mm256_set1_ps((node.origin[axis] - wideRay.origin[axis]) *
+                                   wideRay.invDirection[axis]);
+    __m256 tAxisNear = _mm256_fmadd_ps(
+        loadQuantized(node.bounds[2 * axis + nearOffset]), scale, offset);
+    __m256 tAxisFar = _mm256_fmadd_ps(
+        loadQuantized(node.bounds[2 * axis + 1 - nearOffset]), scale, offset);
+    tNear = _mm256_max_ps(tAxisNear, tNear);
+    tFar = _mm256_min_ps(tAxisFar, tFar);
+  }
+  _mm256_store_ps(tEntries, tNear);
+  return static_cast<u32>(
+      _mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ)));
+}
+
+#include "compressed_bvh_traversal.inl"
+#include "wide_bvh_traversal.inl"
+
+} /* namespace avx2_kernels */
+NEKO_END_TARGET_AVX2
+#endif /* NEKO_SIMD_X86 */
+
+SimdIsa clampWideBvhIsa(u32 width, SimdIsa isa) noexcept {
+#if NEKO_SIMD_X86
+  if (width == 8 && isa >= SimdIsa::avx2) {
+    return SimdIsa::avx2;
+  }
+  if (width == 4 && isa >= SimdIsa::sse) {
+    return SimdIsa::sse;
+  }
+#endif /* NEKO_SIMD_X86 */
+  return SimdIsa::scalar;
+}
+
+WideBvh::Kernels selectWideBvhKernels(u32 width, u32 blockWidth, SimdIsa isa) {
+#if NEKO_SIMD_X86
+  if (width == 8 && isa == SimdIsa::avx2) {
+    if (blockWidth == 8) {
+      return {&avx2_kernels::intersectWide<8, 8>,
+              &avx2_kernels::occludedWide<8, 8>};
+    }
+    return {&avx2_kernels::intersectWide<8, 4>,
+            &avx2_kernels::occludedWide<8, 4>};
+  }
+  if (width == 4 && isa == SimdIsa::sse) {
+    return {&sse_kernels::intersectWide<4, 4>,
+            &sse_kernels::occludedWide<4, 4>};
+  }
+#endif /* NEKO_SIMD_X86 */
+  if (width == 8) {
+    return {&scalar_kernels::intersectWide<8, 4>,
+            &scalar_kernels::occludedWide<8, 4>};
+  }
+  return {&scalar_kernels::intersectWide<4, 4>,
+          &scalar_kernels::occludedWide<4, 4>};
+}
+
+SimdIsa clampCompressedBvhIsa(SimdIsa isa) noexcept {
+#if NEKO_SIMD_X86
+  if (isa >= SimdIsa::avx2) {
+    return SimdIsa::avx2;
+  }
+#endif /* NEKO_SIMD_X86 */
+  return SimdIsa::scalar;
+}
+
+CompressedBvh::Kernels selectCompressedBvhKernels(u32 blockWidth,
+                                                  SimdIsa isa) {
+#if NEKO_SIMD_X86
+  if (isa == SimdIsa::avx2) {
+    if (blockWidth == 8) {
+      return {&avx2_kernels::intersectCompressed<8>,
+              &avx2_kernels::occludedCompressed<8>};
+    }
+    return {&avx2_kernels::intersectCompressed<4>,
+            &avx2_kernels::occludedCompressed<4>};
+  }
+#endif /* NEKO_SIMD_X86 */
+  return {&scalar_kernels::intersectCompressed<4>,
+          &scalar_kernels::occludedCompressed<4>};
+}
+
+} /* namespace neko */
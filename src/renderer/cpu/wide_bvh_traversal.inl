@@ -0,0 +1,105 @@
+/* Closest- and any-hit traversals of a {WideBvh}, included by
+wide_bvh_kernels.cpp once per instruction set, inside a namespace that provides
+the matching {intersectNode(node, wideRay, tMax, tEntries)}. The node test
+returns the mask of hit slots and stores their entry distances in {tEntries} */
+
+template <u32 Width, u32 BlockWidth>
+bool intersectWide(const WideBvh &wideBvh, Ray &ray, Hit &hit,
+                   TraversalStats &stats) {
+  ++stats.rayCount;
+  const std::vector<WideBvhNode<Width>> &nodes = wideBvh.nodes<Width>();
+  const std::vector<TriangleBlock<BlockWidth>> &blocks =
+      wideBvh.blocks<BlockWidth>();
+  WideRay wideRay = makeWideRay(ray);
+  WatertightRay watertightRay = makeWatertightRay(ray);
+
+  /* Node children have a primitive count of 0, leaf children reference
+  {primitiveCount} triangle blocks starting at {child} */
+  struct StackEntry {
+    u32 child;
+    u32 primitiveCount;
+    f32 tEntry;
+  };
+  StackEntry stack[Bvh::maxDepth * Width];
+  u32 stackSize = 0;
+  stack[stackSize++] = {0, 0, 0.0f};
+  bool found = false;
+  while (stackSize > 0) {
+    StackEntry entry = stack[--stackSize];
+    /* Skip subtrees behind the closest hit found since they were pushed */
+    if (entry.tEntry > ray.tMax) {
+      continue;
+    }
+    if (entry.primitiveCount > 0) {
+      found |= intersectBlocks(blocks.data() + entry.child,
+                               entry.primitiveCount, watertightRay, ray, hit);
+      continue;
+    }
+
+    const WideBvhNode<Width> &node = nodes[entry.child];
+    ++stats.visitedNodeCount;
+    alignas(32) f32 tEntries[Width];
+    u32 hitMask = intersectNode(node, wideRay, ray.tMax, tEntries);
+
+    /* Sort the hit children far to near, so the nearest is popped first */
+    StackEntry hitChildren[Width];
+    u32 hitCount = 0;
+    while (hitMask != 0) {
+      auto iSlot = static_cast<u32>(std::countr_zero(hitMask));
+      hitMask &= hitMask - 1;
+      StackEntry hitChild = {node.children[iSlot],
+                             node.primitiveCounts[iSlot], tEntries[iSlot]};
+      u32 iHit = hitCount++;
+      for (; iHit > 0 && hitChildren[iHit - 1].tEntry < hitChild.tEntry;
+           --iHit) {
+        hitChildren[iHit] = hitChildren[iHit - 1];
+      }
+      hitChildren[iHit] = hitChild;
+    }
+    for (u32 iHit = 0; iHit < hitCount; ++iHit) {
+      stack[stackSize++] = hitChildren[iHit];
+    }
+  }
+  return found;
+}
+
+/* Any-hit traversal: the hit children are pushed unsorted, and the first
+triangle found before {ray.tMax} ends the query */
+template <u32 Width, u32 BlockWidth>
+bool occludedWide(const WideBvh &wideBvh, const Ray &ray, u32 &occluderIndex,
+                  TraversalStats &stats) {
+  ++stats.rayCount;
+  const std::vector<WideBvhNode<Width>> &nodes = wideBvh.nodes<Width>();
+  const std::vector<TriangleBlock<BlockWidth>> &blocks =
+      wideBvh.blocks<BlockWidth>();
+  WideRay wideRay = makeWideRay(ray);
+  WatertightRay watertightRay = makeWatertightRay(ray);
+
+  struct StackEntry {
+    u32 child;
+    u32 primitiveCount;
+  };
+  StackEntry stack[Bvh::maxDepth * Width];
+  u32 stackSize = 0;
+  stack[stackSize++] = {0, 0};
+  while (stackSize > 0) {
+    StackEntry entry = stack[--stackSize];
+    if (entry.primitiveCount > 0) {
+      if (occludedBlocks(blocks.data() + entry.child, entry.primitiveCount,
+                         watertightRay, ray, occluderIndex)) {
+        return true;
+      }
+      continue;
+    }
+
+    const WideBvhNode<Width> &node = nodes[entry.child];
+    ++stats.visitedNodeCount;
+    alignas(32) f32 tEntries[Width];
+    for (u32 hitMask = intersectNode(node, wideRay, ray.tMax, tEntries);
+         hitMask != 0; hitMask &= hitMask - 1) {
+      auto iSlot = static_cast<u32>(std::countr_zero(hitMask));
+      stack[stackSize++] = {node.children[iSlot], node.primitiveCounts[iSlot]};
+    }
+  }
+  return false;
+}
@@ -8,10 +8,11 @@
 
 namespace neko {
 
-Device::Device(const Instance &crInstance, const Surface &crSurface) {
-  VkPhysicalDevice selectedPhysicalDevice =
-      selectPhysicalDevice(getPhysicalDevices(*crInstance));
+Device::Device(const Instance &crInstance, const Surface &crSurface)
+    : Device{selectPhysicalDevice(crInstance), crSurface} {}
 
+Device::Device(VkPhysicalDevice selectedPhysicalDevice,
+               const Surface &crSurface) {
   u32 selectedQueueFamilyIndex =
       selectUniversalQueueFamily(selectedPhysicalDevice, *crSurface);
   u32 selectedQueueIndex = 0;
@@ -87,6 +88,10 @@ u32 Device::selectUniversalQueueFamily(VkPhysicalDevice physicalDevice,
   throw std::runtime_error("Failed to select a queue family.");
 }
 
+VkPhysicalDevice Device::selectPhysicalDevice(const Instance &crInstance) {
+  return selectPhysicalDevice(getPhysicalDevices(*crInstance));
+}
+
 VkPhysicalDevice Device::selectPhysicalDevice(
     std::vector<VkPhysicalDevice> &&rrPhysicalDevices) {
   if (rrPhysicalDevices.size() == 1) {
@@ -31,6 +31,13 @@ public:
 
   Device(const Instance &crInstance, const Surface &crSurface);
 
+  /**
+   * @brief Creates the logical device on {physicalDevice}, as selected by
+   * {selectPhysicalDevice}, which does not need the surface and can run
+   * while it is created.
+   */
+  Device(VkPhysicalDevice physicalDevice, const Surface &crSurface);
+
   Device(const Device &) = delete;
 
   Device(Device &&) = default;
@@ -47,6 +54,13 @@ public:
 
   const UniversalQueue &queue() const noexcept { return mQueue; }
 
+  /**
+   * @brief Enumerates the physical devices of {crInstance} and selects the
+   * first that meets the requirements of the engine.
+   */
+  [[nodiscard]] static VkPhysicalDevice
+  selectPhysicalDevice(const Instance &crInstance);
+
 private:
   VkDevice mLogicalDevice;
   VkPhysicalDevice mPhysicalDevice;
@@ -55,18 +69,18 @@ private:
   uint32_t selectUniversalQueueFamily(VkPhysicalDevice physicalDevice,
                                       VkSurfaceKHR surface);
 
-  [[nodiscard]] VkPhysicalDevice
+  [[nodiscard]] static VkPhysicalDevice
   selectPhysicalDevice(std::vector<VkPhysicalDevice> &&rrPhysicalDevices);
 
-  bool checkRequirements(VkPhysicalDevice physicalDevice);
+  static bool checkRequirements(VkPhysicalDevice physicalDevice);
 
-  bool checkProperties(VkPhysicalDevice physicalDevice);
+  static bool checkProperties(VkPhysicalDevice physicalDevice);
 
-  bool checkExtensions(VkPhysicalDevice physicalDevice);
+  static bool checkExtensions(VkPhysicalDevice physicalDevice);
 
-  bool checkFeatures(VkPhysicalDevice physicalDevice);
+  static bool checkFeatures(VkPhysicalDevice physicalDevice);
 
-  std::vector<VkPhysicalDevice> getPhysicalDevices(VkInstance instance);
+  static std::vector<VkPhysicalDevice> getPhysicalDevices(VkInstance instance);
 };
 
 } /* namespace neko */
@@ -1,20 +1,226 @@
 #include "renderer.hpp"
 
+#include "events.hpp"
+#include "task_graph.hpp"
 #include "threads.hpp"
 
 namespace neko {
 
-Renderer::Renderer(const Settings &settings, ThreadPool &threadPool)
-    : mpSettings{&settings}, mpThreadPool{&threadPool}, mInstance{*mpSettings},
-      mWindow{*mpSettings}, mSurface{mInstance, mWindow}, mDevice{mInstance,
-                                                                  mSurface} {}
+Renderer::Renderer(const Settings &settings, ThreadPool &threadPool,
+                   EventBus &eventBus)
+    : mpSettings{&settings}, mpThreadPool{&threadPool},
+      mpEventBus{&eventBus} {}
 
 Renderer::~Renderer() = default;
 
+void Renderer::createWindow() {
+  if (mpSettings->graphics.backend != RenderBackend::vulkan) {
+    return;
+  }
+  {
+    NEKO_PROFILE_ZONE("GLFW initialization");
+    mpVulkanContext = std::make_unique<VulkanContext>();
+  }
+  NEKO_PROFILE_ZONE("Window creation");
+  mpVulkanContext->mpWindow = std::make_unique<Window>(*mpSettings);
+}
+
+void Renderer::addStartupTasks(TaskGraph &graph) {
+  switch (mpSettings->graphics.backend) {
+  case RenderBackend::vulkan:
+    addVulkanStartupTasks(graph);
+    break;
+  case RenderBackend::cpu:
+    addOfflineStartupTasks(graph);
+    break;
+  }
+}
+
+void Renderer::addVulkanStartupTasks(TaskGraph &graph) {
+  /* GLFW and the window already exist, {createWindow} made them on the main
+  thread */
+  auto instance = graph.addTask("vulkan-instance", [this] {
+    NEKO_PROFILE_ZONE("Instance creation");
+    mpVulkanContext->mpInstance = std::make_unique<Instance>(*mpSettings);
+  });
+  /* Enumerating the physical devices and querying their extensions only
+  needs the instance, so it overlaps the creation of the surface */
+  auto physicalDevice = graph.addTask("device-enumeration", [this] {
+    NEKO_PROFILE_ZONE("Device enumeration");
+    mpVulkanContext->mPhysicalDevice =
+        Device::selectPhysicalDevice(*mpVulkanContext->mpInstance);
+  });
+  auto surface = graph.addTask("surface", [this] {
+    NEKO_PROFILE_ZONE("Surface creation");
+    mpVulkanContext->mpSurface = std::make_unique<Surface>(
+        *mpVulkanContext->mpInstance, *mpVulkanContext->mpWindow);
+  });
+  auto device = graph.addTask("device", [this] {
+    NEKO_PROFILE_ZONE("Device creation");
+    mpVulkanContext->mpDevice = std::make_unique<Device>(
+        mpVulkanContext->mPhysicalDevice, *mpVulkanContext->mpSurface);
+  });
+  graph.addDependency(instance, physicalDevice);
+  graph.addDependency(instance, surface);
+  graph.addDependency(physicalDevice, device);
+  graph.addDependency(surface, device);
+}
+
+void Renderer::addOfflineStartupTasks(TaskGraph &graph) {
+  const auto &pathTracerSettings = mpSettings->graphics.pathTracer;
+  graph.addTask("path-tracer", [this, &pathTracerSettings] {
+    NEKO_PROFILE_ZONE("Path tracer creation");
+    if (pathTracerSettings.mode == PathTracerMode::wavefront) {
+      mpWavefrontPathTracer =
+          std::make_unique<WavefrontPathTracer>(*mpSettings, *mpThreadPool);
+    } else {
+      mpPathTracer = std::make_unique<PathTracer>(*mpSettings, *mpThreadPool);
+    }
+  });
+  auto scene = graph.addTask("scene", [this, &pathTracerSettings] {
+    NEKO_PROFILE_ZONE("Scene creation");
+    f32 aspectRatio = static_cast<f32>(mpSettings->graphics.screenWidth) /
+                      static_cast<f32>(mpSettings->graphics.screenHeight);
+    mScene = Scene::cornellBox(aspectRatio,
+                               pathTracerSettings.sphereSegmentCount);
+  });
+  /* Both only read the triangles of the scene */
+  auto bvh = graph.addTask("bvh", [this, &pathTracerSettings] {
+    mBvhOptions.maxLeafSize = pathTracerSettings.bvhMaxLeafSize;
+    mBvhOptions.binCount = pathTracerSettings.bvhBinCount;
+    mBvhStats = mScene.buildBvh(*mpThreadPool, mBvhOptions,
+                                pathTracerSettings.bvhWidth,
+                                pathTracerSettings.simdIsa,
+                                pathTracerSettings.compressedBvh);
+  });
+  auto lights = graph.addTask("lights", [this, &pathTracerSettings] {
+    mLightStats =
+        mScene.buildLights(*mpThreadPool, pathTracerSettings.lightSampling);
+  });
+  graph.addDependency(scene, bvh);
+  graph.addDependency(scene, lights);
+}
+
 void Renderer::start() {
-  mWindow.open();
+  if (mpPathTracer || mpWavefrontPathTracer) {
+    renderOffline();
+    return;
+  }
+  mpVulkanContext->mpWindow->open(*mpEventBus, *mpThreadPool);
   // Instance instance = std::move(mInstance);
   // mInstance.release();
 }
 
-} /* namespace neko */
\ No newline at end of file
+void Renderer::renderOffline() {
+  NEKO_PROFILE_FUNCTION();
+  const auto &pathTracerSettings = mpSettings->graphics.pathTracer;
+  u32 width = mpSettings->graphics.screenWidth;
+  u32 height = mpSettings->graphics.screenHeight;
+  Scene &scene = mScene;
+  const BvhBuildStats &bvhStats = mBvhStats;
+  Framebuffer framebuffer{width, height};
+
+  logInfo("BVH build: %zu triangles, %f ms, %u nodes, %u leaves, depth %u, "
+          "SAH cost %.2f",
+          scene.triangles().size(), static_cast<f64>(bvhStats.buildTime),
+          bvhStats.nodeCount, bvhStats.leafCount, bvhStats.maxDepth,
+          static_cast<f64>(bvhStats.sahCost));
+  /* The binary BVH references the scene triangles, the other layouts keep
+  their own copy in the leaf blocks */
+  auto triangleCount = static_cast<f64>(scene.triangles().size());
+  f64 bytesPerTriangle =
+      static_cast<f64>(scene.bvh().memoryBytes()) / triangleCount +
+      static_cast<f64>(sizeof(Triangle));
+  if (!scene.wideBvh().empty()) {
+    logInfo("BVH%u: %u nodes, %s traversal", scene.wideBvh().width(),
+            bvhStats.wideNodeCount, simdIsaName(scene.wideBvh().isa()));
+    bytesPerTriangle =
+        static_cast<f64>(scene.wideBvh().memoryBytes()) / triangleCount;
+  }
+  if (!scene.compressedBvh().empty()) {
+    logInfo("Compressed BVH8: %u nodes, %s traversal", bvhStats.wideNodeCount,
+            simdIsaName(scene.compressedBvh().isa()));
+    bytesPerTriangle =
+        static_cast<f64>(scene.compressedBvh().memoryBytes()) / triangleCount;
+  }
+  logInfo("BVH memory: %.1f bytes/triangle", bytesPerTriangle);
+  const LightBuildStats &lightStats = mLightStats;
+  logInfo("Lights: %u emitters, %s sampling, %u BVH nodes, %.1f KiB, %f ms",
+          lightStats.emitterCount,
+          lightSamplingModeName(pathTracerSettings.lightSampling),
+          lightStats.bvhNodeCount,
+          static_cast<f64>(lightStats.memoryBytes) / 1024.0,
+          static_cast<f64>(lightStats.buildTime));
+  if (!scene.instances().empty()) {
+    InstanceUpdateStats instanceStats =
+        scene.updateInstances(*mpThreadPool, mBvhOptions);
+    logInfo("Instances: %zu instances, %u meshes built, %u refitted, "
+            "BLAS %f ms, TLAS %f ms, %.1f KiB (%.1f KiB flattened)",
+            scene.instances().instances().size(), instanceStats.builtMeshCount,
+            instanceStats.refittedMeshCount,
+            static_cast<f64>(instanceStats.blasTime),
+            static_cast<f64>(instanceStats.tlasTime),
+            static_cast<f64>(scene.instances().memoryBytes()) / 1024.0,
+            static_cast<f64>(scene.instances().flattenedMemoryBytes()) /
+                1024.0);
+  }
+
+  RenderStats stats = mpPathTracer
+                          ? mpPathTracer->render(scene, framebuffer)
+                          : mpWavefrontPathTracer->render(scene, framebuffer);
+  framebuffer.writePpm(pathTracerSettings.outputFile);
+  logInfo("CPU path tracer: %ux%u, %u spp, %f ms, %.2f Mrays/s, "
+          "%.1f nodes/ray",
+          width, height, pathTracerSettings.samplesPerPixel,
+          static_cast<f64>(stats.renderTime), stats.mraysPerSecond(),
+          stats.traversal.averageVisitedNodeCount());
+  logInfo("Shadow rays: %.2f M, %.1f%% blocked by the cached occluder",
+          static_cast<f64>(stats.shadowRayCount) / 1e6,
+          stats.shadowRayCount > 0
+              ? 100.0 * static_cast<f64>(stats.cachedOcclusionCount) /
+                    static_cast<f64>(stats.shadowRayCount)
+              : 0.0);
+  if (mpPathTracer && pathTracerSettings.adaptiveSampling) {
+    logInfo("Adaptive sampling: %.1f spp on average, %u of %u tiles below "
+            "the noise threshold",
+            static_cast<f64>(stats.pixelSampleCount) /
+                (static_cast<f64>(width) * static_cast<f64>(height)),
+            stats.convergedTileCount, stats.tileCount);
+  }
+  if (mpWavefrontPathTracer) {
+    const WavefrontStageTimes &times = mpWavefrontPathTracer->stageTimes();
+    logInfo("Wavefront stages: generate %.2f ms, sort %.2f ms, extend %.2f ms, "
+            "shade %.2f ms, shadow %.2f ms, accumulate %.2f ms",
+            static_cast<f64>(times.generate), static_cast<f64>(times.sort),
+            static_cast<f64>(times.extend), static_cast<f64>(times.shade),
+            static_cast<f64>(times.shadow), static_cast<f64>(times.accumulate));
+    const auto &bounceSortStats = mpWavefrontPathTracer->bounceSortStats();
+    for (u32 depth = 1; depth < bounceSortStats.size(); ++depth) {
+      const BounceSortStats &bounceStats = bounceSortStats[depth];
+      if (bounceStats.sortedRayCount == 0) {
+        continue;
+      }
+      logInfo("Bounce %u: %.2f M rays sorted, %.2f M unsorted, "
+              "sort %.1f ns/ray, extend %.1f ns/ray sorted vs %.1f unsorted",
+              depth, static_cast<f64>(bounceStats.sortedRayCount) / 1e6,
+              static_cast<f64>(bounceStats.unsortedRayCount) / 1e6,
+              bounceStats.sortCost(), bounceStats.sortedExtendCost(),
+              bounceStats.unsortedExtendCost());
+    }
+    const MaterialShadingStats &shadingStats =
+        mpWavefrontPathTracer->shadingStats();
+    for (u32 iType = 0; iType < materialTypeCount; ++iType) {
+      if (shadingStats.hitCounts[iType] == 0) {
+        continue;
+      }
+      logInfo("Shading %s: %.2f M hits, %.2f ms, %.1f ns/hit",
+              materialTypeName(static_cast<MaterialType>(iType)),
+              static_cast<f64>(shadingStats.hitCounts[iType]) / 1e6,
+              static_cast<f64>(shadingStats.times[iType]),
+              static_cast<f64>(shadingStats.times[iType]) * 1e6 /
+                  static_cast<f64>(shadingStats.hitCounts[iType]));
+    }
+  }
+}
+
+} /* namespace neko */
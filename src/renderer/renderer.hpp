@@ -7,12 +7,18 @@
 #include "basic/surface.hpp"
 #include "basic/window.hpp"
 #include "commands/commands.hpp"
+#include "cpu/path_tracer.hpp"
+#include "cpu/wavefront_path_tracer.hpp"
 #include "devices/logical_device.hpp"
 #include "devices/physical_device.hpp"
 #include "devices/queues.hpp"
 
+#include <memory>
+
 namespace neko {
 
+class EventBus;
+class TaskGraph;
 class ThreadPool;
 
 class Renderer {
@@ -23,20 +29,73 @@ public:
   Renderer &operator=(const Renderer &) = delete;
   Renderer &operator=(Renderer &&) = default;
 
-  Renderer(const Settings &settings, ThreadPool &threadPool);
+  /**
+   * @brief Objects of the backend are only created by the tasks of
+   * {addStartupTasks}.
+   */
+  Renderer(const Settings &settings, ThreadPool &threadPool,
+           EventBus &eventBus);
 
   ~Renderer();
 
+  /**
+   * @brief Initializes GLFW and creates the window of the Vulkan backend, does
+   * nothing for the CPU backend. Must precede {addStartupTasks}.
+   * ! Must be called on the main thread, GLFW only works from it.
+   */
+  void createWindow();
+
+  /**
+   * @brief Adds the creation of the other backend objects to {graph}, as
+   * tasks named after the startup stages, with independent ones free to run
+   * concurrently. {graph} must have run before {start} is called.
+   */
+  void addStartupTasks(TaskGraph &graph);
+
+  /**
+   * @brief Runs the Vulkan backend until its window is closed, or renders one
+   * frame with the CPU path tracer and writes it to
+   * {Settings::graphics.pathTracer.outputFile}.
+   * ! Must be called on the main thread with the Vulkan backend, which
+   * ! processes the window events there.
+   */
   void start();
 
 private:
+  /* Objects of the Vulkan backend, never created by the CPU backend so it
+  runs without a GPU or a display. Created one by one by the startup tasks,
+  and destroyed in the reverse order */
+  struct VulkanContext {
+    /* Initializes GLFW before the window and the instance are created */
+    Context mContext;
+    std::unique_ptr<Instance> mpInstance;
+    std::unique_ptr<Window> mpWindow;
+    std::unique_ptr<Surface> mpSurface;
+    VkPhysicalDevice mPhysicalDevice = nullptr;
+    std::unique_ptr<Device> mpDevice;
+  };
+
   const Settings *mpSettings;
   ThreadPool *mpThreadPool;
+  EventBus *mpEventBus;
+
+  std::unique_ptr<VulkanContext> mpVulkanContext;
+  /* One of the two CPU path tracers, depending on
+  {Settings::graphics.pathTracer.mode} */
+  std::unique_ptr<PathTracer> mpPathTracer;
+  std::unique_ptr<WavefrontPathTracer> mpWavefrontPathTracer;
+  /* Scene of the CPU path tracers, with its acceleration structures built
+  during startup */
+  Scene mScene;
+  BvhBuildOptions mBvhOptions;
+  BvhBuildStats mBvhStats;
+  LightBuildStats mLightStats;
+
+  void addVulkanStartupTasks(TaskGraph &graph);
+
+  void addOfflineStartupTasks(TaskGraph &graph);
 
-  Instance mInstance;
-  Window mWindow;
-  Surface mSurface;
-  Device mDevice;
+  void renderOffline();
 };
 
 } /* namespace neko */
@@ -0,0 +1,66 @@
+#include "io.hpp"
+
+#include <fstream>
+
+namespace neko {
+
+IoService::IoService(ThreadPool &threadPool)
+    : mpThreadPool{&threadPool}, mThread{IoService::threadLoop, this} {}
+
+IoService::~IoService() {
+  {
+    MutexLock_T lock{mRequestMutex};
+    mShouldTerminate = true;
+  }
+  mRequestCondition.notify_all();
+  mThread.join();
+}
+
+void IoService::enqueue(ReadRequest &request) {
+  /* Notified under the lock: once it is released, the request may complete
+  and its coroutine destroy the service before {notify_one} returns */
+  MutexLock_T lock{mRequestMutex};
+  mRequests.push_back(&request);
+  mRequestCondition.notify_one();
+}
+
+void IoService::readFile(ReadRequest &request) {
+  std::ifstream fs(request.filePath, std::ios::binary | std::ios::ate);
+  if (!fs.is_open()) {
+    throw std::runtime_error("Failed to open file " + request.filePath);
+  }
+  auto fileSize = static_cast<std::streamsize>(fs.tellg());
+  request.data.resize(static_cast<size_t>(fileSize));
+  fs.seekg(0);
+  if (!fs.read(reinterpret_cast<char *>(request.data.data()), fileSize)) {
+    throw std::runtime_error("Failed to read file " + request.filePath);
+  }
+}
+
+void IoService::threadLoop(IoService *ioService) {
+  while (true) {
+    ReadRequest *pRequest;
+    {
+      MutexLock_T lock{ioService->mRequestMutex};
+      ioService->mRequestCondition.wait(lock, [ioService] {
+        return !ioService->mRequests.empty() || ioService->mShouldTerminate;
+      });
+      /* Pending requests are still served on shutdown, their coroutines
+      would otherwise never resume */
+      if (ioService->mRequests.empty()) {
+        return;
+      }
+      pRequest = ioService->mRequests.front();
+      ioService->mRequests.pop_front();
+    }
+    try {
+      readFile(*pRequest);
+    } catch (...) {
+      pRequest->exception = std::current_exception();
+    }
+    auto handle = pRequest->handle;
+    ioService->mpThreadPool->submitDetached([handle] { handle.resume(); });
+  }
+}
+
+} /* namespace neko */
@@ -0,0 +1,90 @@
+#ifndef NEKO_THREADS_IO_HPP
+#define NEKO_THREADS_IO_HPP
+
+#include "threads.hpp"
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace neko {
+
+/**
+ * @brief Dedicated thread for blocking file I/O. Coroutines suspended on one
+ * of its awaitables are resumed on {ThreadPool} workers once the request has
+ * completed, so waiting on the disk never occupies a worker.
+ */
+class IoService {
+  typedef std::unique_lock<std::mutex> MutexLock_T;
+
+public:
+  struct ReadRequest {
+    std::string filePath;
+    std::vector<u8> data;
+    std::exception_ptr exception = nullptr;
+    std::coroutine_handle<> handle = nullptr;
+  };
+
+  class ReadFileAwaiter {
+  public:
+    ReadFileAwaiter(IoService &ioService, std::string filePath)
+        : mpIoService{&ioService},
+          mRequest{std::move(filePath), {}, nullptr, nullptr} {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      mRequest.handle = handle;
+      mpIoService->enqueue(mRequest);
+    }
+
+    std::vector<u8> await_resume() {
+      if (mRequest.exception) {
+        std::rethrow_exception(mRequest.exception);
+      }
+      return std::move(mRequest.data);
+    }
+
+  private:
+    IoService *mpIoService;
+    ReadRequest mRequest;
+  };
+
+  explicit IoService(ThreadPool &threadPool);
+  IoService(const IoService &) = delete;
+  IoService(IoService &&) = delete;
+  IoService &operator=(const IoService &) = delete;
+  IoService &operator=(IoService &&) = delete;
+  ~IoService();
+
+  /**
+   * @brief Reads the whole file at {filePath}. Awaiting the result throws if
+   * the file cannot be read.
+   */
+  [[nodiscard]] ReadFileAwaiter readFile(std::string filePath) {
+    return {*this, std::move(filePath)};
+  }
+
+private:
+  ThreadPool *mpThreadPool;
+  std::deque<ReadRequest *> mRequests;
+  std::mutex mRequestMutex;
+  std::condition_variable mRequestCondition;
+  bool mShouldTerminate = false;
+
+  /* Started last, once the members it reads are constructed */
+  std::thread mThread;
+
+  void enqueue(ReadRequest &request);
+
+  static void readFile(ReadRequest &request);
+
+  static void threadLoop(IoService *ioService);
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_THREADS_IO_HPP */
@@ -0,0 +1,193 @@
+#ifndef NEKO_THREADS_JOB_HPP
+#define NEKO_THREADS_JOB_HPP
+
+#include "utils.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace neko {
+
+class ThreadPool;
+
+/**
+ * @brief Queue lane of a job. Workers always drain higher lanes first, both
+ * in their own queue and when stealing.
+ */
+enum class JobPriority : u8 {
+  high = 0,
+  normal = 1,
+  background = 2,
+};
+
+inline constexpr u64 jobPriorityCount = 3;
+
+/**
+ * @brief Type-erased, move-only callable with inline storage. Callables that
+ * fit in {inlineSize} bytes and are nothrow-movable are stored in place, so
+ * submitting them never touches the heap. Larger callables fall back to a
+ * single heap allocation.
+ */
+class Job {
+public:
+  static constexpr size_t inlineSize = 6 * sizeof(void *);
+
+  Job() = default;
+
+  template <typename Func, typename = std::enable_if_t<
+                               !std::is_same_v<std::decay_t<Func>, Job>>>
+  Job(Func &&func) {
+    using Callable_T = std::decay_t<Func>;
+    if constexpr (fitsInline<Callable_T>()) {
+      new (mStorage) Callable_T(std::forward<Func>(func));
+      mpOperations = &InlineOperations<Callable_T>::table;
+    } else {
+      new (mStorage) Callable_T *(new Callable_T(std::forward<Func>(func)));
+      mpOperations = &HeapOperations<Callable_T>::table;
+    }
+  }
+
+  Job(const Job &) = delete;
+
+  Job(Job &&rhs) noexcept { moveFrom(rhs); }
+
+  Job &operator=(const Job &) = delete;
+
+  Job &operator=(Job &&rhs) noexcept {
+    if (this != &rhs) {
+      reset();
+      moveFrom(rhs);
+    }
+    return *this;
+  }
+
+  ~Job() { reset(); }
+
+  explicit operator bool() const noexcept { return mpOperations != nullptr; }
+
+  void operator()() { mpOperations->invoke(mStorage); }
+
+  void reset() noexcept {
+    if (mpOperations != nullptr) {
+      mpOperations->destroy(mStorage);
+      mpOperations = nullptr;
+    }
+  }
+
+private:
+  struct Operations {
+    void (*invoke)(void *pStorage);
+    void (*move)(void *pDstStorage, void *pSrcStorage) noexcept;
+    void (*destroy)(void *pStorage) noexcept;
+  };
+
+  template <typename Callable_T> struct InlineOperations {
+    static Callable_T *get(void *pStorage) noexcept {
+      return std::launder(reinterpret_cast<Callable_T *>(pStorage));
+    }
+    static void invoke(void *pStorage) { (*get(pStorage))(); }
+    static void move(void *pDstStorage, void *pSrcStorage) noexcept {
+      new (pDstStorage) Callable_T(std::move(*get(pSrcStorage)));
+      get(pSrcStorage)->~Callable_T();
+    }
+    static void destroy(void *pStorage) noexcept {
+      get(pStorage)->~Callable_T();
+    }
+    static constexpr Operations table = {invoke, move, destroy};
+  };
+
+  template <typename Callable_T> struct HeapOperations {
+    static Callable_T *&get(void *pStorage) noexcept {
+      return *std::launder(reinterpret_cast<Callable_T **>(pStorage));
+    }
+    static void invoke(void *pStorage) { (*get(pStorage))(); }
+    static void move(void *pDstStorage, void *pSrcStorage) noexcept {
+      new (pDstStorage) Callable_T *(get(pSrcStorage));
+    }
+    static void destroy(void *pStorage) noexcept { delete get(pStorage); }
+    static constexpr Operations table = {invoke, move, destroy};
+  };
+
+  template <typename Callable_T> static constexpr bool fitsInline() {
+    return sizeof(Callable_T) <= inlineSize &&
+           alignof(Callable_T) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible_v<Callable_T>;
+  }
+
+  alignas(std::max_align_t) std::byte mStorage[inlineSize];
+  const Operations *mpOperations = nullptr;
+
+  void moveFrom(Job &rhs) noexcept {
+    if (rhs.mpOperations != nullptr) {
+      rhs.mpOperations->move(mStorage, rhs.mStorage);
+      mpOperations = std::exchange(rhs.mpOperations, nullptr);
+    }
+  }
+};
+
+/**
+ * @brief Completion handle for any number of jobs. The counter is owned by the
+ * caller (usually on the stack) and can be reused once {done()} returns true,
+ * so tracking completion costs one atomic increment and decrement per job.
+ */
+class JobCounter {
+public:
+  friend class ThreadPool;
+
+  JobCounter() = default;
+  JobCounter(const JobCounter &) = delete;
+  JobCounter(JobCounter &&) = delete;
+  JobCounter &operator=(const JobCounter &) = delete;
+  JobCounter &operator=(JobCounter &&) = delete;
+  ~JobCounter() = default;
+
+  bool done() const noexcept {
+    return mPendingCount.load(std::memory_order_acquire) == 0;
+  }
+
+  u64 pending() const noexcept {
+    return mPendingCount.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<u64> mPendingCount = 0;
+};
+
+/**
+ * @brief Cooperative cancellation flag shared by a group of jobs. Jobs that
+ * have not started when {cancel()} is called are skipped (their counters are
+ * still decremented), running jobs may poll {cancelled()} to stop early.
+ * Like {JobCounter}, the token is owned by the caller and must outlive the
+ * jobs referring to it.
+ */
+class CancellationToken {
+public:
+  CancellationToken() = default;
+  CancellationToken(const CancellationToken &) = delete;
+  CancellationToken(CancellationToken &&) = delete;
+  CancellationToken &operator=(const CancellationToken &) = delete;
+  CancellationToken &operator=(CancellationToken &&) = delete;
+  ~CancellationToken() = default;
+
+  void cancel() noexcept { mCancelled.store(true, std::memory_order_release); }
+
+  void reset() noexcept { mCancelled.store(false, std::memory_order_release); }
+
+  bool cancelled() const noexcept {
+    return mCancelled.load(std::memory_order_acquire);
+  }
+
+private:
+  std::atomic<bool> mCancelled = false;
+};
+
+struct JobOptions {
+  JobPriority priority = JobPriority::normal;
+  const CancellationToken *pCancellationToken = nullptr;
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_THREADS_JOB_HPP */
\ No newline at end of file
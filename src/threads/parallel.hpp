@@ -0,0 +1,100 @@
+#ifndef NEKO_THREADS_PARALLEL_HPP
+#define NEKO_THREADS_PARALLEL_HPP
+
+#include "threads.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace neko {
+
+/* Chunks per worker when the caller leaves the grain size to the pool */
+inline constexpr u64 defaultChunksPerWorker = 4;
+
+/**
+ * @brief Picks the number of indices per chunk. A {grainSize} of 0 splits the
+ * range into {defaultChunksPerWorker} chunks per worker.
+ */
+inline u64 chooseGrainSize(const ThreadPool &threadPool, u64 indexCount,
+                           u64 grainSize) {
+  if (grainSize > 0) {
+    return grainSize;
+  }
+  u64 chunkCount = (threadPool.threadCount() + 1) * defaultChunksPerWorker;
+  return std::max<u64>(1, (indexCount + chunkCount - 1) / chunkCount);
+}
+
+/**
+ * @brief Calls {func(chunkBegin, chunkEnd)} for consecutive chunks of at most
+ * {grainSize} indices covering [begin, end) and returns once all chunks have
+ * finished. The calling thread executes chunks too.
+ */
+template <typename Func>
+void parallelForRange(ThreadPool &threadPool, u64 begin, u64 end,
+                      u64 grainSize, const Func &func) {
+  if (begin >= end) {
+    return;
+  }
+  grainSize = chooseGrainSize(threadPool, end - begin, grainSize);
+  u64 chunkCount = (end - begin + grainSize - 1) / grainSize;
+  if (chunkCount == 1) {
+    func(begin, end);
+    return;
+  }
+  JobCounter counter;
+  threadPool.submitBatch(
+      chunkCount,
+      [&func, begin, end, grainSize](u64 iChunk) {
+        u64 chunkBegin = begin + iChunk * grainSize;
+        func(chunkBegin, std::min(chunkBegin + grainSize, end));
+      },
+      counter);
+  threadPool.wait(counter);
+}
+
+/**
+ * @brief Calls {func(index)} for every index in [begin, end), {grainSize}
+ * indices per job.
+ */
+template <typename Func>
+void parallelFor(ThreadPool &threadPool, u64 begin, u64 end, u64 grainSize,
+                 const Func &func) {
+  parallelForRange(threadPool, begin, end, grainSize,
+                   [&func](u64 chunkBegin, u64 chunkEnd) {
+                     for (u64 index = chunkBegin; index < chunkEnd; ++index) {
+                       func(index);
+                     }
+                   });
+}
+
+/**
+ * @brief Reduces [begin, end) in parallel. {mapFunc(chunkBegin, chunkEnd)}
+ * produces one partial result per chunk, the partial results are then folded
+ * in index order with {reduceFunc(lhs, rhs)} starting from {identity}, so the
+ * result is deterministic for a given grain size.
+ */
+template <typename Value_T, typename MapFunc, typename ReduceFunc>
+Value_T parallelReduce(ThreadPool &threadPool, u64 begin, u64 end,
+                       u64 grainSize, Value_T identity, const MapFunc &mapFunc,
+                       const ReduceFunc &reduceFunc) {
+  if (begin >= end) {
+    return identity;
+  }
+  grainSize = chooseGrainSize(threadPool, end - begin, grainSize);
+  u64 chunkCount = (end - begin + grainSize - 1) / grainSize;
+  std::vector<Value_T> partialResults(chunkCount, identity);
+  parallelFor(threadPool, 0, chunkCount, 1,
+              [&, begin, end, grainSize](u64 iChunk) {
+                u64 chunkBegin = begin + iChunk * grainSize;
+                partialResults[iChunk] =
+                    mapFunc(chunkBegin, std::min(chunkBegin + grainSize, end));
+              });
+  for (auto &partialResult : partialResults) {
+    identity = reduceFunc(std::move(identity), std::move(partialResult));
+  }
+  return identity;
+}
+
+} /* namespace neko */
+
+#endif /* NEKO_THREADS_PARALLEL_HPP */
\ No newline at end of file
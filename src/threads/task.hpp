@@ -0,0 +1,385 @@
+#ifndef NEKO_THREADS_TASK_HPP
+#define NEKO_THREADS_TASK_HPP
+
+#include "threads.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace neko {
+
+template <typename Value_T = void> class Task;
+
+/**
+ * @brief Awaitable that moves the awaiting coroutine onto a worker of
+ * {threadPool}.
+ */
+class ScheduleAwaiter {
+public:
+  ScheduleAwaiter(ThreadPool &threadPool, JobPriority priority)
+      : mpThreadPool{&threadPool}, mPriority{priority} {}
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    mpThreadPool->submitDetached([handle] { handle.resume(); }, {mPriority});
+  }
+
+  void await_resume() const noexcept {}
+
+private:
+  ThreadPool *mpThreadPool;
+  JobPriority mPriority;
+};
+
+inline ScheduleAwaiter schedule(ThreadPool &threadPool,
+                                JobPriority priority = JobPriority::normal) {
+  return {threadPool, priority};
+}
+
+class TaskPromiseBase {
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template <typename Promise_T>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise_T> handle) noexcept {
+      auto continuation = handle.promise().mContinuation;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+public:
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+
+  void unhandled_exception() noexcept {
+    mException = std::current_exception();
+  }
+
+  void setContinuation(std::coroutine_handle<> continuation) noexcept {
+    mContinuation = continuation;
+  }
+
+protected:
+  std::coroutine_handle<> mContinuation = nullptr;
+  std::exception_ptr mException = nullptr;
+
+  void rethrowIfFailed() const {
+    if (mException) {
+      std::rethrow_exception(mException);
+    }
+  }
+};
+
+template <typename Value_T> class TaskPromise : public TaskPromiseBase {
+public:
+  Task<Value_T> get_return_object() noexcept;
+
+  template <typename Result_T> void return_value(Result_T &&result) {
+    mValue.emplace(std::forward<Result_T>(result));
+  }
+
+  Value_T takeResult() {
+    rethrowIfFailed();
+    return std::move(*mValue);
+  }
+
+private:
+  std::optional<Value_T> mValue;
+};
+
+template <> class TaskPromise<void> : public TaskPromiseBase {
+public:
+  Task<void> get_return_object() noexcept;
+
+  void return_void() const noexcept {}
+
+  void takeResult() const { rethrowIfFailed(); }
+};
+
+/**
+ * @brief Lazily started coroutine producing a {Value_T}. The coroutine body
+ * runs when the task is awaited, and resumes its awaiter when it completes.
+ * Use {schedule} inside the body to hop onto the thread pool, and {syncWait}
+ * to drive a task from ordinary code.
+ */
+template <typename Value_T> class [[nodiscard]] Task {
+public:
+  typedef TaskPromise<Value_T> promise_type;
+  typedef std::coroutine_handle<promise_type> Handle_T;
+
+  Task() = default;
+  explicit Task(Handle_T handle) noexcept : mHandle{handle} {}
+  Task(const Task &) = delete;
+  Task(Task &&rhs) noexcept : mHandle{std::exchange(rhs.mHandle, nullptr)} {}
+  Task &operator=(const Task &) = delete;
+  Task &operator=(Task &&rhs) noexcept {
+    if (this != &rhs) {
+      release();
+      mHandle = std::exchange(rhs.mHandle, nullptr);
+    }
+    return *this;
+  }
+  ~Task() { release(); }
+
+  bool valid() const noexcept { return static_cast<bool>(mHandle); }
+
+  auto operator co_await() &&noexcept {
+    struct Awaiter {
+      Handle_T handle;
+
+      bool await_ready() const noexcept { return !handle || handle.done(); }
+
+      std::coroutine_handle<>
+      await_suspend(std::coroutine_handle<> continuation) noexcept {
+        handle.promise().setContinuation(continuation);
+        return handle;
+      }
+
+      Value_T await_resume() {
+        if (!handle) {
+          throw std::runtime_error("Awaiting an empty task.");
+        }
+        return handle.promise().takeResult();
+      }
+    };
+    return Awaiter{mHandle};
+  }
+
+private:
+  Handle_T mHandle = nullptr;
+
+  void release() noexcept {
+    if (mHandle) {
+      mHandle.destroy();
+      mHandle = nullptr;
+    }
+  }
+};
+
+template <typename Value_T>
+Task<Value_T> TaskPromise<Value_T>::get_return_object() noexcept {
+  return Task<Value_T>{
+      std::coroutine_handle<TaskPromise<Value_T>>::from_promise(*this)};
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+  return Task<void>{
+      std::coroutine_handle<TaskPromise<void>>::from_promise(*this)};
+}
+
+/**
+ * @brief Eagerly started coroutine that destroys itself on completion. Only
+ * used to drive {Task}s from non-coroutine code.
+ */
+class DetachedTask {
+public:
+  struct promise_type {
+    DetachedTask get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+template <typename Value_T> struct TaskOutcome {
+  std::optional<std::conditional_t<std::is_void_v<Value_T>, bool, Value_T>>
+      value;
+  std::exception_ptr exception = nullptr;
+};
+
+/**
+ * @brief Runs {task} on {threadPool} and hands its outcome to
+ * {onDone(TaskOutcome<Value_T> &&)} on the worker that finished it.
+ */
+template <typename Value_T, typename OnDone>
+DetachedTask runDetached(ThreadPool &threadPool, Task<Value_T> task,
+                         OnDone onDone) {
+  co_await schedule(threadPool);
+  TaskOutcome<Value_T> outcome;
+  try {
+    if constexpr (std::is_void_v<Value_T>) {
+      co_await std::move(task);
+      outcome.value.emplace(true);
+    } else {
+      outcome.value.emplace(co_await std::move(task));
+    }
+  } catch (...) {
+    outcome.exception = std::current_exception();
+  }
+  onDone(std::move(outcome));
+}
+
+/**
+ * @brief Runs {task} to completion and returns its result, rethrowing its
+ * exception if it failed. The calling thread executes pool jobs while it
+ * waits.
+ */
+template <typename Value_T>
+Value_T syncWait(ThreadPool &threadPool, Task<Value_T> task) {
+  JobCounter counter;
+  TaskOutcome<Value_T> outcome;
+  threadPool.retain(counter);
+  runDetached(
+      threadPool, std::move(task),
+      [&threadPool, &counter, &outcome](TaskOutcome<Value_T> &&result) {
+        outcome = std::move(result);
+        threadPool.signal(counter);
+      });
+  threadPool.wait(counter);
+  if (outcome.exception) {
+    std::rethrow_exception(outcome.exception);
+  }
+  if constexpr (!std::is_void_v<Value_T>) {
+    return std::move(*outcome.value);
+  }
+}
+
+template <typename Value_T>
+using WhenAllResult_T =
+    std::conditional_t<std::is_void_v<Value_T>, void, std::vector<Value_T>>;
+
+/**
+ * @brief Starts every task concurrently on {threadPool} and completes once all
+ * of them have, with their results in the order of {tasks}. If any task
+ * fails, the first failure is rethrown after all tasks have finished.
+ */
+template <typename Value_T>
+Task<WhenAllResult_T<Value_T>> whenAll(ThreadPool &threadPool,
+                                       std::vector<Task<Value_T>> tasks) {
+  struct State {
+    std::vector<TaskOutcome<Value_T>> outcomes;
+    /* One per task plus one for the launching coroutine */
+    std::atomic<u64> remainingCount;
+    std::coroutine_handle<> continuation;
+  };
+
+  struct Awaiter {
+    ThreadPool &threadPool;
+    std::vector<Task<Value_T>> &tasks;
+    State &state;
+
+    bool await_ready() const noexcept { return tasks.empty(); }
+
+    bool await_suspend(std::coroutine_handle<> continuation) {
+      state.continuation = continuation;
+      for (u64 iTask = 0; iTask < tasks.size(); ++iTask) {
+        runDetached(threadPool, std::move(tasks[iTask]),
+                    [&sharedState = state,
+                     iTask](TaskOutcome<Value_T> &&outcome) {
+                      sharedState.outcomes[iTask] = std::move(outcome);
+                      if (sharedState.remainingCount.fetch_sub(1) == 1) {
+                        sharedState.continuation.resume();
+                      }
+                    });
+      }
+      /* The continuation cannot resume before this decrement */
+      return state.remainingCount.fetch_sub(1) != 1;
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  State state;
+  state.outcomes.resize(tasks.size());
+  state.remainingCount = tasks.size() + 1;
+  co_await Awaiter{threadPool, tasks, state};
+
+  for (auto &outcome : state.outcomes) {
+    if (outcome.exception) {
+      std::rethrow_exception(outcome.exception);
+    }
+  }
+  if constexpr (!std::is_void_v<Value_T>) {
+    std::vector<Value_T> results;
+    results.reserve(state.outcomes.size());
+    for (auto &outcome : state.outcomes) {
+      results.push_back(std::move(*outcome.value));
+    }
+    co_return results;
+  }
+}
+
+template <typename Value_T>
+using WhenAnyResult_T =
+    std::conditional_t<std::is_void_v<Value_T>, u64, std::pair<u64, Value_T>>;
+
+/**
+ * @brief Starts every task concurrently on {threadPool} and completes as soon
+ * as the first one does, with its index (and result). The remaining tasks
+ * keep running to completion in the background and their results are
+ * discarded.
+ */
+template <typename Value_T>
+Task<WhenAnyResult_T<Value_T>> whenAny(ThreadPool &threadPool,
+                                       std::vector<Task<Value_T>> tasks) {
+  if (tasks.empty()) {
+    throw std::runtime_error("whenAny() requires at least one task.");
+  }
+
+  /* Shared with the tasks that finish after the awaiting coroutine resumed */
+  struct State {
+    TaskOutcome<Value_T> outcome;
+    u64 index = 0;
+    std::atomic<bool> claimed = false;
+    std::coroutine_handle<> continuation;
+  };
+
+  struct Awaiter {
+    ThreadPool &threadPool;
+    std::vector<Task<Value_T>> &tasks;
+    /* Held by reference: some compilers destroy non-trivial members of a
+    temporary awaiter twice */
+    std::shared_ptr<State> &pState;
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> continuation) {
+      pState->continuation = continuation;
+      /* The first finished task may resume and destroy the awaiting frame
+      while tasks are still being started, so only use locals from here on */
+      ThreadPool &pool = threadPool;
+      auto pendingTasks = std::move(tasks);
+      auto pLocalState = pState;
+      for (u64 iTask = 0; iTask < pendingTasks.size(); ++iTask) {
+        runDetached(pool, std::move(pendingTasks[iTask]),
+                    [pSharedState = pLocalState,
+                     iTask](TaskOutcome<Value_T> &&outcome) {
+                      if (!pSharedState->claimed.exchange(true)) {
+                        pSharedState->outcome = std::move(outcome);
+                        pSharedState->index = iTask;
+                        pSharedState->continuation.resume();
+                      }
+                    });
+      }
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  auto pState = std::make_shared<State>();
+  co_await Awaiter{threadPool, tasks, pState};
+
+  if (pState->outcome.exception) {
+    std::rethrow_exception(pState->outcome.exception);
+  }
+  if constexpr (std::is_void_v<Value_T>) {
+    co_return pState->index;
+  } else {
+    co_return std::pair<u64, Value_T>{pState->index,
+                                      std::move(*pState->outcome.value)};
+  }
+}
+
+} /* namespace neko */
+
+#endif /* NEKO_THREADS_TASK_HPP */
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "task_graph.hpp"
+
+namespace neko {
+
+TaskGraph::TaskId TaskGraph::addTask(Task_T task) {
+  mNodes.emplace_back(std::make_unique<Node>());
+  mNodes.back()->task = std::move(task);
+  return mNodes.size() - 1;
+}
+
+TaskGraph::TaskId TaskGraph::addTask(std::string name, Task_T task) {
+  TaskId id = addTask(std::move(task));
+  mNodes.back()->name = std::move(name);
+  return id;
+}
+
+void TaskGraph::addDependency(TaskId before, TaskId after) {
+  if (before >= mNodes.size() || after >= mNodes.size()) {
+    throw std::runtime_error("Task graph dependency refers to unknown task.");
+  }
+  mNodes[before]->successors.push_back(after);
+  ++mNodes[after]->predecessorCount;
+}
+
+void TaskGraph::run(ThreadPool &threadPool) {
+  checkAcyclic();
+  for (auto &pNode : mNodes) {
+    pNode->pendingPredecessorCount.store(pNode->predecessorCount,
+                                         std::memory_order_relaxed);
+    pNode->skipped.store(false, std::memory_order_relaxed);
+    pNode->beginTime = 0;
+    pNode->endTime = 0;
+  }
+  RunState state;
+  for (auto &pNode : mNodes) {
+    if (pNode->predecessorCount == 0) {
+      submitNode(threadPool, state, *pNode);
+    }
+  }
+  threadPool.wait(state.counter);
+  if (state.exception) {
+    std::rethrow_exception(state.exception);
+  }
+}
+
+std::vector<TaskGraph::TaskTiming> TaskGraph::timings() const {
+  std::vector<TaskTiming> taskTimings;
+  for (const auto &pNode : mNodes) {
+    if (!pNode->name.empty()) {
+      taskTimings.push_back({pNode->name, pNode->beginTime, pNode->endTime});
+    }
+  }
+  return taskTimings;
+}
+
+void TaskGraph::checkAcyclic() const {
+  /* Kahn's algorithm, a cycle leaves some tasks that would never start */
+  std::vector<u64> predecessorCounts(mNodes.size());
+  std::vector<TaskId> readyTasks;
+  for (TaskId iTask = 0; iTask < mNodes.size(); ++iTask) {
+    predecessorCounts[iTask] = mNodes[iTask]->predecessorCount;
+    if (predecessorCounts[iTask] == 0) {
+      readyTasks.push_back(iTask);
+    }
+  }
+  u64 visitedCount = 0;
+  while (!readyTasks.empty()) {
+    TaskId iTask = readyTasks.back();
+    readyTasks.pop_back();
+    ++visitedCount;
+    for (TaskId iSuccessor : mNodes[iTask]->successors) {
+      if (--predecessorCounts[iSuccessor] == 0) {
+        readyTasks.push_back(iSuccessor);
+      }
+    }
+  }
+  if (visitedCount != mNodes.size()) {
+    throw std::runtime_error("Task graph contains a cycle.");
+  }
+}
+
+void TaskGraph::submitNode(ThreadPool &threadPool, RunState &state,
+                           Node &node) {
+  threadPool.submit(
+      [this, &threadPool, &state, &node] {
+        /* Set by a predecessor that failed or was skipped, before it
+        released this task */
+        bool skipped = node.skipped.load(std::memory_order_relaxed);
+        if (node.task && !skipped) {
+          node.beginTime = metricsClock();
+          try {
+            node.task();
+          } catch (...) {
+            std::lock_guard lock{state.exceptionMutex};
+            if (!state.exception) {
+              state.exception = std::current_exception();
+            }
+            skipped = true;
+          }
+          node.endTime = metricsClock();
+        }
+        /* Successors are submitted before this job completes, so the counter
+        cannot drain while any task is still outstanding */
+        for (TaskId iSuccessor : node.successors) {
+          Node &successor = *mNodes[iSuccessor];
+          /* Successors of a failed task would see it half done */
+          if (skipped) {
+            successor.skipped.store(true, std::memory_order_relaxed);
+          }
+          if (successor.pendingPredecessorCount.fetch_sub(
+                  1, std::memory_order_acq_rel) == 1) {
+            submitNode(threadPool, state, successor);
+          }
+        }
+      },
+      state.counter);
+}
+
+} /* namespace neko */
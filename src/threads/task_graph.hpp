@@ -0,0 +1,98 @@
+#ifndef NEKO_THREADS_TASK_GRAPH_HPP
+#define NEKO_THREADS_TASK_GRAPH_HPP
+
+#include "threads.hpp"
+
+#include <exception>
+#include <mutex>
+#include <vector>
+
+namespace neko {
+
+/**
+ * @brief Directed acyclic graph of tasks. A task is submitted to the pool as
+ * soon as all of its predecessors have finished, so independent branches run
+ * concurrently without any thread blocking on an intermediate result.
+ *
+ * The graph can be run any number of times, but must not be modified while
+ * {run} is in progress. If a task throws, the tasks depending on it, directly
+ * or not, are skipped, the others still run, and {run} rethrows the first
+ * exception.
+ */
+class TaskGraph {
+  typedef std::function<void()> Task_T;
+
+public:
+  typedef u64 TaskId;
+
+  /* Nanoseconds of {metricsClock} at which a task of the last {run} started
+  and finished */
+  struct TaskTiming {
+    std::string name;
+    u64 begin = 0;
+    u64 end = 0;
+  };
+
+  TaskGraph() = default;
+  TaskGraph(const TaskGraph &) = delete;
+  TaskGraph(TaskGraph &&) = default;
+  TaskGraph &operator=(const TaskGraph &) = delete;
+  TaskGraph &operator=(TaskGraph &&) = default;
+  ~TaskGraph() = default;
+
+  TaskId addTask(Task_T task);
+
+  /**
+   * @brief Adds a task reported by {timings} under {name}.
+   */
+  TaskId addTask(std::string name, Task_T task);
+
+  /**
+   * @brief {after} will only start once {before} has finished.
+   */
+  void addDependency(TaskId before, TaskId after);
+
+  size_t taskCount() const noexcept { return mNodes.size(); }
+
+  /**
+   * @brief Runs every task and returns once all of them have finished or
+   * been skipped. The calling thread executes tasks while it waits.
+   */
+  void run(ThreadPool &threadPool);
+
+  /**
+   * @brief Timings of the named tasks in the last {run}, in the order they
+   * were added.
+   */
+  std::vector<TaskTiming> timings() const;
+
+private:
+  struct Node {
+    Task_T task;
+    std::string name;
+    u64 beginTime = 0;
+    u64 endTime = 0;
+    std::vector<TaskId> successors;
+    u64 predecessorCount = 0;
+    std::atomic<u64> pendingPredecessorCount = 0;
+    /* Whether a task this one depends on threw */
+    std::atomic<bool> skipped = false;
+  };
+
+  /* State of one {run}, shared by its jobs */
+  struct RunState {
+    JobCounter counter;
+    std::mutex exceptionMutex;
+    std::exception_ptr exception = nullptr;
+  };
+
+  std::vector<std::unique_ptr<Node>> mNodes;
+
+  void checkAcyclic() const;
+
+  void submitNode(ThreadPool &threadPool, RunState &state, Node &node);
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_THREADS_TASK_GRAPH_HPP */
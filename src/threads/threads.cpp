@@ -1,77 +1,581 @@
 #include "threads.hpp"
 
+#include <algorithm>
+
 namespace neko {
 
-std::shared_ptr<JobPromise> ThreadPool::submitJob(const Job_T &job) {
-  std::shared_ptr<JobPromise> jobReady;
-  {
-    MutexLock_T lock{mQueueMutex};
-    jobReady = std::make_shared<JobPromise>();
-    mJobs.push([=] {
-      job();
-      jobReady->setFlag();
-    });
+/* Number of empty scans over all queues before an idle worker parks */
+static constexpr u32 spinCountBeforePark = 64;
+
+/* Number of completion checks before a waiting thread blocks */
+static constexpr u32 spinCountBeforeBlock = 64;
+
+/* One job in this many has its queue wait and run time recorded, reading the
+clock twice per job costs more than the shortest jobs run */
+static constexpr u32 jobTimingSamplePeriod = 64;
+
+/* A job finishing as {waitIdle} starts blocking may not see it waiting, the
+waiting thread then checks again after this long */
+static constexpr std::chrono::milliseconds idleCheckPeriod{1};
+
+struct WorkerContext {
+  ThreadPool *pool = nullptr;
+  u64 index = 0;
+};
+
+static thread_local WorkerContext currentWorker = {};
+
+/* Jobs this thread submits before the next one is timed */
+static thread_local u32 jobTimingCountdown = 0;
+
+static bool sampleJobTiming() noexcept {
+  if (jobTimingCountdown == 0) {
+    jobTimingCountdown = jobTimingSamplePeriod - 1;
+    return true;
   }
-  mMutexCondition.notify_one();
+  --jobTimingCountdown;
+  return false;
+}
+
+/**
+ * @brief Per-worker job deque with one lane per {JobPriority}. Each lane is a
+ * power-of-two ring buffer, so pushing and popping jobs does not allocate once
+ * the ring has grown to its working size. The owning worker pushes and pops at
+ * the back (LIFO, cache-warm), other workers steal from the front (FIFO,
+ * oldest and usually largest jobs first).
+ *
+ * The size of a lane only changes under {mutex}, but is read without it to
+ * skip empty lanes and to tell whether any job is queued. No counter is
+ * shared by all the queues, so pushing and popping touch only the queue.
+ */
+struct alignas(64) ThreadPool::WorkQueue {
+  struct Lane {
+    std::vector<QueuedJob> slots = std::vector<QueuedJob>(64);
+    u64 head = 0;
+    std::atomic<u64> size = 0;
+
+    bool empty() const noexcept {
+      return size.load(std::memory_order_relaxed) == 0;
+    }
+
+    void pushBack(QueuedJob &&queuedJob) {
+      u64 count = size.load(std::memory_order_relaxed);
+      if (count == slots.size()) {
+        grow();
+      }
+      slots[(head + count) & (slots.size() - 1)] = std::move(queuedJob);
+      size.store(count + 1, std::memory_order_relaxed);
+    }
+
+    void popBack(QueuedJob &queuedJob) noexcept {
+      u64 count = size.load(std::memory_order_relaxed) - 1;
+      queuedJob = std::move(slots[(head + count) & (slots.size() - 1)]);
+      size.store(count, std::memory_order_relaxed);
+    }
+
+    void popFront(QueuedJob &queuedJob) noexcept {
+      queuedJob = std::move(slots[head]);
+      head = (head + 1) & (slots.size() - 1);
+      size.store(size.load(std::memory_order_relaxed) - 1,
+                 std::memory_order_relaxed);
+    }
+
+    void grow() {
+      u64 count = size.load(std::memory_order_relaxed);
+      std::vector<QueuedJob> largerSlots(slots.size() * 2);
+      for (u64 iSlot = 0; iSlot < count; ++iSlot) {
+        largerSlots[iSlot] =
+            std::move(slots[(head + iSlot) & (slots.size() - 1)]);
+      }
+      slots.swap(largerSlots);
+      head = 0;
+    }
+  };
+
+  std::mutex mutex;
+  Lane lanes[jobPriorityCount];
+};
+
+/**
+ * @brief Jobs submitted and finished by one worker. Only that worker writes
+ * its tally, so counting a job is a plain store rather than a read-modify-write
+ * on a cache line shared by every thread. The tally of the threads outside the
+ * pool is shared by all of them and updated atomically.
+ */
+struct alignas(64) ThreadPool::JobTally {
+  std::atomic<u64> submittedCount = 0;
+  std::atomic<u64> finishedCount = 0;
+  bool shared = false;
+
+  static void add(std::atomic<u64> &count, u64 amount, bool shared) noexcept {
+    if (shared) {
+      count.fetch_add(amount, std::memory_order_release);
+    } else {
+      count.store(count.load(std::memory_order_relaxed) + amount,
+                  std::memory_order_release);
+    }
+  }
+
+  void addSubmitted(u64 amount) noexcept {
+    add(submittedCount, amount, shared);
+  }
+
+  void addFinished() noexcept { add(finishedCount, 1, shared); }
+};
+
+bool JobPromise::wait() {
+  mpThreadPool->wait(mCounter);
+  return true;
+}
+
+ThreadPool::ThreadPool() {
+  Settings settings;
+  settings.system.cpuThreadUsage = medium;
+  initializePool(settings);
+}
+
+ThreadPool::ThreadPool(const Settings &settings) { initializePool(settings); }
+
+ThreadPool::~ThreadPool() { release(); }
+
+std::shared_ptr<JobPromise> ThreadPool::submitJob(const Job_T &job,
+                                                  JobPriority priority) {
+  auto jobReady = std::make_shared<JobPromise>();
+  jobReady->mpThreadPool = this;
+  /* The job keeps {jobReady} alive until its counter has been decremented */
+  submit([job, jobReady] { job(); }, jobReady->mCounter, {priority});
   return jobReady;
 }
 
-bool ThreadPool::busy() {
-  bool poolbusy;
-  {
-    MutexLock_T lock{mQueueMutex};
-    poolbusy = mJobs.empty();
+void ThreadPool::wait(JobCounter &counter) {
+  u32 idleSpinCount = 0;
+  while (!counter.done()) {
+    /* Help with queued jobs instead of blocking, so nested waits on workers
+    neither deadlock nor leave cores idle */
+    if (runPendingJob()) {
+      idleSpinCount = 0;
+      continue;
+    }
+    if (idleSpinCount < spinCountBeforeBlock) {
+      ++idleSpinCount;
+      std::this_thread::yield();
+      continue;
+    }
+    MutexLock_T lock{mCompletionMutex};
+    mWaitingCount.fetch_add(1);
+    /* Pairs with {finishJob}: either it sees this thread waiting, or this
+    thread sees the counter drained. Jobs queued meanwhile are seen by
+    {hasQueuedJobsLocked}, see {wakeWorkers} */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    mCompletionCondition.wait(lock, [this, &counter] {
+      return counter.done() || hasQueuedJobsLocked();
+    });
+    mWaitingCount.fetch_sub(1);
+    idleSpinCount = 0;
   }
-  return poolbusy;
+}
+
+bool ThreadPool::runPendingJob() {
+  QueuedJob queuedJob;
+  if (currentWorker.pool == this) {
+    if (!popJob(currentWorker.index, queuedJob)) {
+      return false;
+    }
+  } else {
+    bool found = false;
+    for (u64 iLane = 0; iLane < jobPriorityCount && !found; ++iLane) {
+      found = stealJob(mStealOrders.back(), iLane, queuedJob);
+    }
+    if (!found) {
+      return false;
+    }
+  }
+  runJob(queuedJob);
+  return true;
+}
+
+void ThreadPool::waitIdle() {
+  if (currentWorker.pool == this) {
+    throw std::runtime_error(
+        "ThreadPool::waitIdle() called from one of its own workers.");
+  }
+  MutexLock_T lock{mCompletionMutex};
+  mIdleWaitingCount.fetch_add(1);
+  /* {finishJob} notifies once it sees this thread waiting, which keeps a
+  fence off its path but may miss the last job, hence the periodic check */
+  while (inFlightJobCount() != 0) {
+    mCompletionCondition.wait_for(lock, idleCheckPeriod);
+  }
+  mIdleWaitingCount.fetch_sub(1);
 }
 
 void ThreadPool::force_release() {
   {
-    MutexLock_T lock{mQueueMutex};
+    MutexLock_T lock{mParkMutex};
     mShouldTerminate = true;
   }
-  mMutexCondition.notify_all();
+  mParkCondition.notify_all();
   for (auto &activeThread : mThreads) {
     activeThread.join();
   }
   mThreads.clear();
+  dropQueuedJobs();
 }
 
 void ThreadPool::release() {
-  while (!busy()) {
+  if (!mThreads.empty()) {
+    waitIdle();
   }
   force_release();
 }
 
-void ThreadPool::initializePool(CPUThreadUsage usageMode) {
-  auto supportedThreadCount = std::thread::hardware_concurrency();
-  if (supportedThreadCount < 4) {
-    throw std::runtime_error("std::thread::hardware_concurrency() < 4");
+void ThreadPool::initializePool(const Settings &settings) {
+  mpQueueWaitTimes = &metricsRegistry().histogram("thread-pool.queue-wait-ns");
+  mpJobRunTimes = &metricsRegistry().histogram("thread-pool.job-run-ns");
+  mpStealCount = &metricsRegistry().counter("thread-pool.steals");
+  mTopology = CpuTopology::detect();
+  bool restrictAffinity = !settings.system.cpuAffinity.empty();
+  if (restrictAffinity) {
+    mTopology =
+        mTopology.restrictedTo(parseCpuList(settings.system.cpuAffinity));
+    if (mTopology.logicalCpus.empty()) {
+      throw std::runtime_error(
+          "cpu-affinity does not list any CPU available to the process.");
+    }
   }
   mShouldTerminate = false;
-  u64 threadCount = std::thread::hardware_concurrency() / usageMode;
-  threadCount = threadCount > 2 ? threadCount : 2;
+  u64 threadCount = selectWorkerCount(settings);
+
+  std::vector<LogicalCpu> workerCpus(threadCount);
+  std::vector<u32> allowedCpuIds;
+  auto placementOrder = mTopology.placementOrder();
+  for (u64 iThread = 0; iThread < threadCount; ++iThread) {
+    workerCpus[iThread] = placementOrder[iThread % placementOrder.size()];
+  }
+  for (const auto &cpu : mTopology.logicalCpus) {
+    allowedCpuIds.push_back(cpu.id);
+  }
+  mWorkerAffinities.assign(threadCount, {});
+  for (u64 iThread = 0; iThread < threadCount; ++iThread) {
+    if (settings.system.pinWorkers) {
+      mWorkerAffinities[iThread] = {workerCpus[iThread].id};
+    } else if (restrictAffinity) {
+      mWorkerAffinities[iThread] = allowedCpuIds;
+    }
+  }
+  buildStealOrders(workerCpus);
+
+  mQueues.resize(threadCount);
+  for (auto &queue : mQueues) {
+    queue = std::make_unique<WorkQueue>();
+  }
+  mJobTallies.resize(threadCount + 1);
+  for (auto &pTally : mJobTallies) {
+    pTally = std::make_unique<JobTally>();
+  }
+  mJobTallies.back()->shared = true;
   mThreads.resize(threadCount);
-  for (auto &thread : mThreads) {
-    thread = std::thread{ThreadPool::threadLoop, this};
+  for (u64 iThread = 0; iThread < threadCount; ++iThread) {
+    mThreads[iThread] = std::thread{ThreadPool::threadLoop, this, iThread};
+  }
+}
+
+u64 ThreadPool::selectWorkerCount(const Settings &settings) const {
+  if (settings.system.workerCount > 0) {
+    return settings.system.workerCount;
   }
+  u64 threadCount = 0;
+  switch (settings.system.cpuThreadUsage) {
+  case high:
+    threadCount = mTopology.logicalCpus.size();
+    break;
+  case medium:
+    /* SMT siblings share execution units, one worker per physical core */
+    threadCount = mTopology.physicalCoreCount;
+    break;
+  case low:
+    threadCount = mTopology.physicalCoreCount / 2;
+    break;
+  }
+  /* Keep a second worker so one long-running job cannot stall the pool */
+  return std::max<u64>(threadCount, 2);
 }
 
-void ThreadPool::threadLoop(ThreadPool *pool) {
-  while (true) {
-    Job_T job;
+void ThreadPool::buildStealOrders(const std::vector<LogicalCpu> &workerCpus) {
+  u64 threadCount = workerCpus.size();
+  mStealOrders.assign(threadCount + 1, {});
+  for (u64 iThread = 0; iThread < threadCount; ++iThread) {
+    auto localityRank = [&workerCpus, iThread](u64 iVictim) {
+      const auto &victimCpu = workerCpus[iVictim];
+      const auto &thiefCpu = workerCpus[iThread];
+      if (victimCpu.l3Domain == thiefCpu.l3Domain) {
+        return 0;
+      }
+      return victimCpu.numaNode == thiefCpu.numaNode ? 1 : 2;
+    };
+    auto &stealOrder = mStealOrders[iThread];
+    for (u64 iOffset = 1; iOffset < threadCount; ++iOffset) {
+      stealOrder.push_back((iThread + iOffset) % threadCount);
+    }
+    std::stable_sort(stealOrder.begin(), stealOrder.end(),
+                     [&localityRank](u64 lhs, u64 rhs) {
+                       return localityRank(lhs) < localityRank(rhs);
+                     });
+  }
+  for (u64 iThread = 0; iThread < threadCount; ++iThread) {
+    mStealOrders[threadCount].push_back(iThread);
+  }
+}
+
+u64 ThreadPool::selectQueue() {
+  if (currentWorker.pool == this) {
+    return currentWorker.index;
+  }
+  return mNextQueue.fetch_add(1, std::memory_order_relaxed) % mQueues.size();
+}
+
+bool ThreadPool::isWorkerThread() const noexcept {
+  return currentWorker.pool == this;
+}
+
+bool ThreadPool::hasQueuedJobs() const noexcept {
+  for (const auto &pQueue : mQueues) {
+    for (const auto &lane : pQueue->lanes) {
+      if (!lane.empty()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::hasQueuedJobsLocked() {
+  for (auto &pQueue : mQueues) {
+    MutexLock_T lock{pQueue->mutex};
+    for (const auto &lane : pQueue->lanes) {
+      if (!lane.empty()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+ThreadPool::JobTally &ThreadPool::currentJobTally() noexcept {
+  if (currentWorker.pool == this) {
+    return *mJobTallies[currentWorker.index];
+  }
+  return *mJobTallies.back();
+}
+
+u64 ThreadPool::inFlightJobCount() const noexcept {
+  /* Finished counts first: a job counted as finished was submitted before,
+  so the later loads count its submission and the difference cannot wrap */
+  u64 finishedCount = 0;
+  for (const auto &pTally : mJobTallies) {
+    finishedCount += pTally->finishedCount.load(std::memory_order_acquire);
+  }
+  u64 submittedCount = 0;
+  for (const auto &pTally : mJobTallies) {
+    submittedCount += pTally->submittedCount.load(std::memory_order_acquire);
+  }
+  return submittedCount - finishedCount;
+}
+
+void ThreadPool::pushJob(QueuedJob &&queuedJob, JobPriority priority) {
+  auto lane = static_cast<u64>(priority);
+  currentJobTally().addSubmitted(1);
+  queuedJob.queueTime = sampleJobTiming() ? metricsClock() : 0;
+  {
+    auto &queue = *mQueues[selectQueue()];
+    MutexLock_T lock{queue.mutex};
+    queue.lanes[lane].pushBack(std::move(queuedJob));
+  }
+  wakeWorkers(1);
+}
+
+void ThreadPool::pushJobs(u64 jobCount, JobCounter &counter,
+                          JobOptions options,
+                          Job (*makeJob)(const void *pFunc, u64 iJob),
+                          const void *pFunc) {
+  if (jobCount == 0) {
+    return;
+  }
+  auto lane = static_cast<u64>(options.priority);
+  currentJobTally().addSubmitted(jobCount);
+  u64 queueTime = metricsClock();
+  {
+    auto &queue = *mQueues[selectQueue()];
+    MutexLock_T lock{queue.mutex};
+    for (u64 iJob = 0; iJob < jobCount; ++iJob) {
+      queue.lanes[lane].pushBack({makeJob(pFunc, iJob), &counter,
+                                  options.pCancellationToken,
+                                  sampleJobTiming() ? queueTime : 0});
+    }
+  }
+  wakeWorkers(jobCount);
+}
+
+bool ThreadPool::popJob(u64 workerIndex, QueuedJob &queuedJob) {
+  /* Higher lanes first, from the own queue before stealing */
+  for (u64 iLane = 0; iLane < jobPriorityCount; ++iLane) {
+    auto &ownQueue = *mQueues[workerIndex];
+    if (!ownQueue.lanes[iLane].empty()) {
+      MutexLock_T lock{ownQueue.mutex};
+      if (!ownQueue.lanes[iLane].empty()) {
+        ownQueue.lanes[iLane].popBack(queuedJob);
+        return true;
+      }
+    }
+    if (stealJob(mStealOrders[workerIndex], iLane, queuedJob)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::stealJob(const std::vector<u64> &victimIndices, u64 lane,
+                          QueuedJob &queuedJob) {
+  for (u64 victimIndex : victimIndices) {
+    auto &victimQueue = *mQueues[victimIndex];
+    if (victimQueue.lanes[lane].empty()) {
+      continue;
+    }
+    MutexLock_T lock{victimQueue.mutex, std::try_to_lock};
+    if (lock.owns_lock() && !victimQueue.lanes[lane].empty()) {
+      victimQueue.lanes[lane].popFront(queuedJob);
+      mpStealCount->add();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::runJob(QueuedJob &queuedJob) {
+  NEKO_PROFILE_ZONE("Job");
+  /* Only the jobs sampled when queued are timed */
+  u64 startTime = 0;
+  if (queuedJob.queueTime != 0) {
+    startTime = metricsClock();
+    mpQueueWaitTimes->record(startTime - queuedJob.queueTime);
+  }
+  if (queuedJob.pCancellationToken == nullptr ||
+      !queuedJob.pCancellationToken->cancelled()) {
+    queuedJob.job();
+  }
+  if (startTime != 0) {
+    mpJobRunTimes->record(metricsClock() - startTime);
+  }
+  finishJob(queuedJob.pCounter);
+}
+
+void ThreadPool::signal(JobCounter &counter) {
+  bool counterDrained = counter.mPendingCount.fetch_sub(1) == 1;
+  notifyCompletion(counterDrained, false);
+}
+
+void ThreadPool::finishJob(JobCounter *pCounter) {
+  bool counterDrained = pCounter->mPendingCount.fetch_sub(1) == 1;
+  /* {pCounter} may be destroyed by its waiter from here on */
+  currentJobTally().addFinished();
+  notifyCompletion(counterDrained, true);
+}
+
+void ThreadPool::notifyCompletion(bool counterDrained, bool jobFinished) {
+  if ((counterDrained && mWaitingCount > 0) ||
+      (jobFinished && mIdleWaitingCount > 0)) {
+    { MutexLock_T lock{mCompletionMutex}; }
+    mCompletionCondition.notify_all();
+  }
+}
+
+void ThreadPool::dropQueuedJobs() {
+  /* Finished outside the queue lock, a waiter may hold the completion lock
+  while it checks the queues */
+  std::vector<JobCounter *> droppedCounters;
+  for (auto &pQueue : mQueues) {
     {
-      MutexLock_T lock{pool->mQueueMutex};
-      pool->mMutexCondition.wait(lock, [pool] {
-        return !pool->mJobs.empty() || pool->mShouldTerminate;
-      });
-      if (pool->mShouldTerminate) {
+      MutexLock_T lock{pQueue->mutex};
+      for (u64 iLane = 0; iLane < jobPriorityCount; ++iLane) {
+        auto &lane = pQueue->lanes[iLane];
+        while (!lane.empty()) {
+          QueuedJob queuedJob;
+          lane.popFront(queuedJob);
+          droppedCounters.push_back(queuedJob.pCounter);
+        }
+      }
+    }
+    for (JobCounter *pCounter : droppedCounters) {
+      finishJob(pCounter);
+    }
+    droppedCounters.clear();
+  }
+}
+
+bool ThreadPool::park() {
+  for (u32 iSpin = 0; iSpin < spinCountBeforePark; ++iSpin) {
+    if (hasQueuedJobs() || mShouldTerminate) {
+      return !mShouldTerminate;
+    }
+    std::this_thread::yield();
+  }
+  MutexLock_T lock{mParkMutex};
+  mParkedCount.fetch_add(1);
+  u64 wakeEpoch = mWakeEpoch;
+  /* See {wakeWorkers}: either the submitter sees this worker as parked, or
+  this worker sees the queued job */
+  if (!hasQueuedJobsLocked()) {
+    mParkCondition.wait(lock, [this, wakeEpoch] {
+      return mWakeEpoch != wakeEpoch || mShouldTerminate;
+    });
+  }
+  mParkedCount.fetch_sub(1);
+  return !mShouldTerminate;
+}
+
+void ThreadPool::wakeWorkers(u64 jobCount) {
+  /* Called after the queue lock of the job was released, no fence needed:
+  a thread that counted itself as parked or waiting then checks the queues
+  under their locks, so either it takes a queue lock after this job was
+  pushed and sees it, or its count was stored before the job was pushed and
+  is seen here */
+  if (mWaitingCount.load(std::memory_order_relaxed) > 0) {
+    { MutexLock_T lock{mCompletionMutex}; }
+    mCompletionCondition.notify_all();
+  }
+  if (mParkedCount.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  {
+    MutexLock_T lock{mParkMutex};
+    ++mWakeEpoch;
+  }
+  if (jobCount == 1) {
+    mParkCondition.notify_one();
+  } else {
+    mParkCondition.notify_all();
+  }
+}
+
+void ThreadPool::threadLoop(ThreadPool *pool, u64 workerIndex) {
+  currentWorker = {pool, workerIndex};
+  NEKO_PROFILE_THREAD("Worker " + std::to_string(workerIndex));
+  if (!pool->mWorkerAffinities[workerIndex].empty() &&
+      !setCurrentThreadAffinity(pool->mWorkerAffinities[workerIndex])) {
+    logWarning("Failed to restrict worker %u to its CPUs, check cpu-affinity "
+               "and pin-workers",
+               static_cast<u32>(workerIndex));
+  }
+  while (!pool->mShouldTerminate) {
+    QueuedJob queuedJob;
+    if (pool->popJob(workerIndex, queuedJob)) {
+      pool->runJob(queuedJob);
+    } else {
+      NEKO_PROFILE_ZONE("Park");
+      if (!pool->park()) {
         return;
       }
-      job = pool->mJobs.front();
-      pool->mJobs.pop();
     }
-    job();
   }
 }
 
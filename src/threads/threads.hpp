@@ -3,11 +3,14 @@
 
 #include "utils.hpp"
 
+#include "job.hpp"
+#include "topology.hpp"
+
+#include <atomic>
 #include <condition_variable>
 #include <functional>
-#include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 
 namespace neko {
@@ -19,64 +22,241 @@ class JobPromise {
 public:
   friend class ThreadPool;
 
-  bool wait() {
-    if (!mFinished) {
-      mFinished = mFuture.get();
-    }
-    return mFinished;
-  }
+  bool wait();
 
 private:
-  std::promise<bool> mPromise;
-  std::future<bool> mFuture = mPromise.get_future();
-  bool mFinished = false;
-
-  void setFlag() { mPromise.set_value(true); }
+  ThreadPool *mpThreadPool = nullptr;
+  JobCounter mCounter;
 };
 
 class ThreadPool {
   typedef std::function<void()> Job_T;
   typedef std::unique_lock<std::mutex> MutexLock_T;
 
+  struct QueuedJob {
+    Job job;
+    JobCounter *pCounter = nullptr;
+    const CancellationToken *pCancellationToken = nullptr;
+    /* {metricsClock} when the job was queued, 0 if it is not timed */
+    u64 queueTime = 0;
+  };
+
+  struct WorkQueue;
+  struct JobTally;
+
 public:
-  ThreadPool() { initializePool(); }
-  ThreadPool(const Settings &settings) {
-    initializePool(settings.system.cpuThreadUsage);
-  }
+  ThreadPool();
+  ThreadPool(const Settings &settings);
   ThreadPool(const ThreadPool &) = delete;
   ThreadPool(ThreadPool &&) = delete;
   ThreadPool &operator=(const ThreadPool &) = delete;
   ThreadPool &operator=(ThreadPool &&) = delete;
-  ~ThreadPool() { release(); }
+  ~ThreadPool();
 
   size_t threadCount() const noexcept { return mThreads.size(); }
 
+  /**
+   * @brief CPUs the pool was sized for, after applying
+   * {Settings::system.cpuAffinity}.
+   */
+  const CpuTopology &topology() const noexcept { return mTopology; }
+
   /**
    * @brief
    * ! The caller must ensure that {job} is alive until the worker thread
    * ! finishes using it.
    *
+   * Thin wrapper over {submit} kept for existing callers.
+   *
    * @param job
+   * @param priority
    * @return std::shared_ptr<JobPromise>
    */
-  std::shared_ptr<JobPromise> submitJob(const Job_T &job);
+  std::shared_ptr<JobPromise>
+  submitJob(const Job_T &job, JobPriority priority = JobPriority::normal);
+
+  /**
+   * @brief Submits {func} without allocating as long as it fits in
+   * {Job::inlineSize} bytes. {counter} is incremented now and decremented once
+   * {func} has returned.
+   *
+   * Jobs submitted from a worker thread go to that worker's own queue, jobs
+   * submitted from any other thread are distributed round-robin. Within a
+   * queue, jobs go to the lane of {options.priority}.
+   */
+  template <typename Func>
+  void submit(Func &&func, JobCounter &counter, JobOptions options = {}) {
+    counter.mPendingCount.fetch_add(1, std::memory_order_relaxed);
+    pushJob({Job{std::forward<Func>(func)}, &counter,
+             options.pCancellationToken},
+            options.priority);
+  }
+
+  /**
+   * @brief Submits {jobCount} jobs calling {func(iJob)} under a single queue
+   * lock and a single wake-up. Each job holds its own copy of {func}.
+   */
+  template <typename Func>
+  void submitBatch(u64 jobCount, const Func &func, JobCounter &counter,
+                   JobOptions options = {}) {
+    counter.mPendingCount.fetch_add(jobCount, std::memory_order_relaxed);
+    pushJobs(
+        jobCount, counter, options,
+        [](const void *pFunc, u64 iJob) {
+          return Job{[func = *static_cast<const Func *>(pFunc), iJob] {
+            func(iJob);
+          }};
+        },
+        &func);
+  }
+
+  /**
+   * @brief Submits {func} with no completion handle, for work whose completion
+   * is tracked elsewhere (e.g. a coroutine being resumed). Such jobs still
+   * count towards {busy} and {waitIdle}.
+   */
+  template <typename Func>
+  void submitDetached(Func &&func, JobOptions options = {}) {
+    submit(std::forward<Func>(func), mDetachedCounter, options);
+  }
+
+  /**
+   * @brief Marks {count} units of work tracked by {counter} that do not run as
+   * pool jobs, e.g. a suspended coroutine. {wait(counter)} will not return
+   * before a matching number of {signal(counter)} calls.
+   */
+  void retain(JobCounter &counter, u64 count = 1) noexcept {
+    counter.mPendingCount.fetch_add(count, std::memory_order_relaxed);
+  }
 
-  bool busy();
+  /**
+   * @brief Completes one unit of work added with {retain}.
+   */
+  void signal(JobCounter &counter);
 
+  /**
+   * @brief Returns once every job tracked by {counter} has finished. The
+   * calling thread runs queued jobs while it waits and only blocks when there
+   * is nothing left to help with.
+   */
+  void wait(JobCounter &counter);
+
+  /**
+   * @brief Runs one queued job on the calling thread.
+   *
+   * @return false if no job could be taken
+   */
+  bool runPendingJob();
+
+  /**
+   * @brief Blocks without spinning until no job is queued or running.
+   * ! Must not be called from a worker thread of this pool, it would wait for
+   * ! its own job.
+   */
+  void waitIdle();
+
+  /**
+   * @brief Whether any job is queued or running.
+   */
+  bool busy() const noexcept { return inFlightJobCount() > 0; }
+
+  /**
+   * @brief Whether the calling thread is one of the workers of this pool.
+   */
+  bool isWorkerThread() const noexcept;
+
+  /**
+   * @brief Stops the workers once their current job returns. Jobs still
+   * queued are dropped and their counters released.
+   */
   void force_release();
 
+  /**
+   * @brief Waits for all queued jobs to finish, then stops the workers.
+   */
   void release();
 
 private:
   std::vector<std::thread> mThreads;
-  std::queue<Job_T> mJobs;
-  std::mutex mQueueMutex;
-  std::condition_variable mMutexCondition;
-  bool mShouldTerminate;
+  std::vector<std::unique_ptr<WorkQueue>> mQueues;
+  CpuTopology mTopology;
+
+  /* CPUs each worker is restricted to, empty to leave it to the scheduler */
+  std::vector<std::vector<u32>> mWorkerAffinities;
+
+  /* Victim queues per worker, same L3 domain first, then same NUMA node. The
+  extra last entry lists every queue for threads outside the pool */
+  std::vector<std::vector<u64>> mStealOrders;
+  std::atomic<u64> mNextQueue = 0;
+
+  JobCounter mDetachedCounter;
+
+  /* Jobs submitted and finished, one tally per worker plus a last one shared
+  by the threads outside the pool */
+  std::vector<std::unique_ptr<JobTally>> mJobTallies;
+
+  /* Nanoseconds jobs spent queued and running, sampled, and jobs taken from
+  the queue of another worker, in {metricsRegistry} */
+  Histogram *mpQueueWaitTimes = nullptr;
+  Histogram *mpJobRunTimes = nullptr;
+  Counter *mpStealCount = nullptr;
+
+  /* Idle workers park on {mParkCondition} instead of polling the queues */
+  std::mutex mParkMutex;
+  std::condition_variable mParkCondition;
+  std::atomic<u32> mParkedCount = 0;
+  u64 mWakeEpoch = 0;
+  std::atomic<bool> mShouldTerminate;
+
+  /* Threads blocked in {wait} or {waitIdle} sleep on {mCompletionCondition} */
+  std::mutex mCompletionMutex;
+  std::condition_variable mCompletionCondition;
+  std::atomic<u32> mWaitingCount = 0;
+  std::atomic<u32> mIdleWaitingCount = 0;
+
+  void initializePool(const Settings &settings);
+
+  u64 selectWorkerCount(const Settings &settings) const;
+
+  void buildStealOrders(const std::vector<LogicalCpu> &workerCpus);
+
+  u64 selectQueue();
+
+  bool hasQueuedJobs() const noexcept;
+
+  bool hasQueuedJobsLocked();
+
+  JobTally &currentJobTally() noexcept;
+
+  /**
+   * @brief Jobs submitted but not yet finished, queued or running.
+   */
+  u64 inFlightJobCount() const noexcept;
+
+  void pushJob(QueuedJob &&queuedJob, JobPriority priority);
+
+  void pushJobs(u64 jobCount, JobCounter &counter, JobOptions options,
+                Job (*makeJob)(const void *pFunc, u64 iJob),
+                const void *pFunc);
+
+  bool popJob(u64 workerIndex, QueuedJob &queuedJob);
+
+  bool stealJob(const std::vector<u64> &victimIndices, u64 lane,
+                QueuedJob &queuedJob);
+
+  void runJob(QueuedJob &queuedJob);
+
+  void finishJob(JobCounter *pCounter);
+
+  void notifyCompletion(bool counterDrained, bool jobFinished);
+
+  void dropQueuedJobs();
+
+  bool park();
 
-  void initializePool(CPUThreadUsage usageMode = medium);
+  void wakeWorkers(u64 jobCount);
 
-  static void threadLoop(ThreadPool *pool);
+  static void threadLoop(ThreadPool *pool, u64 workerIndex);
 };
 
 } /* namespace neko */
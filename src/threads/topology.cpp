@@ -0,0 +1,234 @@
+#include "topology.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <thread>
+#include <tuple>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif /* __linux__ */
+
+namespace neko {
+
+static const std::string sysCpuPath = "/sys/devices/system/cpu/";
+
+/* CPU ids a cpulist may name, the ones an affinity mask can express */
+#ifdef __linux__
+static constexpr u64 maxCpuCount = CPU_SETSIZE;
+#else
+static constexpr u64 maxCpuCount = 4096;
+#endif /* __linux__ */
+
+static bool readFirstLine(const std::string &filePath, std::string &line) {
+  std::ifstream fs(filePath);
+  return fs.is_open() && static_cast<bool>(std::getline(fs, line));
+}
+
+static u32 readU32(const std::string &filePath, u32 defaultValue) {
+  std::string line;
+  if (!readFirstLine(filePath, line)) {
+    return defaultValue;
+  }
+  try {
+    return static_cast<u32>(std::stoul(line));
+  } catch (const std::exception &) {
+    return defaultValue;
+  }
+}
+
+static u32 readNumaNode(const std::string &cpuPath, u32 defaultValue) {
+  /* cpuN/ contains a "nodeM" link to its NUMA node */
+  std::error_code errorCode;
+  for (const auto &entry :
+       std::filesystem::directory_iterator{cpuPath, errorCode}) {
+    std::string name = entry.path().filename().string();
+    if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+        std::all_of(name.begin() + 4, name.end(),
+                    [](char c) { return c >= '0' && c <= '9'; })) {
+      return static_cast<u32>(std::stoul(name.substr(4)));
+    }
+  }
+  return defaultValue;
+}
+
+static u64 readL3DomainKey(const std::string &cpuPath, u64 defaultValue) {
+  /* The lowest CPU sharing the L3 identifies the cache domain */
+  std::error_code errorCode;
+  for (const auto &entry : std::filesystem::directory_iterator{
+           cpuPath + "cache", errorCode}) {
+    std::string indexPath = entry.path().string() + "/";
+    std::string line;
+    if (readU32(indexPath + "level", 0) == 3 &&
+        readFirstLine(indexPath + "shared_cpu_list", line)) {
+      auto sharedCpus = parseCpuList(line);
+      if (!sharedCpus.empty()) {
+        return sharedCpus.front();
+      }
+    }
+  }
+  return defaultValue;
+}
+
+static std::vector<u32> getAvailableCpuIds() {
+  std::vector<u32> cpuIds;
+  std::string line;
+  if (readFirstLine(sysCpuPath + "online", line)) {
+    cpuIds = parseCpuList(line);
+  }
+#ifdef __linux__
+  cpu_set_t allowedSet;
+  CPU_ZERO(&allowedSet);
+  if (sched_getaffinity(0, sizeof(allowedSet), &allowedSet) == 0) {
+    if (cpuIds.empty()) {
+      for (u32 cpuId = 0; cpuId < CPU_SETSIZE; ++cpuId) {
+        cpuIds.push_back(cpuId);
+      }
+    }
+    cpuIds.erase(std::remove_if(cpuIds.begin(), cpuIds.end(),
+                                [&allowedSet](u32 cpuId) {
+                                  return cpuId >= CPU_SETSIZE ||
+                                         !CPU_ISSET(cpuId, &allowedSet);
+                                }),
+                 cpuIds.end());
+  }
+#endif /* __linux__ */
+  if (cpuIds.empty()) {
+    u32 hardwareThreadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (u32 cpuId = 0; cpuId < hardwareThreadCount; ++cpuId) {
+      cpuIds.push_back(cpuId);
+    }
+  }
+  return cpuIds;
+}
+
+template <typename Key_T>
+static u32 denseIndex(std::map<Key_T, u32> &indices, const Key_T &key) {
+  return indices.emplace(key, static_cast<u32>(indices.size())).first->second;
+}
+
+static void countDomains(CpuTopology &topology) {
+  std::set<u32> cores, packages, numaNodes, l3Domains;
+  for (const auto &cpu : topology.logicalCpus) {
+    cores.insert(cpu.coreIndex);
+    packages.insert(cpu.packageIndex);
+    numaNodes.insert(cpu.numaNode);
+    l3Domains.insert(cpu.l3Domain);
+  }
+  topology.physicalCoreCount = static_cast<u32>(cores.size());
+  topology.packageCount = static_cast<u32>(packages.size());
+  topology.numaNodeCount = static_cast<u32>(numaNodes.size());
+  topology.l3DomainCount = static_cast<u32>(l3Domains.size());
+}
+
+CpuTopology CpuTopology::detect() {
+  std::map<u32, u32> packageIndices, numaIndices;
+  std::map<std::pair<u32, u32>, u32> coreIndices;
+  std::map<std::pair<u32, u64>, u32> l3Indices;
+  std::map<u32, u32> smtCounts;
+
+  CpuTopology topology;
+  for (u32 cpuId : getAvailableCpuIds()) {
+    std::string cpuPath = sysCpuPath + "cpu" + std::to_string(cpuId) + "/";
+    u32 packageId = readU32(cpuPath + "topology/physical_package_id", 0);
+    u32 coreId = readU32(cpuPath + "topology/core_id", cpuId);
+
+    LogicalCpu cpu{};
+    cpu.id = cpuId;
+    cpu.packageIndex = denseIndex(packageIndices, packageId);
+    cpu.coreIndex = denseIndex(coreIndices, {packageId, coreId});
+    cpu.numaNode = denseIndex(numaIndices, readNumaNode(cpuPath, 0));
+    /* Without cache information, fall back to one domain per package */
+    cpu.l3Domain = denseIndex(
+        l3Indices, {packageId, readL3DomainKey(cpuPath, ~u64{0})});
+    cpu.smtIndex = smtCounts[cpu.coreIndex]++;
+    topology.logicalCpus.push_back(cpu);
+  }
+  countDomains(topology);
+  return topology;
+}
+
+CpuTopology CpuTopology::restrictedTo(const std::vector<u32> &cpuIds) const {
+  CpuTopology topology;
+  for (const auto &cpu : logicalCpus) {
+    if (std::find(cpuIds.begin(), cpuIds.end(), cpu.id) != cpuIds.end()) {
+      topology.logicalCpus.push_back(cpu);
+    }
+  }
+  countDomains(topology);
+  return topology;
+}
+
+std::vector<LogicalCpu> CpuTopology::placementOrder() const {
+  auto orderedCpus = logicalCpus;
+  std::stable_sort(orderedCpus.begin(), orderedCpus.end(),
+                   [](const LogicalCpu &lhs, const LogicalCpu &rhs) {
+                     return std::tie(lhs.smtIndex, lhs.numaNode, lhs.l3Domain,
+                                     lhs.coreIndex, lhs.id) <
+                            std::tie(rhs.smtIndex, rhs.numaNode, rhs.l3Domain,
+                                     rhs.coreIndex, rhs.id);
+                   });
+  return orderedCpus;
+}
+
+std::vector<u32> parseCpuList(const std::string &cpuList) {
+  std::vector<u32> cpuIds;
+  u64 rangeBegin = 0;
+  while (rangeBegin < cpuList.length()) {
+    u64 rangeEnd = cpuList.find(',', rangeBegin);
+    if (rangeEnd == std::string::npos) {
+      rangeEnd = cpuList.length();
+    }
+    std::string range = cpuList.substr(rangeBegin, rangeEnd - rangeBegin);
+    rangeBegin = rangeEnd + 1;
+    range.erase(std::remove_if(range.begin(), range.end(),
+                               [](char c) { return std::isspace(c) != 0; }),
+                range.end());
+    if (range.empty()) {
+      continue;
+    }
+    try {
+      u64 dashIndex = range.find('-');
+      u64 first = std::stoull(range.substr(0, dashIndex));
+      u64 last = first;
+      if (dashIndex != std::string::npos) {
+        last = std::stoull(range.substr(dashIndex + 1));
+      }
+      /* The bound also keeps a huge range from filling memory */
+      if (last < first || last >= maxCpuCount) {
+        throw std::invalid_argument(range);
+      }
+      for (u64 cpuId = first; cpuId <= last; ++cpuId) {
+        cpuIds.push_back(static_cast<u32>(cpuId));
+      }
+    } catch (const std::logic_error &) {
+      throw std::runtime_error("Invalid CPU list \"" + cpuList + "\".");
+    }
+  }
+  std::sort(cpuIds.begin(), cpuIds.end());
+  cpuIds.erase(std::unique(cpuIds.begin(), cpuIds.end()), cpuIds.end());
+  return cpuIds;
+}
+
+bool setCurrentThreadAffinity(const std::vector<u32> &cpuIds) {
+#ifdef __linux__
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  for (u32 cpuId : cpuIds) {
+    if (cpuId < CPU_SETSIZE) {
+      CPU_SET(cpuId, &cpuSet);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+  (void)cpuIds;
+  return false;
+#endif /* __linux__ */
+}
+
+} /* namespace neko */
@@ -0,0 +1,63 @@
+#ifndef NEKO_THREADS_TOPOLOGY_HPP
+#define NEKO_THREADS_TOPOLOGY_HPP
+
+#include "utils.hpp"
+
+namespace neko {
+
+struct LogicalCpu {
+  u32 id;
+  /* Dense indices, consecutive ids share the physical core/node/cache */
+  u32 coreIndex;
+  u32 packageIndex;
+  u32 numaNode;
+  u32 l3Domain;
+  /* 0 for the first hardware thread of a core, 1 for its SMT sibling, ... */
+  u32 smtIndex;
+};
+
+/**
+ * @brief Layout of the online logical CPUs usable by this process. On Linux
+ * it is read from /sys/devices/system, elsewhere (or if /sys is unavailable)
+ * every logical CPU is treated as its own core in a single domain.
+ */
+struct CpuTopology {
+  std::vector<LogicalCpu> logicalCpus;
+  u32 physicalCoreCount = 0;
+  u32 packageCount = 0;
+  u32 numaNodeCount = 0;
+  u32 l3DomainCount = 0;
+
+  static CpuTopology detect();
+
+  /**
+   * @brief Keeps only the CPUs listed in {cpuIds}.
+   */
+  CpuTopology restrictedTo(const std::vector<u32> &cpuIds) const;
+
+  /**
+   * @brief CPUs ordered for worker placement: one hardware thread per
+   * physical core before any SMT sibling, and cores of the same NUMA node and
+   * L3 domain next to each other.
+   */
+  std::vector<LogicalCpu> placementOrder() const;
+};
+
+/**
+ * @brief Parses a Linux cpulist such as "0-3,8,10-11". Reversed ranges and
+ * CPU ids an affinity mask cannot express (1024 and above on Linux) are
+ * rejected.
+ */
+std::vector<u32> parseCpuList(const std::string &cpuList);
+
+/**
+ * @brief Restricts the calling thread to {cpuIds}. No-op on platforms without
+ * affinity support.
+ *
+ * @return false if the affinity could not be applied
+ */
+bool setCurrentThreadAffinity(const std::vector<u32> &cpuIds);
+
+} /* namespace neko */
+
+#endif /* NEKO_THREADS_TOPOLOGY_HPP */
@@ -2,4 +2,6 @@
 #define NEKO_VERSION_MINOR 0
 #define NEKO_VERSION_PATCH 0
 
+#define NEKO_PROFILING 0
+
 #
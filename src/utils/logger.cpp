@@ -0,0 +1,204 @@
+#include "logger.hpp"
+
+#include "metrics.hpp"
+
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+
+namespace neko {
+
+/* Longest a record waits in the queue before the writer wakes up, errors
+wake it at once */
+static constexpr auto logFlushInterval = std::chrono::milliseconds{20};
+
+static_assert((logQueueCapacity & (logQueueCapacity - 1)) == 0,
+              "The log queue capacity must be a power of two.");
+
+static const char *logLevelName(LogLevel level) {
+  switch (level) {
+  case LogLevel::trace:
+    return "trace";
+  case LogLevel::debug:
+    return "debug";
+  case LogLevel::info:
+    return "info";
+  case LogLevel::warning:
+    return "warning";
+  case LogLevel::error:
+    return "error";
+  case LogLevel::off:
+    break;
+  }
+  return "off";
+}
+
+/* Looking the counter up constructs the registry first, so that it is
+destroyed after the logger writes its last records */
+Logger::Logger()
+    : mpSlots{std::make_unique<Slot[]>(logQueueCapacity)},
+      mpDroppedCounter{&metricsRegistry().counter("log.dropped")} {
+  for (u64 iSlot = 0; iSlot < logQueueCapacity; ++iSlot) {
+    mpSlots[iSlot].sequence.store(iSlot, std::memory_order_relaxed);
+  }
+}
+
+Logger::~Logger() { stop(); }
+
+void Logger::start(const std::string &filePath, LogLevel level) {
+  if (mThread.joinable()) {
+    stop();
+  }
+  auto parentPath = std::filesystem::path(filePath).parent_path();
+  if (!parentPath.empty()) {
+    std::filesystem::create_directories(parentPath);
+  }
+  mpFile = std::fopen(filePath.c_str(), "a");
+  if (mpFile == nullptr) {
+    throw std::runtime_error("Failed to open log file " + filePath);
+  }
+  setLevel(level);
+  mStopping = false;
+  mThread = std::thread{&Logger::writeLoop, this};
+}
+
+void Logger::stop() {
+  {
+    std::lock_guard lock{mMutex};
+    mStopping = true;
+  }
+  mWakeCondition.notify_all();
+  if (mThread.joinable()) {
+    mThread.join();
+  }
+  /* Records queued after the writer stopped, or without a writer at all */
+  std::string batch;
+  while (writeBatch(batch)) {
+  }
+  if (mpFile != nullptr) {
+    std::fclose(mpFile);
+    mpFile = nullptr;
+  }
+}
+
+u64 Logger::wallClock() noexcept {
+  return static_cast<u64>(std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::system_clock::now()
+                                  .time_since_epoch())
+                              .count());
+}
+
+u32 Logger::logThreadIndex() noexcept {
+  static std::atomic<u32> nextThreadIndex = 0;
+  thread_local u32 threadIndex =
+      nextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+  return threadIndex;
+}
+
+Logger::Slot *Logger::acquireSlot() noexcept {
+  u64 position = mTail.load(std::memory_order_relaxed);
+  while (true) {
+    Slot &slot = mpSlots[position & (logQueueCapacity - 1)];
+    u64 sequence = slot.sequence.load(std::memory_order_acquire);
+    auto difference =
+        static_cast<std::make_signed_t<u64>>(sequence - position);
+    if (difference == 0) {
+      if (mTail.compare_exchange_weak(position, position + 1,
+                                      std::memory_order_relaxed)) {
+        return &slot;
+      }
+    } else if (difference < 0) {
+      /* The writer has not yet consumed the record a lap ago */
+      mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    } else {
+      position = mTail.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void Logger::publishSlot(Slot *pSlot) noexcept {
+  /* The slot was acquired at the position its sequence still holds */
+  u64 position = pSlot->sequence.load(std::memory_order_relaxed);
+  bool urgent = pSlot->record.level >= LogLevel::error;
+  pSlot->sequence.store(position + 1, std::memory_order_release);
+  if (urgent) {
+    mWakeCondition.notify_one();
+  }
+}
+
+bool Logger::writeBatch(std::string &batch) {
+  batch.clear();
+  bool empty = true;
+  /* At most a lap of the queue, so that busy producers do not grow the batch
+  without bound */
+  for (u64 iRecord = 0; iRecord < logQueueCapacity; ++iRecord) {
+    Slot &slot = mpSlots[mHead & (logQueueCapacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != mHead + 1) {
+      break;
+    }
+    const LogRecord &record = slot.record;
+    auto time = static_cast<std::time_t>(record.time / 1'000'000);
+    std::tm localTime{};
+#ifdef __linux__
+    localtime_r(&time, &localTime);
+#else
+    localtime_s(&localTime, &time);
+#endif /* __linux__ */
+    char prefix[64];
+    u64 prefixLength = std::strftime(prefix, sizeof(prefix),
+                                     "%Y-%m-%d %H:%M:%S", &localTime);
+    batch.append(prefix, prefixLength);
+    std::snprintf(prefix, sizeof(prefix), ".%06u [%s] [thread %u] ",
+                  static_cast<u32>(record.time % 1'000'000),
+                  logLevelName(record.level), record.threadIndex);
+    batch += prefix;
+    u64 messageStart = batch.size();
+    record.pFormatFunc(record, batch);
+    batch += '\n';
+    if (record.level >= LogLevel::warning && mpFile != nullptr) {
+      std::fwrite(batch.data() + messageStart, 1, batch.size() - messageStart,
+                  stderr);
+    }
+    /* Hands the slot back to producers one lap later */
+    slot.sequence.store(mHead + logQueueCapacity, std::memory_order_release);
+    ++mHead;
+    empty = false;
+  }
+
+  u64 droppedCount = mDroppedCount.load(std::memory_order_relaxed);
+  if (droppedCount != mReportedDroppedCount) {
+    u64 newDroppedCount = droppedCount - mReportedDroppedCount;
+    mpDroppedCounter->add(newDroppedCount);
+    batch += "Log queue full, " + std::to_string(newDroppedCount) +
+             " records dropped\n";
+    mReportedDroppedCount = droppedCount;
+  }
+  if (!batch.empty()) {
+    std::FILE *pFile = mpFile != nullptr ? mpFile : stderr;
+    std::fwrite(batch.data(), 1, batch.size(), pFile);
+    std::fflush(pFile);
+  }
+  return !empty;
+}
+
+void Logger::writeLoop() {
+  std::string batch;
+  std::unique_lock lock{mMutex};
+  while (!mStopping) {
+    lock.unlock();
+    bool wrote = writeBatch(batch);
+    lock.lock();
+    if (!wrote) {
+      mWakeCondition.wait_for(lock, logFlushInterval,
+                              [this] { return mStopping; });
+    }
+  }
+}
+
+Logger &logger() {
+  static Logger logger;
+  return logger;
+}
+
+} /* namespace neko */
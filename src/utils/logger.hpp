@@ -0,0 +1,509 @@
+#ifndef NEKO_UTILS_LOGGER_HPP
+#define NEKO_UTILS_LOGGER_HPP
+
+#include "defines.hpp"
+#include "settings.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+namespace neko {
+
+class Counter;
+
+/* Records the queue holds before new ones are dropped */
+inline constexpr u64 logQueueCapacity = 4096;
+
+/* Bytes of a record available to the arguments of its message */
+inline constexpr u32 logArgumentCapacity = 464;
+
+/* Strings are copied into the record, other arguments are copied as bytes */
+template <typename T>
+inline constexpr bool isLogString_v =
+    std::is_convertible_v<const T &, std::string_view>;
+
+template <typename T>
+using LogDecoded_T =
+    std::conditional_t<isLogString_v<T>, const char *, std::decay_t<T>>;
+
+/**
+ * @brief Message of a {log} call, with its arguments still encoded. Formatted
+ * by the writer thread with {pFormatFunc}, which knows their types.
+ */
+struct LogRecord {
+  typedef void (*FormatFunc_T)(const LogRecord &record, std::string &output);
+
+  u64 time = 0;
+  FormatFunc_T pFormatFunc = nullptr;
+  const char *format = nullptr;
+  u32 threadIndex = 0;
+  LogLevel level = LogLevel::info;
+  alignas(8) u8 arguments[logArgumentCapacity];
+};
+
+namespace log_encoding {
+
+/* Encoded string: a flag, then either the length and the characters with
+their terminating zero, or a heap copy too long for the record */
+inline constexpr u8 inlineString = 0;
+inline constexpr u8 heapString = 1;
+
+/* Bytes of an inline string besides its characters */
+inline constexpr u32 inlineStringOverhead = 1 + sizeof(u16) + 1;
+
+template <typename T> constexpr u32 fixedSize() {
+  if constexpr (isLogString_v<T>) {
+    /* Enough for a heap copy, inline strings take the spare bytes beyond */
+    return 1 + sizeof(char *);
+  } else {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Log arguments must be strings or trivially copyable.");
+    return sizeof(T);
+  }
+}
+
+template <typename T>
+void encode(const T &value, u8 *&pBytes, u32 &spareSize) noexcept {
+  if constexpr (isLogString_v<T>) {
+    std::string_view string{value};
+    u64 size = string.size() + inlineStringOverhead;
+    if (size > fixedSize<T>() + spareSize) {
+      /* Does not fit, the writer frees the copy once formatted */
+      auto pCopy = new (std::nothrow) char[string.size() + 1];
+      if (pCopy != nullptr) {
+        std::memcpy(pCopy, string.data(), string.size());
+        pCopy[string.size()] = '\0';
+        *pBytes++ = heapString;
+        std::memcpy(pBytes, &pCopy, sizeof(pCopy));
+        pBytes += sizeof(pCopy);
+        return;
+      }
+    }
+    /* Truncated if there is neither room nor memory */
+    u64 length = std::min<u64>(string.size(), fixedSize<T>() + spareSize -
+                                                  inlineStringOverhead);
+    spareSize -= static_cast<u32>(
+        std::max<u64>(length + inlineStringOverhead, fixedSize<T>()) -
+        fixedSize<T>());
+    *pBytes++ = inlineString;
+    auto length16 = static_cast<u16>(length);
+    std::memcpy(pBytes, &length16, sizeof(length16));
+    pBytes += sizeof(length16);
+    std::memcpy(pBytes, string.data(), length);
+    pBytes += length;
+    *pBytes++ = '\0';
+    /* Short strings leave part of their fixed bytes unused */
+    if (length + inlineStringOverhead < fixedSize<T>()) {
+      pBytes += fixedSize<T>() - length - inlineStringOverhead;
+    }
+  } else {
+    std::memcpy(pBytes, &value, sizeof(T));
+    pBytes += sizeof(T);
+  }
+}
+
+template <typename T>
+LogDecoded_T<T> decode(const u8 *&pBytes,
+                       const char *(&heapStrings)[16], u32 &heapCount) {
+  if constexpr (isLogString_v<T>) {
+    if (*pBytes++ == heapString) {
+      const char *pCopy = nullptr;
+      std::memcpy(&pCopy, pBytes, sizeof(pCopy));
+      pBytes += sizeof(pCopy);
+      heapStrings[heapCount++] = pCopy;
+      return pCopy;
+    }
+    u16 length = 0;
+    std::memcpy(&length, pBytes, sizeof(length));
+    auto string = reinterpret_cast<const char *>(pBytes + sizeof(length));
+    u32 size = length + inlineStringOverhead;
+    pBytes += std::max(size, fixedSize<T>()) - 1;
+    return string;
+  } else {
+    T value;
+    std::memcpy(&value, pBytes, sizeof(T));
+    pBytes += sizeof(T);
+    return value;
+  }
+}
+
+/**
+ * @brief Appends the message of {record} to {output}, {record} having been
+ * encoded from {Args}.
+ */
+template <typename... Args>
+void format(const LogRecord &record, std::string &output) {
+  [[maybe_unused]] const u8 *pBytes = record.arguments;
+  [[maybe_unused]] const char *heapStrings[16] = {};
+  [[maybe_unused]] u32 heapCount = 0;
+  /* Braced initialization decodes the arguments in order */
+  std::tuple<LogDecoded_T<Args>...> values{
+      decode<Args>(pBytes, heapStrings, heapCount)...};
+  std::apply(
+      [&](const auto &...decodedValues) {
+        char buffer[1024];
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat-security"
+#endif /* __GNUC__ */
+        int length = std::snprintf(buffer, sizeof(buffer), record.format,
+                                   decodedValues...);
+        if (length >= static_cast<int>(sizeof(buffer))) {
+          std::string largeBuffer(static_cast<u64>(length) + 1, '\0');
+          std::snprintf(largeBuffer.data(), largeBuffer.size(), record.format,
+                        decodedValues...);
+          output.append(largeBuffer.data(), static_cast<u64>(length));
+        } else if (length > 0) {
+          output.append(buffer, static_cast<u64>(length));
+        }
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ */
+      },
+      values);
+  for (u32 iString = 0; iString < heapCount; ++iString) {
+    delete[] heapStrings[iString];
+  }
+}
+
+/* Called by {LogFormat} on a mismatch, not being constexpr it fails the
+compilation with {reason} in the diagnostic */
+void logFormatMismatch(const char *reason);
+
+/* What a printf conversion expects of its argument, after the default
+argument promotions */
+enum class LogArgumentKind : u8 {
+  integer,
+  floating,
+  longDouble,
+  string,
+  pointer,
+};
+
+struct LogArgumentType {
+  LogArgumentKind kind;
+  u32 size;
+};
+
+template <typename T> consteval LogArgumentType argumentType() {
+  using Decayed_T = std::decay_t<T>;
+  if constexpr (isLogString_v<T>) {
+    return {LogArgumentKind::string, sizeof(const char *)};
+  } else if constexpr (std::is_enum_v<Decayed_T>) {
+    return argumentType<std::underlying_type_t<Decayed_T>>();
+  } else if constexpr (std::is_integral_v<Decayed_T>) {
+    return {LogArgumentKind::integer,
+            static_cast<u32>(std::max(sizeof(Decayed_T), sizeof(int)))};
+  } else if constexpr (std::is_same_v<Decayed_T, long double>) {
+    return {LogArgumentKind::longDouble, sizeof(long double)};
+  } else if constexpr (std::is_floating_point_v<Decayed_T>) {
+    return {LogArgumentKind::floating, sizeof(double)};
+  } else if constexpr (std::is_pointer_v<Decayed_T>) {
+    return {LogArgumentKind::pointer, sizeof(void *)};
+  } else {
+    /* Trivially copyable structs pass the encoding but no conversion */
+    return {LogArgumentKind::pointer, 0};
+  }
+}
+
+} /* namespace log_encoding */
+
+/**
+ * @brief printf format of a {Logger::log} call, checked at compile time
+ * against the types of its arguments as -Wformat would check a literal passed
+ * to printf: every conversion must get an argument of its kind and size,
+ * strings going to %s, and no argument may be left over. Sign mismatches, as
+ * %u given an i32, are accepted.
+ */
+template <typename... Args> class LogFormat {
+public:
+  consteval LogFormat(const char *format) : mFormat{format} {
+    constexpr log_encoding::LogArgumentType types[] = {
+        log_encoding::argumentType<Args>()..., {}};
+    u32 iArgument = 0;
+    auto nextArgument = [&]() {
+      if (iArgument == sizeof...(Args)) {
+        log_encoding::logFormatMismatch("Too few log arguments.");
+      }
+      return types[iArgument++];
+    };
+    for (const char *pChar = format; *pChar != '\0'; ++pChar) {
+      if (*pChar != '%') {
+        continue;
+      }
+      ++pChar;
+      if (*pChar == '%') {
+        continue;
+      }
+      while (*pChar == '-' || *pChar == '+' || *pChar == ' ' || *pChar == '#' ||
+             *pChar == '0') {
+        ++pChar;
+      }
+      /* Width and precision, given as '*' they take an int argument */
+      for (u32 iField = 0; iField < 2; ++iField) {
+        if (iField == 1) {
+          if (*pChar != '.') {
+            break;
+          }
+          ++pChar;
+        }
+        if (*pChar == '*') {
+          auto type = nextArgument();
+          if (type.kind != log_encoding::LogArgumentKind::integer ||
+              type.size != sizeof(int)) {
+            log_encoding::logFormatMismatch("'*' takes an int.");
+          }
+          ++pChar;
+        }
+        while (*pChar >= '0' && *pChar <= '9') {
+          ++pChar;
+        }
+      }
+      /* Size of the integer argument the length modifier selects */
+      u32 integerSize = sizeof(int);
+      bool longDouble = false;
+      if (*pChar == 'h') {
+        pChar += pChar[1] == 'h' ? 2 : 1;
+      } else if (*pChar == 'l') {
+        integerSize = pChar[1] == 'l' ? sizeof(long long) : sizeof(long);
+        pChar += pChar[1] == 'l' ? 2 : 1;
+      } else if (*pChar == 'j') {
+        integerSize = sizeof(intmax_t);
+        ++pChar;
+      } else if (*pChar == 'z') {
+        integerSize = sizeof(size_t);
+        ++pChar;
+      } else if (*pChar == 't') {
+        integerSize = sizeof(ptrdiff_t);
+        ++pChar;
+      } else if (*pChar == 'L') {
+        longDouble = true;
+        ++pChar;
+      }
+      switch (*pChar) {
+      case 'd':
+      case 'i':
+      case 'u':
+      case 'o':
+      case 'x':
+      case 'X':
+      case 'c': {
+        auto type = nextArgument();
+        if (type.kind != log_encoding::LogArgumentKind::integer ||
+            type.size != integerSize) {
+          log_encoding::logFormatMismatch(
+              "Integer conversion given another type or size.");
+        }
+        break;
+      }
+      case 'f':
+      case 'F':
+      case 'e':
+      case 'E':
+      case 'g':
+      case 'G':
+      case 'a':
+      case 'A':
+        if (nextArgument().kind !=
+            (longDouble ? log_encoding::LogArgumentKind::longDouble
+                        : log_encoding::LogArgumentKind::floating)) {
+          log_encoding::logFormatMismatch(
+              "Floating-point conversion given another type.");
+        }
+        break;
+      case 's':
+        if (nextArgument().kind != log_encoding::LogArgumentKind::string) {
+          log_encoding::logFormatMismatch("%s given a non-string.");
+        }
+        break;
+      case 'p': {
+        auto type = nextArgument();
+        if (type.kind != log_encoding::LogArgumentKind::pointer ||
+            type.size != sizeof(void *)) {
+          log_encoding::logFormatMismatch("%p given a non-pointer.");
+        }
+        break;
+      }
+      default:
+        log_encoding::logFormatMismatch("Unsupported log conversion.");
+      }
+    }
+    if (iArgument != sizeof...(Args)) {
+      log_encoding::logFormatMismatch("Too many log arguments.");
+    }
+  }
+
+  const char *get() const noexcept { return mFormat; }
+
+private:
+  const char *mFormat;
+};
+
+/* Keeps the arguments of a call from being deduced from its format */
+template <typename... Args>
+using LogFormat_T = std::type_identity_t<LogFormat<Args...>>;
+
+/**
+ * @brief Asynchronous logger. {log} copies the format string pointer and the
+ * binary arguments into a slot of a bounded lock-free queue (Vyukov's MPMC
+ * ring, with a single consumer) and returns, a background thread formats the
+ * records and writes them in batches. When the queue is full, records are
+ * dropped and counted rather than blocking the caller.
+ *
+ * Records logged before {start}, or by programs that never call it, are
+ * written to stderr by {stop}.
+ */
+class Logger {
+public:
+  Logger();
+  Logger(const Logger &) = delete;
+  Logger(Logger &&) = delete;
+  Logger &operator=(const Logger &) = delete;
+  Logger &operator=(Logger &&) = delete;
+  ~Logger();
+
+  /**
+   * @brief Opens {filePath} for appending, creating missing parent
+   * directories, and starts the writer thread. Records below {level} are
+   * discarded from now on.
+   */
+  void start(const std::string &filePath, LogLevel level);
+
+  /**
+   * @brief Writes every queued record and stops the writer thread.
+   */
+  void stop();
+
+  void setLevel(LogLevel level) noexcept {
+    mLevel.store(level, std::memory_order_relaxed);
+  }
+
+  bool enabled(LogLevel level) const noexcept {
+    return level >= mLevel.load(std::memory_order_relaxed) &&
+           level != LogLevel::off;
+  }
+
+  /**
+   * @brief Queues a message with the printf {format}, which must outlive the
+   * logger (string literals do) and is checked against {args} at compile
+   * time. String arguments are copied, up to 16 per message.
+   */
+  template <typename... Args>
+  void log(LogLevel level, LogFormat_T<Args...> format,
+           const Args &...args) noexcept {
+    static_assert(sizeof...(Args) <= 16, "Too many log arguments.");
+    if (!enabled(level)) {
+      return;
+    }
+    constexpr u32 fixedSize = (0 + ... + log_encoding::fixedSize<Args>());
+    static_assert(fixedSize <= logArgumentCapacity,
+                  "Log arguments do not fit in a record.");
+    Slot *pSlot = acquireSlot();
+    if (pSlot == nullptr) {
+      return;
+    }
+    LogRecord &record = pSlot->record;
+    record.time = wallClock();
+    record.pFormatFunc = &log_encoding::format<Args...>;
+    record.format = format.get();
+    record.threadIndex = logThreadIndex();
+    record.level = level;
+    [[maybe_unused]] u8 *pBytes = record.arguments;
+    [[maybe_unused]] u32 spareSize = logArgumentCapacity - fixedSize;
+    (log_encoding::encode(args, pBytes, spareSize), ...);
+    publishSlot(pSlot);
+  }
+
+  /**
+   * @brief Records dropped because the queue was full.
+   */
+  u64 droppedCount() const noexcept {
+    return mDroppedCount.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct alignas(64) Slot {
+    std::atomic<u64> sequence = 0;
+    LogRecord record;
+  };
+
+  std::unique_ptr<Slot[]> mpSlots;
+  alignas(64) std::atomic<u64> mTail = 0;
+  alignas(64) u64 mHead = 0;
+  std::atomic<LogLevel> mLevel = LogLevel::info;
+  std::atomic<u64> mDroppedCount = 0;
+  /* Dropped records already reported in the log and to the metrics */
+  u64 mReportedDroppedCount = 0;
+  Counter *mpDroppedCounter;
+
+  std::FILE *mpFile = nullptr;
+  std::mutex mMutex;
+  std::condition_variable mWakeCondition;
+  bool mStopping = false;
+  std::thread mThread;
+
+  static u64 wallClock() noexcept;
+
+  static u32 logThreadIndex() noexcept;
+
+  Slot *acquireSlot() noexcept;
+
+  void publishSlot(Slot *pSlot) noexcept;
+
+  /**
+   * @brief Formats the queued records into one batch and writes it.
+   *
+   * @return false if the queue was empty
+   */
+  bool writeBatch(std::string &batch);
+
+  void writeLoop();
+};
+
+/**
+ * @brief Logger of the engine, started with the settings by {Engine}.
+ */
+Logger &logger();
+
+template <typename... Args>
+void logTrace(LogFormat_T<Args...> format, const Args &...args) noexcept {
+  logger().log(LogLevel::trace, format, args...);
+}
+
+template <typename... Args>
+void logDebug(LogFormat_T<Args...> format, const Args &...args) noexcept {
+  logger().log(LogLevel::debug, format, args...);
+}
+
+template <typename... Args>
+void logInfo(LogFormat_T<Args...> format, const Args &...args) noexcept {
+  logger().log(LogLevel::info, format, args...);
+}
+
+template <typename... Args>
+void logWarning(LogFormat_T<Args...> format, const Args &...args) noexcept {
+  logger().log(LogLevel::warning, format, args...);
+}
+
+template <typename... Args>
+void logError(LogFormat_T<Args...> format, const Args &...args) noexcept {
+  logger().log(LogLevel::error, format, args...);
+}
+
+} /* namespace neko */
+
+#endif /* NEKO_UTILS_LOGGER_HPP */
@@ -0,0 +1,215 @@
+#include "metrics.hpp"
+
+#include "nlohmann/json.hpp"
+
+#include <bit>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+namespace neko {
+
+u32 metricShardIndex() noexcept {
+  static std::atomic<u32> nextShardIndex = 0;
+  thread_local u32 shardIndex =
+      nextShardIndex.fetch_add(1, std::memory_order_relaxed) %
+      metricShardCount;
+  return shardIndex;
+}
+
+u64 Counter::value() const noexcept {
+  u64 total = 0;
+  for (const Shard &shard : mShards) {
+    total += shard.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+u32 Histogram::bucketIndex(u64 value) noexcept {
+  auto bitCount = static_cast<u32>(std::bit_width(value));
+  if (bitCount <= subBucketBits + 1) {
+    return static_cast<u32>(value);
+  }
+  /* The {subBucketBits} bits below the leading one select the sub-bucket */
+  u32 shift = bitCount - subBucketBits - 1;
+  return (shift + 1) * subBucketCount +
+         static_cast<u32>(value >> shift) - subBucketCount;
+}
+
+u64 Histogram::bucketUpperBound(u32 index) noexcept {
+  if (index < 2 * subBucketCount) {
+    return index;
+  }
+  u32 shift = index / subBucketCount - 1;
+  u64 mantissa = index % subBucketCount + subBucketCount;
+  return ((mantissa + 1) << shift) - 1;
+}
+
+void Histogram::record(u64 value) noexcept {
+  Shard &shard = mpShards[metricShardIndex()];
+  shard.counts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+  u64 max = shard.max.load(std::memory_order_relaxed);
+  while (value > max && !shard.max.compare_exchange_weak(
+                            max, value, std::memory_order_relaxed)) {
+  }
+}
+
+HistogramSummary Histogram::summary() const {
+  std::vector<u64> counts(bucketCount, 0);
+  HistogramSummary summary;
+  f64 sum = 0.0;
+  for (u32 iShard = 0; iShard < metricShardCount; ++iShard) {
+    const Shard &shard = mpShards[iShard];
+    for (u32 iBucket = 0; iBucket < bucketCount; ++iBucket) {
+      counts[iBucket] += shard.counts[iBucket].load(std::memory_order_relaxed);
+    }
+    sum += static_cast<f64>(shard.sum.load(std::memory_order_relaxed));
+    summary.max =
+        std::max(summary.max, shard.max.load(std::memory_order_relaxed));
+  }
+  for (u64 count : counts) {
+    summary.count += count;
+  }
+  if (summary.count == 0) {
+    return summary;
+  }
+  summary.mean = sum / static_cast<f64>(summary.count);
+
+  /* Rank of each percentile, counted from 1 */
+  const f64 fractions[3] = {0.50, 0.95, 0.99};
+  u64 *pPercentiles[3] = {&summary.p50, &summary.p95, &summary.p99};
+  u32 iPercentile = 0;
+  u64 cumulativeCount = 0;
+  for (u32 iBucket = 0; iBucket < bucketCount && iPercentile < 3; ++iBucket) {
+    cumulativeCount += counts[iBucket];
+    while (iPercentile < 3 &&
+           static_cast<f64>(cumulativeCount) >=
+               std::ceil(fractions[iPercentile] *
+                         static_cast<f64>(summary.count))) {
+      /* Shards are read one after the other, the maximum may lag */
+      *pPercentiles[iPercentile] =
+          std::min(bucketUpperBound(iBucket), summary.max);
+      ++iPercentile;
+    }
+  }
+  return summary;
+}
+
+Counter &MetricsRegistry::counter(const std::string &name) {
+  std::lock_guard lock{mMutex};
+  auto &pCounter = mCounters[name];
+  if (!pCounter) {
+    pCounter = std::make_unique<Counter>();
+  }
+  return *pCounter;
+}
+
+Gauge &MetricsRegistry::gauge(const std::string &name) {
+  std::lock_guard lock{mMutex};
+  auto &pGauge = mGauges[name];
+  if (!pGauge) {
+    pGauge = std::make_unique<Gauge>();
+  }
+  return *pGauge;
+}
+
+Histogram &MetricsRegistry::histogram(const std::string &name) {
+  std::lock_guard lock{mMutex};
+  auto &pHistogram = mHistograms[name];
+  if (!pHistogram) {
+    pHistogram = std::make_unique<Histogram>();
+  }
+  return *pHistogram;
+}
+
+std::string MetricsRegistry::toJson() const {
+  nlohmann::json jsonData;
+  jsonData["counters"] = nlohmann::json::object();
+  jsonData["gauges"] = nlohmann::json::object();
+  jsonData["histograms"] = nlohmann::json::object();
+  std::lock_guard lock{mMutex};
+  for (const auto &[name, pCounter] : mCounters) {
+    jsonData["counters"][name] = pCounter->value();
+  }
+  for (const auto &[name, pGauge] : mGauges) {
+    jsonData["gauges"][name] = pGauge->value();
+  }
+  for (const auto &[name, pHistogram] : mHistograms) {
+    HistogramSummary summary = pHistogram->summary();
+    jsonData["histograms"][name] = {
+        {"count", summary.count}, {"mean", summary.mean},
+        {"p50", summary.p50},     {"p95", summary.p95},
+        {"p99", summary.p99},     {"max", summary.max}};
+  }
+  return jsonData.dump(4);
+}
+
+void MetricsRegistry::writeJson(const std::string &filePath) const {
+  std::string json = toJson();
+  auto parentPath = std::filesystem::path(filePath).parent_path();
+  if (!parentPath.empty()) {
+    std::filesystem::create_directories(parentPath);
+  }
+  std::string temporaryPath = filePath + ".tmp";
+  {
+    std::ofstream fs(temporaryPath);
+    if (!fs.is_open()) {
+      throw std::runtime_error("Failed to open metrics file " +
+                               temporaryPath);
+    }
+    fs << json << "\n";
+    if (!fs) {
+      throw std::runtime_error("Failed to write metrics file " +
+                               temporaryPath);
+    }
+  }
+  std::filesystem::rename(temporaryPath, filePath);
+}
+
+MetricsRegistry &metricsRegistry() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+MetricsWriter::MetricsWriter(const MetricsRegistry &registry,
+                             std::string filePath,
+                             std::chrono::milliseconds interval)
+    : mpRegistry{&registry}, mFilePath{std::move(filePath)},
+      mInterval{interval} {
+  if (mInterval.count() > 0) {
+    mThread = std::thread{&MetricsWriter::writeLoop, this};
+  }
+}
+
+MetricsWriter::~MetricsWriter() {
+  {
+    std::lock_guard lock{mMutex};
+    mStopping = true;
+  }
+  mStopCondition.notify_all();
+  if (mThread.joinable()) {
+    mThread.join();
+  }
+  /* Destructors must not throw, a failed last snapshot is lost */
+  try {
+    mpRegistry->writeJson(mFilePath);
+  } catch (const std::exception &) {
+  }
+}
+
+void MetricsWriter::writeLoop() {
+  std::unique_lock lock{mMutex};
+  while (!mStopCondition.wait_for(lock, mInterval,
+                                  [this] { return mStopping; })) {
+    lock.unlock();
+    try {
+      mpRegistry->writeJson(mFilePath);
+    } catch (const std::exception &) {
+      /* Retried at the next interval */
+    }
+    lock.lock();
+  }
+}
+
+} /* namespace neko */
@@ -0,0 +1,204 @@
+#ifndef NEKO_UTILS_METRICS_HPP
+#define NEKO_UTILS_METRICS_HPP
+
+#include "defines.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace neko {
+
+/* Copies of every counter and histogram, threads add to the copy of their
+{metricShardIndex} so that they rarely share a cache line */
+inline constexpr u32 metricShardCount = 8;
+
+/**
+ * @brief Shard of the calling thread, assigned round-robin on first use.
+ */
+u32 metricShardIndex() noexcept;
+
+/**
+ * @brief Nanoseconds of the steady clock, the unit of the latency histograms.
+ */
+inline u64 metricsClock() noexcept {
+  return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now()
+                                  .time_since_epoch())
+                              .count());
+}
+
+class Counter {
+public:
+  void add(u64 amount = 1) noexcept {
+    mShards[metricShardIndex()].value.fetch_add(amount,
+                                                std::memory_order_relaxed);
+  }
+
+  u64 value() const noexcept;
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<u64> value = 0;
+  };
+
+  Shard mShards[metricShardCount];
+};
+
+/**
+ * @brief Last value set, by whichever thread set it.
+ */
+class Gauge {
+public:
+  void set(f64 value) noexcept {
+    mValue.store(value, std::memory_order_relaxed);
+  }
+
+  f64 value() const noexcept { return mValue.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<f64> mValue = 0.0;
+};
+
+struct HistogramSummary {
+  u64 count = 0;
+  f64 mean = 0.0;
+  /* Upper bounds of the buckets holding the percentiles, within
+  1 / {Histogram::subBucketCount} of the recorded values */
+  u64 p50 = 0;
+  u64 p95 = 0;
+  u64 p99 = 0;
+  u64 max = 0;
+};
+
+/**
+ * @brief Distribution of non-negative integers, usually latencies in
+ * nanoseconds, with the log-linear buckets of HdrHistogram: values below
+ * 2 * {subBucketCount} are counted exactly, above that every power of two is
+ * split into {subBucketCount} buckets. Recording is two relaxed atomic
+ * additions and a maximum.
+ */
+class Histogram {
+public:
+  static constexpr u32 subBucketBits = 5;
+  static constexpr u32 subBucketCount = 1u << subBucketBits;
+  static constexpr u32 bucketCount = (64 - subBucketBits + 1) * subBucketCount;
+
+  Histogram() : mpShards{std::make_unique<Shard[]>(metricShardCount)} {}
+
+  static u32 bucketIndex(u64 value) noexcept;
+
+  /* Highest value counted in bucket {index} */
+  static u64 bucketUpperBound(u32 index) noexcept;
+
+  void record(u64 value) noexcept;
+
+  HistogramSummary summary() const;
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<u64> counts[bucketCount] = {};
+    std::atomic<u64> sum = 0;
+    std::atomic<u64> max = 0;
+  };
+
+  std::unique_ptr<Shard[]> mpShards;
+};
+
+/**
+ * @brief Records the nanoseconds between construction and destruction.
+ */
+class ScopedLatency {
+public:
+  explicit ScopedLatency(Histogram &histogram) noexcept
+      : mpHistogram{&histogram}, mStart{metricsClock()} {}
+  ScopedLatency(const ScopedLatency &) = delete;
+  ScopedLatency(ScopedLatency &&) = delete;
+  ScopedLatency &operator=(const ScopedLatency &) = delete;
+  ScopedLatency &operator=(ScopedLatency &&) = delete;
+
+  ~ScopedLatency() { mpHistogram->record(metricsClock() - mStart); }
+
+private:
+  Histogram *mpHistogram;
+  u64 mStart;
+};
+
+/**
+ * @brief Metrics by name. Looking a metric up locks, so hot paths keep the
+ * returned reference, which stays valid as long as the registry.
+ */
+class MetricsRegistry {
+public:
+  MetricsRegistry() = default;
+  MetricsRegistry(const MetricsRegistry &) = delete;
+  MetricsRegistry(MetricsRegistry &&) = delete;
+  MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+  MetricsRegistry &operator=(MetricsRegistry &&) = delete;
+  ~MetricsRegistry() = default;
+
+  Counter &counter(const std::string &name);
+
+  Gauge &gauge(const std::string &name);
+
+  Histogram &histogram(const std::string &name);
+
+  /**
+   * @brief Current values of every metric as JSON, histograms as their
+   * {HistogramSummary}.
+   */
+  std::string toJson() const;
+
+  /**
+   * @brief Writes {toJson} to {filePath} through a temporary file, so that
+   * readers never see a partial snapshot. Missing parent directories are
+   * created.
+   */
+  void writeJson(const std::string &filePath) const;
+
+private:
+  mutable std::mutex mMutex;
+  std::map<std::string, std::unique_ptr<Counter>> mCounters;
+  std::map<std::string, std::unique_ptr<Gauge>> mGauges;
+  std::map<std::string, std::unique_ptr<Histogram>> mHistograms;
+};
+
+/**
+ * @brief Registry the engine subsystems report to.
+ */
+MetricsRegistry &metricsRegistry();
+
+/**
+ * @brief Writes snapshots of a registry from a background thread every
+ * {interval}, and a last one when destroyed. An {interval} of 0 only writes
+ * the last one.
+ */
+class MetricsWriter {
+public:
+  MetricsWriter(const MetricsRegistry &registry, std::string filePath,
+                std::chrono::milliseconds interval);
+  MetricsWriter(const MetricsWriter &) = delete;
+  MetricsWriter(MetricsWriter &&) = delete;
+  MetricsWriter &operator=(const MetricsWriter &) = delete;
+  MetricsWriter &operator=(MetricsWriter &&) = delete;
+  ~MetricsWriter();
+
+private:
+  const MetricsRegistry *mpRegistry;
+  std::string mFilePath;
+  std::chrono::milliseconds mInterval;
+  std::mutex mMutex;
+  std::condition_variable mStopCondition;
+  bool mStopping = false;
+  std::thread mThread;
+
+  void writeLoop();
+};
+
+} /* namespace neko */
+
+#endif /* NEKO_UTILS_METRICS_HPP */
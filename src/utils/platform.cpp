@@ -0,0 +1,79 @@
+#include "platform.hpp"
+
+#if NEKO_SIMD_X86
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif /* _MSC_VER */
+#endif /* NEKO_SIMD_X86 */
+
+namespace neko {
+
+#if NEKO_SIMD_X86
+struct CpuidRegisters {
+  u32 eax = 0;
+  u32 ebx = 0;
+  u32 ecx = 0;
+  u32 edx = 0;
+};
+
+static CpuidRegisters cpuid(u32 leaf, u32 subleaf) {
+  CpuidRegisters registers;
+#if defined(_MSC_VER)
+  int values[4];
+  __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+  registers = {static_cast<u32>(values[0]), static_cast<u32>(values[1]),
+               static_cast<u32>(values[2]), static_cast<u32>(values[3])};
+#else
+  __cpuid_count(leaf, subleaf, registers.eax, registers.ebx, registers.ecx,
+                registers.edx);
+#endif /* _MSC_VER */
+  return registers;
+}
+
+/* Register state the OS saves on context switches (XCR0) */
+static u64 readXcr0() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  u32 eax;
+  u32 edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<u64>(edx) << 32) | eax;
+#endif /* _MSC_VER */
+}
+#endif /* NEKO_SIMD_X86 */
+
+SimdIsa detectSimdIsa() {
+#if NEKO_SIMD_X86
+  /* SSE2 is part of x86-64 */
+  if (cpuid(0, 0).eax < 7) {
+    return SimdIsa::sse;
+  }
+  CpuidRegisters features = cpuid(1, 0);
+  bool osSavesYmm = (features.ecx & (1u << 27)) != 0 && (readXcr0() & 6) == 6;
+  bool hasFma = (features.ecx & (1u << 12)) != 0;
+  bool hasAvx = (features.ecx & (1u << 28)) != 0;
+  bool hasAvx2 = (cpuid(7, 0).ebx & (1u << 5)) != 0;
+  return osSavesYmm && hasAvx && hasAvx2 && hasFma ? SimdIsa::avx2
+                                                   : SimdIsa::sse;
+#else
+  return SimdIsa::scalar;
+#endif /* NEKO_SIMD_X86 */
+}
+
+const char *simdIsaName(SimdIsa isa) {
+  switch (isa) {
+  case SimdIsa::scalar:
+    return "scalar";
+  case SimdIsa::sse:
+    return "sse";
+  case SimdIsa::avx2:
+    return "avx2";
+  }
+  return "unknown";
+}
+
+} /* namespace neko */
@@ -3,6 +3,12 @@
 
 #include "defines.hpp"
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define NEKO_SIMD_X86 1
+#else
+#define NEKO_SIMD_X86 0
+#endif /* x86-64 */
+
 namespace neko {
 
 enum Platform { linuxk, windows };
@@ -15,6 +21,24 @@ inline constexpr Platform platform = windows;
 #error "Operating system not supported"
 #endif /* current OS */
 
+/**
+ * @brief Instruction sets the CPU kernels are written for, in increasing
+ * order.
+ */
+enum class SimdIsa : u8 {
+  scalar = 0,
+  sse = 1,
+  avx2 = 2,
+};
+
+/**
+ * @brief Best instruction set supported by both the CPU (queried with CPUID)
+ * and the operating system.
+ */
+SimdIsa detectSimdIsa();
+
+const char *simdIsaName(SimdIsa isa);
+
 } /* namespace neko */
 
 #endif /* UTILS_PLATFORM_HPP */
\ No newline at end of file
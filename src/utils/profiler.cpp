@@ -0,0 +1,217 @@
+#include "profiler.hpp"
+
+#if NEKO_PROFILING
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+namespace neko {
+
+/* Events per chunk, and chunks per thread before events are dropped */
+static constexpr u32 profileChunkCapacity = 4096;
+static constexpr u32 maxProfileChunkCount = 256;
+
+/* Clock readings spaced by at least this long convert ticks to time */
+static constexpr auto minCalibrationDuration = std::chrono::milliseconds{10};
+
+/**
+ * @brief Events are only written by the owning thread. {count} is published
+ * with release semantics so that an exporting thread reads complete events.
+ */
+struct ProfileEventChunk {
+  ProfileEvent events[profileChunkCapacity];
+  std::atomic<u32> count = 0;
+  std::atomic<ProfileEventChunk *> pNext = nullptr;
+};
+
+struct ProfileThreadBuffer {
+  u32 threadIndex = 0;
+  /* Guarded by the mutex of the registry */
+  std::string name;
+  ProfileEventChunk firstChunk;
+  /* Only touched by the owning thread */
+  ProfileEventChunk *pLastChunk = &firstChunk;
+  u32 chunkCount = 1;
+  std::atomic<u64> droppedCount = 0;
+
+  ~ProfileThreadBuffer() {
+    ProfileEventChunk *pChunk = firstChunk.pNext.load();
+    while (pChunk != nullptr) {
+      ProfileEventChunk *pNext = pChunk->pNext.load();
+      delete pChunk;
+      pChunk = pNext;
+    }
+  }
+};
+
+/**
+ * @brief Buffers of every thread that recorded an event, kept until exit so
+ * that the events of finished threads can still be exported.
+ */
+struct ProfileRegistry {
+  typedef std::chrono::steady_clock Clock_T;
+
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ProfileThreadBuffer>> buffers;
+  /* First pair of readings, ticks are converted against it */
+  u64 startTicks = readProfilerClock();
+  Clock_T::time_point startTime = Clock_T::now();
+};
+
+static ProfileRegistry &profileRegistry() {
+  static ProfileRegistry registry;
+  return registry;
+}
+
+/* Created before {main}, so that the start of the registry precedes every
+zone */
+[[maybe_unused]] static ProfileRegistry &gProfileRegistry = profileRegistry();
+
+static thread_local ProfileThreadBuffer *tpProfileBuffer = nullptr;
+
+static ProfileThreadBuffer &currentProfileBuffer() {
+  if (tpProfileBuffer == nullptr) {
+    ProfileRegistry &registry = profileRegistry();
+    std::lock_guard lock{registry.mutex};
+    auto pBuffer = std::make_unique<ProfileThreadBuffer>();
+    pBuffer->threadIndex = static_cast<u32>(registry.buffers.size());
+    tpProfileBuffer = pBuffer.get();
+    registry.buffers.push_back(std::move(pBuffer));
+  }
+  return *tpProfileBuffer;
+}
+
+void recordProfileEvent(const ProfileEvent &event) noexcept {
+  ProfileThreadBuffer &buffer = currentProfileBuffer();
+  ProfileEventChunk *pChunk = buffer.pLastChunk;
+  u32 count = pChunk->count.load(std::memory_order_relaxed);
+  if (count == profileChunkCapacity) {
+    if (buffer.chunkCount == maxProfileChunkCount) {
+      buffer.droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    auto pNewChunk = new (std::nothrow) ProfileEventChunk;
+    if (pNewChunk == nullptr) {
+      buffer.droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    pChunk->pNext.store(pNewChunk, std::memory_order_release);
+    buffer.pLastChunk = pNewChunk;
+    ++buffer.chunkCount;
+    pChunk = pNewChunk;
+    count = 0;
+  }
+  pChunk->events[count] = event;
+  pChunk->count.store(count + 1, std::memory_order_release);
+}
+
+void setProfilerThreadName(const std::string &name) {
+  ProfileThreadBuffer &buffer = currentProfileBuffer();
+  std::lock_guard lock{profileRegistry().mutex};
+  buffer.name = name;
+}
+
+u64 profilerDroppedEventCount() noexcept {
+  ProfileRegistry &registry = profileRegistry();
+  std::lock_guard lock{registry.mutex};
+  u64 droppedCount = 0;
+  for (const auto &pBuffer : registry.buffers) {
+    droppedCount += pBuffer->droppedCount.load(std::memory_order_relaxed);
+  }
+  return droppedCount;
+}
+
+static void writeJsonString(std::ostream &os, const char *string) {
+  os << '"';
+  for (const char *pChar = string; *pChar != '\0'; ++pChar) {
+    if (*pChar == '"' || *pChar == '\\') {
+      os << '\\' << *pChar;
+    } else if (static_cast<unsigned char>(*pChar) < 0x20) {
+      os << ' ';
+    } else {
+      os << *pChar;
+    }
+  }
+  os << '"';
+}
+
+void writeChromeTrace(const std::string &filePath) {
+  typedef ProfileRegistry::Clock_T Clock_T;
+  ProfileRegistry &registry = profileRegistry();
+
+  /* Ticks per microsecond, from two readings of both clocks far enough
+  apart */
+  while (Clock_T::now() - registry.startTime < minCalibrationDuration) {
+    std::this_thread::yield();
+  }
+  u64 endTicks = readProfilerClock();
+  auto elapsed = std::chrono::duration<f64, std::micro>(Clock_T::now() -
+                                                        registry.startTime);
+  f64 microsecondsPerTick =
+      elapsed.count() / static_cast<f64>(endTicks - registry.startTicks);
+
+  auto parentPath = std::filesystem::path(filePath).parent_path();
+  if (!parentPath.empty()) {
+    std::filesystem::create_directories(parentPath);
+  }
+  std::ofstream fs(filePath);
+  if (!fs.is_open()) {
+    throw std::runtime_error("Failed to open trace file " + filePath);
+  }
+  char number[32];
+  auto toMicroseconds = [&](u64 ticks) {
+    f64 time = ticks > registry.startTicks
+                   ? static_cast<f64>(ticks - registry.startTicks) *
+                         microsecondsPerTick
+                   : 0.0;
+    std::snprintf(number, sizeof(number), "%.3f", time);
+    return number;
+  };
+
+  std::lock_guard lock{registry.mutex};
+  fs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto &pBuffer : registry.buffers) {
+    std::string name = pBuffer->name.empty()
+                           ? "Thread " + std::to_string(pBuffer->threadIndex)
+                           : pBuffer->name;
+    fs << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\","
+       << "\"pid\":1,\"tid\":" << pBuffer->threadIndex
+       << ",\"args\":{\"name\":";
+    writeJsonString(fs, name.c_str());
+    fs << "}}";
+    first = false;
+    for (const ProfileEventChunk *pChunk = &pBuffer->firstChunk;
+         pChunk != nullptr;
+         pChunk = pChunk->pNext.load(std::memory_order_acquire)) {
+      u32 count = pChunk->count.load(std::memory_order_acquire);
+      for (u32 iEvent = 0; iEvent < count; ++iEvent) {
+        const ProfileEvent &event = pChunk->events[iEvent];
+        fs << ",\n{\"name\":";
+        writeJsonString(fs, event.name);
+        fs << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << pBuffer->threadIndex
+           << ",\"ts\":" << toMicroseconds(event.begin);
+        /* Durations are differences of the same clock */
+        std::snprintf(number, sizeof(number), "%.3f",
+                      static_cast<f64>(event.end - event.begin) *
+                          microsecondsPerTick);
+        fs << ",\"dur\":" << number << "}";
+      }
+    }
+  }
+  fs << "\n]}\n";
+  if (!fs) {
+    throw std::runtime_error("Failed to write trace file " + filePath);
+  }
+}
+
+} /* namespace neko */
+
+#endif /* NEKO_PROFILING */
@@ -0,0 +1,118 @@
+#ifndef NEKO_UTILS_PROFILER_HPP
+#define NEKO_UTILS_PROFILER_HPP
+
+#include "defines.hpp"
+
+/* The zone profiler only exists when configured with NEKO_PROFILING, the
+macros below expand to nothing otherwise */
+#if NEKO_PROFILING
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64)
+#include <intrin.h>
+#else
+#include <chrono>
+#endif /* architecture */
+
+namespace neko {
+
+/**
+ * @brief Ticks of the profiler clock: the time stamp counter on x86, which is
+ * invariant on every CPU the engine targets and costs a couple of
+ * nanoseconds, the steady clock in nanoseconds elsewhere. Converted to time
+ * when exported.
+ */
+inline u64 readProfilerClock() noexcept {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+  return __rdtsc();
+#else
+  return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now()
+                                  .time_since_epoch())
+                              .count());
+#endif /* architecture */
+}
+
+/**
+ * @brief Zone recorded on the thread that ran it. {name} must outlive the
+ * profiler, string literals and {__func__} do.
+ */
+struct ProfileEvent {
+  const char *name;
+  u64 begin;
+  u64 end;
+};
+
+/**
+ * @brief Appends {event} to the buffer of the calling thread, without locking
+ * once the thread has recorded its first event. Events past the capacity of
+ * the buffer are dropped and counted.
+ */
+void recordProfileEvent(const ProfileEvent &event) noexcept;
+
+/**
+ * @brief Names the calling thread in the exported trace.
+ */
+void setProfilerThreadName(const std::string &name);
+
+/**
+ * @brief Events dropped so far because a thread buffer was full.
+ */
+u64 profilerDroppedEventCount() noexcept;
+
+/**
+ * @brief Writes the events of every thread recorded so far as a Chrome trace
+ * (JSON), which chrome://tracing and Perfetto open. Threads may keep
+ * recording while it runs, their later events are left out. Missing parent
+ * directories are created.
+ */
+void writeChromeTrace(const std::string &filePath);
+
+/**
+ * @brief Records the lifetime of the zone on the calling thread. Zones nest
+ * by their timestamps.
+ */
+class ProfileZone {
+public:
+  explicit ProfileZone(const char *name) noexcept
+      : mName{name}, mBegin{readProfilerClock()} {}
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone(ProfileZone &&) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+  ProfileZone &operator=(ProfileZone &&) = delete;
+
+  ~ProfileZone() { recordProfileEvent({mName, mBegin, readProfilerClock()}); }
+
+private:
+  const char *mName;
+  u64 mBegin;
+};
+
+} /* namespace neko */
+
+#define NEKO_PROFILE_CONCAT_IMPL(lhs, rhs) lhs##rhs
+#define NEKO_PROFILE_CONCAT(lhs, rhs) NEKO_PROFILE_CONCAT_IMPL(lhs, rhs)
+
+#define NEKO_PROFILE_ZONE(name)                                                \
+  neko::ProfileZone NEKO_PROFILE_CONCAT(profileZone, __LINE__) { name }
+
+#define NEKO_PROFILE_FUNCTION() NEKO_PROFILE_ZONE(__func__)
+
+#define NEKO_PROFILE_THREAD(name) neko::setProfilerThreadName(name)
+
+#define NEKO_PROFILE_WRITE_TRACE(filePath) neko::writeChromeTrace(filePath)
+
+#else
+
+#define NEKO_PROFILE_ZONE(name) static_cast<void>(0)
+
+#define NEKO_PROFILE_FUNCTION() static_cast<void>(0)
+
+#define NEKO_PROFILE_THREAD(name) static_cast<void>(0)
+
+#define NEKO_PROFILE_WRITE_TRACE(filePath) static_cast<void>(0)
+
+#endif /* NEKO_PROFILING */
+
+#endif /* NEKO_UTILS_PROFILER_HPP */
@@ -47,6 +47,138 @@ static CPUThreadUsage makeCPUThreadUsage(const std::string &usageModeStr) {
   throw std::runtime_error("Unknown CPU thread usage mode.");
 }
 
+static RenderBackend makeRenderBackend(const std::string &backendStr) {
+  if (backendStr == "vulkan") {
+    return RenderBackend::vulkan;
+  }
+  if (backendStr == "cpu") {
+    return RenderBackend::cpu;
+  }
+  throw std::runtime_error("Unknown render backend.");
+}
+
+static PrimaryRayMode makePrimaryRayMode(const std::string &modeStr) {
+  if (modeStr == "single") {
+    return PrimaryRayMode::single;
+  }
+  if (modeStr == "packet8") {
+    return PrimaryRayMode::packet8;
+  }
+  if (modeStr == "packet16") {
+    return PrimaryRayMode::packet16;
+  }
+  if (modeStr == "stream") {
+    return PrimaryRayMode::stream;
+  }
+  throw std::runtime_error("Unknown primary ray mode.");
+}
+
+static PathTracerMode makePathTracerMode(const std::string &modeStr) {
+  if (modeStr == "tiled") {
+    return PathTracerMode::tiled;
+  }
+  if (modeStr == "wavefront") {
+    return PathTracerMode::wavefront;
+  }
+  throw std::runtime_error("Unknown path tracer mode.");
+}
+
+static RaySortMode makeRaySortMode(const std::string &modeStr) {
+  if (modeStr == "off") {
+    return RaySortMode::off;
+  }
+  if (modeStr == "on") {
+    return RaySortMode::on;
+  }
+  if (modeStr == "adaptive") {
+    return RaySortMode::adaptive;
+  }
+  throw std::runtime_error("Unknown ray sort mode.");
+}
+
+static LightSamplingMode makeLightSamplingMode(const std::string &modeStr) {
+  if (modeStr == "uniform") {
+    return LightSamplingMode::uniform;
+  }
+  if (modeStr == "power") {
+    return LightSamplingMode::power;
+  }
+  if (modeStr == "bvh") {
+    return LightSamplingMode::bvh;
+  }
+  throw std::runtime_error("Unknown light sampling mode.");
+}
+
+static SamplerType makeSamplerType(const std::string &typeStr) {
+  if (typeStr == "pcg") {
+    return SamplerType::pcg;
+  }
+  if (typeStr == "sobol") {
+    return SamplerType::sobol;
+  }
+  if (typeStr == "blue-noise") {
+    return SamplerType::blueNoise;
+  }
+  throw std::runtime_error("Unknown sampler type.");
+}
+
+/* An instruction set the CPU lacks is rejected */
+static SimdIsa makeSimdIsa(const std::string &isaStr) {
+  SimdIsa detectedIsa = detectSimdIsa();
+  if (isaStr == "auto") {
+    return detectedIsa;
+  }
+  SimdIsa isa;
+  if (isaStr == "scalar") {
+    isa = SimdIsa::scalar;
+  } else if (isaStr == "sse") {
+    isa = SimdIsa::sse;
+  } else if (isaStr == "avx2") {
+    isa = SimdIsa::avx2;
+  } else {
+    throw std::runtime_error("Unknown SIMD instruction set " + isaStr);
+  }
+  if (isa > detectedIsa) {
+    throw std::runtime_error("The CPU does not support " + isaStr);
+  }
+  return isa;
+}
+
+static FramePacing makeFramePacing(const std::string &pacingStr) {
+  if (pacingStr == "continuous") {
+    return FramePacing::continuous;
+  }
+  if (pacingStr == "fixed-rate") {
+    return FramePacing::fixedRate;
+  }
+  if (pacingStr == "on-demand") {
+    return FramePacing::onDemand;
+  }
+  throw std::runtime_error("Unknown frame pacing.");
+}
+
+static LogLevel makeLogLevel(const std::string &levelStr) {
+  if (levelStr == "trace") {
+    return LogLevel::trace;
+  }
+  if (levelStr == "debug") {
+    return LogLevel::debug;
+  }
+  if (levelStr == "info") {
+    return LogLevel::info;
+  }
+  if (levelStr == "warning") {
+    return LogLevel::warning;
+  }
+  if (levelStr == "error") {
+    return LogLevel::error;
+  }
+  if (levelStr == "off") {
+    return LogLevel::off;
+  }
+  throw std::runtime_error("Unknown log level.");
+}
+
 Settings::Settings(const std::string &settingsFilePath) {
   std::fstream fs(settingsFilePath);
   if (!fs.is_open()) {
@@ -67,10 +199,69 @@ Settings::Settings(const std::string &settingsFilePath) {
   auto graphicsSettings = jsonData["graphics"];
   graphics.screenWidth = graphicsSettings["render-window"]["width"];
   graphics.screenHeight = graphicsSettings["render-window"]["height"];
+  graphics.backend =
+      makeRenderBackend(graphicsSettings.value("backend", "vulkan"));
+  graphics.framePacing =
+      makeFramePacing(graphicsSettings.value("frame-pacing", "on-demand"));
+  graphics.frameRate = graphicsSettings.value("frame-rate", 60.0f);
+  /* Also rejects NaN, a period of 0 would pace nothing and spin */
+  if (!(graphics.frameRate > 0.0f)) {
+    throw std::runtime_error("The frame rate must be positive.");
+  }
+  auto pathTracerSettings =
+      graphicsSettings.value("path-tracer", nlohmann::json::object());
+  graphics.pathTracer.samplesPerPixel =
+      pathTracerSettings.value("samples-per-pixel", 16u);
+  graphics.pathTracer.maxBounces = pathTracerSettings.value("max-bounces", 5u);
+  graphics.pathTracer.mode = makePathTracerMode(
+      pathTracerSettings.value("mode", std::string{"tiled"}));
+  graphics.pathTracer.raySorting = makeRaySortMode(
+      pathTracerSettings.value("ray-sorting", std::string{"off"}));
+  graphics.pathTracer.lightSampling = makeLightSamplingMode(
+      pathTracerSettings.value("light-sampling", std::string{"uniform"}));
+  graphics.pathTracer.sampler = makeSamplerType(
+      pathTracerSettings.value("sampler", std::string{"pcg"}));
+  graphics.pathTracer.adaptiveSampling =
+      pathTracerSettings.value("adaptive-sampling", false);
+  graphics.pathTracer.noiseThreshold =
+      pathTracerSettings.value("noise-threshold", 0.02f);
+  graphics.pathTracer.timeBudget =
+      pathTracerSettings.value("time-budget", 0.0f);
+  graphics.pathTracer.tileSize = pathTracerSettings.value("tile-size", 16u);
+  graphics.pathTracer.sphereSegmentCount =
+      pathTracerSettings.value("sphere-segment-count", 16u);
+  graphics.pathTracer.bvhMaxLeafSize =
+      pathTracerSettings.value("bvh-max-leaf-size", 4u);
+  graphics.pathTracer.bvhBinCount =
+      pathTracerSettings.value("bvh-bin-count", 16u);
+  graphics.pathTracer.bvhWidth = pathTracerSettings.value("bvh-width", 8u);
+  if (graphics.pathTracer.bvhWidth != 2 && graphics.pathTracer.bvhWidth != 4 &&
+      graphics.pathTracer.bvhWidth != 8) {
+    throw std::runtime_error("The BVH width must be 2, 4 or 8.");
+  }
+  graphics.pathTracer.compressedBvh =
+      pathTracerSettings.value("compressed-bvh", false);
+  graphics.pathTracer.simdIsa =
+      makeSimdIsa(pathTracerSettings.value("simd-isa", std::string{"auto"}));
+  graphics.pathTracer.primaryRays = makePrimaryRayMode(
+      pathTracerSettings.value("primary-rays", std::string{"stream"}));
+  graphics.pathTracer.outputFile = pathTracerSettings.value(
+      "output-file", std::string{"data/renders/cpu.ppm"});
 
   auto systemSettings = jsonData["system"];
   system.cpuThreadUsage =
       makeCPUThreadUsage(systemSettings["cpu-thread-usage"]);
+  system.workerCount = systemSettings.value("worker-count", 0u);
+  system.pinWorkers = systemSettings.value("pin-workers", false);
+  system.cpuAffinity = systemSettings.value("cpu-affinity", std::string{});
+  system.profileTraceFile = systemSettings.value(
+      "profile-trace-file", std::string{"data/logs/trace.json"});
+  system.metricsFile = systemSettings.value(
+      "metrics-file", std::string{"data/logs/metrics.json"});
+  system.metricsInterval = systemSettings.value("metrics-interval", 10.0f);
+  system.logLevel = makeLogLevel(systemSettings.value("log-level", "info"));
+  system.logFile = systemSettings.value("log-file",
+                                        std::string{"data/logs/info.log"});
 
   auto advancedSettings = jsonData["advanced"];
 }
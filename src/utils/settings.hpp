@@ -2,6 +2,7 @@
 #define NEKO_UTILS_SETTINGS_HPP
 
 #include "defines.hpp"
+#include "platform.hpp"
 
 namespace neko {
 
@@ -11,6 +12,83 @@ enum CPUThreadUsage {
   high = 1,
 };
 
+enum class RenderBackend : u8 {
+  vulkan,
+  /* Headless path tracer, needs neither a GPU nor a window */
+  cpu,
+};
+
+/* How the CPU path tracer intersects camera rays */
+enum class PrimaryRayMode : u8 {
+  single,
+  /* 4x2 and 4x4 pixel blocks traced as one packet */
+  packet8,
+  packet16,
+  /* Whole tiles filtered through the BVH as one stream */
+  stream,
+};
+
+/* How the CPU path tracer schedules its work */
+enum class PathTracerMode : u8 {
+  /* Each job traces every path of a tile to completion */
+  tiled,
+  /* All paths advance together through generate, extend, shade, shadow and
+  accumulate stages working on ray queues */
+  wavefront,
+};
+
+/* Whether the wavefront path tracer sorts bounce rays before tracing them */
+enum class RaySortMode : u8 {
+  off,
+  on,
+  /* Sort the bounces for which sorting measurably speeds up traversal */
+  adaptive,
+};
+
+/* How next event estimation picks the emitter to sample */
+enum class LightSamplingMode : u8 {
+  uniform,
+  /* Alias table over the emitted power, constant time per sample */
+  power,
+  /* Light BVH descended towards the subtrees estimated to contribute most to
+  the shading point */
+  bvh,
+};
+
+/* Where the path tracers take their sample values from */
+enum class SamplerType : u8 {
+  /* Independent PCG random numbers */
+  pcg,
+  /* Owen-scrambled Sobol points, decorrelated per pixel */
+  sobol,
+  /* Sobol points shared by all pixels, offset per pixel by a blue noise mask
+  so that the error is spread as blue noise over the image */
+  blueNoise,
+};
+
+/* How the window loop waits between frames */
+enum class FramePacing : u8 {
+  /* Renders frames back to back and polls for events, keeping a core busy */
+  continuous,
+  /* Renders at {frameRate} and sleeps in between, until the next frame or
+  an event */
+  fixedRate,
+  /* Sleeps until an event arrives, then renders at most at {frameRate} */
+  onDemand,
+};
+
+/* Severity of a log record, records below the configured level are
+discarded */
+enum class LogLevel : u8 {
+  trace,
+  debug,
+  info,
+  warning,
+  error,
+  /* Discards every record */
+  off,
+};
+
 struct Version {
   u32 major;
   u32 minor;
@@ -29,11 +107,65 @@ struct Settings {
   struct {
     u32 screenWidth = 800;
     u32 screenHeight = 600;
+    RenderBackend backend = RenderBackend::vulkan;
+    FramePacing framePacing = FramePacing::onDemand;
+    f32 frameRate = 60.0f;
 
+    struct {
+      u32 samplesPerPixel = 16;
+      u32 maxBounces = 5;
+      PathTracerMode mode = PathTracerMode::tiled;
+      RaySortMode raySorting = RaySortMode::off;
+      LightSamplingMode lightSampling = LightSamplingMode::uniform;
+      SamplerType sampler = SamplerType::pcg;
+      /* Tiled mode: spend samples on the noisiest tiles first and stop each
+      tile once its noise falls below {noiseThreshold}, {samplesPerPixel}
+      becoming the maximum per pixel */
+      bool adaptiveSampling = false;
+      /* Standard error of the pixel luminance over the square root of its
+      mean, averaged over a tile */
+      f32 noiseThreshold = 0.02f;
+      /* Milliseconds after which adaptive sampling stops refining tiles, 0 for
+      no limit */
+      f32 timeBudget = 0.0f;
+      /* Side of the square tiles scheduled on the thread pool, in pixels */
+      u32 tileSize = 16;
+      u32 sphereSegmentCount = 16;
+      /* Nodes with more triangles are always split */
+      u32 bvhMaxLeafSize = 4;
+      /* Split candidates per axis evaluated by the binned SAH builder */
+      u32 bvhBinCount = 16;
+      /* Children per node: 2 traverses the binary BVH, 4 and 8 collapse it */
+      u32 bvhWidth = 8;
+      /* Quantize the BVH into 8-wide nodes of 88 bytes, for single rays */
+      bool compressedBvh = false;
+      /* Kernels of the path tracers, "auto" in the settings file selects
+      {detectSimdIsa()} */
+      SimdIsa simdIsa = detectSimdIsa();
+      PrimaryRayMode primaryRays = PrimaryRayMode::stream;
+      std::string outputFile = "data/renders/cpu.ppm";
+    } pathTracer;
   } graphics;
 
   struct {
     CPUThreadUsage cpuThreadUsage = high;
+    /* 0 derives the worker count from {cpuThreadUsage} and the CPU topology */
+    u32 workerCount = 0;
+    /* Pin every worker to a single logical CPU */
+    bool pinWorkers = false;
+    /* Linux cpulist ("0-7,16-23") of the CPUs workers may run on, empty for
+    all CPUs available to the process */
+    std::string cpuAffinity = "";
+    /* Chrome trace written on shutdown by builds configured with
+    NEKO_PROFILING */
+    std::string profileTraceFile = "data/logs/trace.json";
+    /* Snapshot of the metrics registry, rewritten every {metricsInterval}
+    seconds (0 for only on shutdown) */
+    std::string metricsFile = "data/logs/metrics.json";
+    f32 metricsInterval = 10.0f;
+    /* Records of the logger, appended to {logFile} */
+    LogLevel logLevel = LogLevel::info;
+    std::string logFile = "data/logs/info.log";
   } system;
 
   Settings() = default;
@@ -2,13 +2,15 @@
 #define NEKO_UTILS_TIMER_HPP
 
 #include "defines.hpp"
+#include "logger.hpp"
+
 #include <chrono>
 
 #define TIMER_START(timer_name)                                                \
   auto timer_name = neko::ScopedTimer { neko::TimeUnit::milliseconds }
 
 #define TIMER_INVOKE(timer_name, note)                                         \
-  timer_name.invoke([](float x) { printf("%s: %f ms\n", note, x); })
+  timer_name.invoke([](float x) { neko::logInfo("%s: %f ms", note, x); })
 
 namespace neko {
 
@@ -2,7 +2,10 @@
 #define NEKO_UTILS_HPP
 
 #include "defines.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
 #include "platform.hpp"
+#include "profiler.hpp"
 #include "settings.hpp"
 #include "timer.hpp"
 
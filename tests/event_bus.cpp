@@ -0,0 +1,86 @@
+#include "tests.hpp"
+
+#include "events.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace neko {
+
+/* Frames of the headless loop, and numbered events published in each */
+static constexpr u32 frameCount = 200;
+static constexpr u32 eventsPerFrame = 64;
+
+bool testEventBus(ThreadPool &threadPool) {
+  EventBus eventBus;
+  /* Events delivered out of order or in the batch of another frame */
+  u32 mismatchCount = 0;
+  /* Keys count up across frames, each batch continues the previous one */
+  i32 nextKey = 0;
+  eventBus.subscribe<KeyEvent>([&](std::span<const KeyEvent> events) {
+    for (const KeyEvent &event : events) {
+      if (event.key != nextKey) {
+        ++mismatchCount;
+      }
+      nextKey = event.key + 1;
+    }
+  });
+
+  /* The frame the loop waits in, and the last frame fully published */
+  std::atomic<u32> waitingFrame = 0;
+  std::atomic<u32> publishedFrame = 0;
+  std::atomic<u64> publishTime = 0;
+  std::thread publisher{[&] {
+    i32 key = 0;
+    for (u32 iFrame = 1; iFrame <= frameCount; ++iFrame) {
+      while (waitingFrame.load() != iFrame) {
+        std::this_thread::yield();
+      }
+      /* Gives the loop time to block */
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      publishTime.store(metricsClock());
+      for (u32 iEvent = 0; iEvent < eventsPerFrame; ++iEvent) {
+        eventBus.publish(KeyEvent{key++, 0, 0, 0});
+      }
+      publishedFrame.store(iFrame);
+    }
+  }};
+
+  /* Waits that timed out although an event had been published */
+  u32 missedWakeCount = 0;
+  u64 dispatchTime = 0;
+  u64 deliveredCount = 0;
+  f64 latencySum = 0.0;
+  f64 maxLatency = 0.0;
+  for (u32 iFrame = 1; iFrame <= frameCount; ++iFrame) {
+    waitingFrame.store(iFrame);
+    if (!eventBus.waitForEvents(std::chrono::seconds{1})) {
+      ++missedWakeCount;
+    }
+    /* Microseconds from the publish to the return of the wait */
+    f64 latency = static_cast<f64>(metricsClock() - publishTime.load()) / 1e3;
+    latencySum += latency;
+    maxLatency = std::max(maxLatency, latency);
+    while (publishedFrame.load() != iFrame) {
+      std::this_thread::yield();
+    }
+    u64 start = metricsClock();
+    u64 eventCount = eventBus.dispatch(threadPool);
+    dispatchTime += metricsClock() - start;
+    deliveredCount += eventCount;
+    if (eventCount != eventsPerFrame) {
+      ++mismatchCount;
+    }
+  }
+  publisher.join();
+
+  std::printf("Event bus: wake latency %.1f us (max %.1f us), %.1f ns/event "
+              "dispatched, %u missed wakes, %u mismatches\n",
+              latencySum / frameCount, maxLatency,
+              static_cast<f64>(dispatchTime) /
+                  static_cast<f64>(std::max<u64>(deliveredCount, 1)),
+              missedWakeCount, mismatchCount);
+  return missedWakeCount == 0 && mismatchCount == 0;
+}
+
+} /* namespace neko */
@@ -0,0 +1,57 @@
+#include "tests.hpp"
+
+#include <cstring>
+#include <iostream>
+
+struct Test {
+  const char *name;
+  bool (*pRun)(neko::ThreadPool &threadPool);
+};
+
+static constexpr Test tests[] = {
+    {"event-bus", &neko::testEventBus},
+    {"occlusion", &neko::testOcclusion},
+    {"parallel", &neko::testParallel},
+    {"task-graph", &neko::testTaskGraph},
+    {"tasks", &neko::testTasks},
+};
+
+static int protected_main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <test|all>\nTests:";
+    for (const auto &test : tests) {
+      std::cerr << ' ' << test.name;
+    }
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+  neko::ThreadPool threadPool{neko::Settings{}};
+  bool runAll = std::strcmp(argv[1], "all") == 0;
+  bool found = false;
+  bool passed = true;
+  for (const auto &test : tests) {
+    if (runAll || std::strcmp(argv[1], test.name) == 0) {
+      found = true;
+      bool testPassed = test.pRun(threadPool);
+      std::cout << test.name << (testPassed ? ": passed" : ": failed")
+                << std::endl;
+      passed = passed && testPassed;
+    }
+  }
+  if (!found) {
+    std::cerr << "Unknown test " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+  try {
+    return protected_main(argc, argv);
+  } catch (std::exception &e) {
+    std::cerr << e.what() << std::endl;
+  } catch (...) {
+    std::cerr << "Uncaught exception" << std::endl;
+  }
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,98 @@
+#include "tests.hpp"
+
+#include "random.hpp"
+#include "scene.hpp"
+
+#include <bit>
+#include <cstdio>
+
+namespace neko {
+
+/* Packets queried per BVH layout and instruction set */
+static constexpr u32 packetCount = 4096;
+
+struct BvhLayout {
+  const char *name;
+  u32 width;
+  bool compressed;
+};
+
+static constexpr BvhLayout bvhLayouts[] = {
+    {"binary", 2, false},
+    {"wide-4", 4, false},
+    {"wide-8", 8, false},
+    {"compressed", 8, true},
+};
+
+/* Shadow-like ray between two points of {bounds}, or leaving the scene */
+static Ray randomRay(Rng &rng, const Aabb &bounds) {
+  auto randomPoint = [&rng, &bounds]() {
+    return bounds.lower + Vec3{rng.nextF32(), rng.nextF32(), rng.nextF32()} *
+                              bounds.extent();
+  };
+  Vec3 origin = randomPoint();
+  Vec3 toTarget = randomPoint() - origin;
+  f32 distance = length(toTarget);
+  Ray ray;
+  ray.origin = origin;
+  ray.direction = toTarget / distance;
+  if (rng.nextU32() % 4 != 0) {
+    ray.tMax = distance;
+  }
+  return ray;
+}
+
+bool testOcclusion(ThreadPool &threadPool) {
+  Scene scene = Scene::cornellBox(1.0f, 16);
+  const SimdIsa bestIsa = detectSimdIsa();
+  u64 mismatchCount = 0;
+  for (const BvhLayout &layout : bvhLayouts) {
+    for (auto isa : {SimdIsa::scalar, SimdIsa::sse, SimdIsa::avx2}) {
+      if (isa > bestIsa) {
+        continue;
+      }
+      scene.buildBvh(threadPool, {}, layout.width, isa, layout.compressed);
+      scene.updateInstances(threadPool, {});
+      const Aabb bounds = scene.bounds();
+      Rng rng{layout.width, static_cast<u64>(isa)};
+      /* Kept across packets, as in a shadow stage, so that both the cached
+      occluder and the traversal answer lanes */
+      OcclusionCache cache;
+      TraversalStats stats;
+      u64 occludedCount = 0;
+      u64 layoutMismatchCount = 0;
+      for (u32 iPacket = 0; iPacket < packetCount; ++iPacket) {
+        RayPacket<8> packet;
+        Ray rays[8];
+        for (u32 lane = 0; lane < 8; ++lane) {
+          rays[lane] = randomRay(rng, bounds);
+          packet.setRay(lane, rays[lane]);
+        }
+        /* Every fourth packet is full, the others have random lanes off */
+        u32 validMask = iPacket % 4 == 0 ? 0xffu : rng.nextU32() & 0xffu;
+        u32 occludedMask = scene.occluded8(validMask, packet, cache, stats);
+        u32 expectedMask = 0;
+        for (u32 lane = 0; lane < 8; ++lane) {
+          if ((validMask >> lane) & 1u && scene.occluded(rays[lane], stats)) {
+            expectedMask |= 1u << lane;
+          }
+        }
+        if (occludedMask != expectedMask) {
+          ++layoutMismatchCount;
+        }
+        occludedCount += static_cast<u64>(std::popcount(expectedMask));
+      }
+      std::printf("%-10s %-6s occluded %llu, cache hits %llu / %llu, "
+                  "mismatched packets %llu\n",
+                  layout.name, simdIsaName(isa),
+                  static_cast<unsigned long long>(occludedCount),
+                  static_cast<unsigned long long>(cache.hitCount),
+                  static_cast<unsigned long long>(cache.queryCount),
+                  static_cast<unsigned long long>(layoutMismatchCount));
+      mismatchCount += layoutMismatchCount;
+    }
+  }
+  return mismatchCount == 0;
+}
+
+} /* namespace neko */
@@ -0,0 +1,211 @@
+#include "tests.hpp"
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+
+namespace neko {
+
+/* Ranges split by {parallelForRange}, a grain size of 0 lets the pool pick */
+struct SplitCase {
+  u64 begin;
+  u64 end;
+  u64 grainSize;
+};
+
+static constexpr SplitCase splitCases[] = {
+    {0, 0, 4},
+    {5, 5, 0},
+    {0, 1, 0},
+    {0, 1000, 1},
+    {0, 1000, 7},
+    {3, 1000, 0},
+    {17, 18, 5},
+    {0, 64, 64},
+    {0, 65, 64},
+    {100, 4100, 0},
+};
+
+/* Jobs each nested job submits, and levels of jobs waiting on their own */
+static constexpr u32 nestedFanOut = 4;
+static constexpr u32 nestedDepth = 4;
+
+/* Waits the calling thread is inside, so that jobs can tell they are run by a
+thread helping while it waits */
+static thread_local u32 waitDepth = 0;
+
+/**
+ * @brief Whether {parallelForRange} covers each range with consecutive
+ * chunks of exactly the grain size, but the last one, and {parallelFor}
+ * visits each index once.
+ */
+static bool testGrainSplitting(ThreadPool &threadPool) {
+  bool passed = true;
+  for (const SplitCase &split : splitCases) {
+    std::mutex chunksMutex;
+    std::vector<std::pair<u64, u64>> chunks;
+    parallelForRange(threadPool, split.begin, split.end, split.grainSize,
+                     [&](u64 chunkBegin, u64 chunkEnd) {
+                       std::lock_guard lock{chunksMutex};
+                       chunks.emplace_back(chunkBegin, chunkEnd);
+                     });
+    std::sort(chunks.begin(), chunks.end());
+    u64 grainSize =
+        split.begin < split.end
+            ? chooseGrainSize(threadPool, split.end - split.begin,
+                              split.grainSize)
+            : 0;
+    bool covered = true;
+    u64 nextBegin = split.begin;
+    for (const auto &[chunkBegin, chunkEnd] : chunks) {
+      u64 expectedEnd = std::min(chunkBegin + grainSize, split.end);
+      covered = covered && chunkBegin == nextBegin && chunkEnd == expectedEnd;
+      nextBegin = chunkEnd;
+    }
+    covered = covered && nextBegin == split.end;
+
+    std::vector<std::atomic<u32>> visitCounts(split.end);
+    parallelFor(threadPool, split.begin, split.end, split.grainSize,
+                [&visitCounts](u64 index) {
+                  visitCounts[index].fetch_add(1, std::memory_order_relaxed);
+                });
+    for (u64 index = 0; index < split.end; ++index) {
+      covered = covered &&
+                visitCounts[index].load() == (index >= split.begin ? 1 : 0);
+    }
+    if (!covered) {
+      std::printf("Range [%llu, %llu) with grain size %llu split wrongly\n",
+                  static_cast<unsigned long long>(split.begin),
+                  static_cast<unsigned long long>(split.end),
+                  static_cast<unsigned long long>(split.grainSize));
+    }
+    passed = passed && covered;
+  }
+  return passed;
+}
+
+/**
+ * @brief Whether {parallelReduce} folds its partial results in index order,
+ * checked with a fold that is not commutative and with a floating-point sum
+ * that must not change from run to run.
+ */
+static bool testReduceOrder(ThreadPool &threadPool) {
+  constexpr u64 indexCount = 10000;
+  constexpr u64 grainSize = 37;
+  /* Chunk begins in the order they were folded */
+  auto chunkBegins = parallelReduce(
+      threadPool, 0, indexCount, grainSize, std::vector<u64>{},
+      [](u64 chunkBegin, u64) { return std::vector<u64>{chunkBegin}; },
+      [](std::vector<u64> lhs, std::vector<u64> rhs) {
+        lhs.insert(lhs.end(), rhs.begin(), rhs.end());
+        return lhs;
+      });
+  bool ordered =
+      chunkBegins.size() == (indexCount + grainSize - 1) / grainSize;
+  for (u64 iChunk = 0; iChunk < chunkBegins.size(); ++iChunk) {
+    ordered = ordered && chunkBegins[iChunk] == iChunk * grainSize;
+  }
+
+  /* Terms of very different magnitudes, whose float sum depends on the
+  order it is taken in */
+  auto term = [](u64 index) {
+    return index % 7 == 0 ? 1e7f : 0.1f * static_cast<f32>(index);
+  };
+  auto sumTerms = [&](u64 chunkBegin, u64 chunkEnd) {
+    f32 sum = 0.0f;
+    for (u64 index = chunkBegin; index < chunkEnd; ++index) {
+      sum += term(index);
+    }
+    return sum;
+  };
+  f32 expectedSum = 0.0f;
+  for (u64 chunkBegin = 0; chunkBegin < indexCount; chunkBegin += grainSize) {
+    expectedSum +=
+        sumTerms(chunkBegin, std::min(chunkBegin + grainSize, indexCount));
+  }
+  bool deterministic = true;
+  for (u32 iRun = 0; iRun < 20; ++iRun) {
+    f32 sum =
+        parallelReduce(threadPool, 0, indexCount, grainSize, 0.0f, sumTerms,
+                       [](f32 lhs, f32 rhs) { return lhs + rhs; });
+    deterministic = deterministic && sum == expectedSum;
+  }
+  std::printf("Reduce: %zu chunks folded %s, sums %s\n",
+              chunkBegins.size(), ordered ? "in order" : "out of order",
+              deterministic ? "identical" : "differing");
+  return ordered && deterministic;
+}
+
+/**
+ * @brief Job waiting on {nestedFanOut} jobs of the next level, down to
+ * {nestedDepth}. More jobs wait at once than the pool has threads, so the
+ * tree only completes if waiting workers run the jobs of other waits.
+ */
+static void runNestedJob(ThreadPool &threadPool, u32 level,
+                         std::atomic<u64> &leafCount,
+                         std::atomic<u64> &helpedCount) {
+  if (waitDepth > 0) {
+    helpedCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (level == nestedDepth) {
+    leafCount.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  JobCounter counter;
+  for (u32 iChild = 0; iChild < nestedFanOut; ++iChild) {
+    threadPool.submit(
+        [&threadPool, level, &leafCount, &helpedCount] {
+          runNestedJob(threadPool, level + 1, leafCount, helpedCount);
+        },
+        counter);
+  }
+  ++waitDepth;
+  threadPool.wait(counter);
+  --waitDepth;
+}
+
+static bool testNestedWaits(ThreadPool &threadPool) {
+  std::atomic<u64> leafCount = 0;
+  std::atomic<u64> helpedCount = 0;
+  JobCounter counter;
+  threadPool.submit(
+      [&threadPool, &leafCount, &helpedCount] {
+        runNestedJob(threadPool, 0, leafCount, helpedCount);
+      },
+      counter);
+  threadPool.wait(counter);
+
+  /* Nested {parallelFor}s wait from workers too */
+  std::atomic<u64> cellCount = 0;
+  parallelFor(threadPool, 0, 16, 1, [&](u64) {
+    parallelFor(threadPool, 0, 16, 1, [&](u64) {
+      parallelFor(threadPool, 0, 16, 1, [&](u64) {
+        cellCount.fetch_add(1, std::memory_order_relaxed);
+      });
+    });
+  });
+
+  u64 expectedLeafCount = 1;
+  for (u32 level = 0; level < nestedDepth; ++level) {
+    expectedLeafCount *= nestedFanOut;
+  }
+  std::printf("Nested waits: %llu / %llu leaves, %llu jobs run by waiting "
+              "threads, %llu / 4096 cells\n",
+              static_cast<unsigned long long>(leafCount.load()),
+              static_cast<unsigned long long>(expectedLeafCount),
+              static_cast<unsigned long long>(helpedCount.load()),
+              static_cast<unsigned long long>(cellCount.load()));
+  return leafCount.load() == expectedLeafCount && helpedCount.load() > 0 &&
+         cellCount.load() == 16 * 16 * 16;
+}
+
+bool testParallel(ThreadPool &threadPool) {
+  bool grainSplitting = testGrainSplitting(threadPool);
+  bool reduceOrder = testReduceOrder(threadPool);
+  bool nestedWaits = testNestedWaits(threadPool);
+  return grainSplitting && reduceOrder && nestedWaits;
+}
+
+} /* namespace neko */
@@ -0,0 +1,175 @@
+#include "tests.hpp"
+
+#include "task_graph.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace neko {
+
+/* Runs of each graph, so that the tasks get scheduled in different orders */
+static constexpr u32 runCount = 100;
+
+/* Tasks of the random graph, each depending on up to {maxPredecessorCount}
+earlier ones */
+static constexpr u32 randomTaskCount = 64;
+static constexpr u32 maxPredecessorCount = 3;
+
+/**
+ * @brief Whether a graph with a cycle is rejected by {run} without running
+ * any task, as is a dependency on a task that does not exist.
+ */
+static bool testCycle(ThreadPool &threadPool) {
+  std::atomic<u32> startedCount = 0;
+  TaskGraph graph;
+  auto countRun = [&startedCount] { startedCount.fetch_add(1); };
+  TaskGraph::TaskId first = graph.addTask(countRun);
+  TaskGraph::TaskId second = graph.addTask(countRun);
+  TaskGraph::TaskId third = graph.addTask(countRun);
+  graph.addTask(countRun);
+  graph.addDependency(first, second);
+  graph.addDependency(second, third);
+  graph.addDependency(third, first);
+  bool cycleRejected = false;
+  try {
+    graph.run(threadPool);
+  } catch (const std::runtime_error &) {
+    cycleRejected = true;
+  }
+  bool unknownRejected = false;
+  try {
+    graph.addDependency(first, graph.taskCount());
+  } catch (const std::runtime_error &) {
+    unknownRejected = true;
+  }
+  std::printf("Cycle: %s, %u tasks run, unknown task %s\n",
+              cycleRejected ? "rejected" : "accepted", startedCount.load(),
+              unknownRejected ? "rejected" : "accepted");
+  return cycleRejected && unknownRejected && startedCount.load() == 0;
+}
+
+/**
+ * @brief Whether every task of a random graph starts after all of its
+ * predecessors have finished, and runs once per {run}.
+ */
+static bool testDependencyOrder(ThreadPool &threadPool) {
+  std::vector<std::vector<u32>> predecessors(randomTaskCount);
+  u64 seed = 0x9e3779b97f4a7c15ull;
+  for (u32 iTask = 1; iTask < randomTaskCount; ++iTask) {
+    for (u32 iEdge = 0; iEdge < maxPredecessorCount; ++iEdge) {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      auto iPredecessor = static_cast<u32>((seed >> 33) % iTask);
+      if (std::find(predecessors[iTask].begin(), predecessors[iTask].end(),
+                    iPredecessor) == predecessors[iTask].end()) {
+        predecessors[iTask].push_back(iPredecessor);
+      }
+    }
+  }
+
+  /* Run in which each task last finished, and tasks started early */
+  std::vector<std::atomic<u32>> finishedRuns(randomTaskCount);
+  std::atomic<u32> earlyStartCount = 0;
+  u32 runIndex = 0;
+  TaskGraph graph;
+  for (u32 iTask = 0; iTask < randomTaskCount; ++iTask) {
+    graph.addTask([&, iTask] {
+      for (u32 iPredecessor : predecessors[iTask]) {
+        if (finishedRuns[iPredecessor].load() != runIndex + 1) {
+          earlyStartCount.fetch_add(1);
+        }
+      }
+      finishedRuns[iTask].store(runIndex + 1);
+    });
+  }
+  for (u32 iTask = 0; iTask < randomTaskCount; ++iTask) {
+    for (u32 iPredecessor : predecessors[iTask]) {
+      graph.addDependency(iPredecessor, iTask);
+    }
+  }
+
+  u32 missedCount = 0;
+  for (runIndex = 0; runIndex < runCount; ++runIndex) {
+    graph.run(threadPool);
+    for (const auto &finishedRun : finishedRuns) {
+      if (finishedRun.load() != runIndex + 1) {
+        ++missedCount;
+      }
+    }
+  }
+  std::printf("Dependency order: %u tasks started early, %u not run\n",
+              earlyStartCount.load(), missedCount);
+  return earlyStartCount.load() == 0 && missedCount == 0;
+}
+
+/* Thrown by the failing task, identified by {runIndex} */
+struct TaskFailure {
+  u32 runIndex;
+};
+
+/**
+ * @brief Graph whose middle task throws: its successors must be skipped, the
+ * tasks that do not depend on it must still run, and {run} must rethrow its
+ * exception.
+ */
+static bool testFailingTask(ThreadPool &threadPool) {
+  enum : u32 {
+    root,
+    failing,
+    successor,
+    descendant,
+    join,
+    sibling,
+    independent,
+    taskCount,
+  };
+  std::atomic<u32> runCounts[taskCount] = {};
+  u32 runIndex = 0;
+  TaskGraph graph;
+  for (u32 iTask = 0; iTask < taskCount; ++iTask) {
+    graph.addTask([&runCounts, &runIndex, iTask] {
+      runCounts[iTask].fetch_add(1, std::memory_order_relaxed);
+      if (iTask == failing) {
+        throw TaskFailure{runIndex};
+      }
+    });
+  }
+  graph.addDependency(root, failing);
+  graph.addDependency(failing, successor);
+  graph.addDependency(successor, descendant);
+  graph.addDependency(root, sibling);
+  graph.addDependency(failing, join);
+  graph.addDependency(sibling, join);
+
+  u32 rethrowCount = 0;
+  for (runIndex = 0; runIndex < runCount; ++runIndex) {
+    try {
+      graph.run(threadPool);
+    } catch (const TaskFailure &failure) {
+      if (failure.runIndex == runIndex) {
+        ++rethrowCount;
+      }
+    }
+  }
+  bool passed = rethrowCount == runCount;
+  for (u32 iTask = 0; iTask < taskCount; ++iTask) {
+    bool skipped = iTask == successor || iTask == descendant || iTask == join;
+    passed = passed && runCounts[iTask].load() == (skipped ? 0 : runCount);
+  }
+  std::printf("Failing task: %u / %u rethrown, successors run %u times, "
+              "independent tasks run %u times\n",
+              rethrowCount, runCount,
+              runCounts[successor].load() + runCounts[descendant].load() +
+                  runCounts[join].load(),
+              runCounts[sibling].load() + runCounts[independent].load());
+  return passed;
+}
+
+bool testTaskGraph(ThreadPool &threadPool) {
+  bool cycle = testCycle(threadPool);
+  bool dependencyOrder = testDependencyOrder(threadPool);
+  bool failingTask = testFailingTask(threadPool);
+  return cycle && dependencyOrder && failingTask;
+}
+
+} /* namespace neko */
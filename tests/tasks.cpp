@@ -0,0 +1,149 @@
+#include "tests.hpp"
+
+#include "io.hpp"
+#include "task.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace neko {
+
+/* Pool jobs also run on the thread blocked in {syncWait} or {wait} */
+static bool onPoolThread(const ThreadPool &threadPool,
+                         std::thread::id callerId) noexcept {
+  return threadPool.isWorkerThread() || std::this_thread::get_id() == callerId;
+}
+
+static Task<u64> square(ThreadPool &threadPool, u64 value) {
+  co_await schedule(threadPool);
+  co_return value * value;
+}
+
+static Task<u64> spinUntilCancelled(ThreadPool &threadPool,
+                                    const CancellationToken &token,
+                                    JobCounter &counter) {
+  while (!token.cancelled()) {
+    co_await schedule(threadPool, JobPriority::background);
+  }
+  /* Neither {token} nor {counter} may be used past this point */
+  threadPool.signal(counter);
+  co_return 0;
+}
+
+static Task<u64> readFileSize(ThreadPool &threadPool, IoService &ioService,
+                              std::string filePath, std::thread::id callerId,
+                              std::atomic<u32> &misplacedResumeCount) {
+  std::vector<u8> data = co_await ioService.readFile(std::move(filePath));
+  if (!onPoolThread(threadPool, callerId)) {
+    misplacedResumeCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  co_return data.size();
+}
+
+/* Started on the calling thread, so the request is queued before it returns */
+static DetachedTask readOnShutdown(ThreadPool &threadPool, IoService &ioService,
+                                   std::string filePath, JobCounter &counter,
+                                   u64 &readSize) {
+  try {
+    readSize = (co_await ioService.readFile(std::move(filePath))).size();
+  } catch (const std::exception &) {
+    readSize = 0;
+  }
+  threadPool.signal(counter);
+}
+
+bool testTasks(ThreadPool &threadPool) {
+  std::thread::id callerId = std::this_thread::get_id();
+  u32 mismatchCount = 0;
+  u32 missedErrorCount = 0;
+  std::atomic<u32> misplacedResumeCount = 0;
+
+  std::vector<Task<u64>> squares;
+  for (u64 value = 0; value < 16; ++value) {
+    squares.push_back(square(threadPool, value));
+  }
+  std::vector<u64> squareValues =
+      syncWait(threadPool, whenAll(threadPool, std::move(squares)));
+  for (u64 value = 0; value < squareValues.size(); ++value) {
+    mismatchCount += squareValues[value] != value * value;
+  }
+
+  /* The losers only return once cancelled, so the last task has to win */
+  static constexpr u32 loserCount = 3;
+  CancellationToken loserToken;
+  JobCounter loserCounter;
+  std::vector<Task<u64>> racers;
+  for (u32 iLoser = 0; iLoser < loserCount; ++iLoser) {
+    threadPool.retain(loserCounter);
+    racers.push_back(spinUntilCancelled(threadPool, loserToken, loserCounter));
+  }
+  racers.push_back(square(threadPool, 7));
+  auto [winnerIndex, winnerValue] =
+      syncWait(threadPool, whenAny(threadPool, std::move(racers)));
+  mismatchCount += winnerIndex != loserCount;
+  mismatchCount += winnerValue != 49;
+  loserToken.cancel();
+  threadPool.wait(loserCounter);
+
+  static constexpr u64 fileSize = 1 << 16;
+  std::string filePath =
+      (std::filesystem::temp_directory_path() / "neko-tasks-test.bin")
+          .string();
+  {
+    std::ofstream fs(filePath, std::ios::binary);
+    for (u64 iByte = 0; iByte < fileSize; ++iByte) {
+      fs.put(static_cast<char>(iByte));
+    }
+  }
+  std::string missingPath = filePath + ".missing";
+  {
+    IoService ioService{threadPool};
+    std::vector<Task<u64>> reads;
+    for (u32 iRead = 0; iRead < 4; ++iRead) {
+      reads.push_back(readFileSize(threadPool, ioService, filePath, callerId,
+                                   misplacedResumeCount));
+    }
+    for (u64 readSize :
+         syncWait(threadPool, whenAll(threadPool, std::move(reads)))) {
+      mismatchCount += readSize != fileSize;
+    }
+
+    try {
+      syncWait(threadPool, readFileSize(threadPool, ioService, missingPath,
+                                        callerId, misplacedResumeCount));
+      ++missedErrorCount;
+    } catch (const std::runtime_error &) {
+    }
+    reads.clear();
+    reads.push_back(readFileSize(threadPool, ioService, filePath, callerId,
+                                 misplacedResumeCount));
+    reads.push_back(readFileSize(threadPool, ioService, missingPath, callerId,
+                                 misplacedResumeCount));
+    try {
+      syncWait(threadPool, whenAll(threadPool, std::move(reads)));
+      ++missedErrorCount;
+    } catch (const std::runtime_error &) {
+    }
+  }
+
+  JobCounter shutdownCounter;
+  u64 shutdownReadSize = 0;
+  {
+    IoService ioService{threadPool};
+    threadPool.retain(shutdownCounter);
+    readOnShutdown(threadPool, ioService, filePath, shutdownCounter,
+                   shutdownReadSize);
+  }
+  threadPool.wait(shutdownCounter);
+  mismatchCount += shutdownReadSize != fileSize;
+  std::filesystem::remove(filePath);
+
+  std::printf("Tasks: %u resumed outside the pool, %u mismatches, %u missed "
+              "errors\n",
+              misplacedResumeCount.load(), mismatchCount, missedErrorCount);
+  return misplacedResumeCount.load() == 0 && mismatchCount == 0 &&
+         missedErrorCount == 0;
+}
+
+} /* namespace neko */
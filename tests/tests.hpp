@@ -0,0 +1,58 @@
+#ifndef NEKO_TESTS_HPP
+#define NEKO_TESTS_HPP
+
+#include "threads.hpp"
+
+namespace neko {
+
+/**
+ * @brief Compares the masks of {Scene::occluded8} with scalar {Scene::occluded}
+ * queries on random shadow rays of the Cornell box, full and partial packets,
+ * for every BVH layout and every instruction set the CPU supports.
+ *
+ * @return whether every packet agreed with its lanes traced one by one
+ */
+bool testOcclusion(ThreadPool &threadPool);
+
+/**
+ * @brief Splits ranges with {parallelForRange} and {parallelFor}, folds with
+ * {parallelReduce}, and runs trees of jobs that wait on their children from
+ * the workers.
+ *
+ * @return whether every range was covered by chunks of the grain size, every
+ * fold was taken in index order, and every nested wait completed by having
+ * waiting threads run jobs
+ */
+bool testParallel(ThreadPool &threadPool);
+
+/**
+ * @brief Runs a {TaskGraph} with a cycle, a random acyclic one, and one whose
+ * middle task throws, many times over.
+ *
+ * @return whether the cycle was rejected, every task started after its
+ * predecessors, and every failure skipped the tasks depending on the failed
+ * one, ran the others, and was rethrown by {run}
+ */
+bool testTaskGraph(ThreadPool &threadPool);
+
+/**
+ * @brief Runs {Task}s through {syncWait}, {whenAll} and {whenAny}, cancelling
+ * the tasks {whenAny} did not wait for, and reads a file with an {IoService},
+ * including a failed read and one still pending when the service shuts down.
+ *
+ * @return whether every result, resume thread and error was the expected one
+ */
+bool testTasks(ThreadPool &threadPool);
+
+/**
+ * @brief Runs frames of a headless loop blocked in {EventBus::waitForEvents},
+ * a second thread publishing numbered events in each, without a window.
+ *
+ * @return whether every wait woke up on its events and every frame delivered
+ * them as one batch in order
+ */
+bool testEventBus(ThreadPool &threadPool);
+
+} /* namespace neko */
+
+#endif /* NEKO_TESTS_HPP */
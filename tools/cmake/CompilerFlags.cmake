@@ -7,9 +7,10 @@ set(msvc_cxx_flags -W3)
 
 option(CMAKE_BUILD_TYPE Debug)
 option(BUILD_SHARED_LIBS OFF)
+option(NEKO_PROFILING "Compile the zone profiler in" OFF)
 
 add_library(compiler_flags INTERFACE)
-target_compile_features(compiler_flags INTERFACE cxx_std_17)
+target_compile_features(compiler_flags INTERFACE cxx_std_20)
 target_compile_options(compiler_flags INTERFACE
     $<${gcc_like_cxx}: $<BUILD_INTERFACE: ${gcc_like_cxx_flags}>>
     $<${msvc_cxx}: $<BUILD_INTERFACE: ${msvc_cxx_flags}>>
@@ -19,7 +19,13 @@ install(FILES
     ${PROJECT_SOURCE_DIR}/src/engine/engine.hpp
     ${PROJECT_SOURCE_DIR}/src/events/events.hpp
     ${PROJECT_SOURCE_DIR}/src/renderer/renderer.hpp
+    ${PROJECT_SOURCE_DIR}/src/threads/io.hpp
+    ${PROJECT_SOURCE_DIR}/src/threads/job.hpp
+    ${PROJECT_SOURCE_DIR}/src/threads/parallel.hpp
+    ${PROJECT_SOURCE_DIR}/src/threads/task.hpp
+    ${PROJECT_SOURCE_DIR}/src/threads/task_graph.hpp
     ${PROJECT_SOURCE_DIR}/src/threads/threads.hpp
+    ${PROJECT_SOURCE_DIR}/src/threads/topology.hpp
     ${PROJECT_SOURCE_DIR}/src/utils/utils.hpp
     DESTINATION ${PROJECT_SOURCE_DIR}/install/include/neko
 )